@@ -118,6 +118,9 @@ bool Application::update()
     // シーンの更新
     m_pSceneManager->update(elapsedTime, deltaTime);
 
+    // 更新で変わったモーフをまとめて適用し始める (物理と並行して進み,描画の前に待つ)
+    m_pModelManager->dispatchMorphs();
+
     // 物理シミュレーション
     m_pPhysicsManager->simulate(deltaTime);
 
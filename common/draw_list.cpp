@@ -0,0 +1,265 @@
+//--------------------------------------------
+//
+// 描画リスト (カリングとソート) [draw_list.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "draw_list.h"
+#include <bit>         // std::bit_cast (ソートキー)
+#include <immintrin.h> // SSE (カリング)
+
+namespace
+{
+    //--------------
+    // 奥行きを順序を保ったビット列にする関数 (正のfloatはビット列の大小が値の大小と一致する)
+    //--------------
+    uint32_t DepthToBits(float depth)
+    {
+        return (depth > 0.0f) ? std::bit_cast<uint32_t>(depth) : 0u;
+    }
+}
+
+//--------------
+// ソートキーの作成関数
+//--------------
+uint64_t draw::MakeSortKey(RenderQueue queue, RasMode rasMode, const DrawKeyState& state, float depth, uint32_t sequence)
+{
+    uint64_t key = static_cast<uint64_t>(queue) << SORT_KEY_QUEUE_SHIFT;
+    switch (queue)
+    {
+    case RenderQueue::Transparent: // 奥から手前 (ブレンドの順番を優先)
+        key |= static_cast<uint64_t>(~DepthToBits(depth)) << 28;
+        key |= static_cast<uint64_t>(static_cast<uint8_t>(rasMode) & 0x7u) << 25;
+        key |= static_cast<uint64_t>(state.shader & 0x1fu) << 20;
+        key |= static_cast<uint64_t>(state.texture & 0x3fffu) << 6;
+        key |= static_cast<uint64_t>(state.mesh & 0x3fu);
+        break;
+    case RenderQueue::UI:     // 登録順 (重なり順を変えない)
+    case RenderQueue::String: //
+        key |= static_cast<uint64_t>(sequence) << 28;
+        break;
+    default:                   // 状態の切り替えが少ない順,同じ状態なら手前から
+        key |= static_cast<uint64_t>(static_cast<uint8_t>(rasMode) & 0x7u) << 57;
+        key |= static_cast<uint64_t>(state.shader & 0x1fu) << 52;
+        key |= static_cast<uint64_t>(state.texture & 0x3fffu) << 38;
+        key |= static_cast<uint64_t>(state.material & 0x3ffu) << 28;
+        key |= static_cast<uint64_t>(state.mesh & 0x3fffu) << 14;
+        key |= static_cast<uint64_t>(DepthToBits(depth) >> 17); // 符号ビットを除いた上位14bit
+        break;
+    }
+    return key;
+}
+
+//--------------
+// 同じマテリアルか (パディングがあるのでメンバーごとに比べる)
+//--------------
+bool draw::IsSameMaterial(const Material& a, const Material& b)
+{
+    auto isSameColor = [](const Color& ca, const Color& cb) { return ca.r == cb.r && ca.g == cb.g && ca.b == cb.b && ca.a == cb.a; };
+    return isSameColor(a.Diffuse, b.Diffuse) && isSameColor(a.Specular, b.Specular) && isSameColor(a.Emissive, b.Emissive) &&
+        a.Power == b.Power && a.AlphaCutoff == b.AlphaCutoff && a.pixelShaderType == b.pixelShaderType;
+}
+
+//--------------
+// 同じ描画状態か (インスタンシングでまとめられるか)
+//--------------
+bool draw::IsSameInstanceState(const InstanceDrawDesc& a, const InstanceDrawDesc& b)
+{
+    return a.mesh.id == b.mesh.id && a.texture.id == b.texture.id && a.rasMode == b.rasMode && IsSameMaterial(a.material, b.material);
+}
+
+//--------------
+// 視錐台カリング関数 (SoAの境界ボックスを4つずつ判定する)
+//--------------
+void draw::CullFrustum(const Frustum& frustum, const CullBounds& bounds, std::vector<uint8_t>& outVisible)
+{
+    outVisible.resize(bounds.size());
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (size_t cnt = 0; cnt < bounds.size(); cnt += 4u)
+    {
+        __m128 centerX = _mm_loadu_ps(&bounds.centerX[cnt]), centerY = _mm_loadu_ps(&bounds.centerY[cnt]), centerZ = _mm_loadu_ps(&bounds.centerZ[cnt]);
+        __m128 extentX = _mm_loadu_ps(&bounds.extentX[cnt]), extentY = _mm_loadu_ps(&bounds.extentY[cnt]), extentZ = _mm_loadu_ps(&bounds.extentZ[cnt]);
+
+        // どれか1つの平面の完全に外側なら見えない
+        __m128 outside = zero;
+        for (const auto& plane : frustum.planes)
+        {
+            __m128 normalX = _mm_set1_ps(plane.x), normalY = _mm_set1_ps(plane.y), normalZ = _mm_set1_ps(plane.z);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_mul_ps(normalY, centerY)), _mm_add_ps(_mm_mul_ps(normalZ, centerZ), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(normalX, signMask), extentX), _mm_mul_ps(_mm_and_ps(normalY, signMask), extentY)), _mm_mul_ps(_mm_and_ps(normalZ, signMask), extentZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < 4u; ++lane)
+        {
+            outVisible[cnt + lane] = ((mask >> lane) & 1) == 0 ? 1u : 0u;
+        }
+    }
+}
+
+//--------------
+// 描画アイテムの基数ソート関数 (8bitずつ8パス 安定 全要素で同じ桁は飛ばす)
+//--------------
+void draw::RadixSortDrawItems(std::vector<DrawItem>& items, std::vector<DrawItem>& work)
+{
+    if (items.size() < 2u)
+    {
+        return;
+    }
+
+    // 全桁のヒストグラムを1回の走査で作る
+    std::array<std::array<size_t, 256>, 8> counts{};
+    for (const auto& item : items)
+    {
+        for (size_t cntDigit = 0; cntDigit < counts.size(); ++cntDigit)
+        {
+            ++counts[cntDigit][(item.key >> (cntDigit * 8u)) & 0xffu];
+        }
+    }
+
+    work.resize(items.size());
+    for (size_t cntDigit = 0; cntDigit < counts.size(); ++cntDigit)
+    {
+        size_t shift = cntDigit * 8u;
+        auto& count = counts[cntDigit];
+        if (count[(items.front().key >> shift) & 0xffu] == items.size())
+        {
+            continue; // 全部同じ値なので並びは変わらない
+        }
+
+        size_t offset = 0u;
+        for (auto& bucket : count)
+        {
+            size_t num = bucket;
+            bucket = offset;
+            offset += num;
+        }
+
+        for (const auto& item : items)
+        {
+            work[count[(item.key >> shift) & 0xffu]++] = item;
+        }
+        items.swap(work);
+    }
+}
+
+//-------------------------------------------
+// カリング用の境界ボックスを集める (SoA)
+//-------------------------------------------
+void DrawList::buildBounds(std::span<RenderComponent* const> renderComponents, const Renderer& renderer)
+{
+    m_cullBounds.resize((renderComponents.size() + 3u) & ~size_t(3u)); // 4の倍数 (端数は原点の点)
+    m_staticCasters.assign(renderComponents.size(), 0u);
+    m_occluders.clear();
+    m_staticCasterKey = 14695981039346656037ull; // FNV-1a (64bit)
+    m_staticCasterCount = 0u;
+    auto mixKey = [this](uint64_t value) { m_staticCasterKey = (m_staticCasterKey ^ value) * 1099511628211ull; };
+
+    for (size_t cnt = 0; cnt < renderComponents.size(); ++cnt)
+    {
+        // 動かない影を落とすものは顔ぶれと変更回数を覚える (どれかが動いたり増減したら影のキャッシュを作り直す)
+        RenderComponent* pComponent = renderComponents[cnt];
+        if (pComponent->getRenderQueue() == RenderQueue::Shadow && pComponent->isStaticCaster())
+        {
+            m_staticCasters[cnt] = 1u;
+            ++m_staticCasterCount;
+            mixKey(reinterpret_cast<uintptr_t>(pComponent));
+            mixKey(pComponent->getTransformVersion());
+        }
+
+        // 遮蔽物の候補
+        OccluderBox occluder{};
+        if (pComponent->isOccluder() && pComponent->getOccluderBox(renderer, occluder.world, occluder.local) && occluder.local.isValid())
+        {
+            occluder.index = static_cast<uint32_t>(cnt);
+            m_occluders.push_back(occluder);
+        }
+
+        AABB bounds{};
+        if (!renderComponents[cnt]->getWorldBounds(renderer, bounds) || !bounds.isValid())
+        {// 境界ボックスがないものは常に見える
+            m_cullBounds.extentX[cnt] = m_cullBounds.extentY[cnt] = m_cullBounds.extentZ[cnt] = draw::UNBOUNDED_EXTENT;
+            continue;
+        }
+
+        Vector3 center = bounds.getCenter(), extent = bounds.getExtent();
+        m_cullBounds.centerX[cnt] = center.x; m_cullBounds.centerY[cnt] = center.y; m_cullBounds.centerZ[cnt] = center.z;
+        m_cullBounds.extentX[cnt] = extent.x; m_cullBounds.extentY[cnt] = extent.y; m_cullBounds.extentZ[cnt] = extent.z;
+    }
+}
+
+//-------------------------------------------
+// 見えているものを動かない影と動く影に分ける
+//-------------------------------------------
+void DrawList::splitStaticCasters(std::span<const uint8_t> visible, std::vector<uint8_t>& outStatic, std::vector<uint8_t>& outDynamic) const
+{
+    outStatic.assign(visible.begin(), visible.end());
+    outDynamic.assign(visible.begin(), visible.end());
+    for (size_t cnt = 0; cnt < m_staticCasters.size() && cnt < visible.size(); ++cnt)
+    {
+        if (m_staticCasters[cnt] != 0u)
+        {
+            outDynamic[cnt] = 0u;
+        }
+        else
+        {
+            outStatic[cnt] = 0u;
+        }
+    }
+}
+
+//-------------------------------------------
+// 描画アイテムの作成 (見えないものを除いてソートキーを作り基数ソートする)
+//-------------------------------------------
+void DrawList::build(std::span<RenderComponent* const> renderComponents, const Matrix& view, std::span<const uint8_t> visible)
+{
+    m_drawItems.clear();
+    m_drawItems.reserve(renderComponents.size());
+
+    uint32_t sequence = 0u;
+    for (size_t cnt = 0; cnt < renderComponents.size(); ++cnt)
+    {
+        RenderComponent* pComponent = renderComponents[cnt];
+        RenderQueue queue = pComponent->getRenderQueue();
+
+        // 影はライトごとに判定するのでここでは除かない
+        if (queue != RenderQueue::Shadow && cnt < visible.size() && visible[cnt] == 0u)
+        {
+            ++sequence;
+            continue;
+        }
+
+        // ビュー空間の奥行き (UIとStringは登録順なので不要)
+        float depth = 0.0f;
+        Vector3 position{};
+        if (queue != RenderQueue::UI && queue != RenderQueue::String && pComponent->getSortPosition(position))
+        {
+            depth = position.x * view.m[0][2] + position.y * view.m[1][2] + position.z * view.m[2][2] + view.m[3][2];
+        }
+
+        m_drawItems.emplace_back(draw::MakeSortKey(queue, pComponent->getRasMode(), pComponent->getDrawKeyState(), depth, sequence++), pComponent, static_cast<uint32_t>(cnt));
+    }
+
+    draw::RadixSortDrawItems(m_drawItems, m_drawItemsWork);
+
+    // キューごとの範囲 (ソート済みなので二分探索)
+    for (size_t cntQueue = 0; cntQueue < m_queueStarts.size(); ++cntQueue)
+    {
+        m_queueStarts[cntQueue] = static_cast<size_t>(std::partition_point(m_drawItems.begin(), m_drawItems.end(),
+            [cntQueue](const DrawItem& item) { return (item.key >> draw::SORT_KEY_QUEUE_SHIFT) < cntQueue; }) - m_drawItems.begin());
+    }
+}
+
+//-------------------------------------------
+// キューの描画アイテムを取得 (ソート済み)
+//-------------------------------------------
+std::span<const DrawItem> DrawList::getQueue(RenderQueue queue) const
+{
+    size_t queueIndex = static_cast<size_t>(queue);
+    size_t end = std::min(m_queueStarts[queueIndex + 1u], m_drawItems.size());
+    size_t start = std::min(m_queueStarts[queueIndex], end);
+    return std::span<const DrawItem>(m_drawItems.data() + start, end - start);
+}
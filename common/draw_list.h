@@ -0,0 +1,109 @@
+//--------------------------------------------
+//
+// 描画リスト (カリングとソート) [draw_list.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "render.h" // RenderComponent, InstanceDrawDesc
+#include <span>
+#include <vector>
+
+class Renderer;
+
+// 描画アイテム (1フレーム分の配列をソートキーで並べ替えて描画する)
+struct DrawItem
+{
+    uint64_t key;                 // ソートキー (上位4bitがRenderQueue)
+    RenderComponent* pComponent;  // 描画するコンポーネント
+    uint32_t index;               // コンポーネント番号 (カリング結果の参照用)
+
+    DrawItem() : key{}, pComponent{}, index{} {}
+    DrawItem(uint64_t sortKey, RenderComponent* pRenderComponent, uint32_t componentIndex) : key{ sortKey }, pComponent{ pRenderComponent }, index{ componentIndex } {}
+    ~DrawItem() = default;
+};
+
+// カリング用の境界ボックス (SoA 要素数は4の倍数)
+struct CullBounds
+{
+    std::vector<float> centerX, centerY, centerZ; // 中心
+    std::vector<float> extentX, extentY, extentZ; // 半分の大きさ
+
+    CullBounds() : centerX{}, centerY{}, centerZ{}, extentX{}, extentY{}, extentZ{} {}
+    ~CullBounds() = default;
+
+    void resize(size_t count)
+    {
+        for (auto* pArray : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+        {
+            pArray->assign(count, 0.0f);
+        }
+    }
+    size_t size() const { return centerX.size(); }
+};
+
+// 遮蔽物の箱 (中身が詰まっているものだけ 箱の面を深度バッファに描く)
+struct OccluderBox
+{
+    Matrix world;   // ワールド行列
+    AABB local;     // ローカルの境界ボックス
+    uint32_t index; // コンポーネント番号 (カメラから見えるかの参照用)
+
+    OccluderBox() : world{}, local{}, index{} {}
+    ~OccluderBox() = default;
+};
+
+namespace draw
+{
+    // ソートキーのビット配置 (上位から)
+    // 不透明    : queue 4 | ras 3 | shader 5 | texture 14 | material 10 | mesh 14 | depth 14 (手前から)
+    // 半透明    : queue 4 | depth 32 (奥から) | ras 3 | shader 5 | texture 14 | mesh 6
+    // UI,String : queue 4 | 登録順 32
+    constexpr int SORT_KEY_QUEUE_SHIFT = 60;
+    constexpr float UNBOUNDED_EXTENT = 1.0e30f; // 境界ボックスを持たないものの大きさ (必ず可視)
+    constexpr size_t MIN_INSTANCE_BATCH = 2u;   // これ以上並んだらインスタンシングで描画する
+
+    //--------------
+    // インスタンシングでまとめてよいキューか (アウトラインとデカールは専用の頂点シェーダー,UIは登録順)
+    //--------------
+    constexpr bool IsInstancingQueue(RenderQueue queue)
+    {
+        return queue == RenderQueue::Shadow || queue == RenderQueue::Geometry || queue == RenderQueue::Sky || queue == RenderQueue::Transparent;
+    }
+
+    uint64_t MakeSortKey(RenderQueue queue, RasMode rasMode, const DrawKeyState& state, float depth, uint32_t sequence);
+    bool IsSameMaterial(const Material& a, const Material& b);
+    bool IsSameInstanceState(const InstanceDrawDesc& a, const InstanceDrawDesc& b);
+    void CullFrustum(const Frustum& frustum, const CullBounds& bounds, std::vector<uint8_t>& outVisible);
+    void RadixSortDrawItems(std::vector<DrawItem>& items, std::vector<DrawItem>& work);
+}
+
+//----------------------------
+// 描画リスト (バックエンドに依存しないフレームの準備 境界ボックスを集め,カリングし,キューごとにソートする)
+//----------------------------
+class DrawList
+{
+public:
+    DrawList() : m_drawItems{}, m_drawItemsWork{}, m_queueStarts{}, m_cullBounds{}, m_occluders{}, m_staticCasters{}, m_staticCasterKey{}, m_staticCasterCount{} {}
+    ~DrawList() = default;
+
+    void buildBounds(std::span<RenderComponent* const> renderComponents, const Renderer& renderer);
+    void cull(const Frustum& frustum, std::vector<uint8_t>& outVisible) const { draw::CullFrustum(frustum, m_cullBounds, outVisible); }
+    const CullBounds& getCullBounds() const { return m_cullBounds; }
+    std::span<const OccluderBox> getOccluders() const { return m_occluders; }
+    void splitStaticCasters(std::span<const uint8_t> visible, std::vector<uint8_t>& outStatic, std::vector<uint8_t>& outDynamic) const;
+    uint64_t getStaticCasterKey() const { return m_staticCasterKey; } // 動かない影を落とすものの顔ぶれと変更回数 (変わったら影のキャッシュを作り直す)
+    size_t getStaticCasterCount() const { return m_staticCasterCount; }
+    void build(std::span<RenderComponent* const> renderComponents, const Matrix& view, std::span<const uint8_t> visible);
+    std::span<const DrawItem> getQueue(RenderQueue queue) const;
+
+private:
+    std::vector<DrawItem> m_drawItems;                                 // ソート済みの描画アイテム
+    std::vector<DrawItem> m_drawItemsWork;                             // 基数ソートの作業領域
+    std::array<size_t, size_t(RenderQueue::Max) + 1u> m_queueStarts;   // キューごとの先頭位置
+    CullBounds m_cullBounds;                                           // コンポーネントのワールド境界ボックス (カメラとライトで共有)
+    std::vector<OccluderBox> m_occluders;                              // 遮蔽物の候補 (カメラごとに画面に大きく映るものを選ぶ)
+    std::vector<uint8_t> m_staticCasters;                              // 動かない影を落とすものか (コンポーネント番号)
+    uint64_t m_staticCasterKey;                                        // ↑のハッシュ (ポインタとTransformの変更回数)
+    size_t m_staticCasterCount;                                        // ↑の数
+};
@@ -0,0 +1,104 @@
+//--------------------------------------------
+//
+// 動的解像度 (フレーム時間から3Dを描く解像度を決める) [dynamic_resolution.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+
+//-------------------------------------------
+// 記録したフレーム時間を順に入れた時の割合 (設定を調整するときにオフラインで確かめる)
+//-------------------------------------------
+void dynamic_resolution::Replay(const DynamicResolutionSettings& settings, std::span<const float> frameTimes, std::vector<float>& outScales)
+{
+    DynamicResolution controller;
+    controller.setSettings(settings);
+
+    outScales.clear();
+    outScales.reserve(frameTimes.size());
+    for (float frameMs : frameTimes)
+    {
+        outScales.push_back(controller.update(frameMs));
+    }
+}
+
+//-------------------------------------------
+// 設定 (範囲を直し,今の割合を新しい範囲に収める)
+//-------------------------------------------
+void DynamicResolution::setSettings(const DynamicResolutionSettings& settings)
+{
+    m_settings = settings;
+    m_settings.maxScale = std::clamp(m_settings.maxScale, dynamic_resolution::MIN_SCALE_LIMIT, 1.0f);
+    m_settings.minScale = std::clamp(m_settings.minScale, dynamic_resolution::MIN_SCALE_LIMIT, m_settings.maxScale);
+    m_settings.scaleStep = std::max(m_settings.scaleStep, 0.0f);
+    m_settings.smoothing = std::clamp(m_settings.smoothing, 0.01f, 1.0f);
+    m_settings.targetFrameMs = std::max(m_settings.targetFrameMs, 0.1f);
+
+    float minArea = m_settings.minScale * m_settings.minScale, maxArea = m_settings.maxScale * m_settings.maxScale;
+    m_integral = std::clamp(m_integral, minArea, maxArea);
+    m_scale = m_settings.isEnabled ? quantize(std::sqrt(m_integral)) : 1.0f;
+}
+
+//-------------------------------------------
+// 最初から (上限の解像度から始める)
+//-------------------------------------------
+void DynamicResolution::reset()
+{
+    m_integral = m_settings.maxScale * m_settings.maxScale;
+    m_scale = m_settings.isEnabled ? m_settings.maxScale : 1.0f;
+    m_frameMs = 0.0f;
+    m_prevError = 0.0f;
+    m_sampleCount = 0u;
+}
+
+//-------------------------------------------
+// フレーム時間を入れて次のフレームの割合を決める (測れなかったフレームは0以下を入れると今の割合のまま)
+//-------------------------------------------
+float DynamicResolution::update(float frameMs)
+{
+    if (!m_settings.isEnabled)
+    {
+        m_scale = 1.0f;
+        return m_scale;
+    }
+    if (!(frameMs > 0.0f) || !std::isfinite(frameMs))
+    {
+        return m_scale;
+    }
+
+    // 平滑化 (1フレームだけのぶれで解像度を揺らさない)
+    m_frameMs = m_sampleCount == 0u ? frameMs : m_frameMs + (frameMs - m_frameMs) * m_settings.smoothing;
+
+    // 誤差 (余裕があれば正 目標で割って目標の大きさによらない係数にする)
+    float error = std::clamp((m_settings.targetFrameMs - m_frameMs) / m_settings.targetFrameMs, -dynamic_resolution::MAX_ERROR, dynamic_resolution::MAX_ERROR);
+    float derivative = m_sampleCount == 0u ? 0.0f : error - m_prevError;
+    m_prevError = error;
+    ++m_sampleCount;
+
+    // 出力は画素数の割合 (GPUの手間は画素数にほぼ比例する) 積分は範囲で止めて張り付いている間にたまらないようにする
+    float minArea = m_settings.minScale * m_settings.minScale, maxArea = m_settings.maxScale * m_settings.maxScale;
+    m_integral = std::clamp(m_integral + m_settings.ki * error, minArea, maxArea);
+    float area = std::clamp(m_integral + m_settings.kp * error + m_settings.kd * derivative, minArea, maxArea);
+
+    // 刻みの間で落ち着いた時に隣の刻みと行き来しないよう,刻みの大半を超えてから変える
+    float scale = std::sqrt(area);
+    if (std::abs(scale - m_scale) > m_settings.scaleStep * dynamic_resolution::HYSTERESIS || scale <= m_settings.minScale || scale >= m_settings.maxScale)
+    {
+        m_scale = quantize(scale);
+    }
+    return m_scale;
+}
+
+//-------------------------------------------
+// 割合を刻みに揃える (範囲の中で)
+//-------------------------------------------
+float DynamicResolution::quantize(float scale) const
+{
+    if (m_settings.scaleStep > 0.0f)
+    {
+        scale = std::round(scale / m_settings.scaleStep) * m_settings.scaleStep;
+    }
+    return std::clamp(scale, m_settings.minScale, m_settings.maxScale);
+}
@@ -0,0 +1,47 @@
+//--------------------------------------------
+//
+// 動的解像度 (フレーム時間から3Dを描く解像度を決める) [dynamic_resolution.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // DynamicResolutionSettings
+#include <span>
+#include <vector>
+
+namespace dynamic_resolution
+{
+    constexpr float MAX_ERROR = 1.0f;        // 誤差の上限 (読み込みなどで1フレームだけ重くなっても一気に縮めない)
+    constexpr float MIN_SCALE_LIMIT = 0.1f;  // 設定できる割合の下限
+    constexpr float HYSTERESIS = 0.75f;      // 割合を変えるのは刻みのこの割合より離れてから
+
+    void Replay(const DynamicResolutionSettings& settings, std::span<const float> frameTimes, std::vector<float>& outScales);
+}
+
+//----------------------------
+// 動的解像度の制御 (フレーム時間を平滑化し,目標との差から画素数の割合をPIDで決める 時計もGPUも使わないので記録したフレーム時間で再現できる)
+//----------------------------
+class DynamicResolution
+{
+public:
+    DynamicResolution() : m_settings{}, m_scale{ 1.0f }, m_frameMs{}, m_integral{ 1.0f }, m_prevError{}, m_sampleCount{} {}
+    ~DynamicResolution() = default;
+
+    void setSettings(const DynamicResolutionSettings& settings);
+    const DynamicResolutionSettings& getSettings() const { return m_settings; }
+    void reset();
+    float update(float frameMs);
+
+    float getScale() const { return m_scale; }
+    float getFrameMs() const { return m_frameMs; }
+
+private:
+    float quantize(float scale) const;
+
+    DynamicResolutionSettings m_settings; // 設定
+    float m_scale;                        // 今の割合 (刻み済み)
+    float m_frameMs;                      // 平滑化したフレーム時間
+    float m_integral;                     // 積分 (画素数の割合 落ち着く解像度)
+    float m_prevError;                    // 前のフレームの誤差 (微分用)
+    unsigned int m_sampleCount;           // 受け取ったフレーム時間の数
+};
@@ -263,17 +263,17 @@ namespace easingf
     // Sine
     inline float easeInSine(float x)
     {
-        return 1.0f - std::cosf((x * PI) / 2.0f);
+        return 1.0f - std::cos((x * PI) / 2.0f);
     }
 
     inline float easeOutSine(float x)
     {
-        return std::sinf((x * PI) / 2.0f);
+        return std::sin((x * PI) / 2.0f);
     }
 
     inline float easeInOutSine(float x)
     {
-        return -(std::cosf(PI * x) - 1.0f) / 2.0f;
+        return -(std::cos(PI * x) - 1.0f) / 2.0f;
     }
 
     // Quad
@@ -289,7 +289,7 @@ namespace easingf
 
     inline float easeInOutQuad(float x)
     {
-        return x < 0.5f ? 2.0f * x * x : 1.0f - std::powf(-2.0f * x + 2.0f, 2.0f) / 2.0f;
+        return x < 0.5f ? 2.0f * x * x : 1.0f - std::pow(-2.0f * x + 2.0f, 2.0f) / 2.0f;
     }
 
     // Cubic
@@ -300,12 +300,12 @@ namespace easingf
 
     inline float easeOutCubic(float x)
     {
-        return 1.0f - std::powf(1.0f - x, 3.0f);
+        return 1.0f - std::pow(1.0f - x, 3.0f);
     }
 
     inline float easeInOutCubic(float x)
     {
-        return x < 0.5f ? 4.0f * x * x * x : 1.0f - std::powf(-2.0f * x + 2.0f, 3.0f) / 2.0f;
+        return x < 0.5f ? 4.0f * x * x * x : 1.0f - std::pow(-2.0f * x + 2.0f, 3.0f) / 2.0f;
     }
 
     // Quart
@@ -316,12 +316,12 @@ namespace easingf
 
     inline float easeOutQuart(float x)
     {
-        return 1.0f - std::powf(1.0f - x, 4.0f);
+        return 1.0f - std::pow(1.0f - x, 4.0f);
     }
 
     inline float easeInOutQuart(float x)
     {
-        return x < 0.5f ? 8.0f * x * x * x * x : 1.0f - std::powf(-2.0f * x + 2.0f, 4.0f) / 2.0f;
+        return x < 0.5f ? 8.0f * x * x * x * x : 1.0f - std::pow(-2.0f * x + 2.0f, 4.0f) / 2.0f;
     }
 
     // Quint
@@ -332,23 +332,23 @@ namespace easingf
 
     inline float easeOutQuint(float x)
     {
-        return 1.0f - std::powf(1.0f - x, 5.0f);
+        return 1.0f - std::pow(1.0f - x, 5.0f);
     }
 
     inline float easeInOutQuint(float x)
     {
-        return x < 0.5f ? 16.0f * x * x * x * x * x : 1.0f - std::powf(-2.0f * x + 2.0f, 5.0f) / 2.0f;
+        return x < 0.5f ? 16.0f * x * x * x * x * x : 1.0f - std::pow(-2.0f * x + 2.0f, 5.0f) / 2.0f;
     }
 
     // Expo
     inline float easeInExpo(float x)
     {
-        return x == 0.0f ? 0.0f : std::powf(2.0f, 10.0f * x - 10.0f);
+        return x == 0.0f ? 0.0f : std::pow(2.0f, 10.0f * x - 10.0f);
     }
 
     inline float easeOutExpo(float x)
     {
-        return x == 1.0f ? 1.0f : 1.0f - std::powf(2.0f, -10.0f * x);
+        return x == 1.0f ? 1.0f : 1.0f - std::pow(2.0f, -10.0f * x);
     }
 
     inline float easeInOutExpo(float x)
@@ -357,26 +357,26 @@ namespace easingf
             ? 0.0f
             : x == 1.0f
             ? 1.0f
-            : x < 0.5f ? std::powf(2.0f, 20.0f * x - 10.0f) / 2.0f
-            : (2.0f - std::powf(2.0f, -20.0f * x + 10.0f)) / 2.0f;
+            : x < 0.5f ? std::pow(2.0f, 20.0f * x - 10.0f) / 2.0f
+            : (2.0f - std::pow(2.0f, -20.0f * x + 10.0f)) / 2.0f;
     }
 
     // Circ
     inline float easeInCirc(float x)
     {
-        return 1.0f - std::sqrtf(1.0f - std::powf(x, 2.0f));
+        return 1.0f - std::sqrt(1.0f - std::pow(x, 2.0f));
     }
 
     inline float easeOutCirc(float x)
     {
-        return std::sqrtf(1.0f - std::powf(x - 1.0f, 2.0f));
+        return std::sqrt(1.0f - std::pow(x - 1.0f, 2.0f));
     }
 
     inline float easeInOutCirc(float x)
     {
         return x < 0.5f
-            ? (1.0f - std::sqrtf(1.0f - std::powf(2.0f * x, 2.0f))) / 2.0f
-            : (std::sqrtf(1.0f - std::powf(-2.0f * x + 2.0f, 2.0f)) + 1.0f) / 2.0f;
+            ? (1.0f - std::sqrt(1.0f - std::pow(2.0f * x, 2.0f))) / 2.0f
+            : (std::sqrt(1.0f - std::pow(-2.0f * x + 2.0f, 2.0f)) + 1.0f) / 2.0f;
     }
 
     // Back
@@ -393,7 +393,7 @@ namespace easingf
         const float c1 = 1.70158f;
         const float c3 = c1 + 1.0f;
 
-        return 1.0f + c3 * std::powf(x - 1.0f, 3.0f) + c1 * std::powf(x - 1.0f, 2.0f);
+        return 1.0f + c3 * std::pow(x - 1.0f, 3.0f) + c1 * std::pow(x - 1.0f, 2.0f);
     }
 
     inline float easeInOutBack(float x)
@@ -402,8 +402,8 @@ namespace easingf
         const float c2 = c1 * 1.525f;
 
         return x < 0.5f
-            ? (std::powf(2.0f * x, 2.0f) * ((c2 + 1.0f) * 2.0f * x - c2)) / 2.0f
-            : (std::powf(2.0f * x - 2.0f, 2.0f) * ((c2 + 1.0f) * (x * 2.0f - 2.0f) + c2) + 2.0f) / 2.0f;
+            ? (std::pow(2.0f * x, 2.0f) * ((c2 + 1.0f) * 2.0f * x - c2)) / 2.0f
+            : (std::pow(2.0f * x - 2.0f, 2.0f) * ((c2 + 1.0f) * (x * 2.0f - 2.0f) + c2) + 2.0f) / 2.0f;
     }
 
     // Elastic
@@ -415,7 +415,7 @@ namespace easingf
             ? 0.0f
             : x == 1.0f
             ? 1.0f
-            : -std::powf(2.0f, 10.0f * x - 10.0f) * std::sinf((x * 10.0f - 10.75f) * c4);
+            : -std::pow(2.0f, 10.0f * x - 10.0f) * std::sin((x * 10.0f - 10.75f) * c4);
     }
 
     inline float easeOutElastic(float x)
@@ -426,7 +426,7 @@ namespace easingf
             ? 0.0f
             : x == 1.0f
             ? 1.0f
-            : std::powf(2.0f, -10.0f * x) * std::sinf((x * 10.0f - 0.75f) * c4) + 1.0f;
+            : std::pow(2.0f, -10.0f * x) * std::sin((x * 10.0f - 0.75f) * c4) + 1.0f;
     }
 
     inline float easeInOutElastic(float x)
@@ -438,8 +438,8 @@ namespace easingf
             : x == 1.0f
             ? 1.0f
             : x < 0.5f
-            ? -(std::powf(2.0f, 20.0f * x - 10.0f) * std::sinf((20.0f * x - 11.125f) * c5)) / 2.0f
-            : (std::powf(2.0f, -20.0f * x + 10.0f) * std::sinf((20.0f * x - 11.125f) * c5)) / 2.0f + 1.0f;
+            ? -(std::pow(2.0f, 20.0f * x - 10.0f) * std::sin((20.0f * x - 11.125f) * c5)) / 2.0f
+            : (std::pow(2.0f, -20.0f * x + 10.0f) * std::sin((20.0f * x - 11.125f) * c5)) / 2.0f + 1.0f;
     }
 
     // Bounce
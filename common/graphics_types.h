@@ -6,9 +6,18 @@
 //--------------------------------------------
 #pragma once
 #include "math_types.h"
+#include <cstddef>
+#include <cstdint>
+
+// ウィンドウハンドル (windows.hと同じ型 windows.hなしでもバックエンドの宣言に使える)
+struct HWND__;
+typedef HWND__* HWND;
 
 constexpr size_t MAX_BONES = 256; // 最大ボーン数
-constexpr size_t MAX_LIGHT = 8;   // 最大ライト数
+constexpr size_t MAX_LIGHT = 8;   // 最大ライト数 (平行光源 全画素で計算する)
+constexpr size_t MAX_POINT_LIGHT = 1024; // 最大点光源数 (クラスターに振り分けて近くの画素だけ計算する)
+constexpr float LIGHT_DEFAULT_RANGE = 1000.0f; // 点光源の半径を指定しないときの影響半径
+constexpr size_t MAX_SHADOW_CASCADES = 4; // 最大シャドウカスケード数
 
 constexpr float WORLD_SIZE = 100.0f; // 1,0f = 1mの世界 (主にmodel変換など用)
 
@@ -26,7 +35,20 @@ enum class RenderQueue : unsigned char
     Outline,
     Transparent,
     UI,
-    String
+    String,
+    Max
+};
+
+// 描画アイテムのソートキーに使う状態 (値が近いほど状態の切り替えが少ない)
+struct DrawKeyState
+{
+    uint16_t shader;   // シェーダーの組み合わせ
+    uint16_t texture;  // テクスチャ
+    uint16_t material; // マテリアル
+    uint16_t mesh;     // メッシュ
+
+    DrawKeyState() : shader{}, texture{}, material{}, mesh{} {}
+    ~DrawKeyState() = default;
 };
 
 // 頂点シェーダーの種類
@@ -160,7 +182,7 @@ struct LightData
 {
     Vector4 position;  // ライトの位置
     Color color;       // ライトの色
-    Vector4 direction; // ライトの方向
+    Vector4 direction; // ライトの方向 (点光源はwが影響半径 0ならLIGHT_DEFAULT_RANGE)
     LightData() : position{}, color{ 1,1,1,1 }, direction{ 0,-1,0,0 } {}
     LightData(Vector4 position, Vector4 direction, Color color) : position{ position }, direction{ direction }, color{ color } {}
     ~LightData() = default;
@@ -267,6 +289,118 @@ struct VertexModel
     ~VertexModel() = default;
 };
 
+// インスタンシング描画のインスタンスごとの情報 (頂点バッファのスロット1)
+struct InstanceData
+{
+    Matrix world; // ワールド行列
+    Color color;  // 頂点カラーにかける色
+
+    InstanceData() : world{}, color{ 1.0f, 1.0f, 1.0f, 1.0f } {}
+    InstanceData(const Matrix& world, const Color& color) : world{ world }, color{ color } {}
+    ~InstanceData() = default;
+};
+
+// 1フレームのステート設定の統計
+struct RenderStateStats
+{
+    unsigned int issuedCalls;    // 実際に発行した設定
+    unsigned int redundantCalls; // 設定済みと同じなので省いた設定
+
+    RenderStateStats() : issuedCalls{}, redundantCalls{} {}
+    ~RenderStateStats() = default;
+};
+
+// 影の設定 (カスケードシャドウマップ)
+struct ShadowSettings
+{
+    unsigned int cascadeCount; // カスケード数 (1~MAX_SHADOW_CASCADES)
+    unsigned int resolution;   // 1カスケードの解像度 1024,2048,4096
+    float maxDistance;         // 影を描く最大距離 (カメラから)
+    float splitLambda;         // 分割の対数の割合 (0:均等 1:対数)
+    float casterDistance;      // 光の方向へ伸ばす距離 (カスケードの外から影を落とすもの用)
+
+    ShadowSettings() : cascadeCount{ 3u }, resolution{ 2048u }, maxDistance{ 100.0f }, splitLambda{ 0.75f }, casterDistance{ 50.0f } {}
+    ~ShadowSettings() = default;
+};
+
+// テクスチャストリーミングの設定
+struct TextureStreamingSettings
+{
+    size_t budgetBytes;              // テクスチャに使うVRAMの上限 (起動時のミップは上限を超えても常駐)
+    unsigned int startupMaxSize;     // 起動時に読み込むミップの最大の大きさ (これより大きいミップは必要になってから)
+    unsigned int maxStreamsPerFrame; // 1フレームに始める読み込みの最大数
+    unsigned int evictFrames;        // 使われないまま過ぎたら高いミップを捨てるフレーム数
+
+    TextureStreamingSettings() : budgetBytes{ size_t(256) << 20 }, startupMaxSize{ 128u }, maxStreamsPerFrame{ 4u }, evictFrames{ 300u } {}
+    ~TextureStreamingSettings() = default;
+};
+
+// テクスチャストリーミングの統計
+struct TextureStreamingStats
+{
+    size_t residentBytes;     // 常駐しているミップのバイト数
+    size_t budgetBytes;       // 上限
+    unsigned int textures;    // 管理しているテクスチャ数
+    unsigned int pending;     // 読み込み中の数
+    unsigned int streamedIn;  // このフレームに始めた読み込み数
+    unsigned int evicted;     // このフレームに捨てた数
+
+    TextureStreamingStats() : residentBytes{}, budgetBytes{}, textures{}, pending{}, streamedIn{}, evicted{} {}
+    ~TextureStreamingStats() = default;
+};
+
+// オクルージョンカリングの設定 (遮蔽物に指定した箱をCPUで小さな深度バッファに描き,その奥に隠れたものを描かない)
+struct OcclusionCullingSettings
+{
+    bool isEnabled;             // 使うか
+    unsigned int maxOccluders;  // 1カメラで描く遮蔽物の最大数 (画面に大きく映るものから選ぶ)
+    float minOccluderArea;      // 遮蔽物にする画面に占める割合の下限 (小さいものは隠す量より描く手間が勝つ)
+
+    OcclusionCullingSettings() : isEnabled{ true }, maxOccluders{ 128u }, minOccluderArea{ 0.002f } {}
+    ~OcclusionCullingSettings() = default;
+};
+
+// オクルージョンカリングの統計 (最後のカメラの分)
+struct OcclusionCullingStats
+{
+    unsigned int occluders; // 描いた遮蔽物の数
+    unsigned int triangles; // 描いた三角形の数 (手前で切った後)
+    unsigned int tested;    // 判定した境界ボックスの数
+    unsigned int culled;    // 隠れていたので除いた数
+
+    OcclusionCullingStats() : occluders{}, triangles{}, tested{}, culled{} {}
+    ~OcclusionCullingStats() = default;
+};
+
+// 動的解像度の設定 (GPUのフレーム時間が目標に収まるよう3Dを描く解像度をPIDで変え,最後のパスで画面に引き伸ばす)
+struct DynamicResolutionSettings
+{
+    bool isEnabled;      // 使うか (使わなければ等倍 見た目が変わるので既定は使わない)
+    float targetFrameMs; // 目標のGPUフレーム時間 (ミリ秒 VSyncの間隔より少し短く)
+    float minScale;      // 幅と高さにかける割合の下限
+    float maxScale;      // 上限 (1で画面と同じ)
+    float scaleStep;     // 割合の刻み (小さな揺れで拡大の位相が変わり続けないように)
+    float smoothing;     // フレーム時間の平滑化 (新しいフレームを混ぜる割合 1で平滑化しない)
+    float kp;            // 比例の係数 (誤差は目標との差を目標で割った値,出力は画素数の割合)
+    float ki;            // 積分の係数 (落ち着く解像度はこれで決まる)
+    float kd;            // 微分の係数
+
+    DynamicResolutionSettings() : isEnabled{ false }, targetFrameMs{ 15.0f }, minScale{ 0.5f }, maxScale{ 1.0f }, scaleStep{ 0.025f }, smoothing{ 0.1f }, kp{ 0.2f }, ki{ 0.04f }, kd{ 0.05f } {}
+    ~DynamicResolutionSettings() = default;
+};
+
+// 動的解像度の統計
+struct DynamicResolutionStats
+{
+    float scale;         // 今の割合
+    float frameMs;       // 平滑化したGPUフレーム時間 (まだ測れていなければ0)
+    unsigned int width;  // 3Dを描いた大きさ
+    unsigned int height; //
+
+    DynamicResolutionStats() : scale{ 1.0f }, frameMs{}, width{}, height{} {}
+    ~DynamicResolutionStats() = default;
+};
+
 inline PostProcessShaderMask operator|(PostProcessShaderMask lhs, PostProcessShaderMask rhs)
 {
     return static_cast<PostProcessShaderMask>(
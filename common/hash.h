@@ -0,0 +1,30 @@
+//--------------------------------------------
+//
+// 文字列ハッシュ (FNV-1a リソースIDに使う) [hash.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include <cstdint>
+
+constexpr uint64_t Hash(const char* str)
+{
+    uint64_t h = 2166136261u; // FNV-1a
+    while (*str)
+    {
+        h ^= static_cast<uint8_t>(*str++);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr uint64_t Hash(const char8_t* str)
+{
+    uint64_t h = 2166136261u; // FNV-1a
+    while (*str)
+    {
+        h ^= static_cast<uint8_t>(*str++);
+        h *= 16777619u;
+    }
+    return h;
+}
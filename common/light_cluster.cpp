@@ -0,0 +1,325 @@
+//--------------------------------------------
+//
+// クラスターライト (点光源の割り当て) [light_cluster.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "light_cluster.h"
+#include <future>
+#include <immintrin.h> // SSE (球とクラスターの判定)
+
+namespace
+{
+    constexpr unsigned int SLICE_CLUSTERS = cluster::COUNT_X * cluster::COUNT_Y; // 1スライスのクラスター数 (4の倍数)
+    static_assert(SLICE_CLUSTERS % 4u == 0u, "SIMDで4つずつ判定するのでスライスのクラスター数は4の倍数");
+    static_assert(MAX_POINT_LIGHT <= 0xffffu, "クラスターのライト番号は16bit");
+
+    //--------------
+    // NDCの点をビュー空間へ戻し,指定の奥行きの位置にする関数 (手前と奥の点を結ぶ線上)
+    //--------------
+    Vector3 UnprojectAtDepth(const Matrix& invProj, float ndcX, float ndcY, float depth)
+    {
+        Vector3 nearPos(ndcX, ndcY, 0.0f), farPos(ndcX, ndcY, 1.0f);
+        nearPos.transformCoord(invProj);
+        farPos.transformCoord(invProj);
+        float t = (depth - nearPos.z) / (farPos.z - nearPos.z);
+        return nearPos + (farPos - nearPos) * t;
+    }
+}
+
+//--------------
+// 球と箱が触れているか (全探索の確認用 SIMD版と同じ式)
+//--------------
+bool cluster::IsSphereInBox(const Vector3& center, float radius, const Vector3& boxCenter, const Vector3& boxExtent)
+{
+    float dx = std::max(std::fabs(center.x - boxCenter.x) - boxExtent.x, 0.0f);
+    float dy = std::max(std::fabs(center.y - boxCenter.y) - boxExtent.y, 0.0f);
+    float dz = std::max(std::fabs(center.z - boxCenter.z) - boxExtent.z, 0.0f);
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+//-------------------------------------------
+// 点光源をクラスターに振り分ける (奥行きのスライスごとにスレッドへ分け,最後に1本のリストに詰める)
+//-------------------------------------------
+bool LightClusterGrid::build(const Matrix& view, const Matrix& proj, std::span<const LightData> pointLights, unsigned int maxThread)
+{
+    m_pointLights.clear();
+    m_viewLights.clear();
+    m_clusters.assign(cluster::CLUSTER_COUNT, LightClusterRange());
+    m_lightIndices.clear();
+
+    if (!buildClusterBounds(proj))
+    {
+        return false;
+    }
+    m_viewDepthRow = Vector4(view.m[0][2], view.m[1][2], view.m[2][2], view.m[3][2]);
+
+    // ビュー空間へ (半径が0以下のものは既定の半径)
+    size_t count = std::min(pointLights.size(), MAX_POINT_LIGHT);
+    m_pointLights.reserve(count);
+    m_viewLights.reserve(count);
+    for (size_t cnt = 0; cnt < count; ++cnt)
+    {
+        const LightData& light = pointLights[cnt];
+        float range = (light.direction.w > 0.0f) ? light.direction.w : LIGHT_DEFAULT_RANGE;
+        Vector3 position(light.position.x, light.position.y, light.position.z);
+        m_pointLights.emplace_back(Vector4(position, range), light.color);
+
+        position.transformCoord(view);
+        m_viewLights.emplace_back(position, range);
+    }
+
+    // 振り分け (スライスは別々のクラスターなのでスレッド間で書き込みは重ならない)
+    m_clusterCounts.assign(cluster::CLUSTER_COUNT, 0u);
+    m_clusterLights.resize(size_t(cluster::CLUSTER_COUNT) * cluster::MAX_LIGHTS_PER_CLUSTER);
+    unsigned int threadCount = (m_viewLights.size() >= cluster::MIN_PARALLEL_LIGHTS) ? std::clamp(maxThread, 1u, cluster::COUNT_Z) : 1u;
+    unsigned int slicesPerThread = (cluster::COUNT_Z + threadCount - 1u) / threadCount;
+    {// 先頭以外をワーカーに任せて呼び出し側は先頭を振り分ける (抜けるときに全部待つ)
+        std::vector<std::future<void>> tasks;
+        tasks.reserve(threadCount);
+        for (unsigned int thread = 1; thread < threadCount; ++thread)
+        {
+            unsigned int first = thread * slicesPerThread;
+            if (first < cluster::COUNT_Z)
+            {
+                tasks.push_back(std::async(std::launch::async, [this, first, slicesPerThread]() { binSlices(first, std::min(first + slicesPerThread, cluster::COUNT_Z)); }));
+            }
+        }
+        binSlices(0u, std::min(slicesPerThread, cluster::COUNT_Z));
+        for (auto& task : tasks)
+        {
+            task.get();
+        }
+    }
+
+    // 1本のリストに詰める (入りきらない分は捨てる)
+    for (unsigned int cnt = 0; cnt < cluster::CLUSTER_COUNT; ++cnt)
+    {
+        uint32_t lightCount = std::min(m_clusterCounts[cnt], static_cast<uint32_t>(cluster::MAX_LIGHT_INDICES - m_lightIndices.size()));
+        m_clusters[cnt].offset = static_cast<uint32_t>(m_lightIndices.size());
+        m_clusters[cnt].count = lightCount;
+        const uint16_t* pLights = &m_clusterLights[size_t(cnt) * cluster::MAX_LIGHTS_PER_CLUSTER];
+        m_lightIndices.insert(m_lightIndices.end(), pLights, pLights + lightCount);
+    }
+    return true;
+}
+
+//-------------------------------------------
+// クラスターのビュー空間の境界ボックスを作る (プロジェクションが変わったときだけ)
+//-------------------------------------------
+bool LightClusterGrid::buildClusterBounds(const Matrix& proj)
+{
+    if (m_clusterBounds.size() == cluster::CLUSTER_COUNT && std::memcmp(&m_proj, &proj, sizeof(Matrix)) == 0)
+    {
+        return true;
+    }
+
+    Matrix invProj{};
+    if (!Matrix::Inverse(proj, invProj))
+    {
+        m_clusterBounds.resize(0u);
+        return false;
+    }
+
+    // 手前と奥 (NDCのZが0と1の点)
+    Vector3 nearPos(0.0f, 0.0f, 0.0f), farPos(0.0f, 0.0f, 1.0f);
+    nearPos.transformCoord(invProj);
+    farPos.transformCoord(invProj);
+    m_nearZ = nearPos.z;
+    m_farZ = farPos.z;
+    if (m_farZ <= m_nearZ)
+    {
+        m_clusterBounds.resize(0u);
+        return false;
+    }
+
+    // 奥行きの分け方 (透視は対数 手前ほど細かく,正射影で手前が0以下なら線形)
+    m_isLogarithmic = m_nearZ > 0.0f;
+    if (m_isLogarithmic)
+    {
+        m_sliceScale = static_cast<float>(cluster::COUNT_Z) / std::log(m_farZ / m_nearZ);
+        m_sliceBias = -std::log(m_nearZ) * m_sliceScale;
+    }
+    else
+    {
+        m_sliceScale = static_cast<float>(cluster::COUNT_Z) / (m_farZ - m_nearZ);
+        m_sliceBias = -m_nearZ * m_sliceScale;
+    }
+
+    m_clusterBounds.resize(cluster::CLUSTER_COUNT);
+    for (unsigned int z = 0; z < cluster::COUNT_Z; ++z)
+    {
+        float sliceNear = sliceToDepth(z), sliceFar = sliceToDepth(z + 1u);
+        for (unsigned int y = 0; y < cluster::COUNT_Y; ++y)
+        {
+            // タイルの行は画面の上から (NDCのYは上が1)
+            float top = 1.0f - 2.0f * static_cast<float>(y) / static_cast<float>(cluster::COUNT_Y);
+            float bottom = 1.0f - 2.0f * static_cast<float>(y + 1u) / static_cast<float>(cluster::COUNT_Y);
+            for (unsigned int x = 0; x < cluster::COUNT_X; ++x)
+            {
+                float left = -1.0f + 2.0f * static_cast<float>(x) / static_cast<float>(cluster::COUNT_X);
+                float right = -1.0f + 2.0f * static_cast<float>(x + 1u) / static_cast<float>(cluster::COUNT_X);
+
+                // タイルの4隅を区間の手前と奥に置いた8点を包む
+                Vector3 minPos(FLT_MAX, FLT_MAX, FLT_MAX), maxPos(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+                for (float depth : { sliceNear, sliceFar })
+                {
+                    for (float ndcY : { top, bottom })
+                    {
+                        for (float ndcX : { left, right })
+                        {
+                            Vector3 corner = UnprojectAtDepth(invProj, ndcX, ndcY, depth);
+                            minPos = Vector3(std::min(minPos.x, corner.x), std::min(minPos.y, corner.y), std::min(minPos.z, corner.z));
+                            maxPos = Vector3(std::max(maxPos.x, corner.x), std::max(maxPos.y, corner.y), std::max(maxPos.z, corner.z));
+                        }
+                    }
+                }
+
+                size_t index = (size_t(z) * cluster::COUNT_Y + y) * cluster::COUNT_X + x;
+                Vector3 center = (minPos + maxPos) * 0.5f, extent = (maxPos - minPos) * 0.5f;
+                m_clusterBounds.centerX[index] = center.x; m_clusterBounds.centerY[index] = center.y; m_clusterBounds.centerZ[index] = center.z;
+                m_clusterBounds.extentX[index] = extent.x; m_clusterBounds.extentY[index] = extent.y; m_clusterBounds.extentZ[index] = extent.z;
+            }
+        }
+    }
+
+    m_proj = proj;
+    return true;
+}
+
+//-------------------------------------------
+// スライスの範囲のクラスターに点光源を振り分ける (球の奥行きでスライスを絞り,スライス内は4つずつSIMDで判定)
+//-------------------------------------------
+void LightClusterGrid::binSlices(unsigned int firstSlice, unsigned int lastSlice)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (size_t cntLight = 0; cntLight < m_viewLights.size(); ++cntLight)
+    {
+        const Vector4& light = m_viewLights[cntLight];
+        if (light.z + light.w < m_nearZ || light.z - light.w > m_farZ)
+        {
+            continue; // 視錐台の手前か奥
+        }
+
+        // 境界の丸め誤差で触れているスライスを落とさないよう前後に1つ広げる (箱の判定で絞られる)
+        unsigned int sliceBegin = std::max(std::max(depthToSlice(light.z - light.w), 1u) - 1u, firstSlice);
+        unsigned int sliceEnd = std::min(depthToSlice(light.z + light.w) + 2u, lastSlice);
+
+        __m128 lightX = _mm_set1_ps(light.x), lightY = _mm_set1_ps(light.y), lightZ = _mm_set1_ps(light.z);
+        __m128 radiusSq = _mm_set1_ps(light.w * light.w);
+        for (unsigned int slice = sliceBegin; slice < sliceEnd; ++slice)
+        {
+            size_t first = size_t(slice) * SLICE_CLUSTERS;
+            for (size_t cnt = first; cnt < first + SLICE_CLUSTERS; cnt += 4u)
+            {
+                // 箱の外側への距離 (軸ごとに |中心の差| - 半分の大きさ を0で切る)
+                __m128 dx = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(lightX, _mm_loadu_ps(&m_clusterBounds.centerX[cnt])), signMask), _mm_loadu_ps(&m_clusterBounds.extentX[cnt])), zero);
+                __m128 dy = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(lightY, _mm_loadu_ps(&m_clusterBounds.centerY[cnt])), signMask), _mm_loadu_ps(&m_clusterBounds.extentY[cnt])), zero);
+                __m128 dz = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(lightZ, _mm_loadu_ps(&m_clusterBounds.centerZ[cnt])), signMask), _mm_loadu_ps(&m_clusterBounds.extentZ[cnt])), zero);
+                __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+                int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq));
+                for (size_t lane = 0; lane < 4u; ++lane)
+                {
+                    uint32_t& lightCount = m_clusterCounts[cnt + lane];
+                    if (((mask >> lane) & 1) != 0 && lightCount < cluster::MAX_LIGHTS_PER_CLUSTER)
+                    {
+                        m_clusterLights[(cnt + lane) * cluster::MAX_LIGHTS_PER_CLUSTER + lightCount] = static_cast<uint16_t>(cntLight);
+                        ++lightCount;
+                    }
+                }
+            }
+        }
+    }
+}
+
+//-------------------------------------------
+// 振り分けの確認 (全クラスターと全ライトを1つずつ判定した結果と一致するか)
+//-------------------------------------------
+bool LightClusterGrid::validate() const
+{
+    if (m_clusters.size() != cluster::CLUSTER_COUNT || m_clusterBounds.size() != cluster::CLUSTER_COUNT)
+    {
+        return m_viewLights.empty();
+    }
+
+    std::vector<uint32_t> expected;
+    size_t totalIndices = 0u;
+    for (size_t cntCluster = 0; cntCluster < cluster::CLUSTER_COUNT; ++cntCluster)
+    {
+        Vector3 boxCenter(m_clusterBounds.centerX[cntCluster], m_clusterBounds.centerY[cntCluster], m_clusterBounds.centerZ[cntCluster]);
+        Vector3 boxExtent(m_clusterBounds.extentX[cntCluster], m_clusterBounds.extentY[cntCluster], m_clusterBounds.extentZ[cntCluster]);
+
+        expected.clear();
+        for (size_t cntLight = 0; cntLight < m_viewLights.size(); ++cntLight)
+        {
+            const Vector4& light = m_viewLights[cntLight];
+            if (light.z + light.w < m_nearZ || light.z - light.w > m_farZ)
+            {
+                continue;
+            }
+            if (cluster::IsSphereInBox(Vector3(light.x, light.y, light.z), light.w, boxCenter, boxExtent) && expected.size() < cluster::MAX_LIGHTS_PER_CLUSTER)
+            {
+                expected.push_back(static_cast<uint32_t>(cntLight));
+            }
+        }
+
+        // リストが一杯で切られた分は先頭だけ比べる
+        size_t expectedCount = std::min(expected.size(), cluster::MAX_LIGHT_INDICES - totalIndices);
+        const LightClusterRange& range = m_clusters[cntCluster];
+        if (range.count != expectedCount || range.offset != totalIndices ||
+            !std::equal(expected.begin(), expected.begin() + expectedCount, m_lightIndices.begin() + range.offset))
+        {
+            return false;
+        }
+        totalIndices += expectedCount;
+    }
+    return totalIndices == m_lightIndices.size();
+}
+
+//-------------------------------------------
+// クラスターのライト番号
+//-------------------------------------------
+void LightClusterGrid::getClusterLights(unsigned int x, unsigned int y, unsigned int z, std::span<const uint32_t>& outIndices) const
+{
+    outIndices = {};
+    if (x >= cluster::COUNT_X || y >= cluster::COUNT_Y || z >= cluster::COUNT_Z || m_clusters.size() != cluster::CLUSTER_COUNT)
+    {
+        return;
+    }
+    const LightClusterRange& range = m_clusters[(size_t(z) * cluster::COUNT_Y + y) * cluster::COUNT_X + x];
+    outIndices = std::span<const uint32_t>(m_lightIndices).subspan(range.offset, range.count);
+}
+
+//-------------------------------------------
+// シェーダーでクラスターを引くための値 (画素→タイル,奥行き→スライス)
+//-------------------------------------------
+void LightClusterGrid::getShaderParams(const Vector2& viewportSize, Vector4& outViewDepthRow, Vector4& outScale, bool& outIsLogarithmic) const
+{
+    outViewDepthRow = m_viewDepthRow;
+    outScale = Vector4(static_cast<float>(cluster::COUNT_X) / std::max(viewportSize.x, 1.0f), static_cast<float>(cluster::COUNT_Y) / std::max(viewportSize.y, 1.0f), m_sliceScale, m_sliceBias);
+    outIsLogarithmic = m_isLogarithmic;
+}
+
+//-------------------------------------------
+// 奥行きからスライス番号 (範囲外は端)
+//-------------------------------------------
+unsigned int LightClusterGrid::depthToSlice(float depth) const
+{
+    if (depth <= m_nearZ)
+    {
+        return 0u;
+    }
+    float slice = (m_isLogarithmic ? std::log(depth) : depth) * m_sliceScale + m_sliceBias;
+    return std::min(static_cast<unsigned int>(std::max(slice, 0.0f)), cluster::COUNT_Z - 1u);
+}
+
+//-------------------------------------------
+// スライス番号の手前の奥行き
+//-------------------------------------------
+float LightClusterGrid::sliceToDepth(unsigned int slice) const
+{
+    float ratio = static_cast<float>(slice) / static_cast<float>(cluster::COUNT_Z);
+    return m_isLogarithmic ? m_nearZ * std::pow(m_farZ / m_nearZ, ratio) : m_nearZ + (m_farZ - m_nearZ) * ratio;
+}
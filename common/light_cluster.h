@@ -0,0 +1,84 @@
+//--------------------------------------------
+//
+// クラスターライト (点光源の割り当て) [light_cluster.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // LightData, MAX_POINT_LIGHT
+#include "draw_list.h"      // CullBounds
+
+// GPUに送る点光源 (StructuredBuffer t6)
+struct PointLightData
+{
+    Vector4 positionRange; // ワールド座標と影響半径
+    Color color;           // 色
+
+    PointLightData() : positionRange{}, color{} {}
+    PointLightData(const Vector4& lightPositionRange, const Color& lightColor) : positionRange{ lightPositionRange }, color{ lightColor } {}
+    ~PointLightData() = default;
+};
+
+// クラスター1つ分のライト番号の範囲 (StructuredBuffer t7)
+struct LightClusterRange
+{
+    uint32_t offset; // ライト番号リストの先頭
+    uint32_t count;  // 数
+
+    LightClusterRange() : offset{}, count{} {}
+    ~LightClusterRange() = default;
+};
+
+namespace cluster
+{
+    // 視錐台の分割数 (画面をX*Yのタイルに,奥行きをZに分ける)
+    constexpr unsigned int COUNT_X = 16u;
+    constexpr unsigned int COUNT_Y = 9u;
+    constexpr unsigned int COUNT_Z = 24u;
+    constexpr unsigned int CLUSTER_COUNT = COUNT_X * COUNT_Y * COUNT_Z;
+    constexpr unsigned int MAX_LIGHTS_PER_CLUSTER = 128u;                     // 1クラスターに入るライトの最大数 (超えた分は捨てる)
+    constexpr unsigned int MAX_LIGHT_INDICES = CLUSTER_COUNT * 32u;           // ライト番号リストの最大数 (GPUのバッファの大きさ)
+    constexpr size_t MIN_PARALLEL_LIGHTS = 64u;                               // これ以上の点光源なら奥行きごとにスレッドに分ける
+
+    bool IsSphereInBox(const Vector3& center, float radius, const Vector3& boxCenter, const Vector3& boxExtent);
+}
+
+//----------------------------
+// クラスターライトのグリッド (カメラの視錐台を3Dに分割し,点光源を触れるクラスターに振り分ける)
+//----------------------------
+class LightClusterGrid
+{
+public:
+    LightClusterGrid() : m_proj{ 0 }, m_clusterBounds{}, m_pointLights{}, m_viewLights{}, m_clusterLights{}, m_clusterCounts{}, m_clusters{}, m_lightIndices{}, m_viewDepthRow{}, m_nearZ{}, m_farZ{}, m_sliceScale{}, m_sliceBias{}, m_isLogarithmic{} {}
+    ~LightClusterGrid() = default;
+
+    bool build(const Matrix& view, const Matrix& proj, std::span<const LightData> pointLights, unsigned int maxThread);
+    bool validate() const;
+
+    std::span<const PointLightData> getPointLights() const { return m_pointLights; }
+    std::span<const LightClusterRange> getClusters() const { return m_clusters; }
+    std::span<const uint32_t> getLightIndices() const { return m_lightIndices; }
+    void getClusterLights(unsigned int x, unsigned int y, unsigned int z, std::span<const uint32_t>& outIndices) const;
+    void getShaderParams(const Vector2& viewportSize, Vector4& outViewDepthRow, Vector4& outScale, bool& outIsLogarithmic) const;
+
+private:
+    bool buildClusterBounds(const Matrix& proj);
+    void binSlices(unsigned int firstSlice, unsigned int lastSlice);
+    unsigned int depthToSlice(float depth) const;
+    float sliceToDepth(unsigned int slice) const;
+
+    Matrix m_proj;                               // クラスターの境界を作ったときのプロジェクション
+    CullBounds m_clusterBounds;                  // クラスターのビュー空間の境界ボックス (SoA 奥行き,Y,Xの順)
+    std::vector<PointLightData> m_pointLights;   // 点光源 (ワールド空間)
+    std::vector<Vector4> m_viewLights;           // 点光源 (ビュー空間の位置と半径)
+    std::vector<uint16_t> m_clusterLights;       // クラスターごとのライト番号 (MAX_LIGHTS_PER_CLUSTERずつ)
+    std::vector<uint32_t> m_clusterCounts;       // ↑の数
+    std::vector<LightClusterRange> m_clusters;   // 詰めたクラスターごとの範囲
+    std::vector<uint32_t> m_lightIndices;        // 詰めたライト番号リスト
+    Vector4 m_viewDepthRow;                      // ワールド座標からビュー空間の奥行きを出す (View行列の3列目)
+    float m_nearZ;                               // 手前
+    float m_farZ;                                // 奥
+    float m_sliceScale;                          // 奥行き (対数か線形) からスライスへの係数
+    float m_sliceBias;                           //
+    bool m_isLogarithmic;                        // 奥行きを対数で分けるか (正射影で手前が0以下なら線形)
+};
@@ -26,7 +26,9 @@ public:
     }
     bool getShadowInfo(Vector3* shadowEye = nullptr, Vector3* shadowTarget = nullptr, Vector3* shadowUp = nullptr)
     {
-        shadowEye = &m_shadowEye; shadowTarget = &m_shadowTarget; shadowUp = &m_shadowUp;
+        if (shadowEye != nullptr) *shadowEye = m_shadowEye;
+        if (shadowTarget != nullptr) *shadowTarget = m_shadowTarget;
+        if (shadowUp != nullptr) *shadowUp = m_shadowUp;
         return m_isShadowCast;
     }
 
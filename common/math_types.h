@@ -9,6 +9,8 @@
 #include <cmath>
 #include <cstring>
 #include <algorithm>
+#include <cfloat>
+#include <array>
 
 // --------------------------------------------------------
 // 1. 前方宣言
@@ -758,6 +760,60 @@ struct Color
     static Color Blue() { return Color(0.0f, 0.0f, 1.0f, 1.0f); }
 };
 
+// 軸平行境界ボックス
+struct AABB
+{
+    Vector3 min;
+    Vector3 max;
+
+    // 初期状態は空 (min > max)
+    AABB() : min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+    AABB(const Vector3& min, const Vector3& max) : min(min), max(max) {}
+    ~AABB() = default;
+
+    bool isValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    void reset() { *this = AABB(); }
+
+    // 点を含むように拡張
+    void expand(const Vector3& point)
+    {
+        min.x = std::min(min.x, point.x); min.y = std::min(min.y, point.y); min.z = std::min(min.z, point.z);
+        max.x = std::max(max.x, point.x); max.y = std::max(max.y, point.y); max.z = std::max(max.z, point.z);
+    }
+    // ボックスを含むように拡張
+    void merge(const AABB& other)
+    {
+        if (!other.isValid()) return;
+        expand(other.min);
+        expand(other.max);
+    }
+
+    Vector3 getCenter() const { return (min + max) * 0.5f; }
+    Vector3 getExtent() const { return (max - min) * 0.5f; }
+
+    void transform(const Matrix& mat);
+
+    static AABB Transformed(const AABB& box, const Matrix& mat)
+    {
+        AABB result = box;
+        result.transform(mat);
+        return result;
+    }
+};
+
+// 視錐台 (平面の法線は内側向き)
+struct Frustum
+{
+    std::array<Vector4, 6> planes; // 左,右,下,上,近,遠 (xyz:法線 w:距離)
+
+    Frustum() : planes{} {}
+    explicit Frustum(const Matrix& viewProj) : planes{} { set(viewProj); }
+    ~Frustum() = default;
+
+    void set(const Matrix& viewProj);
+    bool intersects(const AABB& box) const;
+};
+
 // --------------------------------------------------------
 // 3. 遅延実装
 // --------------------------------------------------------
@@ -788,6 +844,64 @@ inline void Vector3::transformCoord(const Matrix& mat)
     if (tw != 0.0f) { x = tx / tw; y = ty / tw; z = tz / tw; }
 }
 
+// 変換後の8頂点を包むボックス (中心と|M|で半径を変換する)
+inline void AABB::transform(const Matrix& mat)
+{
+    if (!isValid()) return;
+
+    Vector3 center = getCenter();
+    Vector3 extent = getExtent();
+    center.transformCoord(mat);
+
+    Vector3 newExtent(
+        extent.x * fabsf(mat.m[0][0]) + extent.y * fabsf(mat.m[1][0]) + extent.z * fabsf(mat.m[2][0]),
+        extent.x * fabsf(mat.m[0][1]) + extent.y * fabsf(mat.m[1][1]) + extent.z * fabsf(mat.m[2][1]),
+        extent.x * fabsf(mat.m[0][2]) + extent.y * fabsf(mat.m[1][2]) + extent.z * fabsf(mat.m[2][2])
+    );
+
+    min = center - newExtent;
+    max = center + newExtent;
+}
+
+// Row-Major (v * M) のViewProjから平面を取り出す (D3Dのクリップ空間 0 <= z <= w)
+inline void Frustum::set(const Matrix& viewProj)
+{
+    auto column = [&viewProj](int index) { return Vector4(viewProj.m[0][index], viewProj.m[1][index], viewProj.m[2][index], viewProj.m[3][index]); };
+    Vector4 c0 = column(0), c1 = column(1), c2 = column(2), c3 = column(3);
+
+    planes[0] = Vector4(c3.x + c0.x, c3.y + c0.y, c3.z + c0.z, c3.w + c0.w); // 左
+    planes[1] = Vector4(c3.x - c0.x, c3.y - c0.y, c3.z - c0.z, c3.w - c0.w); // 右
+    planes[2] = Vector4(c3.x + c1.x, c3.y + c1.y, c3.z + c1.z, c3.w + c1.w); // 下
+    planes[3] = Vector4(c3.x - c1.x, c3.y - c1.y, c3.z - c1.z, c3.w - c1.w); // 上
+    planes[4] = c2;                                                          // 近
+    planes[5] = Vector4(c3.x - c2.x, c3.y - c2.y, c3.z - c2.z, c3.w - c2.w); // 遠
+
+    for (auto& plane : planes)
+    {
+        float len = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (len > 0.0f)
+        {
+            plane = Vector4(plane.x / len, plane.y / len, plane.z / len, plane.w / len);
+        }
+    }
+}
+
+// ボックスが完全に外側の平面があれば交差しない
+inline bool Frustum::intersects(const AABB& box) const
+{
+    if (!box.isValid()) return false;
+
+    Vector3 center = box.getCenter();
+    Vector3 extent = box.getExtent();
+    for (const auto& plane : planes)
+    {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (distance + radius < 0.0f) return false;
+    }
+    return true;
+}
+
 inline void Matrix::inverse()
 {
     Matrix inv;
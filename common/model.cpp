@@ -7,11 +7,14 @@
 #include "model.h"
 #include "texture.h"
 #include "renderer.h"
+#include "skinned_bounds.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <immintrin.h> // SSE (モーフ適用)
+
 // DirectX用に変換する (左手座標系,UV反転,カリング対策),ポリゴンをすべて三角形に変換,タンジェントとバイタンジェントを計算,スキニング,法線がない場合に生成
 constexpr unsigned int LOAD_FLAGS{ aiProcess_ConvertToLeftHanded | aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights | aiProcess_GenNormals };
 
@@ -49,11 +52,90 @@ struct Subset
     unsigned int indexStart;    // インデックスバッファの開始位置
     unsigned int indexCount;    // インデックス数
     unsigned int materialIndex; // 使用するマテリアルの番号
+    unsigned int paletteStart;  // ボーンパレットの開始位置
+    unsigned int paletteCount;  // ボーンパレットの数 (0ならボーンなし)
 
-    Subset() : indexStart(0), indexCount(0), materialIndex(0) {}
+    Subset() : indexStart(0), indexCount(0), materialIndex(0), paletteStart(0), paletteCount(0) {}
     ~Subset() = default;
 };
 
+// 描画パケット (ロード時に構築する不変の描画単位)
+struct DrawPacket
+{
+    unsigned int indexStart;    // インデックスバッファの開始位置
+    unsigned int indexCount;    // インデックス数
+    unsigned int materialIndex; // マテリアル番号 (ステート変更の判定用)
+    unsigned int paletteStart;  // ボーンパレットの開始位置 (ボーン行列の送り直しの判定用)
+    unsigned int paletteCount;  // ボーンパレットの数
+    Material material;          // 変換済みマテリアル
+    TextureHandle texture;      // テクスチャハンドル
+
+    DrawPacket() : indexStart(0), indexCount(0), materialIndex(0), paletteStart(0), paletteCount(0), material{}, texture{} {}
+    ~DrawPacket() = default;
+};
+
+// モーフ頂点 (位置と法線をSIMDで読めるよう16byte境界に置く)
+struct alignas(16) MorphVertex
+{
+    float position[4]; // 位置 (w = 0)
+    float normal[4];   // 法線 (w = 0)
+
+    MorphVertex() : position{}, normal{} {}
+    ~MorphVertex() = default;
+};
+
+// モーフターゲット (ブレンドシェイプ) 動く頂点だけを疎に持つ
+struct MorphTarget
+{
+    std::string name;                        // ターゲット名
+    unsigned int animMeshIndex;              // aiMesh::mAnimMeshes内の番号 (アニメーションの参照用)
+    std::vector<unsigned int> vertexIndices; // 影響する頂点 (m_vertices上のインデックス)
+    std::vector<MorphVertex> deltas;         // 位置と法線の差分
+    Vector3 maxDelta;                        // 位置の差分の軸ごとの絶対値の最大 (境界ボックスを広げる量)
+
+    MorphTarget() : name{}, animMeshIndex(0), vertexIndices{}, deltas{}, maxDelta{} {}
+    ~MorphTarget() = default;
+};
+
+// モーフキー (ある時間のターゲットごとのウェイト)
+struct MorphKey
+{
+    double time;                       // 時間
+    std::vector<unsigned int> targets; // aiMesh::mAnimMeshes内の番号
+    std::vector<float> weights;        // ウェイト
+
+    MorphKey() : time(0.0), targets{}, weights{} {}
+    ~MorphKey() = default;
+};
+
+// モーフチャンネル (1つのノードのメッシュに対応するウェイトアニメーション)
+struct MorphAnimation
+{
+    std::string nodeName;       // 対象のノード名
+    std::vector<MorphKey> keys; // キー
+
+    MorphAnimation() : nodeName{}, keys{} {}
+    ~MorphAnimation() = default;
+};
+
+// メッシュ変換の作業単位 (並列処理用)
+struct MeshJob
+{
+    const aiMesh* mesh;                           // 変換元メッシュ
+    Matrix transform;                             // ノードのグローバル変換行列
+    std::string nodeName;                         // メッシュを持つノード名
+    unsigned int vertexStart;                     // 頂点の書き込み位置
+    unsigned int indexStart;                      // インデックスの書き込み位置
+    std::vector<int> boneIndices;                 // aiMesh::mBones -> m_boneInfo のインデックス
+    std::vector<std::array<uint32_t, 4>> vertexBones; // 頂点ごとのメッシュ内のボーン番号 (パレットに収まらないメッシュのみ)
+    std::vector<std::pair<int, AABB>> boneBounds; // このメッシュで求めたボーンの境界 (後で合成)
+    AABB staticBounds;                            // ボーンの影響を受けない頂点の境界
+    std::vector<MorphTarget> morphTargets;        // このメッシュのモーフターゲット (後で合成)
+
+    MeshJob() : mesh(nullptr), transform{}, nodeName{}, vertexStart(0), indexStart(0), boneIndices{}, vertexBones{}, boneBounds{}, staticBounds{}, morphTargets{} {}
+    ~MeshJob() = default;
+};
+
 // キーフレーム (時間と値のペア)
 struct VectorKey { double time; Vector3 value;  VectorKey() : time(0.0), value{} {} VectorKey(double time, Vector3 value) : time(time), value(value) {} ~VectorKey() = default; };
 struct QuatKey { double time; Quaternion value;  QuatKey() : time(0.0), value{} {} QuatKey(double time, Quaternion value) : time(time), value(value) {}  ~QuatKey() = default; };
@@ -77,18 +159,48 @@ struct Animation
     double duration;        // 全体の長さ(Tick)
     double ticksPerSecond;  // 1秒あたりのTick数
     std::vector<NodeAnimation> channels;
+    std::vector<MorphAnimation> morphChannels;
 
-    Animation() : name{}, duration(0.0), ticksPerSecond(0.0), channels{} {}
+    Animation() : name{}, duration(0.0), ticksPerSecond(0.0), channels{}, morphChannels{} {}
     ~Animation() = default;
 };
 
+// アニメーション参照 (ファイル参照で登録したクリップはキーデータを遅延読み込みする)
+struct AnimationRef
+{
+    std::string name;                // アニメーション名 (空ならファイル内の番号で探す)
+    std::filesystem::path path;      // 読み込み元ファイル (空なら常駐)
+    unsigned int sourceIndex;        // ファイル内のアニメーション番号
+    std::shared_ptr<Animation> data; // キーデータ (未読み込みならnullptr)
+    size_t byteSize;                 // キーデータのおおよそのサイズ
+    uint64_t lastUsed;               // 最後に使われた時刻 (LRU用)
+    bool isFailed;                   // 読み込みに失敗した (何度も読みに行かない)
+
+    AnimationRef() : name{}, path{}, sourceIndex(0), data{}, byteSize(0), lastUsed(0), isFailed(false) {}
+    ~AnimationRef() = default;
+};
+
+// ファイルから読み込むクリップ (同じファイルのまだ読んでいないクリップは1回の読み込みでまとめて変換する)
+struct AnimationClipRequest
+{
+    size_t index;                    // アニメーション番号
+    std::string name;                // アニメーション名 (空ならファイル内の番号で探す)
+    unsigned int sourceIndex;        // ファイル内のアニメーション番号
+    std::shared_ptr<Animation> data; // 読み込んだキーデータ (見つからなければnullptr)
+
+    AnimationClipRequest() : index(0), name{}, sourceIndex(0), data{} {}
+    AnimationClipRequest(size_t index, const std::string& name, unsigned int sourceIndex) : index(index), name(name), sourceIndex(sourceIndex), data{} {}
+    ~AnimationClipRequest() = default;
+};
+
 // ボーン情報
 struct BoneInfo
 {
     std::string name;    // ボーン名
     Matrix offsetMatrix; // オフセット行列 (モデル空間 -> ボーン空間)
+    AABB bounds;         // 影響する頂点の境界ボックス (ボーン空間)
 
-    BoneInfo() : name{}, offsetMatrix{} {}
+    BoneInfo() : name{}, offsetMatrix{}, bounds{} {}
     ~BoneInfo() = default;
 };
 
@@ -197,6 +309,152 @@ namespace
         return keys.back().value;
     }
 
+    //--------------
+    // 1つのモデルの読み込みで使えるスレッド数 (同時に読み込むモデルでコア数を分け合う)
+    //--------------
+    unsigned int LoadThreadBudget(unsigned int concurrentLoads)
+    {
+        return std::max(1u, std::max(1u, std::thread::hardware_concurrency()) / std::max(1u, concurrentLoads));
+    }
+
+    //--------------
+    // [0, count) を threadBudget 個までのスレッドで処理する (呼び出し元スレッドも処理に加わる)
+    //--------------
+    template<class Func>
+    void ParallelFor(size_t count, unsigned int threadBudget, Func func)
+    {
+        size_t threadCount = std::min<size_t>(std::max(1u, threadBudget), count);
+        if (threadCount <= 1)
+        {
+            for (size_t cnt = 0; cnt < count; ++cnt) func(cnt);
+            return;
+        }
+
+        // 処理量に偏りがあるので番号を取り合う
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]()
+            {
+                for (size_t index = next++; index < count; index = next++)
+                {
+                    func(index);
+                }
+            };
+
+        std::vector<std::future<void>> futures{};
+        futures.reserve(threadCount - 1);
+        for (size_t cnt = 0; cnt < threadCount - 1; ++cnt)
+        {
+            futures.push_back(std::async(std::launch::async, worker));
+        }
+        worker();
+
+        for (auto& future : futures)
+        {
+            future.get();
+        }
+    }
+
+    //--------------
+    // アニメーションのおおよそのメモリサイズ
+    //--------------
+    size_t EstimateAnimationSize(const Animation& anim)
+    {
+        size_t size = sizeof(Animation) + anim.name.capacity();
+        for (const auto& channel : anim.channels)
+        {
+            size += sizeof(NodeAnimation) + channel.nodeName.capacity();
+            size += channel.positionKeys.capacity() * sizeof(VectorKey);
+            size += channel.rotationKeys.capacity() * sizeof(QuatKey);
+            size += channel.scalingKeys.capacity() * sizeof(VectorKey);
+        }
+        for (const auto& channel : anim.morphChannels)
+        {
+            size += sizeof(MorphAnimation) + channel.nodeName.capacity();
+            for (const auto& key : channel.keys)
+            {
+                size += sizeof(MorphKey) + key.targets.capacity() * sizeof(unsigned int) + key.weights.capacity() * sizeof(float);
+            }
+        }
+        return size;
+    }
+
+    //--------------
+    // モーフウェイトのサンプリング (キーに無いターゲットは0扱い)
+    //--------------
+    void SampleMorphWeights(double time, const MorphAnimation& channel, std::span<const size_t> targetIndices, std::span<const MorphTarget> targets, std::vector<float>& outWeights)
+    {
+        const auto& keys = channel.keys;
+        if (keys.empty()) return;
+
+        // 区間を探す
+        size_t keyIndex = 0;
+        while (keyIndex + 1 < keys.size() && time >= keys[keyIndex + 1].time) ++keyIndex;
+        const MorphKey& key0 = keys[keyIndex];
+        const MorphKey& key1 = keys[std::min(keyIndex + 1, keys.size() - 1)];
+
+        float t = 0.0f;
+        double diff = key1.time - key0.time;
+        if (diff > 0.0001)
+        {
+            t = std::clamp(float((time - key0.time) / diff), 0.0f, 1.0f);
+        }
+
+        // このノードのターゲットにウェイトを書き込む
+        for (size_t targetIndex : targetIndices)
+        {
+            unsigned int animMeshIndex = targets[targetIndex].animMeshIndex;
+            float weight0 = 0.0f, weight1 = 0.0f;
+            for (size_t cnt = 0; cnt < key0.targets.size(); ++cnt)
+            {
+                if (key0.targets[cnt] == animMeshIndex) { weight0 = key0.weights[cnt]; break; }
+            }
+            for (size_t cnt = 0; cnt < key1.targets.size(); ++cnt)
+            {
+                if (key1.targets[cnt] == animMeshIndex) { weight1 = key1.weights[cnt]; break; }
+            }
+            outWeights[targetIndex] = weight0 + (weight1 - weight0) * t;
+        }
+    }
+
+    //--------------
+    // モーフターゲットを頂点に適用 (SSE)
+    //--------------
+    void ApplyMorphTargets(std::span<VertexModel> vertices, std::span<const unsigned int> baseIndices, std::span<const MorphVertex> baseVertices, std::span<const MorphTarget> targets, std::span<const float> weights)
+    {
+        // 影響を受ける頂点だけ基準形状に戻す
+        for (size_t cnt = 0; cnt < baseIndices.size(); ++cnt)
+        {
+            VertexModel& v = vertices[baseIndices[cnt]];
+            const MorphVertex& base = baseVertices[cnt];
+            v.pos = Vector3(base.position[0], base.position[1], base.position[2]);
+            v.nor = Vector3(base.normal[0], base.normal[1], base.normal[2]);
+        }
+
+        // ウェイトが0でないターゲットの差分を加算
+        // posとnorの後ろは同じ頂点内のメンバなので4要素で読み書きしても差分のw=0で値は変わらない
+        for (size_t cntTarget = 0; cntTarget < targets.size() && cntTarget < weights.size(); ++cntTarget)
+        {
+            float weight = weights[cntTarget];
+            if (fabsf(weight) < 1e-4f) continue;
+
+            const MorphTarget& target = targets[cntTarget];
+            const __m128 w = _mm_set1_ps(weight);
+            for (size_t cnt = 0; cnt < target.vertexIndices.size(); ++cnt)
+            {
+                VertexModel& v = vertices[target.vertexIndices[cnt]];
+                const MorphVertex& delta = target.deltas[cnt];
+
+                __m128 pos = _mm_loadu_ps(&v.pos.x);
+                pos = _mm_add_ps(pos, _mm_mul_ps(_mm_load_ps(delta.position), w));
+                _mm_storeu_ps(&v.pos.x, pos);
+
+                __m128 nor = _mm_loadu_ps(&v.nor.x);
+                nor = _mm_add_ps(nor, _mm_mul_ps(_mm_load_ps(delta.normal), w));
+                _mm_storeu_ps(&v.nor.x, nor);
+            }
+        }
+    }
+
     //--------------
     // 名前からノードを探す（再帰）
     //--------------
@@ -250,14 +508,15 @@ public:
     ModelResource(const std::filesystem::path& path, Renderer& renderer);
     ~ModelResource();
 
-    bool load(TextureManager& textureManager, bool isAnimOnly);
-    bool setAnimation(std::span<Animation> anims);
+    bool load(TextureManager& textureManager, bool isAnimOnly, unsigned int threadBudget);
+    bool setAnimation(std::span<const AnimationRef> anims);
     void unload();
 
     float getImportScale() const { return m_importScale; }
     Node* getRootNode() const { return m_rootNode; }
     size_t getNumBones() const { return m_boneInfo.size(); }
     BoneInfo* getBoneInfo(size_t index) { return (index < m_boneInfo.size()) ? &m_boneInfo[index] : nullptr; }
+    const AABB& getStaticBounds() const { return m_staticBounds; }
     size_t getNumVertices() const { return m_vertices.size(); }
     size_t getNumIndices() const { return m_indices.size(); }
     MeshHandle getMesh() const { return m_mesh; }
@@ -265,19 +524,43 @@ public:
     MaterialData* getMaterial(size_t index) { return (index < m_materials.size()) ? &m_materials[index] : nullptr; }
     size_t getNumSubsets() const { return m_subsets.size(); }
     Subset* getSubset(size_t index) { return (index < m_subsets.size()) ? &m_subsets[index] : nullptr; }
+    std::span<const DrawPacket> getDrawPackets() const { return m_drawPackets; }
+    std::span<const uint32_t> getBonePalette(const DrawPacket& packet) const { return std::span<const uint32_t>(m_bonePalettes).subspan(packet.paletteStart, packet.paletteCount); }
+    std::span<const VertexModel> getVertices() const { return m_vertices; }
+    size_t getNumMorphTargets() const { return m_morphTargets.size(); }
+    std::span<const MorphTarget> getMorphTargets() const { return m_morphTargets; }
+    std::span<const unsigned int> getMorphBaseIndices() const { return m_morphBaseIndices; }
+    std::span<const MorphVertex> getMorphBaseVertices() const { return m_morphBaseVertices; }
+    std::span<const size_t> getMorphTargetsOfNode(const std::string& nodeName) const;
+    size_t findMorphTarget(std::string_view name) const;
     size_t getNumTextures() const { return m_textures.size(); }
     TextureHandle getTextureHandle(size_t index) const { return (index < m_textures.size()) ? m_textures[index] : TextureHandle(); }
-    size_t getNumAnimations() const { return m_animations.size(); }
-    Animation* getAnimation(size_t index) { return (index < m_animations.size()) ? &m_animations[index] : nullptr; }
-    std::span<Animation> getAnimations() { return m_animations; }
+    size_t getNumAnimations() const;
+    std::shared_ptr<Animation> acquireAnimation(size_t index, uint64_t tick, size_t* pLoadedBytes = nullptr);
+    std::vector<AnimationRef> getAnimationRefs() const;
+    size_t addAnimationRef(const std::filesystem::path& path, std::string_view name, unsigned int sourceIndex);
+    void getEvictableAnimations(std::vector<std::pair<uint64_t, size_t>>& outCandidates) const;
+    size_t evictAnimation(size_t index);
+    size_t getLazyAnimationBytes() const;
     bool isThisAnimationLoaded(const std::string& name) const;
+    bool sampleNodeTransforms(const Animation& anim, std::span<const double> times, std::span<const std::string> nodeNames, std::span<Matrix> outTransforms, bool isLoop) const;
     bool isSetUpGpu() { return m_mesh.isValid(); }
 
 private:
-    void processMaterials(const aiScene* scene, TextureManager& textureManager);
-    Node* processNode(aiNode* node, const aiScene* scene, const Matrix& parentTransform);
-    void processMesh(aiMesh* mesh, const aiScene* scene, const Matrix& transform);
-    void processAnimations(const aiScene* scene);
+    void processMaterials(const aiScene* scene, TextureManager& textureManager, unsigned int threadBudget);
+    MaterialData processMaterial(const aiScene* scene, const aiMaterial* mat, TextureManager& textureManager, TextureHandle& outTexture) const;
+    Node* processNode(aiNode* node, const aiScene* scene, const Matrix& parentTransform, std::vector<MeshJob>& jobs);
+    void processMeshes(std::vector<MeshJob>& jobs, unsigned int threadBudget);
+    void processMesh(MeshJob& job, Subset& outSubset);
+    void buildBonePalettes(MeshJob& job, size_t subsetIndex);
+    void registerBonePalette(const std::vector<uint32_t>& palette, Subset& outSubset);
+    void processMorphTargets(MeshJob& job, bool hasBones);
+    void setupMorphBase();
+    void processAnimations(const aiScene* scene, bool isLazy);
+    void loadAnimationClips(const std::filesystem::path& path, std::span<AnimationClipRequest> requests) const;
+    bool isNodeMatch(const Animation& anim) const;
+    static Animation convertAnimation(const aiAnimation* srcAnim);
+    void buildDrawPackets();
     void setupMeshs();
 
     // モデルのファイルパス
@@ -294,14 +577,24 @@ private:
     std::vector<unsigned int> m_indices;   // インデックスデータ
     std::vector<MaterialData> m_materials; // マテリアルデータ
     std::vector<Subset> m_subsets;         // サブセット
+    std::vector<DrawPacket> m_drawPackets; // 描画パケット (マテリアル順)
     std::vector<TextureHandle> m_textures; // テクスチャハンドルリスト
+    AABB m_staticBounds;                   // ボーンの影響を受けない頂点の境界ボックス (メッシュ空間)
 
     // ボーンデータ
     std::vector<BoneInfo> m_boneInfo;                       // ボーンリスト (インデックスで管理)
+    std::vector<uint32_t> m_bonePalettes;                   // 描画単位のボーンパレット (m_boneInfoのインデックス MAX_BONES以下ずつ)
     std::unordered_map<std::string, int> m_boneMapping;     // ボーン名 -> インデックスの検索用
 
+    // モーフデータ
+    std::vector<MorphTarget> m_morphTargets;                                     // モーフターゲット
+    std::vector<unsigned int> m_morphBaseIndices;                                // いずれかのターゲットで動く頂点 (昇順)
+    std::vector<MorphVertex> m_morphBaseVertices;                                // ↑の基準形状
+    std::unordered_map<std::string, std::vector<size_t>> m_morphTargetsOfNode;   // ノード名 -> ターゲット番号
+
     // アニメーションデータ
-    std::vector<Animation> m_animations; // 読み込んだアニメーションリスト
+    mutable std::mutex m_animMutex;         // ↓のmutex (先読みスレッドから触る)
+    std::vector<AnimationRef> m_animations; // アニメーションリスト (常駐または遅延読み込み)
 
     // GPUリソース
     Renderer& m_renderer; // レンダラー参照
@@ -309,14 +602,15 @@ private:
 };
 
 static constexpr double DEFAULT_TICKSPERSECOND = 24.0; // デフォルトのTICK
+static constexpr float MIN_MATERIAL_POWER = 32.0f;     // 最小の鋭さ
 
-ModelResource::ModelResource(const std::filesystem::path& path, Renderer& renderer) : m_path(path), m_vertices{}, m_indices{}, m_materials{}, m_subsets{}, m_textures{}, m_rootNode{}, m_renderer(renderer), m_animations{}, m_boneInfo{}, m_boneMapping{}, m_importScale{}, m_mesh{} {}
+ModelResource::ModelResource(const std::filesystem::path& path, Renderer& renderer) : m_path(path), m_vertices{}, m_indices{}, m_materials{}, m_subsets{}, m_textures{}, m_rootNode{}, m_renderer(renderer), m_animMutex{}, m_animations{}, m_boneInfo{}, m_bonePalettes{}, m_boneMapping{}, m_importScale{}, m_mesh{}, m_staticBounds{}, m_drawPackets{}, m_morphTargets{}, m_morphBaseIndices{}, m_morphBaseVertices{}, m_morphTargetsOfNode{} {}
 ModelResource::~ModelResource() { unload(); }
 
 //--------------
-// モデルを読み込む関数
+// モデルを読み込む関数 (threadBudgetはこの読み込みで使えるスレッド数 呼び出し元スレッドを含む)
 //--------------
-bool ModelResource::load(TextureManager& textureManager, bool isAnimOnly)
+bool ModelResource::load(TextureManager& textureManager, bool isAnimOnly, unsigned int threadBudget)
 {
     // モデルを読み込む
     Assimp::Importer importer;
@@ -355,18 +649,47 @@ bool ModelResource::load(TextureManager& textureManager, bool isAnimOnly)
             }
         }
 
-        // マテリアルを処理
-        processMaterials(scene, textureManager);
+        // マテリアルはメッシュと並行して処理 (スレッドを分け合う 1つしかなければ順番に)
+        threadBudget = std::max(1u, threadBudget);
+        unsigned int materialBudget = threadBudget / 2u;
+        std::future<void> materialTask{};
+        if (materialBudget > 0u)
+        {
+            materialTask = std::async(std::launch::async, [this, scene, &textureManager, materialBudget]()
+                {
+                    processMaterials(scene, textureManager, materialBudget);
+                });
+        }
+        else
+        {
+            processMaterials(scene, textureManager, 1u);
+        }
+
+        // ルートノードから再帰的にノードを作成してメッシュを集める
+        std::vector<MeshJob> meshJobs{};
+        m_rootNode = processNode(scene->mRootNode, scene, Matrix(), meshJobs);
+
+        // メッシュを並列で処理
+        processMeshes(meshJobs, threadBudget - materialBudget);
+
+        // マテリアルを待つ
+        if (materialTask.valid())
+        {
+            materialTask.get();
+        }
+
+        // 描画パケットの構築
+        buildDrawPackets();
 
-        // ルートノードから再帰的に処理を開始
-        m_rootNode = processNode(scene->mRootNode, scene, Matrix());
+        // モーフの基準形状を保存
+        setupMorphBase();
 
         // メッシュ生成
         setupMeshs();
     }
 
-    // アニメーションを処理
-    processAnimations(scene);
+    // アニメーションを処理 (アニメーションだけのファイルは名前だけ登録し,キーデータは使われるときに読み込む)
+    processAnimations(scene, isAnimOnly);
 
     return true;
 }
@@ -374,34 +697,301 @@ bool ModelResource::load(TextureManager& textureManager, bool isAnimOnly)
 //--------------
 // アニメーションを読み込む関数
 //--------------
-bool ModelResource::setAnimation(std::span<Animation> anims)
+bool ModelResource::setAnimation(std::span<const AnimationRef> anims)
 {
-    // アニメーション対象のノードが現在のモデルに存在するか確認
     for (const auto& anim : anims)
     {
         if (isThisAnimationLoaded(anim.name)) return false;
 
-        bool isNodeMatch = true;
-        // アニメーションが持っている「動かす対象のボーン名」を一つずつ確認する
-        for (const auto& channel : anim.channels)
+        if (anim.data == nullptr)
+        {// 遅延読み込みのクリップはファイル参照で登録する (ノードの確認は読み込むとき)
+            if (!anim.path.empty()) addAnimationRef(anim.path, anim.name, anim.sourceIndex);
+        }
+        else if (isNodeMatch(*anim.data))
+        {// アニメーション対象のノードが現在のモデルに存在すればキーデータは共有する
+            AnimationRef ref{};
+            ref.name = anim.name;
+            ref.data = anim.data;
+
+            std::lock_guard<std::mutex> lock(m_animMutex);
+            m_animations.push_back(ref);
+        }
+    }
+    return true;
+}
+
+//--------------
+// アニメーションが動かすノードがすべてこのモデルにあるか調べる関数
+//--------------
+bool ModelResource::isNodeMatch(const Animation& anim) const
+{
+    // アニメーションが持っている「動かす対象のボーン名」を一つずつ確認する
+    for (const auto& channel : anim.channels)
+    {
+        if (FindNode(m_rootNode, channel.nodeName) == nullptr)
         {
-            if (FindNode(m_rootNode, channel.nodeName) == nullptr)
+            if (FindNodeofExtract(m_rootNode, channel.nodeName) == nullptr)
             {
-                if (FindNodeofExtract(m_rootNode, channel.nodeName) == nullptr)
+                return false; // ノードが存在しない
+            }
+        }
+    }
+    return true;
+}
+
+//--------------
+// アニメーション数を取得する関数
+//--------------
+size_t ModelResource::getNumAnimations() const
+{
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    return m_animations.size();
+}
+
+//--------------
+// アニメーションのキーデータを取得する関数 (未読み込みならここで読み込む)
+//--------------
+std::shared_ptr<Animation> ModelResource::acquireAnimation(size_t index, uint64_t tick, size_t* pLoadedBytes)
+{
+    std::filesystem::path path{};
+    std::vector<AnimationClipRequest> requests{};
+    {
+        std::lock_guard<std::mutex> lock(m_animMutex);
+        if (index >= m_animations.size()) return nullptr;
+
+        AnimationRef& ref = m_animations[index];
+        ref.lastUsed = tick;
+        if (ref.data != nullptr || ref.isFailed) return ref.data;
+
+        // 同じファイルのまだ読んでいないクリップも一緒に読む (ファイルの解析は1回で済ませる)
+        path = ref.path;
+        requests.emplace_back(index, ref.name, ref.sourceIndex);
+        for (size_t cnt = 0; cnt < m_animations.size(); ++cnt)
+        {
+            const AnimationRef& other = m_animations[cnt];
+            if (cnt != index && other.path == path && other.data == nullptr && !other.isFailed)
+            {
+                requests.emplace_back(cnt, other.name, other.sourceIndex);
+            }
+        }
+    }
+
+    // ファイルの読み込みはロックの外で行う
+    loadAnimationClips(path, requests);
+
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    size_t loadedBytes = 0;
+    for (const auto& request : requests)
+    {
+        AnimationRef& ref = m_animations[request.index];
+        if (request.data == nullptr)
+        {
+            if (ref.data == nullptr) ref.isFailed = true;
+            continue;
+        }
+        if (ref.data == nullptr)
+        {// 他のスレッドが先に読み込んでいなければ登録
+            ref.data = request.data;
+            ref.name = request.data->name;
+            ref.byteSize = EstimateAnimationSize(*request.data);
+            loadedBytes += ref.byteSize;
+        }
+    }
+    if (pLoadedBytes != nullptr) *pLoadedBytes = loadedBytes;
+    return m_animations[index].data;
+}
+
+//--------------
+// ファイルからアニメーションをまとめて読み込む関数 (見つからないかこのモデルで使えないクリップはnullptrのまま)
+//--------------
+void ModelResource::loadAnimationClips(const std::filesystem::path& path, std::span<AnimationClipRequest> requests) const
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(ToUtf8String(path), 0);
+    if (!scene || !scene->mAnimations)
+    {
+        return; // 読み込み失敗
+    }
+
+    for (auto& request : requests)
+    {
+        // 番号の名前が合えば番号で,違えば名前で探す (名前がなければ番号だけ)
+        const aiAnimation* srcAnim{};
+        if (request.sourceIndex < scene->mNumAnimations && (request.name.empty() || request.name == scene->mAnimations[request.sourceIndex]->mName.C_Str()))
+        {
+            srcAnim = scene->mAnimations[request.sourceIndex];
+        }
+        else if (!request.name.empty())
+        {
+            for (unsigned int cnt = 0; cnt < scene->mNumAnimations; ++cnt)
+            {
+                if (request.name == scene->mAnimations[cnt]->mName.C_Str())
                 {
-                    isNodeMatch = false; // ノードが存在しない
+                    srcAnim = scene->mAnimations[cnt];
+                    break;
                 }
             }
         }
-
-        if (isNodeMatch)
+        if (srcAnim == nullptr)
         {
-            m_animations.push_back(anim);
+            continue; // 見つからない
+        }
+
+        std::shared_ptr<Animation> anim = std::make_shared<Animation>(convertAnimation(srcAnim));
+        if (m_rootNode == nullptr || isNodeMatch(*anim))
+        {// このモデルで使えるものだけ (アニメーションだけのファイルはノードを持たないので確認しない)
+            request.data = anim;
         }
     }
+}
+
+//--------------
+// アニメーションを指定時間で評価してノードのモデル空間変換行列を取得する関数
+// outTransforms には times.size() * nodeNames.size() 個が時間ごとに並ぶ
+//--------------
+bool ModelResource::sampleNodeTransforms(const Animation& anim, std::span<const double> times, std::span<const std::string> nodeNames, std::span<Matrix> outTransforms, bool isLoop) const
+{
+    if (m_rootNode == nullptr || outTransforms.size() < times.size() * nodeNames.size())
+    {
+        return false;
+    }
+
+    // ノード名 -> チャンネルの検索表 (全時間で共有)
+    std::unordered_map<std::string_view, const NodeAnimation*> channelMap{};
+    for (const auto& channel : anim.channels)
+    {
+        channelMap.try_emplace(channel.nodeName, &channel);
+    }
+
+    // 出力するノードの順番
+    std::unordered_map<std::string_view, size_t> outputMap{};
+    for (size_t cnt = 0; cnt < nodeNames.size(); ++cnt)
+    {
+        outputMap.try_emplace(nodeNames[cnt], cnt);
+    }
+
+    for (size_t cntTime = 0; cntTime < times.size(); ++cntTime)
+    {
+        double time = times[cntTime];
+        std::span<Matrix> out = outTransforms.subspan(cntTime * nodeNames.size(), nodeNames.size());
+
+        // 親から子へ行列をかけ合わせていく
+        auto evaluate = [&](auto&& self, const Node* node, const Matrix& parentTransform) -> void
+            {
+                Transform local = node->defaultTransform.toTransform();
+                auto channel = channelMap.find(node->name);
+                if (channel != channelMap.end())
+                {
+                    local.position = CalcInterpolatedVector(time, channel->second->positionKeys, anim.duration, isLoop, local.position);
+                    local.rotation = CalcInterpolatedRotation(time, channel->second->rotationKeys, anim.duration, isLoop, local.rotation);
+                    local.scale = CalcInterpolatedVector(time, channel->second->scalingKeys, anim.duration, isLoop, local.scale);
+                }
+
+                Matrix globalTransform = Matrix::Multiply(local.toMatrix(), parentTransform);
+                auto output = outputMap.find(node->name);
+                if (output != outputMap.end())
+                {
+                    out[output->second] = globalTransform;
+                }
+
+                for (auto child : node->children)
+                {
+                    self(self, child, globalTransform);
+                }
+            };
+        evaluate(evaluate, m_rootNode, Matrix());
+    }
     return true;
 }
 
+//--------------
+// アニメーション参照を取得する関数 (常駐ならキーデータ,遅延読み込みならファイル参照)
+//--------------
+std::vector<AnimationRef> ModelResource::getAnimationRefs() const
+{
+    std::vector<AnimationRef> anims{};
+
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    for (const auto& ref : m_animations)
+    {
+        if (ref.data != nullptr || !ref.path.empty()) anims.push_back(ref);
+    }
+    return anims;
+}
+
+//--------------
+// ファイル参照でアニメーションを登録する関数 (キーデータは読み込まない)
+//--------------
+size_t ModelResource::addAnimationRef(const std::filesystem::path& path, std::string_view name, unsigned int sourceIndex)
+{
+    std::lock_guard<std::mutex> lock(m_animMutex);
+
+    // 登録済みならその番号
+    for (size_t cnt = 0; cnt < m_animations.size(); ++cnt)
+    {
+        const AnimationRef& ref = m_animations[cnt];
+        if (ref.path == path && (name.empty() ? ref.sourceIndex == sourceIndex : ref.name == name))
+        {
+            return cnt;
+        }
+    }
+
+    AnimationRef ref{};
+    ref.name = name;
+    ref.path = path;
+    ref.sourceIndex = sourceIndex;
+    m_animations.push_back(ref);
+    return m_animations.size() - 1;
+}
+
+//--------------
+// 解放できるアニメーションを集める関数 (遅延読み込みで誰も再生していないもの)
+//--------------
+void ModelResource::getEvictableAnimations(std::vector<std::pair<uint64_t, size_t>>& outCandidates) const
+{
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    for (size_t cnt = 0; cnt < m_animations.size(); ++cnt)
+    {
+        const AnimationRef& ref = m_animations[cnt];
+        if (!ref.path.empty() && ref.data != nullptr && ref.data.use_count() == 1)
+        {
+            outCandidates.push_back({ ref.lastUsed, cnt });
+        }
+    }
+}
+
+//--------------
+// アニメーションのキーデータを解放する関数 (解放したサイズを返す)
+//--------------
+size_t ModelResource::evictAnimation(size_t index)
+{
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    if (index >= m_animations.size()) return 0;
+
+    AnimationRef& ref = m_animations[index];
+    if (ref.path.empty() || ref.data == nullptr || ref.data.use_count() != 1) return 0;
+
+    size_t size = ref.byteSize;
+    ref.data.reset();
+    ref.byteSize = 0;
+    return size;
+}
+
+//--------------
+// 遅延読み込みしたアニメーションの合計サイズを取得する関数
+//--------------
+size_t ModelResource::getLazyAnimationBytes() const
+{
+    size_t size = 0;
+
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    for (const auto& ref : m_animations)
+    {
+        if (!ref.path.empty()) size += ref.byteSize;
+    }
+    return size;
+}
+
 //--------------
 // モデルを解放する関数
 //--------------
@@ -423,8 +1013,27 @@ void ModelResource::unload()
     m_materials.shrink_to_fit();
     m_subsets.clear();
     m_subsets.shrink_to_fit();
+    m_drawPackets.clear();
+    m_drawPackets.shrink_to_fit();
+    m_bonePalettes.clear();
+    m_bonePalettes.shrink_to_fit();
+    m_morphTargets.clear();
+    m_morphTargets.shrink_to_fit();
+    m_morphBaseIndices.clear();
+    m_morphBaseIndices.shrink_to_fit();
+    m_morphBaseVertices.clear();
+    m_morphBaseVertices.shrink_to_fit();
+    m_morphTargetsOfNode.clear();
     m_textures.clear();
     m_textures.shrink_to_fit();
+    m_staticBounds.reset();
+
+    // アリーナの範囲を返す
+    if (m_mesh.isValid())
+    {
+        m_renderer.releaseMesh(m_mesh);
+        m_mesh = MeshHandle();
+    }
 }
 
 //--------------
@@ -432,6 +1041,7 @@ void ModelResource::unload()
 //--------------
 bool ModelResource::isThisAnimationLoaded(const std::string& name) const
 {
+    std::lock_guard<std::mutex> lock(m_animMutex);
     for (const auto& anim : m_animations)
     {
         if (anim.name == name)
@@ -445,88 +1055,31 @@ bool ModelResource::isThisAnimationLoaded(const std::string& name) const
 //--------------
 // マテリアルを処理する関数
 //--------------
-void ModelResource::processMaterials(const aiScene* scene, TextureManager& textureManager)
+void ModelResource::processMaterials(const aiScene* scene, TextureManager& textureManager, unsigned int threadBudget)
 {
     m_materials.clear();
     m_textures.clear();
 
     if (scene->HasMaterials())
     {
-        for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
-        {
-            aiMaterial* mat = scene->mMaterials[i];
-            MaterialData matData;
-
-            aiString name;
-            mat->Get(AI_MATKEY_NAME, name);
-            matData.name = name.C_Str();
-
-            // 色とスペキュラーの強さを取得
-            aiColor4D color;
-            float shininess = 0.0f;
-            if (AI_SUCCESS == mat->Get(AI_MATKEY_COLOR_DIFFUSE, color))
-            {
-                matData.diffuseColor = Color(color.r, color.g, color.b, color.a);
-            }
-            if (AI_SUCCESS == mat->Get(AI_MATKEY_COLOR_SPECULAR, color))
+        // マテリアルごとに並列で変換 (テクスチャマネージャーへの登録はスレッドセーフ)
+        std::vector<MaterialData> materials(scene->mNumMaterials);
+        std::vector<TextureHandle> textures(scene->mNumMaterials);
+        ParallelFor(scene->mNumMaterials, threadBudget, [&](size_t index)
             {
-                matData.specularColor = Color(color.r, color.g, color.b, color.a);
-            }
-            if (AI_SUCCESS == mat->Get(AI_MATKEY_COLOR_EMISSIVE, color))
-            {
-                matData.emissiveColor = Color(color.r, color.g, color.b, color.a);
-            }
-            if (AI_SUCCESS == mat->Get(AI_MATKEY_SHININESS, shininess))
-            {
-                matData.shininess = shininess;
-            }
+                materials[index] = processMaterial(scene, scene->mMaterials[index], textureManager, textures[index]);
+            });
 
-            aiString path;
-            if (AI_SUCCESS == mat->GetTexture(aiTextureType_DIFFUSE, 0, &path))
+        // テクスチャ番号は元の順番で振る
+        for (size_t cnt = 0; cnt < materials.size(); ++cnt)
+        {
+            // 読み込めたらリストに追加してインデックスを保存
+            if (textures[cnt].isValid())
             {
-                std::string pathStr = path.C_Str();
-                std::filesystem::path u8path = reinterpret_cast<const char8_t*>(path.C_Str());
-                std::filesystem::path fullPath = m_path.parent_path() / u8path;
-                TextureHandle texHandle{};
-                uint64_t texID = Hash(fullPath.u8string().c_str());
-
-                // 埋め込みテクスチャか確認
-                const aiTexture* embedded = scene->GetEmbeddedTexture(path.C_Str());
-                if (embedded)
-                {// 埋め込みテクスチャ
-                    // コピー
-                    if (embedded->mHeight == 0)
-                    {// 圧縮テクスチャ (jpg, pngなど)
-                        // バッファを確保してコピー
-                        std::vector<uint8_t> buffer(embedded->mWidth);
-                        const uint8_t* src = reinterpret_cast<const uint8_t*>(embedded->pcData);
-                        buffer.assign(src, src + embedded->mWidth);
-
-                        textureManager.registerByteData(texID, fullPath, buffer, embedded->achFormatHint);
-                        texHandle = textureManager.getTextureHandle(texID);
-                    }
-                    else
-                    {
-                        unsigned char* src = reinterpret_cast<unsigned char*>(embedded->pcData);
-                        textureManager.registerRawData(texID, fullPath, src, embedded->mWidth, embedded->mHeight);
-                        texHandle = textureManager.getTextureHandle(texID);
-                    }
-                }
-                else
-                {// 通常のテクスチャファイル
-                    // ファイルから読み込み
-                    textureManager.registerPath(texID, fullPath);
-                    texHandle = textureManager.getTextureHandle(texID);
-                }
-
-                // 読み込めたらリストに追加してインデックスを保存
-                if (texHandle.isValid())
-                {
-                    m_textures.push_back(texHandle);
-                    matData.textureIndex = (int)m_textures.size() - 1;
-                }
+                m_textures.push_back(textures[cnt]);
+                materials[cnt].textureIndex = (int)m_textures.size() - 1;
             }
-            m_materials.push_back(matData);
+            m_materials.push_back(std::move(materials[cnt]));
         }
     }
     // マテリアルがない場合のデフォルトを追加
@@ -534,9 +1087,79 @@ void ModelResource::processMaterials(const aiScene* scene, TextureManager& textu
 }
 
 //--------------
-// ノードを再帰的に処理する関数
+// マテリアルを1つ変換する関数
 //--------------
-Node* ModelResource::processNode(aiNode* node, const aiScene* scene, const Matrix& parentTransform)
+MaterialData ModelResource::processMaterial(const aiScene* scene, const aiMaterial* mat, TextureManager& textureManager, TextureHandle& outTexture) const
+{
+    MaterialData matData;
+
+    aiString name;
+    mat->Get(AI_MATKEY_NAME, name);
+    matData.name = name.C_Str();
+
+    // 色とスペキュラーの強さを取得
+    aiColor4D color;
+    float shininess = 0.0f;
+    if (AI_SUCCESS == mat->Get(AI_MATKEY_COLOR_DIFFUSE, color))
+    {
+        matData.diffuseColor = Color(color.r, color.g, color.b, color.a);
+    }
+    if (AI_SUCCESS == mat->Get(AI_MATKEY_COLOR_SPECULAR, color))
+    {
+        matData.specularColor = Color(color.r, color.g, color.b, color.a);
+    }
+    if (AI_SUCCESS == mat->Get(AI_MATKEY_COLOR_EMISSIVE, color))
+    {
+        matData.emissiveColor = Color(color.r, color.g, color.b, color.a);
+    }
+    if (AI_SUCCESS == mat->Get(AI_MATKEY_SHININESS, shininess))
+    {
+        matData.shininess = shininess;
+    }
+
+    aiString path;
+    if (AI_SUCCESS == mat->GetTexture(aiTextureType_DIFFUSE, 0, &path))
+    {
+        std::filesystem::path u8path = reinterpret_cast<const char8_t*>(path.C_Str());
+        std::filesystem::path fullPath = m_path.parent_path() / u8path;
+        uint64_t texID = Hash(fullPath.u8string().c_str());
+
+        // 埋め込みテクスチャか確認
+        const aiTexture* embedded = scene->GetEmbeddedTexture(path.C_Str());
+        if (embedded)
+        {// 埋め込みテクスチャ
+            // コピー
+            if (embedded->mHeight == 0)
+            {// 圧縮テクスチャ (jpg, pngなど)
+                // バッファを確保してコピー
+                std::vector<uint8_t> buffer(embedded->mWidth);
+                const uint8_t* src = reinterpret_cast<const uint8_t*>(embedded->pcData);
+                buffer.assign(src, src + embedded->mWidth);
+
+                textureManager.registerByteData(texID, fullPath, buffer, embedded->achFormatHint);
+                outTexture = textureManager.getTextureHandle(texID);
+            }
+            else
+            {
+                unsigned char* src = reinterpret_cast<unsigned char*>(embedded->pcData);
+                textureManager.registerRawData(texID, fullPath, src, embedded->mWidth, embedded->mHeight);
+                outTexture = textureManager.getTextureHandle(texID);
+            }
+        }
+        else
+        {// 通常のテクスチャファイル
+            // ファイルから読み込み
+            textureManager.registerPath(texID, fullPath);
+            outTexture = textureManager.getTextureHandle(texID);
+        }
+    }
+    return matData;
+}
+
+//--------------
+// ノードを再帰的に処理する関数 (メッシュは作業リストに積むだけ)
+//--------------
+Node* ModelResource::processNode(aiNode* node, const aiScene* scene, const Matrix& parentTransform, std::vector<MeshJob>& jobs)
 {
     // ノード作成
     Node* newNode = new Node;
@@ -548,21 +1171,23 @@ Node* ModelResource::processNode(aiNode* node, const aiScene* scene, const Matri
     // 親の変換行列と掛け合わせてグローバル変換行列を計算
     Matrix globalTransform = Matrix::Multiply(parentTransform, newNode->defaultTransform);
 
-    // ノードが持つメッシュをすべて処理
+    // ノードが持つメッシュをすべて登録
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         // メッシュへのインデックスを格納
         newNode->meshIndices.push_back(node->mMeshes[i]);
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 
-        // メッシュを処理
-        processMesh(mesh, scene, globalTransform);
+        MeshJob job{};
+        job.mesh = scene->mMeshes[node->mMeshes[i]];
+        job.transform = globalTransform;
+        job.nodeName = newNode->name;
+        jobs.push_back(std::move(job));
     }
 
     // 子ノードを再帰的に処理
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        Node* childNode = processNode(node->mChildren[i], scene, globalTransform);
+        Node* childNode = processNode(node->mChildren[i], scene, globalTransform, jobs);
         childNode->parent = newNode;
         newNode->children.push_back(childNode);
     }
@@ -571,19 +1196,103 @@ Node* ModelResource::processNode(aiNode* node, const aiScene* scene, const Matri
 }
 
 //--------------
-// メッシュデータを処理する関数
+// メッシュをまとめて処理する関数
+//--------------
+void ModelResource::processMeshes(std::vector<MeshJob>& jobs, unsigned int threadBudget)
+{
+    // 頂点とインデックスの書き込み位置を累積和で先に決める
+    size_t vertexCount = m_vertices.size();
+    size_t indexCount = m_indices.size();
+    for (auto& job : jobs)
+    {
+        job.vertexStart = static_cast<unsigned int>(vertexCount);
+        job.indexStart = static_cast<unsigned int>(indexCount);
+        vertexCount += job.mesh->mNumVertices;
+        indexCount += size_t(job.mesh->mNumFaces) * 3;
+    }
+    m_vertices.resize(vertexCount);
+    m_indices.resize(indexCount);
+    size_t subsetStart = m_subsets.size();
+    m_subsets.resize(subsetStart + jobs.size());
+
+    // ボーンの登録は元の順番で先に済ませる (番号を並列処理に依存させない)
+    for (auto& job : jobs)
+    {
+        job.boneIndices.resize(job.mesh->mNumBones);
+        for (unsigned int i = 0; i < job.mesh->mNumBones; ++i)
+        {
+            const aiBone* bone = job.mesh->mBones[i];
+            std::string boneName = bone->mName.C_Str();
+
+            // ボーンが初登場なら登録、既知ならインデックス取得
+            auto it = m_boneMapping.find(boneName);
+            if (it == m_boneMapping.end())
+            {
+                BoneInfo bi;
+                bi.name = boneName;
+                bi.offsetMatrix = convertMatrix(bone->mOffsetMatrix); // オフセット行列を保存
+
+                job.boneIndices[i] = (int)m_boneInfo.size();
+                m_boneMapping[boneName] = job.boneIndices[i];
+                m_boneInfo.push_back(bi);
+            }
+            else
+            {
+                job.boneIndices[i] = it->second;
+            }
+        }
+    }
+
+    // メッシュごとに並列で変換 (書き込み範囲は重ならない)
+    ParallelFor(jobs.size(), threadBudget, [&](size_t index)
+        {
+            processMesh(jobs[index], m_subsets[subsetStart + index]);
+        });
+
+    // メッシュごとの結果を元の順番で合成
+    for (size_t cnt = 0; cnt < jobs.size(); ++cnt)
+    {
+        MeshJob& job = jobs[cnt];
+
+        // ボーンパレット (大きなメッシュは分割して頂点を増やすのでモーフより先に)
+        buildBonePalettes(job, subsetStart + cnt);
+
+        for (const auto& [boneIndex, bounds] : job.boneBounds)
+        {
+            m_boneInfo[boneIndex].bounds.merge(bounds);
+        }
+        m_staticBounds.merge(job.staticBounds);
+
+        for (auto& target : job.morphTargets)
+        {
+            m_morphTargetsOfNode[job.nodeName].push_back(m_morphTargets.size());
+            m_morphTargets.push_back(std::move(target));
+        }
+        job.morphTargets.clear();
+    }
+}
+
+//--------------
+// メッシュデータを処理する関数 (ワーカースレッドから呼ばれる)
 //--------------
-void ModelResource::processMesh(aiMesh* mesh, const aiScene* scene, const Matrix& transform)
+void ModelResource::processMesh(MeshJob& job, Subset& outSubset)
 {
-    unsigned int indexStart = static_cast<unsigned int>(m_indices.size());
-    unsigned int vertexStart = static_cast<unsigned int>(m_vertices.size());
+    const aiMesh* mesh = job.mesh;
+    const Matrix& transform = job.transform;
+    unsigned int vertexStart = job.vertexStart;
+    unsigned int indexStart = job.indexStart;
 
     bool hasBones = mesh->HasBones();
+    bool isSplitPalette = mesh->mNumBones > MAX_BONES; // 1つのパレットに収まらない (後で三角形ごとに分ける)
+    if (isSplitPalette)
+    {
+        job.vertexBones.assign(mesh->mNumVertices, {});
+    }
 
     // 頂点
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        VertexModel vertex;
+        VertexModel& vertex = m_vertices[vertexStart + i];
 
         // 位置
         vertex.pos = Vector3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
@@ -622,36 +1331,17 @@ void ModelResource::processMesh(aiMesh* mesh, const aiScene* scene, const Matrix
             vertex.weights[k] = 0.0f;
             vertex.boneIndices[k] = 0;
         }
-
-        m_vertices.push_back(vertex);
     }
 
     // ボーン
-    if (mesh->HasBones())
+    if (hasBones)
     {
         for (unsigned int i = 0; i < mesh->mNumBones; ++i)
         {
-            aiBone* bone = mesh->mBones[i];
-            std::string boneName = bone->mName.C_Str();
-            int boneIndex = 0;
-
-            // ボーンが初登場なら登録、既知ならインデックス取得
-            if (m_boneMapping.find(boneName) == m_boneMapping.end())
-            {
-                boneIndex = (int)m_boneInfo.size();
-
-                BoneInfo bi;
-                bi.name = boneName;
-                bi.offsetMatrix = convertMatrix(bone->mOffsetMatrix); // オフセット行列を保存
-
-                m_boneInfo.push_back(bi);
-
-                m_boneMapping[boneName] = boneIndex;
-            }
-            else
-            {
-                boneIndex = m_boneMapping[boneName];
-            }
+            const aiBone* bone = mesh->mBones[i];
+            int boneIndex = job.boneIndices[i];
+            const Matrix& offsetMatrix = m_boneInfo[boneIndex].offsetMatrix;
+            AABB bounds{};
 
             // このボーンが影響を与える頂点たちに、IDとウェイトを書き込む
             for (unsigned int j = 0; j < bone->mNumWeights; ++j)
@@ -662,16 +1352,35 @@ void ModelResource::processMesh(aiMesh* mesh, const aiScene* scene, const Matrix
 
                 VertexModel& v = m_vertices[vertexStart + localVertexID];
 
+                // ボーン空間での境界ボックスを拡張 (ウェイト4本の制限に関係なく影響する頂点はすべて含める)
+                if (weight > 0.0f)
+                {
+                    skinning::ExpandBoneBounds(bounds, v.pos, offsetMatrix);
+                }
+
                 for (int k = 0; k < 4; ++k)
                 {
                     if (v.weights[k] == 0.0f) // 空きスロット発見
-                    {
+                    {// ボーン番号はメッシュ内の番号 (パレット内の番号になる)
                         v.weights[k] = weight;
-                        v.boneIndices[k] = (uint8_t)boneIndex;
+                        if (isSplitPalette)
+                        {
+                            job.vertexBones[localVertexID][k] = i;
+                        }
+                        else
+                        {
+                            v.boneIndices[k] = (uint8_t)i;
+                        }
                         break;
                     }
                 }
             }
+
+            // 他のメッシュと共有するボーンがあるので後で合成する
+            if (bounds.isValid())
+            {
+                job.boneBounds.push_back({ boneIndex, bounds });
+            }
         }
     }
 
@@ -680,6 +1389,10 @@ void ModelResource::processMesh(aiMesh* mesh, const aiScene* scene, const Matrix
     {
         VertexModel& v = m_vertices[vertexStart + i];
         float sum = v.weights[0] + v.weights[1] + v.weights[2] + v.weights[3];
+        if (sum <= 0.0001f)
+        {// ボーンの影響がない頂点はワールド行列で描画される
+            job.staticBounds.expand(v.pos);
+        }
         if (sum > 1e-6f && fabsf(sum - 1.0f) > 1e-6f)
         {
             v.weights[0] /= sum;
@@ -692,65 +1405,455 @@ void ModelResource::processMesh(aiMesh* mesh, const aiScene* scene, const Matrix
     // インデックス
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
-        // aiProcess_Triangulate フラグを指定したので、face.mNumIndices は常に 3 のはず
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
+        const aiFace& face = mesh->mFaces[i];
+        unsigned int* dest = &m_indices[indexStart + size_t(i) * 3];
+
+        // aiProcess_Triangulate 後も点や線は残るので、三角形以外は縮退三角形にして範囲を揃える
+        if (face.mNumIndices == 3)
+        {
+            dest[0] = face.mIndices[0] + vertexStart;
+            dest[1] = face.mIndices[1] + vertexStart;
+            dest[2] = face.mIndices[2] + vertexStart;
+        }
+        else
+        {
+            unsigned int first = (face.mNumIndices > 0) ? face.mIndices[0] + vertexStart : vertexStart;
+            dest[0] = dest[1] = dest[2] = first;
+        }
+    }
+
+    // モーフターゲット
+    processMorphTargets(job, hasBones);
+
+    // サブセットの登録
+    outSubset.indexStart = indexStart;              // このメッシュのインデックス開始位置
+    outSubset.indexCount = mesh->mNumFaces * 3;     // インデックス数
+    outSubset.materialIndex = mesh->mMaterialIndex; // マテリアル番号
+}
+
+//--------------
+// メッシュのボーンパレットを作る関数
+// MAX_BONES以下ならメッシュのボーンをそのまま使い,超えるならインデックス順に三角形を詰めて溢れたところでサブセットを区切る
+// 区切りをまたぐ頂点は複製してパレット内の番号を振り直す
+//--------------
+void ModelResource::buildBonePalettes(MeshJob& job, size_t subsetIndex)
+{
+    if (job.boneIndices.empty()) return;
+
+    std::vector<uint32_t> palette{};
+    if (job.vertexBones.empty())
+    {// 1つに収まる (頂点はメッシュ内の番号を持っている)
+        palette.assign(job.boneIndices.begin(), job.boneIndices.end());
+        registerBonePalette(palette, m_subsets[subsetIndex]);
+        return;
+    }
+
+    const unsigned int vertexStart = job.vertexStart;
+    const unsigned int indexStart = m_subsets[subsetIndex].indexStart;
+    const unsigned int indexEnd = indexStart + m_subsets[subsetIndex].indexCount;
+    const unsigned int materialIndex = m_subsets[subsetIndex].materialIndex;
+
+    std::vector<int> vertexGroup(job.vertexBones.size(), -1);                // 頂点を最初に使ったグループ
+    std::vector<int> boneSlots(job.boneIndices.size(), -1);                  // メッシュ内のボーン番号 -> パレット内の番号 (今のグループ)
+    std::unordered_map<unsigned int, unsigned int> duplicateOf{};            // 今のグループで複製した頂点 (メッシュ内の番号 -> m_vertices)
+    std::vector<std::pair<unsigned int, unsigned int>> duplicates{};         // 複製した頂点と複製元 (m_vertices上のインデックス)
+    int group = 0;
+    unsigned int groupStart = indexStart;
+
+    // 今のグループをサブセットにする (最初のグループは元のサブセットを使う)
+    auto closeGroup = [&](unsigned int groupEnd)
+        {
+            std::vector<uint32_t> globalPalette(palette.size());
+            for (size_t cnt = 0; cnt < palette.size(); ++cnt)
+            {
+                globalPalette[cnt] = static_cast<uint32_t>(job.boneIndices[palette[cnt]]);
+            }
+            Subset subset{};
+            subset.indexStart = groupStart;
+            subset.indexCount = groupEnd - groupStart;
+            subset.materialIndex = materialIndex;
+            registerBonePalette(globalPalette, subset);
+            if (group == 0)
+            {
+                m_subsets[subsetIndex] = subset;
+            }
+            else
+            {
+                m_subsets.push_back(subset);
+            }
+
+            for (uint32_t bone : palette)
+            {
+                boneSlots[bone] = -1;
+            }
+            palette.clear();
+            duplicateOf.clear();
+            groupStart = groupEnd;
+            ++group;
+        };
+
+    // パレット内の番号で頂点のボーン番号を書く
+    auto writeBones = [&](VertexModel& vertex, unsigned int localVertex)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                vertex.boneIndices[k] = (vertex.weights[k] > 0.0f) ? static_cast<uint8_t>(boneSlots[job.vertexBones[localVertex][k]]) : 0;
+            }
+        };
+
+    for (unsigned int index = indexStart; index < indexEnd; index += 3)
+    {
+        // この三角形で新しく必要になるボーン
+        std::array<uint32_t, 12> newBones{};
+        size_t newCount = 0;
+        for (unsigned int corner = 0; corner < 3; ++corner)
+        {
+            unsigned int localVertex = m_indices[index + corner] - vertexStart;
+            const VertexModel& vertex = m_vertices[m_indices[index + corner]];
+            for (int k = 0; k < 4; ++k)
+            {
+                uint32_t bone = job.vertexBones[localVertex][k];
+                if (vertex.weights[k] > 0.0f && boneSlots[bone] < 0 && std::find(newBones.begin(), newBones.begin() + newCount, bone) == newBones.begin() + newCount)
+                {
+                    newBones[newCount++] = bone;
+                }
+            }
+        }
+        if (palette.size() + newCount > MAX_BONES)
+        {// 溢れるのでここで区切る (新しいグループでは三角形のボーンはすべて新しい)
+            closeGroup(index);
+            index -= 3;
+            continue;
+        }
+        for (size_t cnt = 0; cnt < newCount; ++cnt)
+        {
+            boneSlots[newBones[cnt]] = static_cast<int>(palette.size());
+            palette.push_back(newBones[cnt]);
+        }
+
+        // 頂点を今のグループの番号にする (他のグループが使った頂点は複製)
+        for (unsigned int corner = 0; corner < 3; ++corner)
+        {
+            unsigned int& vertexIndex = m_indices[index + corner];
+            unsigned int localVertex = vertexIndex - vertexStart;
+            if (vertexGroup[localVertex] < 0)
+            {
+                vertexGroup[localVertex] = group;
+                writeBones(m_vertices[vertexIndex], localVertex);
+            }
+            else if (vertexGroup[localVertex] != group)
+            {
+                auto it = duplicateOf.find(localVertex);
+                if (it == duplicateOf.end())
+                {
+                    VertexModel vertex = m_vertices[vertexIndex];
+                    writeBones(vertex, localVertex);
+                    unsigned int duplicate = static_cast<unsigned int>(m_vertices.size());
+                    m_vertices.push_back(vertex);
+                    duplicates.push_back({ duplicate, vertexIndex });
+                    it = duplicateOf.emplace(localVertex, duplicate).first;
+                }
+                vertexIndex = it->second;
+            }
+        }
+    }
+    closeGroup(indexEnd);
+
+    // 複製した頂点もモーフで動かす (複製は末尾に足したので番号の昇順は崩れない)
+    for (auto& target : job.morphTargets)
+    {
+        for (const auto& [duplicate, source] : duplicates)
+        {
+            auto it = std::lower_bound(target.vertexIndices.begin(), target.vertexIndices.end(), source);
+            if (it != target.vertexIndices.end() && *it == source)
+            {
+                MorphVertex delta = target.deltas[it - target.vertexIndices.begin()];
+                target.vertexIndices.push_back(duplicate);
+                target.deltas.push_back(delta);
+            }
+        }
+    }
+    job.vertexBones.clear();
+}
+
+//--------------
+// ボーンパレットを登録する関数 (同じ並びがあれば共有する)
+//--------------
+void ModelResource::registerBonePalette(const std::vector<uint32_t>& palette, Subset& outSubset)
+{
+    for (const auto& subset : m_subsets)
+    {
+        if (subset.paletteCount == palette.size() && std::equal(palette.begin(), palette.end(), m_bonePalettes.begin() + subset.paletteStart))
+        {
+            outSubset.paletteStart = subset.paletteStart;
+            outSubset.paletteCount = subset.paletteCount;
+            return;
+        }
+    }
+    outSubset.paletteStart = static_cast<unsigned int>(m_bonePalettes.size());
+    outSubset.paletteCount = static_cast<unsigned int>(palette.size());
+    m_bonePalettes.insert(m_bonePalettes.end(), palette.begin(), palette.end());
+}
+
+//--------------
+// モーフターゲットを処理する関数
+//--------------
+void ModelResource::processMorphTargets(MeshJob& job, bool hasBones)
+{
+    static constexpr float MIN_DELTA = 1e-6f; // これ以下の差分は動かない頂点とみなす
+
+    const aiMesh* mesh = job.mesh;
+    const Matrix& transform = job.transform;
+    unsigned int vertexStart = job.vertexStart;
+
+    for (unsigned int cntAnimMesh = 0; cntAnimMesh < mesh->mNumAnimMeshes; ++cntAnimMesh)
+    {
+        const aiAnimMesh* animMesh = mesh->mAnimMeshes[cntAnimMesh];
+        if (animMesh == nullptr || !animMesh->HasPositions() || animMesh->mNumVertices != mesh->mNumVertices) continue;
+
+        MorphTarget target{};
+        target.name = animMesh->mName.C_Str();
+        target.animMeshIndex = cntAnimMesh;
+
+        bool hasNormals = animMesh->HasNormals() && mesh->HasNormals();
+        for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+        {
+            // 絶対値で格納されているので差分にする
+            Vector3 deltaPos(animMesh->mVertices[i].x - mesh->mVertices[i].x, animMesh->mVertices[i].y - mesh->mVertices[i].y, animMesh->mVertices[i].z - mesh->mVertices[i].z);
+            Vector3 deltaNor{};
+            if (hasNormals)
+            {
+                deltaNor = Vector3(animMesh->mNormals[i].x - mesh->mNormals[i].x, animMesh->mNormals[i].y - mesh->mNormals[i].y, animMesh->mNormals[i].z - mesh->mNormals[i].z);
+            }
+
+            if (fabsf(deltaPos.x) < MIN_DELTA && fabsf(deltaPos.y) < MIN_DELTA && fabsf(deltaPos.z) < MIN_DELTA &&
+                fabsf(deltaNor.x) < MIN_DELTA && fabsf(deltaNor.y) < MIN_DELTA && fabsf(deltaNor.z) < MIN_DELTA)
+            {// 動かない頂点は持たない
+                continue;
+            }
+
+            if (hasBones)
+            {// 頂点と同じくモデル空間へ (差分なので移動は含めない)
+                deltaPos.transformNormal(transform);
+                deltaNor.transformNormal(transform);
+            }
+
+            MorphVertex delta{};
+            delta.position[0] = deltaPos.x; delta.position[1] = deltaPos.y; delta.position[2] = deltaPos.z;
+            delta.normal[0] = deltaNor.x; delta.normal[1] = deltaNor.y; delta.normal[2] = deltaNor.z;
+
+            target.vertexIndices.push_back(vertexStart + i);
+            target.deltas.push_back(delta);
+            target.maxDelta = Vector3(std::max(target.maxDelta.x, fabsf(deltaPos.x)), std::max(target.maxDelta.y, fabsf(deltaPos.y)), std::max(target.maxDelta.z, fabsf(deltaPos.z)));
+        }
+
+        if (target.vertexIndices.empty()) continue;
+
+        // ノードへの登録は合成時に元の順番で行う
+        job.morphTargets.push_back(std::move(target));
+    }
+}
+
+//--------------
+// モーフで動く頂点の基準形状を保存する関数
+//--------------
+void ModelResource::setupMorphBase()
+{
+    m_morphBaseIndices.clear();
+    m_morphBaseVertices.clear();
+    if (m_morphTargets.empty()) return;
+
+    for (const auto& target : m_morphTargets)
+    {
+        m_morphBaseIndices.insert(m_morphBaseIndices.end(), target.vertexIndices.begin(), target.vertexIndices.end());
+    }
+    std::sort(m_morphBaseIndices.begin(), m_morphBaseIndices.end());
+    m_morphBaseIndices.erase(std::unique(m_morphBaseIndices.begin(), m_morphBaseIndices.end()), m_morphBaseIndices.end());
+
+    m_morphBaseVertices.resize(m_morphBaseIndices.size());
+    for (size_t cnt = 0; cnt < m_morphBaseIndices.size(); ++cnt)
+    {
+        const VertexModel& v = m_vertices[m_morphBaseIndices[cnt]];
+        MorphVertex& base = m_morphBaseVertices[cnt];
+        base.position[0] = v.pos.x; base.position[1] = v.pos.y; base.position[2] = v.pos.z;
+        base.normal[0] = v.nor.x; base.normal[1] = v.nor.y; base.normal[2] = v.nor.z;
+    }
+}
+
+//--------------
+// ノードが持つモーフターゲットの番号を取得する関数
+//--------------
+std::span<const size_t> ModelResource::getMorphTargetsOfNode(const std::string& nodeName) const
+{
+    auto it = m_morphTargetsOfNode.find(nodeName);
+    if (it != m_morphTargetsOfNode.end())
+    {
+        return it->second;
+    }
+    return {};
+}
+
+//--------------
+// 名前からモーフターゲットの番号を取得する関数
+//--------------
+size_t ModelResource::findMorphTarget(std::string_view name) const
+{
+    for (size_t cnt = 0; cnt < m_morphTargets.size(); ++cnt)
+    {
+        if (m_morphTargets[cnt].name == name)
+        {
+            return cnt;
+        }
+    }
+    return INVALID_MORPH_ID;
+}
+
+//--------------
+// アニメーションデータを処理する関数
+//--------------
+void ModelResource::processAnimations(const aiScene* scene, bool isLazy)
+{
+    std::lock_guard<std::mutex> lock(m_animMutex);
+    for (unsigned int cntAnim = 0; cntAnim < scene->mNumAnimations; ++cntAnim)
+    {
+        AnimationRef ref{};
+        if (isLazy)
+        {// ファイル参照だけ (キーデータは最初に使われるときに読み込む)
+            ref.name = scene->mAnimations[cntAnim]->mName.C_Str();
+            ref.path = m_path;
+            ref.sourceIndex = cntAnim;
+        }
+        else
+        {
+            ref.data = std::make_shared<Animation>(convertAnimation(scene->mAnimations[cntAnim]));
+            ref.name = ref.data->name;
+        }
+        m_animations.push_back(ref);
+    }
+}
+
+//--------------
+// Assimpのアニメーションを変換する関数
+//--------------
+Animation ModelResource::convertAnimation(const aiAnimation* srcAnim)
+{
+    Animation dstAnim;
+    dstAnim.name = srcAnim->mName.C_Str();
+    dstAnim.duration = srcAnim->mDuration;
+    dstAnim.ticksPerSecond = (srcAnim->mTicksPerSecond != 0) ? srcAnim->mTicksPerSecond : DEFAULT_TICKSPERSECOND; // 0ならデフォルト24fps
+
+    // 各ノードの動き(チャンネル)を読み込む
+    for (unsigned int cntChannel = 0; cntChannel < srcAnim->mNumChannels; ++cntChannel)
+    {
+        aiNodeAnim* srcChannel = srcAnim->mChannels[cntChannel];
+        NodeAnimation dstChannel;
+        dstChannel.nodeName = srcChannel->mNodeName.C_Str();
+
+        // 位置キー
+        for (unsigned int cntKey = 0; cntKey < srcChannel->mNumPositionKeys; ++cntKey)
+        {
+            auto& key = srcChannel->mPositionKeys[cntKey];
+            dstChannel.positionKeys.push_back({ key.mTime, Vector3(key.mValue.x, key.mValue.y, key.mValue.z) });
+        }
+        // 回転キー
+        for (unsigned int cntKey = 0; cntKey < srcChannel->mNumRotationKeys; ++cntKey)
+        {
+            auto& key = srcChannel->mRotationKeys[cntKey];
+            dstChannel.rotationKeys.push_back({ key.mTime, Quaternion(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w) });
+        }
+        // スケールキー
+        for (unsigned int cntKey = 0; cntKey < srcChannel->mNumScalingKeys; ++cntKey)
+        {
+            auto& key = srcChannel->mScalingKeys[cntKey];
+            dstChannel.scalingKeys.push_back({ key.mTime, Vector3(key.mValue.x, key.mValue.y, key.mValue.z) });
+        }
+
+        dstAnim.channels.push_back(dstChannel);
+    }
+
+    // モーフのウェイトアニメーションを読み込む
+    for (unsigned int cntChannel = 0; cntChannel < srcAnim->mNumMorphMeshChannels; ++cntChannel)
+    {
+        aiMeshMorphAnim* srcChannel = srcAnim->mMorphMeshChannels[cntChannel];
+        MorphAnimation dstChannel;
+        dstChannel.nodeName = srcChannel->mName.C_Str();
+
+        // "ノード名*番号" の形式の場合はノード名だけにする
+        size_t pos = dstChannel.nodeName.find('*');
+        if (pos != std::string::npos) dstChannel.nodeName.resize(pos);
+
+        for (unsigned int cntKey = 0; cntKey < srcChannel->mNumKeys; ++cntKey)
         {
-            m_indices.push_back(face.mIndices[j] + vertexStart);
+            const aiMeshMorphKey& srcKey = srcChannel->mKeys[cntKey];
+            MorphKey dstKey;
+            dstKey.time = srcKey.mTime;
+            for (unsigned int cnt = 0; cnt < srcKey.mNumValuesAndWeights; ++cnt)
+            {
+                dstKey.targets.push_back(srcKey.mValues[cnt]);
+                dstKey.weights.push_back(float(srcKey.mWeights[cnt]));
+            }
+            dstChannel.keys.push_back(dstKey);
         }
-    }
 
-    // サブセットの登録
-    Subset subset;
-    subset.indexStart = indexStart;              // このメッシュのインデックス開始位置
-    subset.indexCount = mesh->mNumFaces * 3;     // インデックス数
-    subset.materialIndex = mesh->mMaterialIndex; // マテリアル番号
-    m_subsets.push_back(subset);
+        dstAnim.morphChannels.push_back(dstChannel);
+    }
+    return dstAnim;
 }
 
 //--------------
-// アニメーションデータを処理する関数
+// 描画パケットを構築する関数
 //--------------
-void ModelResource::processAnimations(const aiScene* scene)
+void ModelResource::buildDrawPackets()
 {
-    for (unsigned int cntAnim = 0; cntAnim < scene->mNumAnimations; ++cntAnim)
+    m_drawPackets.clear();
+    m_drawPackets.reserve(m_subsets.size());
+
+    for (const auto& subset : m_subsets)
     {
-        aiAnimation* srcAnim = scene->mAnimations[cntAnim];
-        Animation dstAnim;
-        dstAnim.name = srcAnim->mName.C_Str();
-        dstAnim.duration = srcAnim->mDuration;
-        dstAnim.ticksPerSecond = (srcAnim->mTicksPerSecond != 0) ? srcAnim->mTicksPerSecond : DEFAULT_TICKSPERSECOND; // 0ならデフォルト24fps
+        if (subset.indexCount == 0) continue;
 
-        // 各ノードの動き(チャンネル)を読み込む
-        for (unsigned int cntChannel = 0; cntChannel < srcAnim->mNumChannels; ++cntChannel)
-        {
-            aiNodeAnim* srcChannel = srcAnim->mChannels[cntChannel];
-            NodeAnimation dstChannel;
-            dstChannel.nodeName = srcChannel->mNodeName.C_Str();
+        DrawPacket packet{};
+        packet.indexStart = subset.indexStart;
+        packet.indexCount = subset.indexCount;
+        packet.materialIndex = subset.materialIndex;
+        packet.paletteStart = subset.paletteStart;
+        packet.paletteCount = subset.paletteCount;
 
-            // 位置キー
-            for (unsigned int cntKey = 0; cntKey < srcChannel->mNumPositionKeys; ++cntKey)
-            {
-                auto& key = srcChannel->mPositionKeys[cntKey];
-                dstChannel.positionKeys.push_back({ key.mTime, Vector3(key.mValue.x, key.mValue.y, key.mValue.z) });
+        if (subset.materialIndex < m_materials.size())
+        {
+            // マテリアルの変換
+            const MaterialData& matData = m_materials[subset.materialIndex];
+            packet.material.Diffuse = matData.diffuseColor;
+            packet.material.Specular = matData.specularColor;
+            packet.material.Emissive = matData.emissiveColor;
+            if (matData.shininess < 1.0f)
+            {// スペキュラー無効
+                packet.material.Power = MIN_MATERIAL_POWER; // 最小値補正
+                packet.material.Specular = Color::Black();  // スペキュラー無効化
             }
-            // 回転キー
-            for (unsigned int cntKey = 0; cntKey < srcChannel->mNumRotationKeys; ++cntKey)
+            else
             {
-                auto& key = srcChannel->mRotationKeys[cntKey];
-                dstChannel.rotationKeys.push_back({ key.mTime, Quaternion(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w) });
+                packet.material.Power = matData.shininess;
             }
-            // スケールキー
-            for (unsigned int cntKey = 0; cntKey < srcChannel->mNumScalingKeys; ++cntKey)
+            packet.material.AlphaCutoff = 0.01f; // 固定値
+            packet.material.pixelShaderType = PixelShaderType::Toon;
+
+            // テクスチャ
+            if (matData.textureIndex != -1)
             {
-                auto& key = srcChannel->mScalingKeys[cntKey];
-                dstChannel.scalingKeys.push_back({ key.mTime, Vector3(key.mValue.x, key.mValue.y, key.mValue.z) });
+                packet.texture = getTextureHandle(matData.textureIndex);
             }
-
-            dstAnim.channels.push_back(dstChannel);
         }
-        m_animations.push_back(dstAnim);
+        m_drawPackets.push_back(packet);
     }
+
+    // マテリアル順に並べてステート変更を減らす (同一マテリアル内はボーンパレット,インデックス順)
+    std::stable_sort(m_drawPackets.begin(), m_drawPackets.end(), [](const DrawPacket& a, const DrawPacket& b)
+        {
+            if (a.materialIndex != b.materialIndex) return a.materialIndex < b.materialIndex;
+            if (a.paletteStart != b.paletteStart) return a.paletteStart < b.paletteStart;
+            return a.indexStart < b.indexStart;
+        });
 }
 
 //--------------
@@ -766,9 +1869,8 @@ void ModelResource::setupMeshs()
 // モデルクラス
 //----------------------------
 static constexpr size_t START_POSE_ID = ~0u - 1u;  // ブレンド中のポーズからブレンドするときの特殊ID
-static constexpr float MIN_MATERIAL_POWER = 32.0f; // 最小の鋭さ
 
-Model::Model(ModelManager& modelManager, Renderer& renderer, const ModelHandle& handle) : m_modelManager(modelManager), m_renderer(renderer), m_handle(handle), m_nodeInstanceMaps{}, m_boneTransforms{}, m_currentAnimation{}, m_nextAnimation{}, m_blendDuration{}, m_blendTime{}, m_pBlendStartPose{}, m_isSync{}, m_transform{} {}
+Model::Model(ModelManager& modelManager, Renderer& renderer, const ModelHandle& handle) : m_modelManager(modelManager), m_renderer(renderer), m_handle(handle), m_nodeInstanceMaps{}, m_boneTransforms{}, m_paletteTransforms{}, m_currentAnimation{}, m_nextAnimation{}, m_blendDuration{}, m_blendTime{}, m_pBlendStartPose{}, m_isSync{}, m_transform{}, m_bounds{}, m_morphWeights{}, m_morphVertices{}, m_morphMesh{}, m_isMorphDirty{}, m_isMorphUploadPending{} {}
 
 //--------------
 // モデルの初期化
@@ -787,6 +1889,9 @@ void Model::init()
         Node* rootNode = stResource->getRootNode();
         setupNodeInstances(rootNode, Matrix());
     }
+
+    // モーフのセットアップ
+    setupMorph();
 }
 
 //--------------
@@ -794,6 +1899,9 @@ void Model::init()
 //--------------
 void Model::uninit()
 {
+    // インスタンス固有の頂点ストリームを解放
+    releaseMorph();
+
     if (m_pBlendStartPose != nullptr)
     {
         delete m_pBlendStartPose;
@@ -818,6 +1926,12 @@ void Model::update(float deltaTime, const Matrix& worldMatrix)
 
     // ボーンの最終変換行列を更新
     updateBoneTransforms();
+
+    // 境界ボックスを更新
+    updateBounds(worldMatrix);
+
+    // モーフの適用を開始
+    updateMorph();
 }
 
 //--------------
@@ -828,31 +1942,63 @@ void Model::draw()
     auto resource = m_modelManager.getModelData(m_handle);
     if (auto stResource = resource.lock())
     {
-        // メッシュを設定 全ノードで共通
-        m_renderer.setMesh(stResource->getMesh());
+        // モーフ適用済みの頂点を転送
+        waitMorph();
+        if (m_isMorphUploadPending && m_morphMesh.isValid())
+        {
+            m_renderer.updateMeshVertices(m_morphMesh, m_morphVertices.data(), m_morphVertices.size());
+            m_isMorphUploadPending = false;
+        }
+
+        // メッシュを設定 全ノードで共通 (モーフがあればインスタンス固有の頂点ストリーム)
+        m_renderer.setMesh(m_morphMesh.isValid() ? m_morphMesh : stResource->getMesh());
 
-        // ボーン変換行列の設定
-        m_renderer.setBoneTransforms(m_boneTransforms);
+        // 描画パケットを順に描画
+        unsigned int currentMaterial = ~0u;
+        unsigned int currentPalette = ~0u;
+        for (const auto& packet : stResource->getDrawPackets())
+        {
+            if (packet.materialIndex != currentMaterial)
+            {// マテリアルが変わったときだけ設定
+                m_renderer.setMaterial(packet.material);
+                m_renderer.setTexture(packet.texture);
+                currentMaterial = packet.materialIndex;
+            }
+
+            if (packet.paletteCount > 0u && packet.paletteStart != currentPalette)
+            {// ボーンパレットが変わったときだけ使うボーンの行列を集めて設定
+                std::span<const uint32_t> palette = stResource->getBonePalette(packet);
+                m_paletteTransforms.resize(palette.size());
+                for (size_t cnt = 0; cnt < palette.size(); ++cnt)
+                {
+                    m_paletteTransforms[cnt] = (palette[cnt] < m_boneTransforms.size()) ? m_boneTransforms[palette[cnt]] : Matrix();
+                }
+                m_renderer.setBoneTransforms(m_paletteTransforms);
+                currentPalette = packet.paletteStart;
+            }
 
-        // ノードを再帰的に描画
-        drawNode(&m_nodeInstanceMaps[stResource->getRootNode()->name]);
+            // ポリゴンの描画
+            m_renderer.drawIndexedPrimitive
+            (
+                VertexShaderType::VertexModel, // 頂点シェーダーの種類
+                packet.indexCount,             // インデックス数
+                packet.indexStart,             // インデックスバッファの開始位置
+                0                              // 頂点バッファの開始位置
+            );
+        }
     }
 }
 
 //--------------
 // アニメーションの設定関数
 //--------------
-void Model::setAnimation(size_t animationIndex, double blendDuration, bool isSync, bool isLoop, bool forceReset)
+void Model::setAnimation(size_t animationIndex, double blendDuration, bool isSync, bool isLoop, bool forceReset, double startTime)
 {
-    // アニメーションインデックスのチェック
-    Animation* anim{};
-    auto resource = m_modelManager.getModelData(m_handle);
-    if (auto stResource = resource.lock())
+    // アニメーションのキーデータを取得 (ファイル参照のクリップはここで初めて読み込まれる)
+    std::shared_ptr<Animation> clip = m_modelManager.acquireAnimation(m_handle, animationIndex);
+    if (clip == nullptr)
     {
-        if (stResource->getAnimation(animationIndex) == nullptr)
-        {
-            return; // 無効なアニメーションインデックス
-        }
+        return; // 無効なアニメーションインデックス
     }
 
     if ((m_blendTime <= 0.01 && m_currentAnimation.animationIndex != animationIndex) || (m_blendTime > 0.01 && m_nextAnimation.animationIndex != animationIndex) || forceReset)
@@ -862,6 +2008,7 @@ void Model::setAnimation(size_t animationIndex, double blendDuration, bool isSyn
             // 現在のアニメーションをブレンド開始ポーズとして保存
             setupBlendStartPose();                             // ブレンド開始ポーズをセットアップ (m_pBlendStartPose)
             m_currentAnimation.animationIndex = START_POSE_ID; // 特殊識別番号 (m_pBlendStartPose)
+            m_currentAnimation.clip.reset();                   // キーデータは使わない
             m_currentAnimation.currentTime = 0.0;              // 時間は0で初期化
             m_currentAnimation.isPlaying = false;              // 再生停止
             m_currentAnimation.isLoop = false;                 // ループしない
@@ -879,7 +2026,8 @@ void Model::setAnimation(size_t animationIndex, double blendDuration, bool isSyn
 
         // 次のアニメーションをセット
         m_nextAnimation.animationIndex = animationIndex;
-        m_nextAnimation.currentTime = 0.0;
+        m_nextAnimation.clip = clip;
+        m_nextAnimation.currentTime = std::clamp(startTime * clip->ticksPerSecond, 0.0, clip->duration); // 秒 -> Tick
         m_nextAnimation.isPlaying = true;
         m_nextAnimation.isLoop = isLoop;
 
@@ -895,6 +2043,14 @@ void Model::setAnimation(size_t animationIndex, double blendDuration, bool isSyn
     }
 }
 
+//-----------------------------------
+// アニメーションを先読みする (次に使いそうなクリップをワーカースレッドで読み込む)
+//-----------------------------------
+void Model::prefetchAnimation(size_t animationIndex)
+{
+    m_modelManager.prefetchAnimation(m_handle, animationIndex);
+}
+
 //-----------------------------------
 // モデルをスケーリングする (最終調整用)
 //-----------------------------------
@@ -941,6 +2097,7 @@ void Model::updateAnimation(double deltaTime)
             m_nextAnimation.isPlaying = false;
             m_nextAnimation.animationIndex = INVALID_ANIM_ID;
             m_nextAnimation.currentTime = 0.0;
+            m_nextAnimation.clip.reset();
         }
 
         // 現在のアニメーションの進行
@@ -951,7 +2108,7 @@ void Model::updateAnimation(double deltaTime)
         }
         else
         {// 現在のアニメーション
-            currentAnim = stResource->getAnimation(m_currentAnimation.animationIndex);
+            currentAnim = m_currentAnimation.clip.get();
         }
         if (currentAnim != nullptr && m_currentAnimation.isPlaying)
         {
@@ -971,7 +2128,7 @@ void Model::updateAnimation(double deltaTime)
         }
 
         // 現在のアニメーションの進行
-        Animation* nextAnim = stResource->getAnimation(m_nextAnimation.animationIndex);
+        Animation* nextAnim = m_nextAnimation.clip.get();
         if (nextAnim != nullptr && m_nextAnimation.isPlaying)
         {
             if (m_isSync)
@@ -997,6 +2154,9 @@ void Model::updateAnimation(double deltaTime)
             }
         }
 
+        // モーフのウェイトアニメーションを適用
+        updateMorphWeights(*stResource, currentAnim, nextAnim);
+
         // 各チャンネル（ノードの動き）を適用
         updateNodeAnimTransforms(&m_nodeInstanceMaps[stResource->getRootNode()->name], currentAnim, nextAnim, m_currentAnimation.currentTime, m_nextAnimation.currentTime, m_currentAnimation.isLoop, m_nextAnimation.isLoop);
     }
@@ -1057,64 +2217,48 @@ void Model::updateBoneTransforms()
 }
 
 //--------------
-// ノードを描画する関数
+// ワールド境界ボックスを更新する関数
 //--------------
-void Model::drawNode(NodeInstance* node)
+void Model::updateBounds(const Matrix& worldMatrix)
 {
+    m_bounds.reset();
+
     auto resource = m_modelManager.getModelData(m_handle);
     if (auto stResource = resource.lock())
     {
-        // サブセットごとに描画
-        for (const auto& meshIndex : node->node->meshIndices)
+        // モーフで動く量 (モデル空間 ウェイトをかけた差分の最大を足し合わせる どの頂点が動いても収まるように全部のボックスを広げる)
+        Vector3 morphMargin{};
+        std::span<const MorphTarget> morphTargets = stResource->getMorphTargets();
+        for (size_t cnt = 0; cnt < morphTargets.size() && cnt < m_morphWeights.size(); ++cnt)
         {
-            const auto& subset = stResource->getSubset(meshIndex);
-            const auto& matData = stResource->getMaterial(subset->materialIndex);
+            morphMargin += morphTargets[cnt].maxDelta * fabsf(m_morphWeights[cnt]);
+        }
 
-            if (subset->materialIndex < stResource->getNumMaterials())
+        // ボーン空間のボックスをボーンのノードのグローバル行列(ワールド込み)で変換して合成
+        for (size_t cnt = 0; cnt < stResource->getNumBones(); ++cnt)
+        {
+            const BoneInfo* boneInfo = stResource->getBoneInfo(cnt);
+            if (!boneInfo->bounds.isValid())
             {
-                // マテリアルの設定
-                Material material{};
-                material.Diffuse = matData->diffuseColor;
-                material.Specular = matData->specularColor;
-                material.Emissive = matData->emissiveColor;
-                if (matData->shininess < 1.0f)
-                {// スペキュラー無効
-                    material.Power = MIN_MATERIAL_POWER; // 最小値補正
-                    material.Specular = Color::Black();  // スペキュラー無効化
-                }
-                else
-                {
-                    material.Power = matData->shininess;
-                }
-                material.AlphaCutoff = 0.01f; // 固定値
-                material.pixelShaderType = PixelShaderType::Toon;
-                m_renderer.setMaterial(material);
-
-                // テクスチャの設定
-                if (matData->textureIndex != -1)
-                {
-                    m_renderer.setTexture(stResource->getTextureHandle(matData->textureIndex));
-                }
-                else
-                {
-                    m_renderer.setTexture(TextureHandle());
-                }
+                continue;
             }
 
-            // ポリゴンの描画
-            m_renderer.drawIndexedPrimitive
-            (
-                VertexShaderType::VertexModel, // 頂点シェーダーの種類
-                subset->indexCount,            // インデックス数
-                subset->indexStart,            // インデックスバッファの開始位置
-                0                              // 頂点バッファの開始位置
-            );
+            // ノードが見つからないボーンのパレットは単位行列なので,オフセット行列を打ち消す行列で戻す
+            Matrix boneGlobal{};
+            auto node = m_nodeInstanceMaps.find(boneInfo->name);
+            if (node != m_nodeInstanceMaps.end())
+            {
+                boneGlobal = node->second.globalTransform;
+            }
+            else if (!Matrix::Inverse(boneInfo->offsetMatrix, boneGlobal))
+            {
+                continue;
+            }
+            m_bounds.merge(skinning::TransformBoneBounds(boneInfo->bounds, boneInfo->offsetMatrix, boneGlobal, morphMargin));
         }
 
-        for (auto child : node->node->children)
-        {// 子へ送る
-            drawNode(&m_nodeInstanceMaps[child->name]);
-        }
+        // ボーンを持たない頂点はシェーダーと同様にワールド行列で変換
+        m_bounds.merge(AABB::Transformed(skinning::Inflated(stResource->getStaticBounds(), morphMargin), worldMatrix));
     }
 }
 
@@ -1220,6 +2364,141 @@ void Model::setupBlendStartPose()
     }
 }
 
+//--------------
+// モーフのセットアップ
+//--------------
+void Model::setupMorph()
+{
+    auto resource = m_modelManager.getModelData(m_handle);
+    if (auto stResource = resource.lock())
+    {
+        if (stResource->getNumMorphTargets() == 0 || stResource->getNumVertices() == 0) return;
+
+        m_morphWeights.assign(stResource->getNumMorphTargets(), 0.0f);
+
+        // インスタンス固有の頂点ストリームを作成 (インデックスバッファはリソースと共有 作り直すときは前のものを解放)
+        releaseMorph();
+        auto vertices = stResource->getVertices();
+        m_morphVertices.assign(vertices.begin(), vertices.end());
+        m_morphMesh = m_renderer.createDynamicMesh(stResource->getMesh(), m_morphVertices.data(), m_morphVertices.size());
+
+        m_isMorphDirty = false;
+        m_isMorphUploadPending = false;
+    }
+}
+
+//--------------
+// モーフウェイトの設定
+//--------------
+void Model::setMorphWeight(size_t index, float weight)
+{
+    if (index < m_morphWeights.size() && m_morphWeights[index] != weight)
+    {
+        m_morphWeights[index] = weight;
+        m_isMorphDirty = true;
+    }
+}
+
+//--------------
+// モーフウェイトの設定 (名前指定)
+//--------------
+void Model::setMorphWeight(std::string_view name, float weight)
+{
+    auto resource = m_modelManager.getModelData(m_handle);
+    if (auto stResource = resource.lock())
+    {
+        setMorphWeight(stResource->findMorphTarget(name), weight);
+    }
+}
+
+//--------------
+// アニメーションからモーフウェイトを更新する関数
+//--------------
+void Model::updateMorphWeights(const ModelResource& resource, const Animation* currentAnim, const Animation* nextAnim)
+{
+    if (m_morphWeights.empty()) return;
+
+    bool hasCurrent = currentAnim != nullptr && !currentAnim->morphChannels.empty();
+    bool hasNext = nextAnim != nullptr && !nextAnim->morphChannels.empty();
+    if (!hasCurrent && !hasNext) return; // アニメーションで動かさない (手動のウェイトを使う)
+
+    // アニメーションが持たないターゲットは今のウェイトのまま
+    std::vector<float> currentWeights = m_morphWeights;
+    std::vector<float> nextWeights = m_morphWeights;
+    if (hasCurrent)
+    {
+        for (const auto& channel : currentAnim->morphChannels)
+        {
+            SampleMorphWeights(m_currentAnimation.currentTime, channel, resource.getMorphTargetsOfNode(channel.nodeName), resource.getMorphTargets(), currentWeights);
+        }
+    }
+    if (hasNext)
+    {
+        for (const auto& channel : nextAnim->morphChannels)
+        {
+            SampleMorphWeights(m_nextAnimation.currentTime, channel, resource.getMorphTargetsOfNode(channel.nodeName), resource.getMorphTargets(), nextWeights);
+        }
+    }
+
+    // ブレンド
+    float time = 0.0f;
+    if (nextAnim != nullptr)
+    {
+        time = (m_blendDuration > 0.0001f) ? float(m_blendTime / m_blendDuration) : 1.0f;
+        time = std::clamp(time, 0.0f, 1.0f);
+    }
+    for (size_t cnt = 0; cnt < m_morphWeights.size(); ++cnt)
+    {
+        setMorphWeight(cnt, currentWeights[cnt] + (nextWeights[cnt] - currentWeights[cnt]) * time);
+    }
+}
+
+//--------------
+// モーフの適用を依頼する関数 (ModelManagerが他のモデルとまとめて適用する)
+//--------------
+void Model::updateMorph()
+{
+    if (!m_isMorphDirty || !m_morphMesh.isValid()) return;
+
+    auto resource = m_modelManager.getModelData(m_handle);
+    if (auto stResource = resource.lock())
+    {
+        // ウェイトは依頼にコピーする (適用中に書き換えられても影響しない)
+        m_modelManager.requestMorph(stResource, m_morphVertices, m_morphWeights);
+
+        m_isMorphDirty = false;
+        m_isMorphUploadPending = true;
+    }
+}
+
+//--------------
+// モーフの適用を待つ関数
+//--------------
+void Model::waitMorph()
+{
+    if (m_isMorphUploadPending)
+    {
+        m_modelManager.waitMorphs();
+    }
+}
+
+//--------------
+// モーフの頂点ストリームを解放する関数 (適用中なら待ってから)
+//--------------
+void Model::releaseMorph()
+{
+    waitMorph();
+
+    if (m_morphMesh.isValid())
+    {
+        m_renderer.releaseMesh(m_morphMesh);
+        m_morphMesh = MeshHandle();
+    }
+    m_morphVertices.clear();
+    m_isMorphDirty = false;
+    m_isMorphUploadPending = false;
+}
+
 //----------------------------
 // モデルマネージャークラス
 //----------------------------
@@ -1238,7 +2517,7 @@ bool ModelManager::load(Renderer& renderer, TextureManager& textureManager, unsi
             {// 登録されておりまだデータが読み込まれていないテクスチャ
                 // 読み込む
                 std::shared_ptr<ModelResource> data = std::make_shared<ModelResource>(m_slots[handle.id].path, renderer);
-                data->load(textureManager, m_slots[handle.id].isAnimationOnly);
+                data->load(textureManager, m_slots[handle.id].isAnimationOnly, LoadThreadBudget(1u));
                 m_slots[handle.id].data = data;
             }
         }
@@ -1262,6 +2541,10 @@ bool ModelManager::load(Renderer& renderer, TextureManager& textureManager, unsi
         // メモリ確保
         futures.reserve(totalCount);
 
+        // 同時に読み込むモデルでコア数を分け合う (モデルの中の並列処理がさらにスレッドを増やさないように)
+        maxThread = std::max(1u, maxThread);
+        const unsigned int threadBudget = LoadThreadBudget(std::min(maxThread, static_cast<unsigned int>(totalCount)));
+
         for (size_t cnt = 0; cnt < m_slots.size(); cnt++)
         {
             if (m_slots[cnt].data == nullptr)
@@ -1291,11 +2574,11 @@ bool ModelManager::load(Renderer& renderer, TextureManager& textureManager, unsi
                 // 読み込む
                 std::filesystem::path path = m_slots[cnt].path;
                 bool isAnimationOnly = m_slots[cnt].isAnimationOnly;
-                futures.push_back(std::async(std::launch::async, [this, cnt, path, isAnimationOnly, &activeThreads, &finishedCount, &renderer, &textureManager]()
+                futures.push_back(std::async(std::launch::async, [this, cnt, path, isAnimationOnly, threadBudget, &activeThreads, &finishedCount, &renderer, &textureManager]()
                     {
                         // 読み込む
                         std::shared_ptr<ModelResource> data = std::make_shared<ModelResource>(path, renderer);
-                        data->load(textureManager, isAnimationOnly);
+                        data->load(textureManager, isAnimationOnly, threadBudget);
 
                         {// m_slotsは同時に触らない
                             std::lock_guard<std::mutex> lock(m_slotsMutex);
@@ -1355,7 +2638,10 @@ bool ModelManager::registerPath(uint64_t id, const std::filesystem::path& path,
     ModelSlot slot{};
     slot.path = path;
     slot.isAnimationOnly = isAnimationOnly;
-    m_slots.push_back(slot);
+    {// 先読みスレッドがm_slotsを見ている
+        std::lock_guard<std::mutex> lock(m_slotsMutex);
+        m_slots.push_back(slot);
+    }
 
     // ハンドルを登録
     m_idToHandle.try_emplace(id);
@@ -1385,7 +2671,7 @@ bool ModelManager::setAnimation(uint64_t destModel, uint64_t srcAnim)
         }
 
         // まだ読み込まれていない場合、アニメーションを読み込む
-        if (destSlot.data->setAnimation(srcSlot.data->getAnimations()))
+        if (destSlot.data->setAnimation(srcSlot.data->getAnimationRefs()))
         {
             destSlot.motionHandles.push_back(m_idToHandle[srcAnim]);
             return true; // アニメーションが読み込めた
@@ -1398,6 +2684,225 @@ bool ModelManager::setAnimation(uint64_t destModel, uint64_t srcAnim)
     return false; // モデルが存在しない
 }
 
+//----------------------------------
+// ファイル参照でアニメーションを登録する (キーデータは最初に使われるときに読み込む)
+// 戻り値は Model::setAnimation に渡す番号 モデルは読み込み済みである必要がある
+//----------------------------------
+size_t ModelManager::registerAnimation(uint64_t destModel, const std::filesystem::path& path, std::string_view name, unsigned int sourceIndex)
+{
+    if (!m_idToHandle.contains(destModel))
+    {
+        return INVALID_ANIM_ID; // モデルが存在しない
+    }
+
+    ModelSlot& slot = m_slots[m_idToHandle[destModel].id];
+    if (slot.data == nullptr || slot.isAnimationOnly)
+    {
+        return INVALID_ANIM_ID; // まだ読み込まれていない
+    }
+    return slot.data->addAnimationRef(path, name, sourceIndex);
+}
+
+//----------------------------------
+// アニメーションのキーデータを取得する
+//----------------------------------
+std::shared_ptr<Animation> ModelManager::acquireAnimation(const ModelHandle& handle, size_t animationIndex)
+{
+    auto resource = getModelData(handle).lock();
+    if (resource == nullptr)
+    {
+        return nullptr;
+    }
+
+    size_t loadedBytes = 0;
+    std::shared_ptr<Animation> clip = resource->acquireAnimation(animationIndex, ++m_animTick, &loadedBytes);
+    if (loadedBytes > 0)
+    {// 新しく読み込んだら予算を超えた分を解放
+        m_animMemoryUsage += loadedBytes;
+        trimAnimations();
+    }
+    return clip;
+}
+
+//----------------------------------
+// アニメーションを先読みする
+//----------------------------------
+void ModelManager::prefetchAnimation(const ModelHandle& handle, size_t animationIndex)
+{
+    auto resource = getModelData(handle).lock();
+    if (resource == nullptr)
+    {
+        return;
+    }
+
+    // 終わった先読みを片付ける
+    std::erase_if(m_prefetchTasks, [](const std::future<void>& future) { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+
+    uint64_t tick = ++m_animTick;
+    m_prefetchTasks.push_back(std::async(std::launch::async, [this, resource, animationIndex, tick]()
+        {
+            size_t loadedBytes = 0;
+            resource->acquireAnimation(animationIndex, tick, &loadedBytes);
+            if (loadedBytes > 0)
+            {// 読み込んだら予算を超えた分を解放 (先読みしたクリップは一番新しいので最後まで残る)
+                m_animMemoryUsage += loadedBytes;
+                trimAnimations();
+            }
+        }));
+}
+
+//----------------------------------
+// モーフの適用を依頼する (同じ頂点ストリームの依頼が残っていればウェイトだけ差し替える)
+//----------------------------------
+void ModelManager::requestMorph(const std::shared_ptr<ModelResource>& resource, std::span<VertexModel> vertices, std::span<const float> weights)
+{
+    std::lock_guard<std::mutex> lock(m_morphMutex);
+    for (auto& request : m_pendingMorphs)
+    {
+        if (request.vertices.data() == vertices.data())
+        {
+            request.weights.assign(weights.begin(), weights.end());
+            return;
+        }
+    }
+
+    MorphRequest& request = m_pendingMorphs.emplace_back();
+    request.resource = resource;
+    request.vertices = vertices;
+    request.weights.assign(weights.begin(), weights.end());
+}
+
+//----------------------------------
+// 溜まったモーフをまとめて適用し始める (フレームの更新が終わったら呼ぶ 1つのタスクの中で並列に処理する)
+//----------------------------------
+void ModelManager::dispatchMorphs()
+{
+    std::lock_guard<std::mutex> lock(m_morphMutex);
+    if (m_pendingMorphs.empty())
+    {
+        return;
+    }
+
+    // 前のフレームの適用が頂点を触っている間は始めない
+    if (m_morphTask.valid())
+    {
+        m_morphTask.get();
+    }
+
+    m_morphBatch.swap(m_pendingMorphs);
+    m_pendingMorphs.clear();
+    m_morphTask = std::async(std::launch::async, [this]()
+        {
+            ParallelFor(m_morphBatch.size(), std::thread::hardware_concurrency(), [this](size_t index)
+                {
+                    const MorphRequest& request = m_morphBatch[index];
+                    ApplyMorphTargets(request.vertices, request.resource->getMorphBaseIndices(), request.resource->getMorphBaseVertices(), request.resource->getMorphTargets(), request.weights);
+                });
+        });
+}
+
+//----------------------------------
+// モーフの適用が終わるのを待つ (まだ始まっていない依頼はここで始める)
+//----------------------------------
+void ModelManager::waitMorphs()
+{
+    dispatchMorphs();
+
+    std::lock_guard<std::mutex> lock(m_morphMutex);
+    if (m_morphTask.valid())
+    {
+        m_morphTask.get();
+        m_morphBatch.clear();
+    }
+}
+
+//----------------------------------
+// アニメーションのメモリ予算を設定する (0なら無制限)
+//----------------------------------
+void ModelManager::setAnimationMemoryBudget(size_t budget)
+{
+    m_animMemoryBudget = budget;
+    trimAnimations();
+}
+
+//----------------------------------
+// 予算を超えている間、使われていないアニメーションを古い順に解放する
+//----------------------------------
+void ModelManager::trimAnimations()
+{
+    if (m_animMemoryBudget == 0 || m_animMemoryUsage.load() <= m_animMemoryBudget)
+    {
+        return;
+    }
+
+    // 解放できるクリップを集める
+    // 先読みスレッドからも呼ばれるのでm_slotsはロックして見る (解放はロックの外 リソースは候補が持つ)
+    struct Candidate
+    {
+        uint64_t lastUsed;                       // 最後に使われた時刻
+        std::shared_ptr<ModelResource> resource; // リソース
+        size_t index;                            // アニメーション番号
+    };
+    std::vector<Candidate> candidates{};
+    {
+        std::lock_guard<std::mutex> lock(m_slotsMutex);
+        std::vector<std::pair<uint64_t, size_t>> list{};
+        for (const auto& slot : m_slots)
+        {
+            if (slot.data == nullptr) continue;
+
+            list.clear();
+            slot.data->getEvictableAnimations(list);
+            for (const auto& [lastUsed, index] : list)
+            {
+                candidates.push_back({ lastUsed, slot.data, index });
+            }
+        }
+    }
+
+    // 古い順に解放
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.lastUsed < b.lastUsed; });
+    for (const auto& candidate : candidates)
+    {
+        if (m_animMemoryUsage.load() <= m_animMemoryBudget) break;
+        m_animMemoryUsage -= candidate.resource->evictAnimation(candidate.index);
+    }
+}
+
+//----------------------------------
+// アニメーションの長さを取得する (秒)
+//----------------------------------
+double ModelManager::getAnimationDuration(const ModelHandle& handle, size_t animationIndex)
+{
+    std::shared_ptr<Animation> clip = acquireAnimation(handle, animationIndex);
+    if (clip == nullptr || clip->ticksPerSecond <= 0.0)
+    {
+        return 0.0;
+    }
+    return clip->duration / clip->ticksPerSecond;
+}
+
+//----------------------------------
+// アニメーションを評価してノードのモデル空間変換行列を取得する (時間は秒)
+//----------------------------------
+bool ModelManager::sampleNodeTransforms(const ModelHandle& handle, size_t animationIndex, std::span<const double> times, std::span<const std::string> nodeNames, std::span<Matrix> outTransforms, bool isLoop)
+{
+    auto resource = getModelData(handle).lock();
+    std::shared_ptr<Animation> clip = acquireAnimation(handle, animationIndex);
+    if (resource == nullptr || clip == nullptr)
+    {
+        return false;
+    }
+
+    // 秒 -> Tick
+    std::vector<double> ticks(times.size());
+    for (size_t cnt = 0; cnt < times.size(); ++cnt)
+    {
+        ticks[cnt] = times[cnt] * clip->ticksPerSecond;
+    }
+    return resource->sampleNodeTransforms(*clip, ticks, nodeNames, outTransforms, isLoop);
+}
+
 //--------------
 // CPUリソースを解放する関数
 //--------------
@@ -1406,6 +2911,7 @@ void ModelManager::releaseCpuResource(const ModelHandle& handle)
     if (m_slots.size() > handle.id)
     {
         auto data = m_slots[handle.id];
+        m_animMemoryUsage -= data.data->getLazyAnimationBytes();
         data.data->unload();
         data.data.reset();
     }
@@ -1420,6 +2926,7 @@ void ModelManager::releaseCpuResources()
     {
         if (slot.data != nullptr)
         {
+            m_animMemoryUsage -= slot.data->getLazyAnimationBytes();
             slot.data->unload();
             slot.data.reset();
         }
@@ -18,6 +18,8 @@ struct Animation;         // アニメーション構造体
 struct NodeAnimation;     // ノードアニメーション構造体
 
 constexpr size_t INVALID_ANIM_ID = ~0u;     // 無効値
+constexpr size_t INVALID_MORPH_ID = ~0u;    // 無効値
+constexpr size_t DEFAULT_ANIMATION_MEMORY_BUDGET = 64ull * 1024ull * 1024ull; // 遅延読み込みアニメーションのメモリ予算 (64MB)
 
 // ノードのインスタンス情報
 struct NodeInstance
@@ -37,8 +39,9 @@ struct AnimationInstance
     double currentTime;    // 現在の再生時間 (Tick)
     bool isPlaying;        // 再生中フラグ
     bool isLoop;           // ループ再生フラグ
+    std::shared_ptr<Animation> clip; // キーデータ (持っている間は解放されない)
 
-    AnimationInstance() : animationIndex{ INVALID_ANIM_ID }, currentTime{ 0.0 }, isPlaying{ false }, isLoop{ false } {}
+    AnimationInstance() : animationIndex{ INVALID_ANIM_ID }, currentTime{ 0.0 }, isPlaying{ false }, isLoop{ false }, clip{} {}
     ~AnimationInstance() = default;
 };
 
@@ -54,6 +57,17 @@ struct ModelSlot
     ~ModelSlot() = default;
 };
 
+// モーフ適用の依頼 (フレームごとにまとめて1回の並列処理で適用する)
+struct MorphRequest
+{
+    std::shared_ptr<ModelResource> resource; // 基準形状とターゲット
+    std::span<VertexModel> vertices;         // 書き込み先 (インスタンス固有の頂点ストリーム)
+    std::vector<float> weights;              // ウェイト (依頼した時点のコピー)
+
+    MorphRequest() : resource{}, vertices{}, weights{} {}
+    ~MorphRequest() = default;
+};
+
 //----------------------------
 // モデルの動的インスタンス
 //----------------------------
@@ -67,19 +81,30 @@ public:
     void uninit();
     void update(float deltaTime, const Matrix& worldMatrix);
     void draw();
-    void setAnimation(size_t animationIndex = 0u, double blendDuration = 0.0, bool isSync = false, bool isLoop = false, bool forceReset = false);
+    void setAnimation(size_t animationIndex = 0u, double blendDuration = 0.0, bool isSync = false, bool isLoop = false, bool forceReset = false, double startTime = 0.0);
     bool isAnimationPlaying() const { return m_currentAnimation.isPlaying || m_nextAnimation.isPlaying; }
+    void prefetchAnimation(size_t animationIndex);
     void setScale(float scale);
+    const AABB& getBounds() const { return m_bounds; }
+    size_t getNumMorphTargets() const { return m_morphWeights.size(); }
+    void setMorphWeight(size_t index, float weight);
+    void setMorphWeight(std::string_view name, float weight);
+    float getMorphWeight(size_t index) const { return (index < m_morphWeights.size()) ? m_morphWeights[index] : 0.0f; }
 
 private:
     void setupNodeInstances(Node* node, const Matrix& parentTransform);
     void updateAnimation(double deltaTime);
     void updateNodeTransforms(NodeInstance* node, const Matrix& parentTransform);
     void updateBoneTransforms();
-    void drawNode(NodeInstance* node);
+    void updateBounds(const Matrix& worldMatrix);
     void updateNodeAnimTransforms(NodeInstance* node, Animation* currentAnim, Animation* nextAnim, double currentTime, double nextTime, bool isCurrentLoop, bool isNextLoop);
     Transform getAnimatedTransform(NodeInstance* node, const Animation* anim, const Transform& defaultTransform, double currentTime, bool isLoop);
     void setupBlendStartPose();
+    void setupMorph();
+    void updateMorphWeights(const ModelResource& resource, const Animation* currentAnim, const Animation* nextAnim);
+    void updateMorph();
+    void waitMorph();
+    void releaseMorph();
 
     ModelManager& m_modelManager; // モデルマネージャー参照
     Renderer& m_renderer;         // レンダラー参照
@@ -88,6 +113,7 @@ private:
 
     std::unordered_map<std::string, NodeInstance> m_nodeInstanceMaps; // ノードインスタンスマップ
     std::vector<Matrix> m_boneTransforms;                             // 最終的なボーン変換行列リスト
+    std::vector<Matrix> m_paletteTransforms;                          // 描画単位のボーンパレットに並べた↑ (描画時の作業用)
     AnimationInstance m_currentAnimation;                             // 現在のアニメーション情報
     AnimationInstance m_nextAnimation;                                // 次のアニメーション情報
     Animation* m_pBlendStartPose;                                     // ブレンド開始ポーズ (ブレンド中に新しいアニメーションが来た場合用)
@@ -96,6 +122,13 @@ private:
     bool m_isSync;                                                    // 同期ブレンドフラグ
 
     Transform m_transform;                                            // モデル全体変換値
+    AABB m_bounds;                                                    // アニメーション後のワールド境界ボックス (保守的)
+
+    std::vector<float> m_morphWeights;                                // モーフターゲットのウェイト
+    std::vector<VertexModel> m_morphVertices;                         // インスタンス固有の頂点ストリーム (モーフ適用後)
+    MeshHandle m_morphMesh;                                           // ↑の頂点バッファ (インデックスはリソースと共有)
+    bool m_isMorphDirty;                                              // ウェイトが変わった
+    bool m_isMorphUploadPending;                                      // 頂点の転送待ち
 };
 
 //----------------------------
@@ -104,13 +137,27 @@ private:
 class ModelManager
 {
 public:
-    ModelManager() : m_slotsMutex{}, m_slots{}, m_idToHandle{} {}
+    ModelManager() : m_slotsMutex{}, m_slots{}, m_idToHandle{}, m_animMemoryBudget{ DEFAULT_ANIMATION_MEMORY_BUDGET }, m_animMemoryUsage{}, m_animTick{}, m_morphMutex{}, m_pendingMorphs{}, m_morphBatch{}, m_morphTask{}, m_prefetchTasks{} {}
     ~ModelManager() = default;
 
     bool load(Renderer& renderer, TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback = {}, uint64_t id = Hash(""));
 
     bool registerPath(uint64_t id, const std::filesystem::path& path, bool isAnimationOnly);
     bool setAnimation(uint64_t destModel, uint64_t srcAnim);
+    size_t registerAnimation(uint64_t destModel, const std::filesystem::path& path, std::string_view name = std::string_view(), unsigned int sourceIndex = 0u);
+
+    std::shared_ptr<Animation> acquireAnimation(const ModelHandle& handle, size_t animationIndex);
+    void prefetchAnimation(const ModelHandle& handle, size_t animationIndex);
+    void setAnimationMemoryBudget(size_t budget);
+    size_t getAnimationMemoryUsage() const { return m_animMemoryUsage.load(); }
+    void trimAnimations();
+
+    void requestMorph(const std::shared_ptr<ModelResource>& resource, std::span<VertexModel> vertices, std::span<const float> weights);
+    void dispatchMorphs();
+    void waitMorphs();
+
+    double getAnimationDuration(const ModelHandle& handle, size_t animationIndex);
+    bool sampleNodeTransforms(const ModelHandle& handle, size_t animationIndex, std::span<const double> times, std::span<const std::string> nodeNames, std::span<Matrix> outTransforms, bool isLoop = false);
 
     void releaseCpuResources();
     void releaseCpuResource(const ModelHandle& handle);
@@ -122,4 +169,14 @@ private:
     std::mutex m_slotsMutex;                                // ↓のmutex
     std::vector<ModelSlot> m_slots;                         // モデルスロット
     std::unordered_map<uint64_t, ModelHandle> m_idToHandle; // ID -> ハンドルのマップ
+
+    size_t m_animMemoryBudget;                              // 遅延読み込みアニメーションのメモリ予算 (0なら無制限)
+    std::atomic<size_t> m_animMemoryUsage;                  // 遅延読み込みアニメーションの使用量
+    std::atomic<uint64_t> m_animTick;                       // LRU用の時刻
+
+    std::mutex m_morphMutex;                                // ↓のmutex
+    std::vector<MorphRequest> m_pendingMorphs;              // 今フレームのモーフ適用の依頼
+    std::vector<MorphRequest> m_morphBatch;                 // 適用中の依頼 (タスクが終わるまで持つ)
+    std::future<void> m_morphTask;                          // モーフ適用タスク (フレームに1つ 中で並列に処理する)
+    std::vector<std::future<void>> m_prefetchTasks;         // 先読みタスク (最初に破棄されて完了を待つ)
 };
@@ -0,0 +1,349 @@
+//--------------------------------------------
+//
+// モーションデータベース (特徴量の保持と検索) [motion_database.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "motion_database.h"
+
+#include <immintrin.h> // SSE (特徴量検索)
+#include <bit>
+
+namespace
+{
+    constexpr float PAD_FEATURE = 1.0e15f;      // 端数フレームの特徴量 (検索で絶対に選ばれない値)
+    constexpr float MIN_DEVIATION = 1.0e-4f;    // 標準偏差の下限 (ゼロ除算対策)
+    constexpr size_t SMALL_BOX_PER_LARGE = motion::LARGE_BOX_SIZE / motion::SMALL_BOX_SIZE; // 大きい境界ボックス内の小さい境界ボックス数 (SIMD幅)
+
+    static_assert(SMALL_BOX_PER_LARGE == 4u, "小さい境界ボックスはSSEの4レーンで一度に判定する");
+    static_assert(motion::SMALL_BOX_SIZE % 4u == 0u, "小さい境界ボックスはSSEの幅の倍数");
+
+    //--------------
+    // 4レーンの最小値とその位置を取得する関数
+    //--------------
+    int HorizontalMinIndex(__m128 value, float& outMin)
+    {
+        __m128 min = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+        min = _mm_min_ps(min, _mm_shuffle_ps(min, min, _MM_SHUFFLE(1, 0, 3, 2)));
+        outMin = _mm_cvtss_f32(min);
+        return std::countr_zero(static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpeq_ps(value, min))));
+    }
+}
+
+//--------------
+// 特徴量からの構築関数 (フレームごとの生の特徴量を正規化して境界ボックスを作る アニメーションが変わるか時間が戻ったら次のクリップ)
+//--------------
+bool MotionDatabase::buildFromFeatures(std::span<const std::array<float, motion::FEATURE_COUNT>> rawFeatures, std::span<const size_t> frameAnimations, std::span<const float> frameTimes, const MotionFeatureConfig& config)
+{
+    clear();
+    m_config = config;
+    if (rawFeatures.empty() || frameAnimations.size() != rawFeatures.size() || frameTimes.size() != rawFeatures.size())
+    {
+        return false;
+    }
+
+    m_numFrames = rawFeatures.size();
+    m_frameAnimation.assign(frameAnimations.begin(), frameAnimations.end());
+    m_frameTime.assign(frameTimes.begin(), frameTimes.end());
+    m_clipEnd.resize(m_numFrames);
+    size_t clipEnd = m_numFrames;
+    for (size_t cntFrame = m_numFrames; cntFrame-- > 0u;)
+    {
+        m_clipEnd[cntFrame] = clipEnd;
+        if (cntFrame > 0u && (frameAnimations[cntFrame] != frameAnimations[cntFrame - 1u] || frameTimes[cntFrame] <= frameTimes[cntFrame - 1u]))
+        {
+            clipEnd = cntFrame;
+        }
+    }
+
+    // SoAに並べ替える (大きい境界ボックス単位に揃えて端数は選ばれない値で埋める)
+    size_t paddedCount = (m_numFrames + motion::LARGE_BOX_SIZE - 1u) / motion::LARGE_BOX_SIZE * motion::LARGE_BOX_SIZE;
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        m_features[cntDim].assign(paddedCount, PAD_FEATURE);
+        for (size_t cntFrame = 0; cntFrame < m_numFrames; ++cntFrame)
+        {
+            m_features[cntDim][cntFrame] = rawFeatures[cntFrame][cntDim];
+        }
+    }
+
+    // 次元ごとの重み
+    std::array<float, motion::FEATURE_COUNT> weights{};
+    std::fill_n(weights.begin() + motion::TRAJECTORY_POSITION_OFFSET, motion::TRAJECTORY_COUNT * 2u, config.trajectoryPositionWeight);
+    std::fill_n(weights.begin() + motion::TRAJECTORY_DIRECTION_OFFSET, motion::TRAJECTORY_COUNT * 2u, config.trajectoryDirectionWeight);
+    std::fill_n(weights.begin() + motion::POSE_OFFSET + 0u, 6u, config.footPositionWeight);
+    std::fill_n(weights.begin() + motion::POSE_OFFSET + 6u, 6u, config.footVelocityWeight);
+    std::fill_n(weights.begin() + motion::POSE_OFFSET + 12u, 3u, config.hipVelocityWeight);
+
+    normalize(weights);
+    buildBounds();
+    return true;
+}
+
+//--------------
+// データベースの破棄関数
+//--------------
+void MotionDatabase::clear()
+{
+    m_numFrames = 0u;
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        m_features[cntDim].clear();
+        m_smallMin[cntDim].clear();
+        m_smallMax[cntDim].clear();
+        m_largeMin[cntDim].clear();
+        m_largeMax[cntDim].clear();
+    }
+    m_mean.fill(0.0f);
+    m_scale.fill(0.0f);
+    m_frameAnimation.clear();
+    m_frameTime.clear();
+    m_clipEnd.clear();
+}
+
+//--------------
+// 特徴量の正規化関数 (平均を引いて 重み / 標準偏差 をかける)
+//--------------
+void MotionDatabase::normalize(std::span<const float> weights)
+{
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        std::vector<float>& feature = m_features[cntDim];
+
+        double sum{}, sumSq{};
+        for (size_t cntFrame = 0; cntFrame < m_numFrames; ++cntFrame)
+        {
+            sum += feature[cntFrame];
+            sumSq += static_cast<double>(feature[cntFrame]) * feature[cntFrame];
+        }
+        double mean = sum / static_cast<double>(m_numFrames);
+        double variance = std::max(sumSq / static_cast<double>(m_numFrames) - mean * mean, 0.0);
+
+        m_mean[cntDim] = static_cast<float>(mean);
+        m_scale[cntDim] = weights[cntDim] / std::max(static_cast<float>(std::sqrt(variance)), MIN_DEVIATION);
+
+        for (size_t cntFrame = 0; cntFrame < m_numFrames; ++cntFrame)
+        {
+            feature[cntFrame] = (feature[cntFrame] - m_mean[cntDim]) * m_scale[cntDim];
+        }
+    }
+}
+
+//--------------
+// 境界ボックスの構築関数 (次元ごとの最小値と最大値)
+//--------------
+void MotionDatabase::buildBounds()
+{
+    size_t paddedCount = m_features[0].size();
+    size_t smallCount = paddedCount / motion::SMALL_BOX_SIZE;
+    size_t largeCount = paddedCount / motion::LARGE_BOX_SIZE;
+
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        const std::vector<float>& feature = m_features[cntDim];
+        m_smallMin[cntDim].assign(smallCount, FLT_MAX);
+        m_smallMax[cntDim].assign(smallCount, -FLT_MAX);
+        m_largeMin[cntDim].assign(largeCount, FLT_MAX);
+        m_largeMax[cntDim].assign(largeCount, -FLT_MAX);
+
+        for (size_t cntFrame = 0; cntFrame < paddedCount; ++cntFrame)
+        {
+            size_t small = cntFrame / motion::SMALL_BOX_SIZE;
+            size_t large = cntFrame / motion::LARGE_BOX_SIZE;
+            m_smallMin[cntDim][small] = std::min(m_smallMin[cntDim][small], feature[cntFrame]);
+            m_smallMax[cntDim][small] = std::max(m_smallMax[cntDim][small], feature[cntFrame]);
+            m_largeMin[cntDim][large] = std::min(m_largeMin[cntDim][large], feature[cntFrame]);
+            m_largeMax[cntDim][large] = std::max(m_largeMax[cntDim][large], feature[cntFrame]);
+        }
+    }
+}
+
+//--------------
+// 検索クエリの正規化関数
+//--------------
+void MotionDatabase::normalizeQuery(std::span<const float, motion::FEATURE_COUNT> query, std::span<float, motion::FEATURE_COUNT> outQuery) const
+{
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        outQuery[cntDim] = (query[cntDim] - m_mean[cntDim]) * m_scale[cntDim];
+    }
+}
+
+//--------------
+// 最も近いフレームの検索関数 (境界ボックスで枝刈りしながらSIMDで走査する)
+//--------------
+MotionMatchResult MotionDatabase::search(std::span<const float, motion::FEATURE_COUNT> query, float maxCost) const
+{
+    MotionMatchResult best{};
+    best.cost = maxCost;
+    if (m_numFrames == 0u)
+    {
+        return best;
+    }
+
+    std::array<float, motion::FEATURE_COUNT> normalized{};
+    normalizeQuery(query, normalized);
+
+    // 大きい境界ボックスまでの距離 (下限) を先に全部出して近い順に見る (早く良いフレームが見つかるほど残りの箱を中を見ずに除ける)
+    size_t largeCount = m_largeMin[0].size();
+    std::vector<std::pair<float, size_t>> largeBounds(largeCount);
+    for (size_t cntLarge = 0; cntLarge < largeCount; ++cntLarge)
+    {
+        float lowerBound{};
+        for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+        {
+            float diff = normalized[cntDim] - std::clamp(normalized[cntDim], m_largeMin[cntDim][cntLarge], m_largeMax[cntDim][cntLarge]);
+            lowerBound += diff * diff;
+        }
+        largeBounds[cntLarge] = { lowerBound, cntLarge };
+    }
+    std::sort(largeBounds.begin(), largeBounds.end());
+
+    for (const auto& [lowerBound, cntLarge] : largeBounds)
+    {
+        // 下限が今の最良以上なら残りの箱も中を見ない
+        if (lowerBound >= best.cost)
+        {
+            break;
+        }
+
+        // 中の小さい境界ボックス4つを一度に判定
+        size_t smallStart = cntLarge * SMALL_BOX_PER_LARGE;
+        __m128 smallBound = _mm_setzero_ps();
+        for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+        {
+            __m128 q = _mm_set1_ps(normalized[cntDim]);
+            __m128 clamped = _mm_min_ps(_mm_max_ps(q, _mm_loadu_ps(&m_smallMin[cntDim][smallStart])), _mm_loadu_ps(&m_smallMax[cntDim][smallStart]));
+            __m128 diff = _mm_sub_ps(q, clamped);
+            smallBound = _mm_add_ps(smallBound, _mm_mul_ps(diff, diff));
+        }
+
+        alignas(16) float smallBounds[SMALL_BOX_PER_LARGE];
+        _mm_store_ps(smallBounds, smallBound);
+        for (size_t cntSmall = 0; cntSmall < SMALL_BOX_PER_LARGE; ++cntSmall)
+        {
+            if (smallBounds[cntSmall] < best.cost)
+            {
+                size_t start = (smallStart + cntSmall) * motion::SMALL_BOX_SIZE;
+                searchRange(normalized.data(), start, start + motion::SMALL_BOX_SIZE, best);
+            }
+        }
+    }
+
+    if (best.isValid())
+    {
+        best.animationIndex = m_frameAnimation[best.frame];
+        best.time = m_frameTime[best.frame];
+    }
+    return best;
+}
+
+//--------------
+// 全フレームを走査する検索関数 (枝刈りなし 検証用)
+//--------------
+MotionMatchResult MotionDatabase::searchBruteForce(std::span<const float, motion::FEATURE_COUNT> query) const
+{
+    MotionMatchResult best{};
+    if (m_numFrames == 0u)
+    {
+        return best;
+    }
+
+    std::array<float, motion::FEATURE_COUNT> normalized{};
+    normalizeQuery(query, normalized);
+    searchRange(normalized.data(), 0u, m_features[0].size(), best);
+
+    if (best.isValid())
+    {
+        best.animationIndex = m_frameAnimation[best.frame];
+        best.time = m_frameTime[best.frame];
+    }
+    return best;
+}
+
+//--------------
+// 範囲内のフレームを4つずつ走査する関数 (start,endは4の倍数)
+//--------------
+void MotionDatabase::searchRange(const float* query, size_t start, size_t end, MotionMatchResult& best) const
+{
+    for (size_t cntFrame = start; cntFrame < end; cntFrame += 4u)
+    {
+        __m128 cost = _mm_setzero_ps();
+        for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+        {
+            __m128 diff = _mm_sub_ps(_mm_loadu_ps(&m_features[cntDim][cntFrame]), _mm_set1_ps(query[cntDim]));
+            cost = _mm_add_ps(cost, _mm_mul_ps(diff, diff));
+        }
+
+        // 4つのどれかが最良を更新するときだけ取り出す
+        if (_mm_movemask_ps(_mm_cmplt_ps(cost, _mm_set1_ps(best.cost))) != 0)
+        {
+            float minCost{};
+            int lane = HorizontalMinIndex(cost, minCost);
+            best.cost = minCost;
+            best.frame = cntFrame + static_cast<size_t>(lane);
+        }
+    }
+}
+
+//--------------
+// フレームの特徴量を取得する関数 (正規化前の値)
+//--------------
+void MotionDatabase::getFeatures(size_t frame, std::span<float, motion::FEATURE_COUNT> outFeatures) const
+{
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        if (frame >= m_numFrames || m_scale[cntDim] == 0.0f)
+        {// 重みのない次元は平均で代用
+            outFeatures[cntDim] = m_mean[cntDim];
+            continue;
+        }
+        outFeatures[cntDim] = m_features[cntDim][frame] / m_scale[cntDim] + m_mean[cntDim];
+    }
+}
+
+//--------------
+// フレームとクエリの距離を計算する関数
+//--------------
+float MotionDatabase::computeCost(size_t frame, std::span<const float, motion::FEATURE_COUNT> query) const
+{
+    if (frame >= m_numFrames)
+    {
+        return FLT_MAX;
+    }
+
+    float cost{};
+    for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+    {
+        float diff = m_features[cntDim][frame] - (query[cntDim] - m_mean[cntDim]) * m_scale[cntDim];
+        cost += diff * diff;
+    }
+    return cost;
+}
+
+//--------------
+// 同じクリップの次のフレームを取得する関数 (ないなら無効値)
+//--------------
+size_t MotionDatabase::getNextFrame(size_t frame) const
+{
+    if (frame >= m_numFrames)
+    {
+        return motion::INVALID_FRAME;
+    }
+
+    if (frame + 1u < m_clipEnd[frame])
+    {
+        return frame + 1u;
+    }
+
+    if (m_config.isLoop)
+    {// クリップの先頭に戻る
+        size_t clipStart = frame;
+        while (clipStart > 0u && m_clipEnd[clipStart - 1u] == m_clipEnd[frame])
+        {
+            --clipStart;
+        }
+        return clipStart;
+    }
+    return motion::INVALID_FRAME;
+}
@@ -0,0 +1,105 @@
+//--------------------------------------------
+//
+// モーションデータベース (特徴量の保持と検索) [motion_database.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // ModelHandle
+#include <span>
+#include <string>
+#include <vector>
+
+class ModelManager; // モデルマネージャー
+
+namespace motion
+{
+    constexpr size_t TRAJECTORY_COUNT = 3u;                               // 未来の軌道点の数
+    constexpr size_t TRAJECTORY_POSITION_OFFSET = 0u;                     // 特徴量内の軌道位置の先頭 (x,z)
+    constexpr size_t TRAJECTORY_DIRECTION_OFFSET = TRAJECTORY_COUNT * 2u; // 特徴量内の軌道方向の先頭 (x,z)
+    constexpr size_t POSE_OFFSET = TRAJECTORY_COUNT * 4u;                 // 特徴量内のポーズの先頭
+    constexpr size_t FEATURE_COUNT = POSE_OFFSET + 15u;                   // 足の位置,足の速度 (左右) + 腰の速度
+    constexpr size_t SMALL_BOX_SIZE = 16u;                                // 小さい境界ボックスのフレーム数
+    constexpr size_t LARGE_BOX_SIZE = 64u;                                // 大きい境界ボックスのフレーム数 (SMALL_BOX_SIZEの倍数)
+    constexpr size_t INVALID_FRAME = ~0u;                                 // 無効値
+    constexpr size_t INVALID_ANIMATION = ~0u;                             // 無効値 (INVALID_ANIM_IDと同じ)
+}
+
+// 特徴量の抽出設定
+struct MotionFeatureConfig
+{
+    std::string rootNode;                                  // 軌道と向きの基準ノード (腰など)
+    std::string leftFootNode;                              // 左足ノード
+    std::string rightFootNode;                             // 右足ノード
+    float sampleRate;                                      // 1秒あたりのフレーム数
+    std::array<float, motion::TRAJECTORY_COUNT> trajectoryTimes; // 未来の軌道点の時間 (秒)
+    float trajectoryPositionWeight;                        // 軌道位置の重み
+    float trajectoryDirectionWeight;                       // 軌道方向の重み
+    float footPositionWeight;                              // 足の位置の重み
+    float footVelocityWeight;                              // 足の速度の重み
+    float hipVelocityWeight;                               // 腰の速度の重み
+    bool isLoop;                                           // ループするクリップとして扱う (末尾の未来を先頭から取る)
+
+    MotionFeatureConfig() : rootNode{}, leftFootNode{}, rightFootNode{}, sampleRate{ 30.0f }, trajectoryTimes{ 0.33f, 0.66f, 1.0f },
+        trajectoryPositionWeight{ 1.0f }, trajectoryDirectionWeight{ 1.5f }, footPositionWeight{ 0.75f }, footVelocityWeight{ 1.0f }, hipVelocityWeight{ 1.0f }, isLoop{} {}
+    ~MotionFeatureConfig() = default;
+};
+
+// 検索結果
+struct MotionMatchResult
+{
+    size_t frame;          // データベース内のフレーム
+    size_t animationIndex; // アニメーション番号
+    float time;            // アニメーション内の時間 (秒)
+    float cost;            // 特徴量の距離 (二乗)
+
+    MotionMatchResult() : frame{ motion::INVALID_FRAME }, animationIndex{ motion::INVALID_ANIMATION }, time{}, cost{ FLT_MAX } {}
+    ~MotionMatchResult() = default;
+
+    bool isValid() const { return frame != motion::INVALID_FRAME; }
+};
+
+//----------------------------
+// モーションデータベース (特徴量をSoAで保持して検索する モデルからの抽出はmotion_matching.cpp)
+//----------------------------
+class MotionDatabase
+{
+public:
+    MotionDatabase() : m_numFrames{}, m_features{}, m_mean{}, m_scale{}, m_frameAnimation{}, m_frameTime{}, m_clipEnd{}, m_smallMin{}, m_smallMax{}, m_largeMin{}, m_largeMax{}, m_config{} {}
+    ~MotionDatabase() = default;
+
+    bool build(ModelManager& modelManager, const ModelHandle& handle, std::span<const size_t> animationIndices, const MotionFeatureConfig& config);
+    bool buildFromFeatures(std::span<const std::array<float, motion::FEATURE_COUNT>> rawFeatures, std::span<const size_t> frameAnimations, std::span<const float> frameTimes, const MotionFeatureConfig& config);
+    void clear();
+
+    MotionMatchResult search(std::span<const float, motion::FEATURE_COUNT> query, float maxCost = FLT_MAX) const;
+    MotionMatchResult searchBruteForce(std::span<const float, motion::FEATURE_COUNT> query) const;
+
+    void getFeatures(size_t frame, std::span<float, motion::FEATURE_COUNT> outFeatures) const;
+    float computeCost(size_t frame, std::span<const float, motion::FEATURE_COUNT> query) const;
+    size_t getNextFrame(size_t frame) const;
+
+    size_t getNumFrames() const { return m_numFrames; }
+    size_t getAnimationIndex(size_t frame) const { return (frame < m_numFrames) ? m_frameAnimation[frame] : motion::INVALID_ANIMATION; }
+    float getTime(size_t frame) const { return (frame < m_numFrames) ? m_frameTime[frame] : 0.0f; }
+    const MotionFeatureConfig& getConfig() const { return m_config; }
+
+private:
+    void normalize(std::span<const float> weights);
+    void buildBounds();
+    void normalizeQuery(std::span<const float, motion::FEATURE_COUNT> query, std::span<float, motion::FEATURE_COUNT> outQuery) const;
+    void searchRange(const float* query, size_t start, size_t end, MotionMatchResult& best) const;
+
+    size_t m_numFrames;                                                   // フレーム数
+    std::array<std::vector<float>, motion::FEATURE_COUNT> m_features;     // 正規化済み特徴量 (次元ごとの配列 長さはSIMD幅に揃える)
+    std::array<float, motion::FEATURE_COUNT> m_mean;                      // 次元ごとの平均
+    std::array<float, motion::FEATURE_COUNT> m_scale;                     // 次元ごとの倍率 (重み / 標準偏差)
+    std::vector<size_t> m_frameAnimation;                                 // フレーム -> アニメーション番号
+    std::vector<float> m_frameTime;                                       // フレーム -> 時間 (秒)
+    std::vector<size_t> m_clipEnd;                                        // フレーム -> 同じクリップの終端 (次のフレームの判定用)
+    std::array<std::vector<float>, motion::FEATURE_COUNT> m_smallMin;     // 小さい境界ボックスの最小値 (次元ごと)
+    std::array<std::vector<float>, motion::FEATURE_COUNT> m_smallMax;     // 小さい境界ボックスの最大値 (次元ごと)
+    std::array<std::vector<float>, motion::FEATURE_COUNT> m_largeMin;     // 大きい境界ボックスの最小値 (次元ごと)
+    std::array<std::vector<float>, motion::FEATURE_COUNT> m_largeMax;     // 大きい境界ボックスの最大値 (次元ごと)
+    MotionFeatureConfig m_config;                                         // 抽出設定
+};
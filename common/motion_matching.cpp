@@ -0,0 +1,251 @@
+//--------------------------------------------
+//
+// モーションマッチング [motion_matching.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "motion_matching.h"
+
+namespace
+{
+    constexpr float MIN_LENGTH = 1.0e-4f;       // 水平な向きの長さの下限 (真上か真下)
+    constexpr size_t SAMPLE_COUNT = 2u + motion::TRAJECTORY_COUNT; // 1フレームの評価時間数 (現在,前フレーム,未来の軌道点)
+
+    static_assert(motion::INVALID_ANIMATION == INVALID_ANIM_ID, "検索結果のアニメーション番号はModelと同じ無効値");
+
+    // 基準ノードの水平な向き (x:右 z:前 の基底)
+    struct Heading
+    {
+        Vector3 position; // 基準位置
+        Vector3 right;    // 右方向 (水平)
+        Vector3 forward;  // 前方向 (水平)
+    };
+
+    //--------------
+    // 変換行列から水平な向きを作る関数
+    //--------------
+    Heading MakeHeading(const Matrix& transform)
+    {
+        Heading heading{};
+        heading.position = transform.getPosition();
+
+        Vector3 forward = transform.getForward();
+        forward.y = 0.0f;
+        if (forward.length() <= MIN_LENGTH)
+        {// 真上か真下を向いている
+            forward = Vector3(0.0f, 0.0f, 1.0f);
+        }
+        forward.normalize();
+        heading.forward = forward;
+        heading.right = Vector3(forward.z, 0.0f, -forward.x); // Y軸回りに90度 (左手系)
+        return heading;
+    }
+
+    //--------------
+    // ベクトルを基準ノードの空間に変換する関数 (水平のみ)
+    //--------------
+    Vector2 ToLocal2(const Heading& heading, const Vector3& vector)
+    {
+        return Vector2(vector.x * heading.right.x + vector.z * heading.right.z, vector.x * heading.forward.x + vector.z * heading.forward.z);
+    }
+
+    //--------------
+    // ベクトルを基準ノードの空間に変換する関数 (高さはそのまま)
+    //--------------
+    Vector3 ToLocal3(const Heading& heading, const Vector3& vector)
+    {
+        Vector2 horizontal = ToLocal2(heading, vector);
+        return Vector3(horizontal.x, vector.y, horizontal.y);
+    }
+
+    //--------------
+    // クリップ内の時間に収める関数
+    //--------------
+    double WrapTime(double time, double duration, bool isLoop)
+    {
+        if (isLoop && duration > 0.0)
+        {
+            time = std::fmod(time, duration);
+            return (time < 0.0) ? time + duration : time;
+        }
+        return std::clamp(time, 0.0, duration);
+    }
+}
+
+//--------------
+// データベースの構築関数 (クリップを一定間隔で評価して特徴量を作る)
+//--------------
+bool MotionDatabase::build(ModelManager& modelManager, const ModelHandle& handle, std::span<const size_t> animationIndices, const MotionFeatureConfig& config)
+{
+    clear();
+    m_config = config;
+    if (!handle.isValid() || config.sampleRate <= 0.0f)
+    {
+        return false;
+    }
+
+    const std::array<std::string, 3u> nodeNames{ config.rootNode, config.leftFootNode, config.rightFootNode };
+    const double frameDelta = 1.0 / static_cast<double>(config.sampleRate);
+    const double maxFuture = static_cast<double>(*std::max_element(config.trajectoryTimes.begin(), config.trajectoryTimes.end()));
+
+    // 生の特徴量 (フレームごと)
+    std::vector<std::array<float, motion::FEATURE_COUNT>> rawFeatures{};
+    std::vector<size_t> frameAnimations{};
+    std::vector<float> frameTimes{};
+    std::vector<double> times{};
+    std::vector<Matrix> transforms{};
+
+    for (size_t animationIndex : animationIndices)
+    {
+        double duration = modelManager.getAnimationDuration(handle, animationIndex);
+        if (duration <= 0.0)
+        {
+            continue;
+        }
+
+        // 未来の軌道が取れるフレームだけを使う (ループならすべて)
+        double lastTime = config.isLoop ? duration - frameDelta * 0.5 : duration - maxFuture;
+        if (lastTime < 0.0)
+        {
+            continue;
+        }
+        size_t frameCount = static_cast<size_t>(lastTime / frameDelta) + 1u;
+
+        // 全フレームの評価時間をまとめて渡す
+        times.resize(frameCount * SAMPLE_COUNT);
+        for (size_t cntFrame = 0; cntFrame < frameCount; ++cntFrame)
+        {
+            double time = static_cast<double>(cntFrame) * frameDelta;
+            double* pTimes = &times[cntFrame * SAMPLE_COUNT];
+            pTimes[0] = time;
+            pTimes[1] = WrapTime(time - frameDelta, duration, config.isLoop);
+            for (size_t cntTrajectory = 0; cntTrajectory < motion::TRAJECTORY_COUNT; ++cntTrajectory)
+            {
+                pTimes[2u + cntTrajectory] = WrapTime(time + config.trajectoryTimes[cntTrajectory], duration, config.isLoop);
+            }
+        }
+
+        transforms.resize(times.size() * nodeNames.size());
+        if (!modelManager.sampleNodeTransforms(handle, animationIndex, times, nodeNames, transforms, config.isLoop))
+        {
+            continue;
+        }
+
+        size_t clipStart = rawFeatures.size();
+        for (size_t cntFrame = 0; cntFrame < frameCount; ++cntFrame)
+        {
+            const Matrix* pSample = &transforms[cntFrame * SAMPLE_COUNT * nodeNames.size()];
+            auto node = [&](size_t sample, size_t index) -> const Matrix& { return pSample[sample * nodeNames.size() + index]; };
+
+            Heading heading = MakeHeading(node(0u, 0u));
+            std::array<float, motion::FEATURE_COUNT>& feature = rawFeatures.emplace_back();
+
+            // 未来の軌道 (位置と向き)
+            for (size_t cntTrajectory = 0; cntTrajectory < motion::TRAJECTORY_COUNT; ++cntTrajectory)
+            {
+                Heading future = MakeHeading(node(2u + cntTrajectory, 0u));
+                Vector2 position = ToLocal2(heading, future.position - heading.position);
+                Vector2 direction = ToLocal2(heading, future.forward);
+                feature[motion::TRAJECTORY_POSITION_OFFSET + cntTrajectory * 2u + 0u] = position.x;
+                feature[motion::TRAJECTORY_POSITION_OFFSET + cntTrajectory * 2u + 1u] = position.y;
+                feature[motion::TRAJECTORY_DIRECTION_OFFSET + cntTrajectory * 2u + 0u] = direction.x;
+                feature[motion::TRAJECTORY_DIRECTION_OFFSET + cntTrajectory * 2u + 1u] = direction.y;
+            }
+
+            // ポーズ (足の位置,足の速度,腰の速度)
+            const float invDelta = static_cast<float>(1.0 / frameDelta);
+            std::array<Vector3, 5u> pose{};
+            pose[0] = ToLocal3(heading, node(0u, 1u).getPosition() - heading.position);
+            pose[1] = ToLocal3(heading, node(0u, 2u).getPosition() - heading.position);
+            pose[2] = ToLocal3(heading, (node(0u, 1u).getPosition() - node(1u, 1u).getPosition()) * invDelta);
+            pose[3] = ToLocal3(heading, (node(0u, 2u).getPosition() - node(1u, 2u).getPosition()) * invDelta);
+            pose[4] = ToLocal3(heading, (node(0u, 0u).getPosition() - node(1u, 0u).getPosition()) * invDelta);
+            for (size_t cnt = 0; cnt < pose.size(); ++cnt)
+            {
+                feature[motion::POSE_OFFSET + cnt * 3u + 0u] = pose[cnt].x;
+                feature[motion::POSE_OFFSET + cnt * 3u + 1u] = pose[cnt].y;
+                feature[motion::POSE_OFFSET + cnt * 3u + 2u] = pose[cnt].z;
+            }
+
+            frameAnimations.push_back(animationIndex);
+            frameTimes.push_back(static_cast<float>(times[cntFrame * SAMPLE_COUNT]));
+        }
+
+        // 非ループの先頭フレームは前のフレームがないので次のフレームの速度を使う
+        if (!config.isLoop && frameCount > 1u)
+        {
+            std::copy(rawFeatures[clipStart + 1u].begin() + motion::POSE_OFFSET + 6u, rawFeatures[clipStart + 1u].end(), rawFeatures[clipStart].begin() + motion::POSE_OFFSET + 6u);
+        }
+    }
+
+    return buildFromFeatures(rawFeatures, frameAnimations, frameTimes, config);
+}
+
+//--------------
+// 更新関数 (一定間隔で検索して より良いフレームがあれば遷移する)
+//--------------
+bool MotionMatcher::update(Model& model, float deltaTime, const MotionTrajectory& desired)
+{
+    if (m_database.getNumFrames() == 0u)
+    {
+        return false;
+    }
+
+    // 再生位置をデータベースのフレームで追いかける
+    const float frameDelta = 1.0f / m_database.getConfig().sampleRate;
+    bool isEnd = (m_currentFrame == motion::INVALID_FRAME);
+    m_frameTime += deltaTime;
+    m_searchTimer -= deltaTime;
+    while (!isEnd && m_frameTime >= frameDelta)
+    {
+        size_t next = m_database.getNextFrame(m_currentFrame);
+        if (next == motion::INVALID_FRAME)
+        {// クリップの終端 (未来の軌道が取れない)
+            isEnd = true;
+            break;
+        }
+        m_currentFrame = next;
+        m_frameTime -= frameDelta;
+    }
+
+    if (!isEnd && m_searchTimer > 0.0f)
+    {
+        return false;
+    }
+    m_searchTimer = m_searchInterval;
+
+    std::array<float, motion::FEATURE_COUNT> query{};
+    buildQuery(desired, query);
+
+    float currentCost = isEnd ? FLT_MAX : m_database.computeCost(m_currentFrame, query);
+    MotionMatchResult result = m_database.search(query, isEnd ? FLT_MAX : currentCost - m_minImprovement);
+    if (!result.isValid())
+    {// 今のフレームより十分良いものがない
+        return false;
+    }
+
+    if (!isEnd && result.animationIndex == m_database.getAnimationIndex(m_currentFrame) && std::fabs(result.time - m_database.getTime(m_currentFrame)) < m_sameClipThreshold)
+    {// 同じクリップの近い位置ならそのまま再生を続ける
+        return false;
+    }
+
+    model.setAnimation(result.animationIndex, m_blendDuration, false, m_database.getConfig().isLoop, true, result.time);
+    m_currentFrame = result.frame;
+    m_frameTime = 0.0f;
+    return true;
+}
+
+//--------------
+// 検索クエリの作成関数 (ポーズは今のフレーム,軌道は目標)
+//--------------
+void MotionMatcher::buildQuery(const MotionTrajectory& desired, std::span<float, motion::FEATURE_COUNT> outQuery) const
+{
+    m_database.getFeatures(m_currentFrame, outQuery);
+    for (size_t cntTrajectory = 0; cntTrajectory < motion::TRAJECTORY_COUNT; ++cntTrajectory)
+    {
+        outQuery[motion::TRAJECTORY_POSITION_OFFSET + cntTrajectory * 2u + 0u] = desired.positions[cntTrajectory].x;
+        outQuery[motion::TRAJECTORY_POSITION_OFFSET + cntTrajectory * 2u + 1u] = desired.positions[cntTrajectory].y;
+        outQuery[motion::TRAJECTORY_DIRECTION_OFFSET + cntTrajectory * 2u + 0u] = desired.directions[cntTrajectory].x;
+        outQuery[motion::TRAJECTORY_DIRECTION_OFFSET + cntTrajectory * 2u + 1u] = desired.directions[cntTrajectory].y;
+    }
+}
@@ -0,0 +1,49 @@
+//--------------------------------------------
+//
+// モーションマッチング [motion_matching.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "model.h"           // Model, ModelManager
+#include "motion_database.h" // MotionDatabase
+
+// 目標の軌道 (キャラクター空間 x:右 z:前)
+struct MotionTrajectory
+{
+    std::array<Vector2, motion::TRAJECTORY_COUNT> positions;  // 未来の位置
+    std::array<Vector2, motion::TRAJECTORY_COUNT> directions; // 未来の向き (正規化)
+
+    MotionTrajectory() : positions{}, directions{} {}
+    ~MotionTrajectory() = default;
+};
+
+//----------------------------
+// モーションマッチング (データベースを検索してModelのクロスフェードで遷移する)
+//----------------------------
+class MotionMatcher
+{
+public:
+    MotionMatcher(const MotionDatabase& database) : m_database(database), m_currentFrame{ motion::INVALID_FRAME }, m_frameTime{}, m_searchTimer{}, m_searchInterval{ 0.1f }, m_blendDuration{ 0.2f }, m_minImprovement{ 0.05f }, m_sameClipThreshold{ 0.2f } {}
+    ~MotionMatcher() = default;
+
+    void reset() { m_currentFrame = motion::INVALID_FRAME; m_frameTime = 0.0f; m_searchTimer = 0.0f; }
+    bool update(Model& model, float deltaTime, const MotionTrajectory& desired);
+
+    void setSearchInterval(float interval) { m_searchInterval = interval; }
+    void setBlendDuration(float duration) { m_blendDuration = duration; }
+    void setMinImprovement(float improvement) { m_minImprovement = improvement; }
+    size_t getCurrentFrame() const { return m_currentFrame; }
+
+private:
+    void buildQuery(const MotionTrajectory& desired, std::span<float, motion::FEATURE_COUNT> outQuery) const;
+
+    const MotionDatabase& m_database; // データベース参照
+    size_t m_currentFrame;            // 再生中のフレーム
+    float m_frameTime;                // 現在のフレームからの経過時間 (秒)
+    float m_searchTimer;              // 次の検索までの時間
+    float m_searchInterval;           // 検索間隔 (秒)
+    float m_blendDuration;            // 遷移のブレンド時間 (秒)
+    float m_minImprovement;           // 遷移するのに必要なコストの改善量
+    float m_sameClipThreshold;        // 同じクリップの近い時間なら遷移しない (秒)
+};
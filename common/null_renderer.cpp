@@ -0,0 +1,746 @@
+//--------------------------------------------
+//
+// 記録だけするレンダラー [null_renderer.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "null_renderer.h"
+#include "renderer.h"
+#include "texture.h"
+#include "scene.h"
+#include "camera.h"
+#include "camera_comp.h"
+#include "light_comp.h"
+#include <thread>
+
+//-------------------------------------------
+// 初期化 (ウィンドウはなくてもよい)
+//-------------------------------------------
+void NullRenderer::init(HWND handle, long width, long height)
+{
+    m_hWnd = handle;
+    onResize(static_cast<int>(width), static_cast<int>(height));
+    clear();
+}
+
+//-------------------------------------------
+// 終了
+//-------------------------------------------
+void NullRenderer::uninit()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_meshMutex);
+        m_meshes.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_texMutex);
+        m_textures.clear();
+    }
+    m_textureResidency.unregisterAll();
+    clear();
+    m_hWnd = nullptr;
+}
+
+//-------------------------------------------
+// 描画 (D3D11のバックエンドと同じ順番でキューを回し,コマンドを記録する)
+//-------------------------------------------
+bool NullRenderer::render(const Scene& scene, std::function<void()> /*guiRender*/, Renderer& inter)
+{
+    auto cameras = scene.getGameObjectsOfType<CameraComponent>();
+    auto lights = scene.getGameObjectsOfType<LightComponent>();
+    auto renderComponents = scene.getGameObjectsOfType<RenderComponent>();
+
+    // 1フレーム分の記録と統計にする
+    clear();
+
+    // 前のフレームの要求から常駐を決める (転送はないのですぐ常駐する)
+    m_textureResidency.update(m_residencyChanges);
+    for (const auto& change : m_residencyChanges)
+    {
+        m_textureResidency.onResident(change.id, change.mip, true);
+    }
+
+    // カリング用の境界ボックスを集める (カメラとライトで共有)
+    m_drawList.buildBounds(renderComponents, inter);
+    m_staticShadowCache.beginFrame(m_drawList.getStaticCasterKey());
+
+    for (size_t cnt = 0; cnt < cameras.size(); cnt++)
+    {
+        setCameraPosition(cameras[cnt]->get().GetPosition());
+
+        // Cameraの行列
+        Matrix CameraView = cameras[cnt]->get().GetViewMatrix(), CameraProj = cameras[cnt]->get().GetProjectionMatrix();
+
+        // 視錐台の外を除いて描画アイテムをカメラの奥行きでソートする
+        Matrix viewProj = Matrix::Multiply(CameraView, CameraProj);
+        m_drawList.cull(Frustum(viewProj), m_cameraVisible);
+        m_occlusionCuller.build(viewProj, m_drawList.getOccluders(), m_cameraVisible, std::max(1u, std::thread::hardware_concurrency()));
+        m_occlusionCuller.cull(m_drawList.getCullBounds(), m_cameraVisible);
+        m_drawList.build(renderComponents, CameraView, m_cameraVisible);
+
+        // 点光源をクラスターに振り分ける (送る量は点光源,範囲,ライト番号の合計)
+        if (!m_pointLights.empty() && m_lightClusters.build(CameraView, CameraProj, m_pointLights, std::max(1u, std::thread::hardware_concurrency())))
+        {
+            addConstants(m_lightClusters.getPointLights().size_bytes() + m_lightClusters.getClusters().size_bytes() + m_lightClusters.getLightIndices().size_bytes());
+        }
+
+        // 影 (最初の影を落とすライトのカスケードごと)
+        for (const auto& light : lights)
+        {
+            Vector3 eye{}, target, up{};
+            if (!light->getShadowInfo(&eye, &target, &up))
+            {
+                continue;
+            }
+
+            ShadowCascadeSet cascades{};
+            if (BuildShadowCascades(CameraView, CameraProj, target - eye, up, m_shadowSettings, cascades))
+            {
+                bool isCacheable = cnt == 0u && m_drawList.getStaticCasterCount() > 0u;
+                for (unsigned int cntCascade = 0; cntCascade < cascades.count; ++cntCascade)
+                {
+                    const ShadowCascade& cascade = cascades.cascades[cntCascade];
+                    if (!isCacheable)
+                    {
+                        m_drawList.cull(Frustum(Matrix::Multiply(cascade.view, cascade.proj)), m_shadowVisible);
+                        beginQueue(RenderQueue::Shadow, cascade.view, cascade.proj);
+                        drawQueue(RenderQueue::Shadow, inter, m_shadowVisible);
+                        continue;
+                    }
+
+                    // 動かない影はカスケードがキャッシュの範囲から出たときだけ描き,動く影は毎回その範囲で描く
+                    bool isRedraw = !m_staticShadowCache.isReusable(cntCascade, cascade);
+                    if (isRedraw)
+                    {
+                        m_staticShadowCache.store(cntCascade, BuildStaticShadowRegion(cascade, m_shadowSettings));
+                    }
+                    const ShadowCascade& region = m_staticShadowCache.regions[cntCascade];
+                    m_drawList.cull(Frustum(Matrix::Multiply(region.view, region.proj)), m_shadowVisible);
+                    m_drawList.splitStaticCasters(m_shadowVisible, m_staticShadowVisible, m_dynamicShadowVisible);
+                    if (isRedraw)
+                    {
+                        beginQueue(RenderQueue::Shadow, region.view, region.proj);
+                        drawQueue(RenderQueue::Shadow, inter, m_staticShadowVisible);
+                    }
+                    beginQueue(RenderQueue::Shadow, region.view, region.proj);
+                    drawQueue(RenderQueue::Shadow, inter, m_dynamicShadowVisible);
+                }
+            }
+            break;
+        }
+
+        // ジオメトリ,デカール,フォワード
+        beginQueue(RenderQueue::Geometry, CameraView, CameraProj);
+        drawQueue(RenderQueue::Geometry, inter);
+
+        beginQueue(RenderQueue::Decal, CameraView, CameraProj);
+        drawQueue(RenderQueue::Decal, inter);
+
+        beginQueue(RenderQueue::Sky, CameraView, CameraProj);
+        drawQueue(RenderQueue::Sky, inter);
+
+        beginQueue(RenderQueue::Outline, CameraView, CameraProj);
+        setOutlineData(Color::Black(), 0.0005f);
+        drawQueue(RenderQueue::Outline, inter);
+
+        beginQueue(RenderQueue::Transparent, CameraView, CameraProj);
+        drawQueue(RenderQueue::Transparent, inter);
+    }
+
+    // カメラがない場合はUIとStringのためだけに作る
+    if (cameras.empty())
+    {
+        m_drawList.build(renderComponents, Matrix(), {});
+    }
+
+    // UIとString (正射影)
+    Matrix ortho = Matrix::OrthographicOffCenter(0.0f, m_screenSize.x, m_screenSize.y, 0.0f, 0.0f, 1.0f);
+    beginQueue(RenderQueue::UI, Matrix(), ortho);
+    drawQueue(RenderQueue::UI, inter);
+
+    beginQueue(RenderQueue::String, Matrix(), ortho);
+    drawQueue(RenderQueue::String, inter);
+
+    // Gui (guiRender) はデバイスがないと描けないので呼ばない
+
+    return true;
+}
+
+//-------------------------------------------
+// キューの描画アイテムを順番に記録 (同じ状態が続く間はインスタンシングでまとめる)
+//-------------------------------------------
+void NullRenderer::drawQueue(RenderQueue queue, Renderer& inter, std::span<const uint8_t> visible)
+{
+    bool isInstancing = draw::IsInstancingQueue(queue);
+
+    InstanceDrawDesc batchDesc{};
+    RenderComponent* pBatchFirst = nullptr; // まとめ始めのコンポーネント (1つだけならrenderで描画)
+
+    // まとめたものを描画する
+    auto flush = [&]()
+        {
+            if (m_instanceBatch.size() >= draw::MIN_INSTANCE_BATCH)
+            {
+                setMaterial(batchDesc.material);
+                setTexture(batchDesc.texture);
+                setRasMode(batchDesc.rasMode);
+                drawMeshInstanced(batchDesc.mesh, m_instanceBatch);
+                setRasMode(RasMode::Back);
+            }
+            else if (pBatchFirst != nullptr)
+            {
+                pBatchFirst->render(inter);
+            }
+            m_instanceBatch.clear();
+            pBatchFirst = nullptr;
+        };
+
+    for (const DrawItem& item : m_drawList.getQueue(queue))
+    {
+        if (item.index < visible.size() && visible[item.index] == 0u)
+        {
+            continue; // カリング済み
+        }
+
+        // ソートで同じ状態が隣り合うので,続いている間はまとめる
+        InstanceDrawDesc desc{};
+        NullMesh mesh{};
+        if (isInstancing && item.pComponent->getInstanceDraw(desc) && findMesh(desc.mesh, mesh) && mesh.type == VertexShaderType::Vertex3D)
+        {
+            if (pBatchFirst != nullptr && !draw::IsSameInstanceState(batchDesc, desc))
+            {
+                flush();
+            }
+            if (pBatchFirst == nullptr)
+            {
+                pBatchFirst = item.pComponent;
+                batchDesc = desc;
+            }
+            m_instanceBatch.push_back(desc.instance);
+            continue;
+        }
+
+        flush();
+        item.pComponent->render(inter);
+    }
+    flush();
+}
+
+//-------------------------------------------
+// キューの描画開始 (パスの行列を送る)
+//-------------------------------------------
+void NullRenderer::beginQueue(RenderQueue queue, const Matrix& view, const Matrix& proj)
+{
+    record(RenderCommandType::BeginQueue, static_cast<uint32_t>(queue));
+    m_currentQueue = queue;
+    m_isStringBatchOpen = false;
+    m_streamingViewProj = Matrix::Multiply(view, proj);
+    setTransformView(view);
+    setTransformProjection(proj);
+}
+
+//-------------------------------------------
+// 描画に使うテクスチャのミップを要求する (D3D11と同じく 影は測らず,UIは一番細かいミップ)
+//-------------------------------------------
+void NullRenderer::requestTextureMips(VertexShaderType type, const AABB& bounds, const Matrix& world)
+{
+    if (m_currentTexture == TextureHandle().id || m_currentQueue == RenderQueue::Shadow)
+    {
+        return;
+    }
+
+    float screenSize = texture_streaming::FULL_SCREEN_SIZE;
+    if (type != VertexShaderType::Vertex2D && m_currentQueue != RenderQueue::UI && m_currentQueue != RenderQueue::String)
+    {
+        screenSize = texture_streaming::CalcScreenSize(bounds, Matrix::Multiply(world, m_streamingViewProj), m_screenSize * m_dynamicResolution.getScale());
+    }
+    m_textureResidency.request(m_currentTexture, screenSize);
+}
+
+//-------------------------------------------
+// テクスチャの登録 (有効なIDだけ覚える)
+//-------------------------------------------
+bool NullRenderer::uploadTextures(const TextureManager& textureManager, unsigned int /*maxThread*/, std::function<bool(std::string_view, int, int)> progressCallback)
+{
+    std::vector<uint32_t> ids{};
+    for (size_t cnt = 0; ; ++cnt)
+    {
+        auto spTextureData = textureManager.getTextureData(cnt).lock();
+        if (spTextureData == nullptr) break;
+
+        if (spTextureData->isValid)
+        {
+            ids.push_back(static_cast<uint32_t>(cnt));
+
+            // 大きさが分かるものはRGBA8のミップチェーンとしてストリーミングする
+            uint32_t width = static_cast<uint32_t>(std::max(spTextureData->width, 0)), height = static_cast<uint32_t>(std::max(spTextureData->height, 0));
+            unsigned int mipCount = texture_streaming::CountMips(width, height);
+            if (mipCount > 1u && mipCount <= texture_streaming::MAX_MIP_LEVELS && cnt < texture_streaming::MAX_TEXTURES)
+            {
+                std::array<size_t, texture_streaming::MAX_MIP_LEVELS> mipBytes{};
+                for (unsigned int mip = 0; mip < mipCount; ++mip)
+                {
+                    mipBytes[mip] = size_t(std::max(1u, width >> mip)) * std::max(1u, height >> mip) * 4u;
+                }
+                m_textureResidency.registerTexture(static_cast<uint32_t>(cnt), width, height, std::span<const size_t>(mipBytes.data(), mipCount), mipCount - 1u);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_texMutex);
+        m_textures.insert(ids.begin(), ids.end());
+    }
+
+    // 転送はないのですぐ終わる
+    if (progressCallback != nullptr)
+    {
+        return progressCallback("GPU Extract", static_cast<int>(ids.size()), static_cast<int>(ids.size()));
+    }
+    return true;
+}
+
+//-------------------------------------------
+// メッシュの登録 (大きさと境界ボックスだけ残す)
+//-------------------------------------------
+MeshHandle NullRenderer::createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount)
+{
+    if (vertices == nullptr || indices == nullptr)
+    {
+        return MeshHandle();
+    }
+
+    unsigned int stride{}; // 頂点のサイズ (ストライド)
+    switch (type)
+    {
+    case VertexShaderType::Vertex2D:
+        stride = sizeof(Vertex2D);
+        break;
+    case VertexShaderType::Vertex3D:
+        stride = sizeof(Vertex3D);
+        break;
+    case VertexShaderType::VertexModel:
+        stride = sizeof(VertexModel);
+        break;
+    default:
+        return MeshHandle();
+    }
+
+    NullMesh mesh{};
+    mesh.type = type;
+    mesh.verticesCount = verticesCount;
+    mesh.indicesCount = indicesCount;
+
+    // 境界ボックス (3D頂点は先頭が座標)
+    if (type != VertexShaderType::Vertex2D)
+    {
+        const uint8_t* pVertex = static_cast<const uint8_t*>(vertices);
+        for (size_t cnt = 0; cnt < verticesCount; ++cnt)
+        {
+            mesh.bounds.expand(*reinterpret_cast<const Vector3*>(pVertex + cnt * stride));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_meshMutex);
+    MeshHandle handle{};
+    handle.id = static_cast<uint32_t>(m_meshes.size());
+    m_meshes.push_back(mesh);
+    return handle;
+}
+
+//-------------------------------------------
+// インデックスを共有する書き換え可能なメッシュの登録
+//-------------------------------------------
+MeshHandle NullRenderer::createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount)
+{
+    NullMesh mesh{};
+    if (vertices == nullptr || !findMesh(source, mesh) || verticesCount != mesh.verticesCount)
+    {
+        return MeshHandle();
+    }
+    mesh.isDynamic = true;
+
+    std::lock_guard<std::mutex> lock(m_meshMutex);
+    MeshHandle handle{};
+    handle.id = static_cast<uint32_t>(m_meshes.size());
+    m_meshes.push_back(mesh);
+    return handle;
+}
+
+//-------------------------------------------
+// 書き換え可能なメッシュの頂点を更新 (確認だけ)
+//-------------------------------------------
+bool NullRenderer::updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount)
+{
+    NullMesh mesh{};
+    return vertices != nullptr && findMesh(handle, mesh) && mesh.isDynamic && verticesCount <= mesh.verticesCount;
+}
+
+//-------------------------------------------
+// メッシュを解放 (IDは使い回さず,以後は描画できない)
+//-------------------------------------------
+void NullRenderer::releaseMesh(const MeshHandle& handle)
+{
+    std::lock_guard<std::mutex> lock(m_meshMutex);
+    if (handle.isValid() && m_meshes.size() > handle.id)
+    {
+        m_meshes[handle.id] = NullMesh();
+    }
+}
+
+//-------------------------------------------
+// メッシュを設定
+//-------------------------------------------
+bool NullRenderer::setMesh(const MeshHandle& handle)
+{
+    NullMesh mesh{};
+    if (!findMesh(handle, mesh))
+    {
+        return false;
+    }
+    if (changeState(m_currentMesh, handle.id))
+    {
+        record(RenderCommandType::SetMesh, handle.id);
+    }
+    return true;
+}
+
+//-------------------------------------------
+// メッシュの境界ボックスを取得
+//-------------------------------------------
+bool NullRenderer::getMeshBounds(const MeshHandle& handle, AABB& outBounds) const
+{
+    NullMesh mesh{};
+    if (!findMesh(handle, mesh) || !mesh.bounds.isValid())
+    {
+        return false;
+    }
+    outBounds = mesh.bounds;
+    return true;
+}
+
+//-------------------------------------------
+// テクスチャを設定 (未登録なら白を設定して失敗)
+//-------------------------------------------
+bool NullRenderer::setTexture(const TextureHandle& handle)
+{
+    bool isRegistered = true;
+    if (handle.isValid())
+    {
+        std::lock_guard<std::mutex> lock(m_texMutex);
+        isRegistered = m_textures.contains(handle.id);
+    }
+
+    uint32_t id = isRegistered ? handle.id : TextureHandle().id;
+    if (changeState(m_currentTexture, id))
+    {
+        record(RenderCommandType::SetTexture, id);
+    }
+    return isRegistered;
+}
+
+//-------------------------------------------
+// ワールド行列を設定 (変わった時だけ送る)
+//-------------------------------------------
+bool NullRenderer::setTransformWorld(const Matrix& matrix)
+{
+    if (m_isWorldKnown && std::memcmp(&m_world, &matrix, sizeof(Matrix)) == 0)
+    {
+        ++m_stats.redundantStates;
+        return true;
+    }
+    m_world = matrix;
+    m_isWorldKnown = true;
+    ++m_stats.stateChanges;
+    addConstants(sizeof(Matrix));
+    record(RenderCommandType::SetTransformWorld);
+    return true;
+}
+
+//-------------------------------------------
+// ビュー行列を設定
+//-------------------------------------------
+bool NullRenderer::setTransformView(const Matrix& /*matrix*/)
+{
+    addConstants(sizeof(Matrix));
+    record(RenderCommandType::SetTransformView);
+    return true;
+}
+
+//-------------------------------------------
+// プロジェクション行列を設定
+//-------------------------------------------
+bool NullRenderer::setTransformProjection(const Matrix& /*matrix*/)
+{
+    addConstants(sizeof(Matrix));
+    record(RenderCommandType::SetTransformProjection);
+    return true;
+}
+
+//-------------------------------------------
+// カメラの位置を設定
+//-------------------------------------------
+bool NullRenderer::setCameraPosition(const Vector3& /*cameraPos*/)
+{
+    addConstants(sizeof(Vector3));
+    record(RenderCommandType::SetCameraPosition);
+    return true;
+}
+
+//-------------------------------------------
+// マテリアルを設定 (変わった時だけ送る)
+//-------------------------------------------
+bool NullRenderer::setMaterial(const Material& material)
+{
+    if (m_isMaterialKnown && draw::IsSameMaterial(m_material, material))
+    {
+        ++m_stats.redundantStates;
+        return true;
+    }
+    m_material = material;
+    m_isMaterialKnown = true;
+    ++m_stats.stateChanges;
+    addConstants(sizeof(Material));
+    record(RenderCommandType::SetMaterial, static_cast<uint32_t>(material.pixelShaderType));
+    return true;
+}
+
+//-------------------------------------------
+// ライトを設定
+//-------------------------------------------
+bool NullRenderer::setLight(std::span<const LightData> lights, const Color& /*ambient*/)
+{
+    // 平行光源は定数バッファ,点光源はカメラごとにクラスターへ振り分ける (D3D11のバックエンドと同じ)
+    size_t directionalCount = 0u;
+    m_pointLights.clear();
+    for (const auto& light : lights)
+    {
+        if (light.position.w == 0.0f)
+        {
+            directionalCount = std::min(directionalCount + 1u, MAX_LIGHT);
+        }
+        else if (m_pointLights.size() < MAX_POINT_LIGHT)
+        {
+            m_pointLights.push_back(light);
+        }
+    }
+    addConstants(sizeof(LightData) * directionalCount + sizeof(Color));
+    record(RenderCommandType::SetLight, static_cast<uint32_t>(directionalCount), static_cast<uint32_t>(m_pointLights.size()));
+    return true;
+}
+
+//-------------------------------------------
+// フォグを設定
+//-------------------------------------------
+bool NullRenderer::setFog(const FogData& /*fog*/)
+{
+    addConstants(sizeof(FogData));
+    record(RenderCommandType::SetFog);
+    return true;
+}
+
+//-------------------------------------------
+// ボーン行列を設定
+//-------------------------------------------
+bool NullRenderer::setBoneTransforms(std::span<const Matrix> boneTransforms)
+{
+    if (boneTransforms.size() > MAX_BONES)
+    {
+        return false;
+    }
+    addConstants(sizeof(Matrix) * boneTransforms.size());
+    record(RenderCommandType::SetBoneTransforms, static_cast<uint32_t>(boneTransforms.size()));
+    return true;
+}
+
+//-------------------------------------------
+// アウトラインを設定
+//-------------------------------------------
+void NullRenderer::setOutlineData(Color /*color*/, float /*width*/)
+{
+    addConstants(sizeof(Color) + sizeof(float));
+    record(RenderCommandType::SetOutlineData);
+}
+
+//-------------------------------------------
+// ラスタライザーを設定
+//-------------------------------------------
+void NullRenderer::setRasMode(RasMode rasMode)
+{
+    if (changeState(m_currentRasMode, static_cast<uint32_t>(rasMode)))
+    {
+        record(RenderCommandType::SetRasMode, static_cast<uint32_t>(rasMode));
+    }
+}
+
+//-------------------------------------------
+// メッシュを描画
+//-------------------------------------------
+bool NullRenderer::drawMesh(const MeshHandle& handle)
+{
+    NullMesh mesh{};
+    if (!findMesh(handle, mesh))
+    {
+        return false;
+    }
+    setMesh(handle);
+    return drawIndexedPrimitive(mesh.type, static_cast<unsigned int>(mesh.indicesCount), 0u, 0u);
+}
+
+//-------------------------------------------
+// 同じメッシュをまとめて描画
+//-------------------------------------------
+bool NullRenderer::drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances)
+{
+    NullMesh mesh{};
+    if (instances.empty() || !findMesh(handle, mesh) || mesh.type != VertexShaderType::Vertex3D)
+    {
+        return false;
+    }
+    setMesh(handle);
+    requestTextureMips(mesh.type, mesh.bounds, instances[texture_streaming::FindLargestInstance(instances, m_streamingViewProj)].world);
+
+    addConstants(sizeof(InstanceData) * instances.size()); // インスタンスバッファ
+    ++m_stats.draws;
+    m_stats.instances += static_cast<unsigned int>(instances.size());
+    m_stats.triangles += mesh.indicesCount / 3u * instances.size();
+    record(RenderCommandType::DrawInstanced, handle.id, static_cast<uint32_t>(instances.size()));
+    return true;
+}
+
+//-------------------------------------------
+// 頂点描画
+//-------------------------------------------
+bool NullRenderer::drawIndexedPrimitive(VertexShaderType vertexShaderType, unsigned int indexCount, unsigned int /*startIndexLocation*/, unsigned int /*baseVertexLocation*/)
+{
+    if (vertexShaderType >= VertexShaderType::Max)
+    {
+        return false;
+    }
+
+    NullMesh mesh{};
+    findMesh(MeshHandle(m_currentMesh), mesh);
+    requestTextureMips(vertexShaderType, mesh.bounds, m_world);
+
+    ++m_stats.draws;
+    ++m_stats.instances;
+    m_stats.triangles += indexCount / 3u;
+    record(RenderCommandType::DrawIndexed, indexCount, static_cast<uint32_t>(vertexShaderType));
+    return true;
+}
+
+//-------------------------------------------
+// デカールを描画
+//-------------------------------------------
+void NullRenderer::drawDecal(Matrix /*transform*/, const MeshHandle& handle, Color /*color*/)
+{
+    NullMesh mesh{};
+    if (!findMesh(handle, mesh))
+    {
+        return;
+    }
+    setMesh(handle);
+
+    addConstants(sizeof(Matrix) * 2u + sizeof(Color)); // ワールドとその逆行列,色
+    ++m_stats.draws;
+    ++m_stats.instances;
+    m_stats.triangles += mesh.indicesCount / 3u;
+    record(RenderCommandType::DrawDecal, handle.id);
+}
+
+//-------------------------------------------
+// 文字列を描画 (Stringキューの中ではまとめて1回の描画と数える)
+//-------------------------------------------
+void NullRenderer::drawString(std::string_view string, Vector2 /*pos*/, Color /*color*/, float /*angle*/, Vector2 /*scale*/)
+{
+    // D3D11と同じくStringキューの中は1回のバッチにまとめる
+    if (!m_isStringBatchOpen)
+    {
+        ++m_stats.draws;
+        m_isStringBatchOpen = m_currentQueue == RenderQueue::String;
+    }
+    m_stats.triangles += string.size() * 2u; // 1文字1矩形
+    record(RenderCommandType::DrawString, static_cast<uint32_t>(string.size()));
+}
+
+//-------------------------------------------
+// 画面サイズの変更
+//-------------------------------------------
+void NullRenderer::onResize(int width, int height)
+{
+    if (width <= 0 || height <= 0) return;
+
+    m_screenSize = Vector2(static_cast<float>(width), static_cast<float>(height));
+    m_screenMagnification = Vector2(static_cast<float>(width) / DEFAULT_SCREEN_SIZE.x, static_cast<float>(height) / DEFAULT_SCREEN_SIZE.y);
+}
+
+//-------------------------------------------
+// ステート設定の統計を取得 (D3D11と同じ形)
+//-------------------------------------------
+void NullRenderer::getStateStats(RenderStateStats& stats) const
+{
+    stats.issuedCalls = m_stats.stateChanges;
+    stats.redundantCalls = m_stats.redundantStates;
+}
+
+//-------------------------------------------
+// 動的解像度の統計 (割合は設定の上限のまま)
+//-------------------------------------------
+void NullRenderer::getDynamicResolutionStats(DynamicResolutionStats& stats) const
+{
+    stats.scale = m_dynamicResolution.getScale();
+    stats.frameMs = m_dynamicResolution.getFrameMs();
+    stats.width = static_cast<unsigned int>(std::max(1.0f, std::round(m_screenSize.x * stats.scale)));
+    stats.height = static_cast<unsigned int>(std::max(1.0f, std::round(m_screenSize.y * stats.scale)));
+}
+
+//-------------------------------------------
+// 記録と統計と状態の影を消す
+//-------------------------------------------
+void NullRenderer::clear()
+{
+    m_commands.clear();
+    m_stats = NullRenderStats();
+    m_currentMesh = m_currentTexture = m_currentRasMode = ~0u;
+    m_isWorldKnown = m_isMaterialKnown = false;
+}
+
+//-------------------------------------------
+// コマンドを記録
+//-------------------------------------------
+void NullRenderer::record(RenderCommandType type, uint32_t arg0, uint32_t arg1)
+{
+    if (m_isRecording)
+    {
+        m_commands.emplace_back(type, arg0, arg1);
+    }
+}
+
+//-------------------------------------------
+// 状態を変える (変わったらtrue 同じなら省いたとして数える)
+//-------------------------------------------
+bool NullRenderer::changeState(uint32_t& current, uint32_t value)
+{
+    if (current == value)
+    {
+        ++m_stats.redundantStates;
+        return false;
+    }
+    current = value;
+    ++m_stats.stateChanges;
+    return true;
+}
+
+//-------------------------------------------
+// 登録されたメッシュを探す
+//-------------------------------------------
+bool NullRenderer::findMesh(const MeshHandle& handle, NullMesh& outMesh) const
+{
+    std::lock_guard<std::mutex> lock(m_meshMutex);
+    if (!handle.isValid() || m_meshes.size() <= handle.id || m_meshes[handle.id].type == VertexShaderType::Max)
+    {
+        return false; // 未登録か解放済み
+    }
+    outMesh = m_meshes[handle.id];
+    return true;
+}
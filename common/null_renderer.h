@@ -0,0 +1,197 @@
+//--------------------------------------------
+//
+// 記録だけするレンダラー [null_renderer.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "render_backend.h"
+#include "draw_list.h"
+#include "shadow_cascade.h"
+#include "light_cluster.h"
+#include "occlusion_culling.h"
+#include "texture_streaming.h"
+#include "dynamic_resolution.h"
+#include <mutex>
+#include <unordered_set>
+
+// 記録するコマンドの種類
+enum class RenderCommandType : unsigned char
+{
+    BeginQueue,             // キューの描画開始 (arg0:RenderQueue)
+    SetMesh,                // arg0:メッシュID
+    SetTexture,             // arg0:テクスチャID
+    SetTransformWorld,      //
+    SetTransformView,       //
+    SetTransformProjection, //
+    SetCameraPosition,      //
+    SetMaterial,            // arg0:PixelShaderType
+    SetLight,               // arg0:平行光源数 arg1:点光源数
+    SetFog,                 //
+    SetBoneTransforms,      // arg0:ボーン数
+    SetOutlineData,         //
+    SetRasMode,             // arg0:RasMode
+    DrawIndexed,            // arg0:インデックス数 arg1:VertexShaderType
+    DrawInstanced,          // arg0:メッシュID arg1:インスタンス数
+    DrawDecal,              // arg0:メッシュID
+    DrawString,             // arg0:文字数
+    Max
+};
+
+// 記録したコマンド (コンパクトに 引数は種類ごとに意味が違う)
+struct RenderCommand
+{
+    RenderCommandType type; // 種類
+    uint32_t arg0;          // 引数1
+    uint32_t arg1;          // 引数2
+
+    RenderCommand() : type{ RenderCommandType::Max }, arg0{}, arg1{} {}
+    RenderCommand(RenderCommandType commandType, uint32_t argument0, uint32_t argument1) : type{ commandType }, arg0{ argument0 }, arg1{ argument1 } {}
+    ~RenderCommand() = default;
+};
+
+// 記録の統計 (renderの先頭でリセットする)
+struct NullRenderStats
+{
+    unsigned int draws;           // 描画コール数 (インスタンシングは1回)
+    unsigned int instances;       // 描画したインスタンス数
+    unsigned int stateChanges;    // 値が変わった状態の設定数
+    unsigned int redundantStates; // 同じ値なので省いた状態の設定数
+    size_t constantBytes;         // 送った定数のバイト数 (変わらないワールド行列とマテリアルは数えない)
+    size_t triangles;             // 描画した三角形数
+
+    NullRenderStats() : draws{}, instances{}, stateChanges{}, redundantStates{}, constantBytes{}, triangles{} {}
+    ~NullRenderStats() = default;
+};
+
+//----------------------------
+// 記録だけするレンダラー (デバイスもウィンドウも使わない 描画の流れとCPU側の手間を調べる用)
+//----------------------------
+class NullRenderer final : public RenderBackend
+{
+public:
+    NullRenderer() : m_hWnd{}, m_screenSize{}, m_screenMagnification{}, m_meshes{}, m_meshMutex{}, m_textures{}, m_texMutex{}, m_commands{}, m_stats{},
+        m_currentMesh{ ~0u }, m_currentTexture{ ~0u }, m_currentRasMode{ ~0u }, m_world{}, m_material{}, m_isWorldKnown{}, m_isMaterialKnown{},
+        m_postProcessMask{}, m_toneMappingType{}, m_shadowSettings{}, m_pointLights{}, m_lightClusters{}, m_dynamicResolution{}, m_drawList{}, m_cameraVisible{}, m_occlusionCuller{}, m_shadowVisible{}, m_staticShadowVisible{}, m_dynamicShadowVisible{}, m_staticShadowCache{}, m_instanceBatch{}, m_isRecording{ true },
+        m_textureResidency{}, m_residencyChanges{}, m_currentQueue{ RenderQueue::Max }, m_streamingViewProj{}, m_isStringBatchOpen{} {}
+    ~NullRenderer() override = default;
+
+    void init(HWND handle, long width, long height) override;
+    void uninit() override;
+    bool render(const Scene& scene, std::function<void()> guiRender, Renderer& inter) override;
+
+    bool uploadTextures(const TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback) override;
+
+    MeshHandle createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount) override;
+    MeshHandle createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount) override;
+    bool updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount) override;
+    void releaseMesh(const MeshHandle& handle) override;
+    bool setMesh(const MeshHandle& handle) override;
+    bool getMeshBounds(const MeshHandle& handle, AABB& outBounds) const override;
+    bool setTexture(const TextureHandle& handle) override;
+    bool setTransformWorld(const Matrix& matrix) override;
+    bool setTransformView(const Matrix& matrix) override;
+    bool setTransformProjection(const Matrix& matrix) override;
+    bool setCameraPosition(const Vector3& cameraPos) override;
+    bool setMaterial(const Material& material) override;
+    bool setLight(std::span<const LightData> lights, const Color& ambient) override;
+    bool setFog(const FogData& fog) override;
+    bool setBoneTransforms(std::span<const Matrix> boneTransforms) override;
+    void setOutlineData(Color color, float width) override;
+    void setPostProcessShaderMask(PostProcessShaderMask mask) override { m_postProcessMask = mask; }
+    void setToneMappingType(ToneMappingType type) override { m_toneMappingType = type; }
+    void setShadowSettings(const ShadowSettings& settings) override { m_shadowSettings = settings; m_staticShadowCache.invalidate(); }
+    void setTextureStreamingSettings(const TextureStreamingSettings& settings) override { m_textureResidency.setSettings(settings); }
+    void setOcclusionCullingSettings(const OcclusionCullingSettings& settings) override { m_occlusionCuller.setSettings(settings); }
+    void setDynamicResolutionSettings(const DynamicResolutionSettings& settings) override { m_dynamicResolution.setSettings(settings); }
+    void setRasMode(RasMode rasMode) override;
+    bool drawMesh(const MeshHandle& handle) override;
+    bool drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances) override;
+    bool drawIndexedPrimitive(VertexShaderType vertexShaderType, unsigned int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation) override;
+    void drawDecal(Matrix transform, const MeshHandle& handle, Color color) override;
+    void drawString(std::string_view string, Vector2 pos, Color color, float angle, Vector2 scale) override;
+
+    void onResize(int width, int height) override;
+
+    HWND getRegisteredHWND() const override { return m_hWnd; }
+    void getScreenSizeMagnification(Vector2& magnification) const override { magnification = m_screenMagnification; }
+    void getViewportSize(Vector2& size) const override { size = m_screenSize; }
+    void getStateStats(RenderStateStats& stats) const override;
+    void getTextureStreamingStats(TextureStreamingStats& stats) const override { m_textureResidency.getStats(stats); }
+    void getOcclusionCullingStats(OcclusionCullingStats& stats) const override { m_occlusionCuller.getStats(stats); }
+    void getDynamicResolutionStats(DynamicResolutionStats& stats) const override;
+
+    void setRecording(bool isRecording) { m_isRecording = isRecording; } // falseならコマンドは残さず統計だけ取る (ベンチマーク用)
+    void clear();
+    std::span<const RenderCommand> getCommands() const { return m_commands; }
+    void getStats(NullRenderStats& stats) const { stats = m_stats; }
+    const LightClusterGrid& getLightClusters() const { return m_lightClusters; } // 最後のカメラの点光源の振り分け (validateで全探索と比べられる)
+
+private:
+    // 登録されたメッシュ (頂点は持たない)
+    struct NullMesh
+    {
+        VertexShaderType type; // 頂点シェーダーの種類
+        size_t verticesCount;  // 頂点カウント
+        size_t indicesCount;   // インデックスカウント
+        bool isDynamic;        // CPUから頂点を書き換えるか
+        AABB bounds;           // ローカル空間の境界ボックス
+
+        NullMesh() : type{ VertexShaderType::Max }, verticesCount{}, indicesCount{}, isDynamic{}, bounds{} {}
+        ~NullMesh() = default;
+    };
+
+    void record(RenderCommandType type, uint32_t arg0 = 0u, uint32_t arg1 = 0u);
+    void addConstants(size_t size) { m_stats.constantBytes += size; }
+    bool changeState(uint32_t& current, uint32_t value);
+    bool findMesh(const MeshHandle& handle, NullMesh& outMesh) const;
+    void drawQueue(RenderQueue queue, Renderer& inter, std::span<const uint8_t> visible = {});
+    void beginQueue(RenderQueue queue, const Matrix& view, const Matrix& proj);
+    void requestTextureMips(VertexShaderType type, const AABB& bounds, const Matrix& world);
+
+    HWND m_hWnd;                   // 登録されたWindow (nullでもよい)
+    Vector2 m_screenSize;          // 画面サイズ
+    Vector2 m_screenMagnification; // 画面サイズ倍率
+
+    std::vector<NullMesh> m_meshes;                 // 登録されたメッシュ
+    mutable std::mutex m_meshMutex;                 // ↑のmutex (読み込みスレッドから登録される)
+    std::unordered_set<uint32_t> m_textures;        // 登録されたテクスチャID
+    mutable std::mutex m_texMutex;                  // ↑のmutex
+
+    std::vector<RenderCommand> m_commands;          // 記録したコマンド
+    NullRenderStats m_stats;                        // 統計 (renderの先頭から)
+
+    // 状態の影 (同じ値の設定を数え分ける)
+    uint32_t m_currentMesh;                         // 設定中のメッシュ
+    uint32_t m_currentTexture;                      // 設定中のテクスチャ
+    uint32_t m_currentRasMode;                      // 設定中のラスタライザー
+    Matrix m_world;                                 // 送ったワールド行列
+    Material m_material;                            // 送ったマテリアル
+    bool m_isWorldKnown;                            // ↑を送ったか
+    bool m_isMaterialKnown;                         //
+
+    PostProcessShaderMask m_postProcessMask;        // ポストプロセス (記録だけ)
+    ToneMappingType m_toneMappingType;              // 色調補正 (記録だけ)
+    ShadowSettings m_shadowSettings;                // 影の設定 (カスケードの分け方)
+    std::vector<LightData> m_pointLights;           // setLightで渡された点光源
+    LightClusterGrid m_lightClusters;               // 今のカメラの点光源の振り分け
+    DynamicResolution m_dynamicResolution;          // 動的解像度 (GPUの時間は測れないので割合は上限のまま)
+
+    // フレームの準備 (D3D11のバックエンドと同じ)
+    DrawList m_drawList;                            // カリングとソート済みの描画アイテム
+    std::vector<uint8_t> m_cameraVisible;           // カメラから見えるか
+    OcclusionCuller m_occlusionCuller;              // 遮蔽物の奥に隠れたものを除く
+    std::vector<uint8_t> m_shadowVisible;           // ライトから見えるか
+    std::vector<uint8_t> m_staticShadowVisible;     // ↑のうち動かない影
+    std::vector<uint8_t> m_dynamicShadowVisible;    // ↑のうち動く影
+    StaticShadowCache m_staticShadowCache;          // 動かない影のキャッシュの状態 (描いたことにする)
+    std::vector<InstanceData> m_instanceBatch;      // インスタンシングでまとめている途中のインスタンス
+    bool m_isRecording;                             // コマンドを残すか
+
+    // テクスチャストリーミング (読み込みは次のフレームにすぐ終わったことにする)
+    TextureResidency m_textureResidency;            // ミップの常駐管理
+    std::vector<TextureResidencyChange> m_residencyChanges; // このフレームの常駐の変更
+    RenderQueue m_currentQueue;                     // 描画中のキュー
+    Matrix m_streamingViewProj;                     // 画面上の大きさを測るカメラの View * Proj
+    bool m_isStringBatchOpen;                       // Stringキューの文字列を1回の描画にまとめている途中
+};
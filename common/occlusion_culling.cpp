@@ -0,0 +1,509 @@
+//--------------------------------------------
+//
+// オクルージョンカリング (CPUの深度バッファ) [occlusion_culling.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "occlusion_culling.h"
+#include <future>
+#include <immintrin.h> // SSE (4ピクセルずつ描く,8つの角を4つずつ変換する)
+
+namespace
+{
+    static_assert(occlusion::TILE_WIDTH % 4u == 0u, "SIMDで4ピクセルずつ描くのでタイルの幅は4の倍数");
+    static_assert((occlusion::TILE_WIDTH >> (occlusion::TILE_LEVELS - 1u)) > 0u && (occlusion::TILE_HEIGHT >> (occlusion::TILE_LEVELS - 1u)) > 0u, "タイルの中で作る段はタイルに収まる");
+    static_assert((occlusion::DEPTH_HEIGHT >> (occlusion::HIZ_LEVELS - 1u)) > 0u, "階層深度の一番粗い段が1ピクセル以上");
+
+    // 箱の面 (角の番号はbit0がX,bit1がY,bit2がZの最大側 外から見て時計回り)
+    constexpr std::array<std::array<uint8_t, 4>, 6> BOX_FACES =
+    { {
+        { 0, 2, 3, 1 }, // -Z
+        { 4, 5, 7, 6 }, // +Z
+        { 0, 4, 6, 2 }, // -X
+        { 1, 3, 7, 5 }, // +X
+        { 0, 1, 5, 4 }, // -Y
+        { 2, 6, 7, 3 }, // +Y
+    } };
+
+    //--------------
+    // 点をクリップ空間へ (行ベクトル × 行列)
+    //--------------
+    Vector4 TransformPoint(const Vector3& point, const Matrix& mat)
+    {
+        return Vector4(
+            point.x * mat.m[0][0] + point.y * mat.m[1][0] + point.z * mat.m[2][0] + mat.m[3][0],
+            point.x * mat.m[0][1] + point.y * mat.m[1][1] + point.z * mat.m[2][1] + mat.m[3][1],
+            point.x * mat.m[0][2] + point.y * mat.m[1][2] + point.z * mat.m[2][2] + mat.m[3][2],
+            point.x * mat.m[0][3] + point.y * mat.m[1][3] + point.z * mat.m[2][3] + mat.m[3][3]);
+    }
+
+    //--------------
+    // 箱の角 (番号のbitで最小側か最大側か)
+    //--------------
+    Vector3 BoxCorner(const AABB& box, unsigned int corner)
+    {
+        return Vector3((corner & 1u) ? box.max.x : box.min.x, (corner & 2u) ? box.max.y : box.min.y, (corner & 4u) ? box.max.z : box.min.z);
+    }
+
+    //--------------
+    // 4つの中の最小と最大
+    //--------------
+    float HorizontalMin(__m128 value)
+    {
+        value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+        value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(value);
+    }
+    float HorizontalMax(__m128 value)
+    {
+        value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+        value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(value);
+    }
+}
+
+//-------------------------------------------
+// 遮蔽物を深度バッファに描き,階層深度を作る (三角形をタイルに振り分け,タイルごとにスレッドへ分ける)
+//-------------------------------------------
+bool OcclusionCuller::build(const Matrix& viewProj, std::span<const OccluderBox> occluders, std::span<const uint8_t> visible, unsigned int maxThread)
+{
+    m_viewProj = viewProj;
+    m_stats = OcclusionCullingStats();
+    m_isReady = false;
+    m_triangles.clear();
+    for (auto& tile : m_tileTriangles)
+    {
+        tile.clear();
+    }
+    if (!m_settings.isEnabled)
+    {
+        return false;
+    }
+
+    // 画面に大きく映るものから選んで三角形にする
+    selectOccluders(occluders, visible);
+    for (const auto& candidate : m_candidates)
+    {
+        addBox(occluders[candidate.second]);
+    }
+    m_stats.occluders = static_cast<unsigned int>(m_candidates.size());
+    m_stats.triangles = static_cast<unsigned int>(m_triangles.size());
+    if (m_triangles.empty())
+    {
+        return false;
+    }
+
+    // 触れるタイルに振り分ける
+    for (uint32_t cnt = 0; cnt < m_triangles.size(); ++cnt)
+    {
+        const Triangle& triangle = m_triangles[cnt];
+        for (int tileY = triangle.minY / int(occlusion::TILE_HEIGHT); tileY <= triangle.maxY / int(occlusion::TILE_HEIGHT); ++tileY)
+        {
+            for (int tileX = triangle.minX / int(occlusion::TILE_WIDTH); tileX <= triangle.maxX / int(occlusion::TILE_WIDTH); ++tileX)
+            {
+                m_tileTriangles[size_t(tileY) * occlusion::TILE_COUNT_X + size_t(tileX)].push_back(cnt);
+            }
+        }
+    }
+
+    for (unsigned int level = 0; level < occlusion::HIZ_LEVELS; ++level)
+    {
+        m_levels[level].resize(size_t(occlusion::DEPTH_WIDTH >> level) * (occlusion::DEPTH_HEIGHT >> level));
+    }
+
+    // タイルは別々のピクセルなのでスレッド間で書き込みは重ならない
+    unsigned int threadCount = (m_triangles.size() >= occlusion::MIN_PARALLEL_TRIANGLES) ? std::clamp(maxThread, 1u, occlusion::TILE_COUNT) : 1u;
+    unsigned int tilesPerThread = (occlusion::TILE_COUNT + threadCount - 1u) / threadCount;
+    {// 先頭以外をワーカーに任せて呼び出し側は先頭を描く (抜けるときに全部待つ)
+        std::vector<std::future<void>> tasks;
+        tasks.reserve(threadCount);
+        for (unsigned int thread = 1; thread < threadCount; ++thread)
+        {
+            unsigned int first = thread * tilesPerThread;
+            if (first < occlusion::TILE_COUNT)
+            {
+                tasks.push_back(std::async(std::launch::async, [this, first, tilesPerThread]() { rasterizeTiles(first, std::min(first + tilesPerThread, occlusion::TILE_COUNT)); }));
+            }
+        }
+        rasterizeTiles(0u, std::min(tilesPerThread, occlusion::TILE_COUNT));
+        for (auto& task : tasks)
+        {
+            task.get();
+        }
+    }
+
+    // タイルより粗い段
+    for (unsigned int level = occlusion::TILE_LEVELS; level < occlusion::HIZ_LEVELS; ++level)
+    {
+        reduceLevel(level, 0u, 0u, occlusion::DEPTH_WIDTH >> level, occlusion::DEPTH_HEIGHT >> level);
+    }
+
+    m_isReady = true;
+    return true;
+}
+
+//-------------------------------------------
+// 見えているものから隠れているものを除く (除いた数を返す)
+//-------------------------------------------
+size_t OcclusionCuller::cull(const CullBounds& bounds, std::vector<uint8_t>& inoutVisible)
+{
+    m_stats.tested = 0u;
+    m_stats.culled = 0u;
+    if (!m_isReady)
+    {
+        return 0u;
+    }
+
+    size_t count = std::min(bounds.size(), inoutVisible.size());
+    for (size_t cnt = 0; cnt < count; ++cnt)
+    {
+        if (inoutVisible[cnt] == 0u || bounds.extentX[cnt] >= draw::UNBOUNDED_EXTENT)
+        {
+            continue;
+        }
+
+        ++m_stats.tested;
+        Vector3 center(bounds.centerX[cnt], bounds.centerY[cnt], bounds.centerZ[cnt]), extent(bounds.extentX[cnt], bounds.extentY[cnt], bounds.extentZ[cnt]);
+        if (isOccluded(center, extent))
+        {
+            inoutVisible[cnt] = 0u;
+            ++m_stats.culled;
+        }
+    }
+    return m_stats.culled;
+}
+
+//-------------------------------------------
+// 境界ボックスが遮蔽物の奥に隠れているか (触れるテクセルが8x8以下になる段で,一番手前の角が全テクセルより奥なら隠れている)
+//-------------------------------------------
+bool OcclusionCuller::isOccluded(const Vector3& center, const Vector3& extent) const
+{
+    if (!m_isReady)
+    {
+        return false;
+    }
+
+    // 8つの角を4つずつクリップ空間へ
+    const Matrix& mat = m_viewProj;
+    const __m128 zero = _mm_setzero_ps();
+    __m128 pointX = _mm_add_ps(_mm_set1_ps(center.x), _mm_mul_ps(_mm_set1_ps(extent.x), _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f)));
+    __m128 pointY = _mm_add_ps(_mm_set1_ps(center.y), _mm_mul_ps(_mm_set1_ps(extent.y), _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f)));
+    __m128 minX = _mm_set1_ps(FLT_MAX), minY = minX, minZ = minX;
+    __m128 maxX = _mm_set1_ps(-FLT_MAX), maxY = maxX;
+    for (float sign : { -1.0f, 1.0f })
+    {
+        __m128 pointZ = _mm_set1_ps(center.z + extent.z * sign);
+        auto transformColumn = [&](int column)
+            {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(pointX, _mm_set1_ps(mat.m[0][column])), _mm_mul_ps(pointY, _mm_set1_ps(mat.m[1][column]))),
+                    _mm_add_ps(_mm_mul_ps(pointZ, _mm_set1_ps(mat.m[2][column])), _mm_set1_ps(mat.m[3][column])));
+            };
+        __m128 clipX = transformColumn(0), clipY = transformColumn(1), clipZ = transformColumn(2), clipW = transformColumn(3);
+
+        // 手前の面をまたぐものは判定しない (見えることにする)
+        if (_mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(clipZ, zero), _mm_cmple_ps(clipW, zero))) != 0)
+        {
+            return false;
+        }
+
+        __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), clipW);
+        __m128 ndcX = _mm_mul_ps(clipX, invW), ndcY = _mm_mul_ps(clipY, invW);
+        minX = _mm_min_ps(minX, ndcX); maxX = _mm_max_ps(maxX, ndcX);
+        minY = _mm_min_ps(minY, ndcY); maxY = _mm_max_ps(maxY, ndcY);
+        minZ = _mm_min_ps(minZ, _mm_mul_ps(clipZ, invW));
+    }
+    float nearest = HorizontalMin(minZ);
+
+    // 触れるピクセルの範囲 (画面の外は見えることにする)
+    int pixelMinX = static_cast<int>(std::floor((HorizontalMin(minX) * 0.5f + 0.5f) * occlusion::DEPTH_WIDTH));
+    int pixelMaxX = static_cast<int>(std::floor((HorizontalMax(maxX) * 0.5f + 0.5f) * occlusion::DEPTH_WIDTH));
+    int pixelMinY = static_cast<int>(std::floor((0.5f - HorizontalMax(maxY) * 0.5f) * occlusion::DEPTH_HEIGHT));
+    int pixelMaxY = static_cast<int>(std::floor((0.5f - HorizontalMin(minY) * 0.5f) * occlusion::DEPTH_HEIGHT));
+    if (pixelMaxX < 0 || pixelMaxY < 0 || pixelMinX >= int(occlusion::DEPTH_WIDTH) || pixelMinY >= int(occlusion::DEPTH_HEIGHT))
+    {
+        return false;
+    }
+    pixelMinX = std::max(pixelMinX, 0); pixelMaxX = std::min(pixelMaxX, int(occlusion::DEPTH_WIDTH) - 1);
+    pixelMinY = std::max(pixelMinY, 0); pixelMaxY = std::min(pixelMaxY, int(occlusion::DEPTH_HEIGHT) - 1);
+
+    // 見るテクセルが少なくなる段を選ぶ
+    unsigned int level = 0u;
+    while (level + 1u < occlusion::HIZ_LEVELS &&
+        ((pixelMaxX >> level) - (pixelMinX >> level) + 1 > int(occlusion::MAX_TEST_TEXELS) || (pixelMaxY >> level) - (pixelMinY >> level) + 1 > int(occlusion::MAX_TEST_TEXELS)))
+    {
+        ++level;
+    }
+
+    const std::vector<float>& depth = m_levels[level];
+    size_t width = occlusion::DEPTH_WIDTH >> level;
+    for (int y = pixelMinY >> level; y <= (pixelMaxY >> level); ++y)
+    {
+        for (int x = pixelMinX >> level; x <= (pixelMaxX >> level); ++x)
+        {
+            if (nearest <= depth[size_t(y) * width + size_t(x)] + occlusion::DEPTH_BIAS)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------
+// 階層深度の値 (確認用 描いていなければ一番奥)
+//-------------------------------------------
+float OcclusionCuller::getDepth(unsigned int level, unsigned int x, unsigned int y) const
+{
+    if (!m_isReady || level >= occlusion::HIZ_LEVELS || x >= (occlusion::DEPTH_WIDTH >> level) || y >= (occlusion::DEPTH_HEIGHT >> level))
+    {
+        return 1.0f;
+    }
+    return m_levels[level][size_t(y) * (occlusion::DEPTH_WIDTH >> level) + x];
+}
+
+//-------------------------------------------
+// 遮蔽物を選ぶ (カメラから見えていて,画面に占める割合が下限以上のものを大きい順に上限まで)
+//-------------------------------------------
+void OcclusionCuller::selectOccluders(std::span<const OccluderBox> occluders, std::span<const uint8_t> visible)
+{
+    m_candidates.clear();
+    for (uint32_t cnt = 0; cnt < occluders.size(); ++cnt)
+    {
+        const OccluderBox& occluder = occluders[cnt];
+        if (occluder.index >= visible.size() || visible[occluder.index] == 0u)
+        {
+            continue;
+        }
+
+        // 角の画面上の範囲 (手前の面をまたぐものはカメラの目の前にあるので一番大きいことにする)
+        Matrix toClip = Matrix::Multiply(occluder.world, m_viewProj);
+        float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f;
+        bool isNear = false;
+        for (unsigned int corner = 0; corner < 8u && !isNear; ++corner)
+        {
+            Vector4 clip = TransformPoint(BoxCorner(occluder.local, corner), toClip);
+            if (clip.z < 0.0f || clip.w <= 0.0f)
+            {
+                isNear = true;
+                break;
+            }
+            minX = std::min(minX, clip.x / clip.w); maxX = std::max(maxX, clip.x / clip.w);
+            minY = std::min(minY, clip.y / clip.w); maxY = std::max(maxY, clip.y / clip.w);
+        }
+
+        float area = isNear ? 1.0f : (std::clamp(maxX, -1.0f, 1.0f) - std::clamp(minX, -1.0f, 1.0f)) * (std::clamp(maxY, -1.0f, 1.0f) - std::clamp(minY, -1.0f, 1.0f)) * 0.25f;
+        if (area >= m_settings.minOccluderArea)
+        {
+            m_candidates.emplace_back(area, cnt);
+        }
+    }
+
+    if (m_candidates.size() > m_settings.maxOccluders)
+    {
+        auto nth = m_candidates.begin() + m_settings.maxOccluders;
+        std::nth_element(m_candidates.begin(), nth, m_candidates.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        m_candidates.erase(nth, m_candidates.end());
+    }
+}
+
+//-------------------------------------------
+// 箱の面を三角形にする
+//-------------------------------------------
+void OcclusionCuller::addBox(const OccluderBox& occluder)
+{
+    Matrix toClip = Matrix::Multiply(occluder.world, m_viewProj);
+    std::array<Vector4, 8> corners{};
+    for (unsigned int corner = 0; corner < corners.size(); ++corner)
+    {
+        corners[corner] = TransformPoint(BoxCorner(occluder.local, corner), toClip);
+    }
+
+    for (const auto& face : BOX_FACES)
+    {
+        addTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+        addTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+    }
+}
+
+//-------------------------------------------
+// クリップ空間の三角形を手前の面 (z = 0) で切って画面へ
+//-------------------------------------------
+void OcclusionCuller::addTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2)
+{
+    std::array<const Vector4*, 3> vertices{ &v0, &v1, &v2 };
+    std::array<Vector4, 4> polygon{};
+    size_t count = 0u;
+    for (size_t cnt = 0; cnt < vertices.size(); ++cnt)
+    {
+        const Vector4& a = *vertices[cnt];
+        const Vector4& b = *vertices[(cnt + 1u) % vertices.size()];
+        bool isInsideA = a.z >= 0.0f, isInsideB = b.z >= 0.0f;
+        if (isInsideA)
+        {
+            polygon[count++] = a;
+        }
+        if (isInsideA != isInsideB)
+        {
+            polygon[count++] = a + (b - a) * (a.z / (a.z - b.z));
+        }
+    }
+    if (count < 3u)
+    {
+        return;
+    }
+
+    std::array<Vector3, 4> screen{};
+    for (size_t cnt = 0; cnt < count; ++cnt)
+    {
+        const Vector4& clip = polygon[cnt];
+        if (clip.w <= 0.0f)
+        {
+            return;
+        }
+        float invW = 1.0f / clip.w;
+        screen[cnt] = Vector3((clip.x * invW * 0.5f + 0.5f) * occlusion::DEPTH_WIDTH, (0.5f - clip.y * invW * 0.5f) * occlusion::DEPTH_HEIGHT, clip.z * invW);
+    }
+
+    setupTriangle(screen[0], screen[1], screen[2]);
+    if (count == 4u)
+    {
+        setupTriangle(screen[0], screen[2], screen[3]);
+    }
+}
+
+//-------------------------------------------
+// 画面上の三角形の辺と深度の式を作る (裏向き,面積がない,ピクセルの中心に触れないものは捨てる)
+//-------------------------------------------
+void OcclusionCuller::setupTriangle(const Vector3& s0, const Vector3& s1, const Vector3& s2)
+{
+    // 画面はYが下向きなので外から見て時計回りの面は面積が正
+    float area = (s1.x - s0.x) * (s2.y - s0.y) - (s2.x - s0.x) * (s1.y - s0.y);
+    if (area <= FLT_EPSILON)
+    {
+        return;
+    }
+
+    // ピクセルの中心で判定するので範囲は中心が入るピクセル
+    Triangle triangle{};
+    triangle.minX = std::max(static_cast<int>(std::ceil(std::min({ s0.x, s1.x, s2.x }) - 0.5f)), 0);
+    triangle.minY = std::max(static_cast<int>(std::ceil(std::min({ s0.y, s1.y, s2.y }) - 0.5f)), 0);
+    triangle.maxX = std::min(static_cast<int>(std::floor(std::max({ s0.x, s1.x, s2.x }) - 0.5f)), int(occlusion::DEPTH_WIDTH) - 1);
+    triangle.maxY = std::min(static_cast<int>(std::floor(std::max({ s0.y, s1.y, s2.y }) - 0.5f)), int(occlusion::DEPTH_HEIGHT) - 1);
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+    {
+        return;
+    }
+
+    // 辺 (a,b) の式 内側が正
+    std::array<const Vector3*, 3> vertices{ &s0, &s1, &s2 };
+    for (size_t cnt = 0; cnt < vertices.size(); ++cnt)
+    {
+        const Vector3& a = *vertices[cnt];
+        const Vector3& b = *vertices[(cnt + 1u) % vertices.size()];
+        triangle.edgeA[cnt] = a.y - b.y;
+        triangle.edgeB[cnt] = b.x - a.x;
+        triangle.edgeC[cnt] = a.x * b.y - a.y * b.x;
+    }
+
+    // 深度の平面 (z/wは画面上で線形)
+    float invArea = 1.0f / area;
+    triangle.depthA = ((s1.z - s0.z) * (s2.y - s0.y) - (s2.z - s0.z) * (s1.y - s0.y)) * invArea;
+    triangle.depthB = ((s2.z - s0.z) * (s1.x - s0.x) - (s1.z - s0.z) * (s2.x - s0.x)) * invArea;
+    triangle.depthC = s0.z - triangle.depthA * s0.x - triangle.depthB * s0.y;
+
+    m_triangles.push_back(triangle);
+}
+
+//-------------------------------------------
+// タイルを描いてタイルの中の段を作る
+//-------------------------------------------
+void OcclusionCuller::rasterizeTiles(unsigned int firstTile, unsigned int lastTile)
+{
+    for (unsigned int tile = firstTile; tile < lastTile; ++tile)
+    {
+        unsigned int tileMinX = (tile % occlusion::TILE_COUNT_X) * occlusion::TILE_WIDTH;
+        unsigned int tileMinY = (tile / occlusion::TILE_COUNT_X) * occlusion::TILE_HEIGHT;
+
+        // 一番奥で埋める
+        for (unsigned int y = tileMinY; y < tileMinY + occlusion::TILE_HEIGHT; ++y)
+        {
+            float* pRow = &m_levels[0][size_t(y) * occlusion::DEPTH_WIDTH + tileMinX];
+            std::fill(pRow, pRow + occlusion::TILE_WIDTH, 1.0f);
+        }
+
+        for (uint32_t index : m_tileTriangles[tile])
+        {
+            rasterizeTriangle(m_triangles[index], int(tileMinX), int(tileMinY), int(tileMinX + occlusion::TILE_WIDTH) - 1, int(tileMinY + occlusion::TILE_HEIGHT) - 1);
+        }
+
+        for (unsigned int level = 1; level < occlusion::TILE_LEVELS; ++level)
+        {
+            reduceLevel(level, tileMinX >> level, tileMinY >> level, (tileMinX + occlusion::TILE_WIDTH) >> level, (tileMinY + occlusion::TILE_HEIGHT) >> level);
+        }
+    }
+}
+
+//-------------------------------------------
+// 三角形のタイルに入る部分を描く (4ピクセルずつ 中心が内側なら手前の深度を残す)
+//-------------------------------------------
+void OcclusionCuller::rasterizeTriangle(const Triangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+    int minX = std::max(triangle.minX, tileMinX) & ~3; // タイルの左端は4の倍数なので揃えてもタイルからはみ出ない
+    int maxX = std::min(triangle.maxX, tileMaxX);
+    int minY = std::max(triangle.minY, tileMinY);
+    int maxY = std::min(triangle.maxY, tileMaxY);
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]), edgeA1 = _mm_set1_ps(triangle.edgeA[1]), edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+    const __m128 depthA = _mm_set1_ps(triangle.depthA);
+    float* pDepth = m_levels[0].data();
+    for (int y = minY; y <= maxY; ++y)
+    {
+        float centerY = static_cast<float>(y) + 0.5f;
+        __m128 row0 = _mm_set1_ps(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+        __m128 row1 = _mm_set1_ps(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+        __m128 row2 = _mm_set1_ps(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+        __m128 rowDepth = _mm_set1_ps(triangle.depthB * centerY + triangle.depthC);
+        for (int x = minX; x <= maxX; x += 4)
+        {
+            __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffset);
+            __m128 inside = _mm_and_ps(_mm_and_ps(
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, centerX), row0), zero),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, centerX), row1), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, centerX), row2), zero));
+            if (_mm_movemask_ps(inside) == 0)
+            {
+                continue;
+            }
+
+            float* pPixel = pDepth + size_t(y) * occlusion::DEPTH_WIDTH + size_t(x);
+            __m128 current = _mm_loadu_ps(pPixel);
+            __m128 depth = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth));
+            _mm_storeu_ps(pPixel, _mm_or_ps(_mm_and_ps(inside, depth), _mm_andnot_ps(inside, current)));
+        }
+    }
+}
+
+//-------------------------------------------
+// 1つ下の段の2x2の一番奥を取る (範囲はこの段の座標 終わりは含まない)
+//-------------------------------------------
+void OcclusionCuller::reduceLevel(unsigned int level, unsigned int minX, unsigned int minY, unsigned int maxX, unsigned int maxY)
+{
+    const std::vector<float>& source = m_levels[level - 1u];
+    std::vector<float>& target = m_levels[level];
+    size_t sourceWidth = occlusion::DEPTH_WIDTH >> (level - 1u), targetWidth = occlusion::DEPTH_WIDTH >> level;
+    for (unsigned int y = minY; y < maxY; ++y)
+    {
+        const float* pRow0 = &source[size_t(y) * 2u * sourceWidth];
+        const float* pRow1 = pRow0 + sourceWidth;
+        for (unsigned int x = minX; x < maxX; ++x)
+        {
+            target[size_t(y) * targetWidth + x] = std::max(std::max(pRow0[x * 2u], pRow0[x * 2u + 1u]), std::max(pRow1[x * 2u], pRow1[x * 2u + 1u]));
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//--------------------------------------------
+//
+// オクルージョンカリング (CPUの深度バッファ) [occlusion_culling.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // OcclusionCullingSettings, OcclusionCullingStats
+#include "draw_list.h"      // CullBounds, OccluderBox
+
+namespace occlusion
+{
+    // 深度バッファ (画面全体をこの解像度で扱う 値はクリップ空間のz/w 何も描かれていなければ1)
+    constexpr unsigned int DEPTH_WIDTH = 256u;
+    constexpr unsigned int DEPTH_HEIGHT = 128u;
+    constexpr unsigned int TILE_WIDTH = 32u;                                // 三角形を振り分けるタイル (スレッドはタイル単位で描く)
+    constexpr unsigned int TILE_HEIGHT = 16u;                               //
+    constexpr unsigned int TILE_COUNT_X = DEPTH_WIDTH / TILE_WIDTH;
+    constexpr unsigned int TILE_COUNT_Y = DEPTH_HEIGHT / TILE_HEIGHT;
+    constexpr unsigned int TILE_COUNT = TILE_COUNT_X * TILE_COUNT_Y;
+    constexpr unsigned int TILE_LEVELS = 5u;                                // タイルの中で作る階層の数 (32x16から2x1まで)
+    constexpr unsigned int HIZ_LEVELS = 8u;                                 // 階層深度の段数 (256x128から2x1まで 各段は下の段の2x2の一番奥)
+    constexpr unsigned int MAX_TEST_TEXELS = 8u;                            // 判定で見る1辺のテクセル数 (これ以下になる粗い段で見る)
+    constexpr float DEPTH_BIAS = 1.0e-5f;                                   // 遮蔽物が自分の境界ボックスを隠さないための余裕 (z/w)
+    constexpr size_t MIN_PARALLEL_TRIANGLES = 256u;                         // これ以上の三角形ならタイルをスレッドに分ける
+}
+
+//----------------------------
+// オクルージョンカリング (遮蔽物の箱を小さな深度バッファに描き,境界ボックスが全部その奥にあるものを除く)
+//----------------------------
+class OcclusionCuller
+{
+public:
+    OcclusionCuller() : m_viewProj{}, m_settings{}, m_candidates{}, m_triangles{}, m_tileTriangles{}, m_levels{}, m_stats{}, m_isReady{} {}
+    ~OcclusionCuller() = default;
+
+    void setSettings(const OcclusionCullingSettings& settings) { m_settings = settings; }
+    const OcclusionCullingSettings& getSettings() const { return m_settings; }
+    void getStats(OcclusionCullingStats& stats) const { stats = m_stats; }
+
+    bool build(const Matrix& viewProj, std::span<const OccluderBox> occluders, std::span<const uint8_t> visible, unsigned int maxThread);
+    size_t cull(const CullBounds& bounds, std::vector<uint8_t>& inoutVisible);
+    bool isOccluded(const Vector3& center, const Vector3& extent) const;
+    float getDepth(unsigned int level, unsigned int x, unsigned int y) const;
+
+private:
+    // 画面上の三角形 (辺の式は内側が正 深度は画面の平面)
+    struct Triangle
+    {
+        std::array<float, 3> edgeA, edgeB, edgeC; // 辺の式 a*x + b*y + c
+        float depthA, depthB, depthC;             // 深度の平面 a*x + b*y + c
+        int minX, minY, maxX, maxY;               // 画面上の範囲 (ピクセル 両端を含む)
+
+        Triangle() : edgeA{}, edgeB{}, edgeC{}, depthA{}, depthB{}, depthC{}, minX{}, minY{}, maxX{}, maxY{} {}
+        ~Triangle() = default;
+    };
+
+    void selectOccluders(std::span<const OccluderBox> occluders, std::span<const uint8_t> visible);
+    void addBox(const OccluderBox& occluder);
+    void addTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2);
+    void setupTriangle(const Vector3& s0, const Vector3& s1, const Vector3& s2);
+    void rasterizeTiles(unsigned int firstTile, unsigned int lastTile);
+    void rasterizeTriangle(const Triangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+    void reduceLevel(unsigned int level, unsigned int minX, unsigned int minY, unsigned int maxX, unsigned int maxY);
+
+    Matrix m_viewProj;                                                    // 描いたカメラの View * Proj
+    OcclusionCullingSettings m_settings;                                  // 設定
+    std::vector<std::pair<float, uint32_t>> m_candidates;                 // 遮蔽物の候補 (画面に占める割合と番号)
+    std::vector<Triangle> m_triangles;                                    // 遮蔽物の三角形 (手前で切った後 表だけ)
+    std::array<std::vector<uint32_t>, occlusion::TILE_COUNT> m_tileTriangles; // タイルごとの三角形番号
+    std::array<std::vector<float>, occlusion::HIZ_LEVELS> m_levels;        // 階層深度 (0段目が深度バッファ)
+    OcclusionCullingStats m_stats;                                        // 統計
+    bool m_isReady;                                                       // 遮蔽物を描いたか (描いていなければ何も除かない)
+};
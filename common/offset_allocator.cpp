@@ -0,0 +1,160 @@
+//--------------------------------------------
+//
+// 範囲の割り当て (大きなバッファを要素単位で貸し出す) [offset_allocator.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "offset_allocator.h"
+#include <algorithm>
+
+namespace
+{
+    // 位置で並べる
+    bool LessOffset(const OffsetAllocator::Range& range, uint32_t offset)
+    {
+        return range.offset < offset;
+    }
+}
+
+//-------------------------------------------
+// 全部空きにする
+//-------------------------------------------
+void OffsetAllocator::reset(uint32_t capacity)
+{
+    m_capacity = capacity;
+    m_usedSize = 0u;
+    m_freeRanges.clear();
+    m_liveRanges.clear();
+    if (capacity > 0u)
+    {
+        m_freeRanges.emplace_back(0u, capacity);
+    }
+}
+
+//-------------------------------------------
+// 割り当て (一番ぴったりの空きから 同じなら前の方)
+//-------------------------------------------
+uint32_t OffsetAllocator::allocate(uint32_t size)
+{
+    if (size == 0u)
+    {
+        return NO_OFFSET;
+    }
+
+    auto best = m_freeRanges.end();
+    for (auto itr = m_freeRanges.begin(); itr != m_freeRanges.end(); ++itr)
+    {
+        if (itr->size >= size && (best == m_freeRanges.end() || itr->size < best->size))
+        {
+            best = itr;
+            if (best->size == size) break;
+        }
+    }
+    if (best == m_freeRanges.end())
+    {
+        return NO_OFFSET;
+    }
+
+    uint32_t offset = best->offset;
+    if (best->size == size)
+    {
+        m_freeRanges.erase(best);
+    }
+    else
+    {
+        best->offset += size;
+        best->size -= size;
+    }
+
+    m_liveRanges.insert(std::lower_bound(m_liveRanges.begin(), m_liveRanges.end(), offset, LessOffset), Range(offset, size));
+    m_usedSize += size;
+    return offset;
+}
+
+//-------------------------------------------
+// 返す (前後の空きとつなげる 知らない位置ならfalse)
+//-------------------------------------------
+bool OffsetAllocator::release(uint32_t offset)
+{
+    auto live = std::lower_bound(m_liveRanges.begin(), m_liveRanges.end(), offset, LessOffset);
+    if (live == m_liveRanges.end() || live->offset != offset)
+    {
+        return false;
+    }
+    Range range = *live;
+    m_liveRanges.erase(live);
+    m_usedSize -= range.size;
+
+    auto next = std::lower_bound(m_freeRanges.begin(), m_freeRanges.end(), range.offset, LessOffset);
+    bool isJoinPrev = next != m_freeRanges.begin() && std::prev(next)->offset + std::prev(next)->size == range.offset;
+    bool isJoinNext = next != m_freeRanges.end() && range.offset + range.size == next->offset;
+
+    if (isJoinPrev && isJoinNext)
+    {
+        std::prev(next)->size += range.size + next->size;
+        m_freeRanges.erase(next);
+    }
+    else if (isJoinPrev)
+    {
+        std::prev(next)->size += range.size;
+    }
+    else if (isJoinNext)
+    {
+        next->offset = range.offset;
+        next->size += range.size;
+    }
+    else
+    {
+        m_freeRanges.insert(next, range);
+    }
+    return true;
+}
+
+//-------------------------------------------
+// 詰め直す (貸し出し中を前から隙間なく並べ,空きを最後の1つにする 全範囲の移動を返す)
+//-------------------------------------------
+void OffsetAllocator::defragment(std::vector<Move>& outMoves)
+{
+    outMoves.clear();
+    outMoves.reserve(m_liveRanges.size());
+
+    uint32_t offset = 0u;
+    for (auto& range : m_liveRanges)
+    {
+        outMoves.emplace_back(range.offset, offset, range.size);
+        range.offset = offset;
+        offset += range.size;
+    }
+
+    m_freeRanges.clear();
+    if (offset < m_capacity)
+    {
+        m_freeRanges.emplace_back(offset, m_capacity - offset);
+    }
+}
+
+//-------------------------------------------
+// 一番大きい空き
+//-------------------------------------------
+uint32_t OffsetAllocator::getLargestFreeSize() const
+{
+    uint32_t largest = 0u;
+    for (const auto& range : m_freeRanges)
+    {
+        largest = std::max(largest, range.size);
+    }
+    return largest;
+}
+
+//-------------------------------------------
+// 断片化の度合い (0なら空きが1つにまとまっている 1に近いほど細切れ)
+//-------------------------------------------
+float OffsetAllocator::getFragmentation() const
+{
+    uint32_t freeSize = getFreeSize();
+    if (freeSize == 0u)
+    {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(getLargestFreeSize()) / static_cast<float>(freeSize);
+}
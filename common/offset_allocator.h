@@ -0,0 +1,64 @@
+//--------------------------------------------
+//
+// 範囲の割り当て (大きなバッファを要素単位で貸し出す) [offset_allocator.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//----------------------------
+// 範囲の割り当て (空きは位置順に持ち,返された範囲は隣と結合する GPUには触らない)
+//----------------------------
+class OffsetAllocator
+{
+public:
+    static constexpr uint32_t NO_OFFSET = ~0u; // 割り当てられなかった
+
+    // 範囲
+    struct Range
+    {
+        uint32_t offset; // 先頭 (要素単位)
+        uint32_t size;   // 要素数
+
+        Range() : offset{}, size{} {}
+        Range(uint32_t rangeOffset, uint32_t rangeSize) : offset{ rangeOffset }, size{ rangeSize } {}
+        ~Range() = default;
+    };
+
+    // 詰め直しの移動 (from == to でも新しいバッファには写す)
+    struct Move
+    {
+        uint32_t from; // 元の先頭
+        uint32_t to;   // 新しい先頭
+        uint32_t size; // 要素数
+
+        Move() : from{}, to{}, size{} {}
+        Move(uint32_t fromOffset, uint32_t toOffset, uint32_t moveSize) : from{ fromOffset }, to{ toOffset }, size{ moveSize } {}
+        ~Move() = default;
+    };
+
+    OffsetAllocator() : m_capacity{}, m_usedSize{}, m_freeRanges{}, m_liveRanges{} {}
+    explicit OffsetAllocator(uint32_t capacity) : OffsetAllocator() { reset(capacity); }
+    ~OffsetAllocator() = default;
+
+    void reset(uint32_t capacity);
+    uint32_t allocate(uint32_t size);
+    bool release(uint32_t offset);
+    void defragment(std::vector<Move>& outMoves);
+
+    uint32_t getCapacity() const { return m_capacity; }
+    uint32_t getUsedSize() const { return m_usedSize; }
+    uint32_t getFreeSize() const { return m_capacity - m_usedSize; }
+    uint32_t getLargestFreeSize() const;
+    size_t getAllocationCount() const { return m_liveRanges.size(); }
+    float getFragmentation() const;
+
+private:
+    uint32_t m_capacity;             // 全体の要素数
+    uint32_t m_usedSize;             // 貸し出している要素数
+    std::vector<Range> m_freeRanges; // 空き (位置順 隣り合うものはない)
+    std::vector<Range> m_liveRanges; // 貸し出し中 (位置順)
+};
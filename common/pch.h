@@ -30,6 +30,8 @@
 #include <d3d11.h>
 #pragma comment(lib, "d3d11.lib")
 
+#include "hash.h" // Hash (D3Dを使わないヘッダーからも使う)
+
 #define STR(var) #var
 
 // string -> wstring
@@ -87,25 +89,3 @@ inline std::string ToUtf8String(const std::filesystem::path& p)
     auto u8 = p.u8string();
     return std::string(u8.begin(), u8.end());
 }
-
-constexpr uint64_t Hash(const char* str)
-{
-    uint64_t h = 2166136261u; // FNV-1a
-    while (*str)
-    {
-        h ^= static_cast<uint8_t>(*str++);
-        h *= 16777619u;
-    }
-    return h;
-}
-
-constexpr uint64_t Hash(const char8_t* str)
-{
-    uint64_t h = 2166136261u; // FNV-1a
-    while (*str)
-    {
-        h ^= static_cast<uint8_t>(*str++);
-        h *= 16777619u;
-    }
-    return h;
-}
@@ -7,11 +7,40 @@
 #pragma once
 #include "render.h"
 #include "renderer.h"
+#include "object.h"
+#include "trans_comp.h"
 
 //----------------------------
 // 
 // 描画用コンポーネントクラス
 // 
 //----------------------------
-RenderComponent::RenderComponent(const RenderQueue& renderQueue, const RasMode& rasMode) : m_renderQueue(renderQueue), m_rasMode(rasMode){}
+RenderComponent::RenderComponent(const RenderQueue& renderQueue, const RasMode& rasMode) : m_renderQueue(renderQueue), m_rasMode(rasMode), m_isStaticCaster{}, m_isOccluder{} {}
 RenderComponent::~RenderComponent() = default;
+
+//----------------------------
+// ソート用の位置 (奥行きの計算に使う)
+//----------------------------
+bool RenderComponent::getSortPosition(Vector3& outPosition)
+{
+    auto comps = getOwner().Get<TransformComponent>();
+    if (comps.size() != 1)
+    {
+        return false;
+    }
+    outPosition = comps[0]->get().position;
+    return true;
+}
+
+//----------------------------
+// オーナーのTransformの変更回数 (影のキャッシュを作り直すかの判定に使う)
+//----------------------------
+uint32_t RenderComponent::getTransformVersion()
+{
+    auto comps = getOwner().Get<TransformComponent>();
+    if (comps.size() != 1)
+    {
+        return 0u;
+    }
+    return comps[0]->getVersion();
+}
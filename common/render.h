@@ -8,6 +8,19 @@
 #include "component.h"
 #include "graphics_types.h"
 
+// インスタンシング描画の情報 (メッシュ,マテリアル,テクスチャ,ラスタライザーが同じものはまとめて描画される)
+struct InstanceDrawDesc
+{
+    MeshHandle mesh;       // メッシュ
+    Material material;     // マテリアル
+    TextureHandle texture; // テクスチャ
+    RasMode rasMode;       // ラスタライザー
+    InstanceData instance; // ワールド行列と色
+
+    InstanceDrawDesc() : mesh{}, material{}, texture{}, rasMode{ RasMode::Back }, instance{} {}
+    ~InstanceDrawDesc() = default;
+};
+
 //-------------------------------------
 // 描画用コンポーネントクラス [抽象]
 //-------------------------------------
@@ -18,13 +31,25 @@ public:
     virtual ~RenderComponent();
 
     virtual void render(Renderer& renderer) override = 0;
+    virtual DrawKeyState getDrawKeyState() const { return DrawKeyState(); }
+    virtual bool getSortPosition(Vector3& outPosition);
+    virtual bool getWorldBounds(const Renderer& /*renderer*/, AABB& /*outBounds*/) { return false; } // falseならカリングしない
+    virtual bool getInstanceDraw(InstanceDrawDesc& /*outDesc*/) { return false; }                    // falseならrenderで1つずつ描画する
+    virtual bool getOccluderBox(const Renderer& /*renderer*/, Matrix& /*outWorld*/, AABB& /*outLocal*/) { return false; } // 遮蔽物の箱 (ローカルの境界ボックスとワールド行列)
 
     void setRenderQueue(const RenderQueue& renderQueue) { m_renderQueue = renderQueue; }
     RenderQueue getRenderQueue() const { return m_renderQueue; }
     void setRasMode(RasMode mode) { m_rasMode = mode; }
-    RasMode getRasMode() { return m_rasMode; }
+    RasMode getRasMode() const { return m_rasMode; }
+    void setStaticCaster(bool isStatic) { m_isStaticCaster = isStatic; } // 動かない影を落とすもの (影をキャッシュに描いて使い回す)
+    bool isStaticCaster() const { return m_isStaticCaster; }
+    void setOccluder(bool isOccluder) { m_isOccluder = isOccluder; } // 遮蔽物 (壁や床など境界ボックスいっぱいに中身が詰まっているもの)
+    bool isOccluder() const { return m_isOccluder; }
+    uint32_t getTransformVersion();
 
 private:
     RenderQueue m_renderQueue;
     RasMode m_rasMode;
+    bool m_isStaticCaster;
+    bool m_isOccluder;
 };
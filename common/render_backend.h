@@ -0,0 +1,76 @@
+//--------------------------------------------
+//
+// レンダラーのバックエンド [render_backend.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // MeshHandle, Material
+#include <span>
+#include <functional>
+#include <string_view>
+
+class Renderer;
+class TextureManager;
+class Scene;
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+
+//----------------------------
+// レンダラーのバックエンド [抽象] (Rendererはここに渡すだけ D3D11とNullがある)
+//----------------------------
+class RenderBackend
+{
+public:
+    RenderBackend() = default;
+    virtual ~RenderBackend() = default;
+
+    virtual void init(HWND handle, long width, long height) = 0;
+    virtual void uninit() = 0;
+    virtual bool render(const Scene& scene, std::function<void()> guiRender, Renderer& inter) = 0;
+
+    virtual bool uploadTextures(const TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback) = 0;
+
+    virtual MeshHandle createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount) = 0;
+    virtual MeshHandle createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount) = 0;
+    virtual bool updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount) = 0;
+    virtual void releaseMesh(const MeshHandle& handle) = 0;
+    virtual bool setMesh(const MeshHandle& handle) = 0;
+    virtual bool getMeshBounds(const MeshHandle& handle, AABB& outBounds) const = 0;
+    virtual bool setTexture(const TextureHandle& handle) = 0;
+    virtual bool setTransformWorld(const Matrix& matrix) = 0;
+    virtual bool setTransformView(const Matrix& matrix) = 0;
+    virtual bool setTransformProjection(const Matrix& matrix) = 0;
+    virtual bool setCameraPosition(const Vector3& cameraPos) = 0;
+    virtual bool setMaterial(const Material& material) = 0;
+    virtual bool setLight(std::span<const LightData> lights, const Color& ambient) = 0;
+    virtual bool setFog(const FogData& fog) = 0;
+    virtual bool setBoneTransforms(std::span<const Matrix> boneTransforms) = 0;
+    virtual void setOutlineData(Color color, float width) = 0;
+    virtual void setPostProcessShaderMask(PostProcessShaderMask mask) = 0;
+    virtual void setToneMappingType(ToneMappingType type) = 0;
+    virtual void setShadowSettings(const ShadowSettings& settings) = 0;
+    virtual void setTextureStreamingSettings(const TextureStreamingSettings& settings) = 0;
+    virtual void setOcclusionCullingSettings(const OcclusionCullingSettings& settings) = 0;
+    virtual void setDynamicResolutionSettings(const DynamicResolutionSettings& settings) = 0;
+    virtual void setRasMode(RasMode rasMode) = 0;
+    virtual bool drawMesh(const MeshHandle& handle) = 0;
+    virtual bool drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances) = 0;
+    virtual bool drawIndexedPrimitive(VertexShaderType vertexShaderType, unsigned int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation) = 0;
+    virtual void drawDecal(Matrix transform, const MeshHandle& handle, Color color) = 0;
+    virtual void drawString(std::string_view string, Vector2 pos, Color color, float angle, Vector2 scale) = 0;
+
+    virtual void onResize(int width, int height) = 0;
+
+    virtual HWND getRegisteredHWND() const = 0;
+    virtual void getScreenSizeMagnification(Vector2& magnification) const = 0;
+    virtual void getViewportSize(Vector2& size) const = 0;
+    virtual void getStateStats(RenderStateStats& stats) const = 0;
+    virtual void getTextureStreamingStats(TextureStreamingStats& stats) const = 0;
+    virtual void getOcclusionCullingStats(OcclusionCullingStats& stats) const = 0;
+    virtual void getDynamicResolutionStats(DynamicResolutionStats& stats) const = 0;
+
+    virtual ID3D11Device* getDevice() const { return nullptr; }         // デバイスを持たないバックエンドはnull
+    virtual ID3D11DeviceContext* getContext() const { return nullptr; } //
+};
@@ -0,0 +1,366 @@
+//--------------------------------------------
+//
+// レンダーグラフ (パスの順番と描画先の使い回し) [render_graph.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "render_graph.h"
+#include <algorithm>
+
+//-------------------------------------------
+// 全部消す (構成が変わったら登録し直す)
+//-------------------------------------------
+void RenderGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_compiledPasses.clear();
+    m_physicalTextures.clear();
+    m_isCompiled = false;
+}
+
+//-------------------------------------------
+// グラフの中だけで使う描画先を作る (実体はコンパイルで決まる)
+//-------------------------------------------
+uint32_t RenderGraph::createTexture(std::string_view name, const RenderGraphTextureDesc& desc)
+{
+    m_isCompiled = false;
+    Resource& resource = m_resources.emplace_back();
+    resource.name = name;
+    resource.desc = desc;
+    return static_cast<uint32_t>(m_resources.size() - 1u);
+}
+
+//-------------------------------------------
+// 外で持っている描画先を使う (バックバッファ,シャドウマップ,深度)
+//-------------------------------------------
+uint32_t RenderGraph::importTexture(std::string_view name, bool isOutput)
+{
+    m_isCompiled = false;
+    Resource& resource = m_resources.emplace_back();
+    resource.name = name;
+    resource.isImported = true;
+    resource.isOutput = isOutput;
+    return static_cast<uint32_t>(m_resources.size() - 1u);
+}
+
+//-------------------------------------------
+// パスを登録する (登録順に実行する 読む描画先を書くパスより後に登録する)
+//-------------------------------------------
+uint32_t RenderGraph::addPass(std::string_view name, std::function<void()> execute, bool isRepeated)
+{
+    m_isCompiled = false;
+    Pass& pass = m_passes.emplace_back();
+    pass.name = name;
+    pass.execute = std::move(execute);
+    pass.isRepeated = isRepeated;
+    return static_cast<uint32_t>(m_passes.size() - 1u);
+}
+
+//-------------------------------------------
+// パスが読む描画先
+//-------------------------------------------
+bool RenderGraph::read(uint32_t pass, uint32_t resource)
+{
+    if (pass >= m_passes.size() || resource >= m_resources.size())
+    {
+        return false;
+    }
+    m_isCompiled = false;
+    m_passes[pass].reads.push_back(resource);
+    return true;
+}
+
+//-------------------------------------------
+// パスが書く描画先 (先に書いたパスがあれば中身を残して重ねる)
+//-------------------------------------------
+bool RenderGraph::write(uint32_t pass, uint32_t resource)
+{
+    if (pass >= m_passes.size() || resource >= m_resources.size())
+    {
+        return false;
+    }
+    m_isCompiled = false;
+    m_passes[pass].writes.push_back(resource);
+    return true;
+}
+
+//-------------------------------------------
+// 結果を読むパスがなくても残す
+//-------------------------------------------
+void RenderGraph::setSideEffect(uint32_t pass)
+{
+    if (pass < m_passes.size())
+    {
+        m_isCompiled = false;
+        m_passes[pass].hasSideEffect = true;
+    }
+}
+
+//-------------------------------------------
+// コンパイル (使わないパスを除き,描画先の寿命から実体を割り当て,クリアと状態の切り替えを決める)
+//-------------------------------------------
+bool RenderGraph::compile()
+{
+    m_compiledPasses.clear();
+    m_physicalTextures.clear();
+    m_isCompiled = false;
+
+    // 繰り返すパスは並んでいること,同じ描画先を同じパスで読み書きしないこと (D3D11では設定できない)
+    bool isRepeatStarted = false, isRepeatEnded = false;
+    for (const auto& pass : m_passes)
+    {
+        if (pass.isRepeated && isRepeatEnded) return false;
+        isRepeatEnded = isRepeatEnded || (isRepeatStarted && !pass.isRepeated);
+        isRepeatStarted = isRepeatStarted || pass.isRepeated;
+
+        for (uint32_t resource : pass.reads)
+        {
+            if (std::find(pass.writes.begin(), pass.writes.end(), resource) != pass.writes.end()) return false;
+        }
+    }
+
+    cullPasses();
+    for (uint32_t cnt = 0; cnt < m_passes.size(); ++cnt)
+    {
+        if (m_passes[cnt].isAlive)
+        {
+            m_compiledPasses.emplace_back().pass = cnt;
+        }
+    }
+
+    if (!assignLifetimes())
+    {
+        m_compiledPasses.clear();
+        return false;
+    }
+    assignPhysicalTextures();
+    buildBarriers();
+
+    m_isCompiled = true;
+    return true;
+}
+
+//-------------------------------------------
+// 実行する (繰り返すパスか,それ以外を実行順に prepareで切り替えとクリアをしてから描く)
+//-------------------------------------------
+void RenderGraph::execute(bool isRepeated, const std::function<void(const RenderGraphCompiledPass&)>& prepare) const
+{
+    if (!m_isCompiled)
+    {
+        return;
+    }
+
+    for (const auto& compiled : m_compiledPasses)
+    {
+        const Pass& pass = m_passes[compiled.pass];
+        if (pass.isRepeated != isRepeated)
+        {
+            continue;
+        }
+        if (prepare)
+        {
+            prepare(compiled);
+        }
+        if (pass.execute)
+        {
+            pass.execute();
+        }
+    }
+}
+
+//-------------------------------------------
+// 使わないパスを除く (結果を書くパスから読む描画先をさかのぼる)
+//-------------------------------------------
+void RenderGraph::cullPasses()
+{
+    std::vector<uint32_t> stack;
+    for (uint32_t cnt = 0; cnt < m_passes.size(); ++cnt)
+    {
+        Pass& pass = m_passes[cnt];
+        pass.isAlive = pass.hasSideEffect || std::any_of(pass.writes.begin(), pass.writes.end(), [this](uint32_t resource) { return m_resources[resource].isOutput; });
+        if (pass.isAlive)
+        {
+            stack.push_back(cnt);
+        }
+    }
+
+    while (!stack.empty())
+    {
+        uint32_t reader = stack.back();
+        stack.pop_back();
+
+        // 読む描画先を前に書いたパス (繰り返すパス同士は前の回に書いたものも読む)
+        for (uint32_t resource : m_passes[reader].reads)
+        {
+            for (uint32_t writer = 0; writer < m_passes.size(); ++writer)
+            {
+                Pass& pass = m_passes[writer];
+                bool isBefore = writer < reader || (pass.isRepeated && m_passes[reader].isRepeated);
+                if (pass.isAlive || !isBefore || std::find(pass.writes.begin(), pass.writes.end(), resource) == pass.writes.end())
+                {
+                    continue;
+                }
+                pass.isAlive = true;
+                stack.push_back(writer);
+            }
+        }
+    }
+}
+
+//-------------------------------------------
+// 描画先の寿命 (実行順の最初と最後 繰り返すパスで使うものは繰り返しの間ずっと生きている)
+//-------------------------------------------
+bool RenderGraph::assignLifetimes()
+{
+    uint32_t repeatFirst = render_graph::NO_INDEX, repeatLast = 0u;
+    for (uint32_t order = 0; order < m_compiledPasses.size(); ++order)
+    {
+        if (m_passes[m_compiledPasses[order].pass].isRepeated)
+        {
+            repeatFirst = std::min(repeatFirst, order);
+            repeatLast = order;
+        }
+    }
+
+    for (auto& resource : m_resources)
+    {
+        resource.firstPass = render_graph::NO_INDEX;
+        resource.lastPass = 0u;
+        resource.physical = render_graph::NO_INDEX;
+    }
+
+    for (uint32_t order = 0; order < m_compiledPasses.size(); ++order)
+    {
+        const Pass& pass = m_passes[m_compiledPasses[order].pass];
+        auto touch = [&](uint32_t index, bool isWrite)
+            {
+                Resource& resource = m_resources[index];
+                if (resource.firstPass == render_graph::NO_INDEX && !isWrite && !resource.isImported)
+                {
+                    return false; // 書く前に読んでいる (中身が不定)
+                }
+                resource.firstPass = std::min(resource.firstPass, pass.isRepeated ? repeatFirst : order);
+                resource.lastPass = std::max(resource.lastPass, pass.isRepeated ? repeatLast : order);
+                return true;
+            };
+
+        // 同じパスで書いて読むことはないので書く方を先に見る必要はない (読む方は前のパスが書いている)
+        for (uint32_t resource : pass.reads)
+        {
+            if (!touch(resource, false)) return false;
+        }
+        for (uint32_t resource : pass.writes)
+        {
+            touch(resource, true);
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------
+// 実体を割り当てる (使い始めが早い順に,同じ作り方で寿命が終わっている実体があれば使い回す)
+//-------------------------------------------
+void RenderGraph::assignPhysicalTextures()
+{
+    std::vector<uint32_t> order;
+    for (uint32_t cnt = 0; cnt < m_resources.size(); ++cnt)
+    {
+        if (!m_resources[cnt].isImported && m_resources[cnt].firstPass != render_graph::NO_INDEX)
+        {
+            order.push_back(cnt);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_resources[a].firstPass < m_resources[b].firstPass; });
+
+    std::vector<uint32_t> physicalLast; // 実体を最後に使う実行順
+    for (uint32_t index : order)
+    {
+        Resource& resource = m_resources[index];
+        for (uint32_t physical = 0; physical < m_physicalTextures.size(); ++physical)
+        {
+            if (m_physicalTextures[physical] == resource.desc && physicalLast[physical] < resource.firstPass)
+            {
+                resource.physical = physical;
+                break;
+            }
+        }
+        if (resource.physical == render_graph::NO_INDEX)
+        {
+            resource.physical = static_cast<uint32_t>(m_physicalTextures.size());
+            m_physicalTextures.push_back(resource.desc);
+            physicalLast.push_back(0u);
+        }
+        physicalLast[resource.physical] = resource.lastPass;
+    }
+}
+
+//-------------------------------------------
+// クリアと状態の切り替え (状態は実体ごと 使い回した実体は前の描画先の状態から切り替える)
+//-------------------------------------------
+void RenderGraph::buildBarriers()
+{
+    // 実体の後ろに外の描画先を並べて状態を持つ
+    auto stateIndex = [this](uint32_t resource) { return m_resources[resource].isImported ? m_physicalTextures.size() + resource : size_t(m_resources[resource].physical); };
+    std::vector<RenderGraphAccess> states(m_physicalTextures.size() + m_resources.size(), RenderGraphAccess::None);
+    std::vector<uint8_t> isWritten(m_resources.size(), 0u);
+
+    // 繰り返すパスは2周回り,2周目の切り替えを使う (次のカメラは前のカメラの最後の状態から始まる)
+    uint32_t repeatFirst = render_graph::NO_INDEX, repeatLast = 0u;
+    for (uint32_t order = 0; order < m_compiledPasses.size(); ++order)
+    {
+        if (m_passes[m_compiledPasses[order].pass].isRepeated)
+        {
+            repeatFirst = std::min(repeatFirst, order);
+            repeatLast = order;
+        }
+    }
+    std::vector<uint32_t> sequence;
+    for (uint32_t order = 0; order < m_compiledPasses.size(); ++order)
+    {
+        sequence.push_back(order);
+        if (order == repeatLast && repeatFirst != render_graph::NO_INDEX)
+        {
+            for (uint32_t repeat = repeatFirst; repeat <= repeatLast; ++repeat)
+            {
+                sequence.push_back(repeat);
+            }
+        }
+    }
+
+    std::vector<uint8_t> isVisited(m_compiledPasses.size(), 0u);
+    for (uint32_t order : sequence)
+    {
+        RenderGraphCompiledPass& compiled = m_compiledPasses[order];
+        const Pass& pass = m_passes[compiled.pass];
+        if (isVisited[order] != 0u)
+        {
+            compiled.barriers.clear();
+        }
+        isVisited[order] = 1u;
+
+        auto transition = [&](uint32_t resource, RenderGraphAccess access)
+            {
+                RenderGraphAccess& state = states[stateIndex(resource)];
+                if (state != RenderGraphAccess::None && state != access)
+                {
+                    compiled.barriers.emplace_back(resource, state, access);
+                }
+                state = access;
+            };
+
+        for (uint32_t resource : pass.reads)
+        {
+            transition(resource, RenderGraphAccess::Read);
+        }
+        for (uint32_t resource : pass.writes)
+        {
+            transition(resource, RenderGraphAccess::Write);
+            if (isWritten[resource] == 0u && !m_resources[resource].isImported)
+            {
+                compiled.clears.push_back(resource);
+            }
+            isWritten[resource] = 1u;
+        }
+    }
+}
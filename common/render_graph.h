@@ -0,0 +1,133 @@
+//--------------------------------------------
+//
+// レンダーグラフ (パスの順番と描画先の使い回し) [render_graph.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace render_graph
+{
+    constexpr uint32_t NO_INDEX = ~0u; // 登録されていない,実体がない
+}
+
+// 描画先の作り方 (同じ作り方のものは寿命が重ならなければ1つの実体を使い回す)
+struct RenderGraphTextureDesc
+{
+    uint32_t format;    // 形式 (DXGI_FORMATの値 グラフは比べるだけ)
+    uint32_t sizeShift; // 画面サイズを右シフトする量 (0で等倍,2で1/4)
+
+    RenderGraphTextureDesc() : format{}, sizeShift{} {}
+    RenderGraphTextureDesc(uint32_t textureFormat, uint32_t textureSizeShift) : format{ textureFormat }, sizeShift{ textureSizeShift } {}
+    ~RenderGraphTextureDesc() = default;
+
+    bool operator==(const RenderGraphTextureDesc& rhs) const noexcept { return format == rhs.format && sizeShift == rhs.sizeShift; }
+};
+
+// 描画先の使われ方
+enum class RenderGraphAccess : unsigned char
+{
+    None,  // まだ使われていない
+    Read,  // シェーダーリソースとして読む
+    Write, // レンダーターゲット (深度ならデプスステンシル) として書く
+    Max
+};
+
+// 状態の切り替え (D3D11は同じテクスチャを読み書き同時に設定できないので,切り替わる前に外す)
+struct RenderGraphBarrier
+{
+    uint32_t resource;        // 描画先
+    RenderGraphAccess before; // 前のパスでの使われ方
+    RenderGraphAccess after;  // このパスでの使われ方
+
+    RenderGraphBarrier() : resource{ render_graph::NO_INDEX }, before{}, after{} {}
+    RenderGraphBarrier(uint32_t barrierResource, RenderGraphAccess beforeAccess, RenderGraphAccess afterAccess) : resource{ barrierResource }, before{ beforeAccess }, after{ afterAccess } {}
+    ~RenderGraphBarrier() = default;
+};
+
+// コンパイル後のパス (実行する順)
+struct RenderGraphCompiledPass
+{
+    uint32_t pass;                            // 登録したパスの番号
+    std::vector<uint32_t> clears;             // 始める前にクリアする描画先 (実体を使い回すので最初の書き込みは中身が不定)
+    std::vector<RenderGraphBarrier> barriers; // 始める前の状態の切り替え
+
+    RenderGraphCompiledPass() : pass{ render_graph::NO_INDEX }, clears{}, barriers{} {}
+    ~RenderGraphCompiledPass() = default;
+};
+
+//----------------------------
+// レンダーグラフ (パスが読み書きする描画先を宣言し,コンパイルで使わないパスを除き,寿命が重ならない描画先の実体を共有する GPUには触らない)
+//----------------------------
+class RenderGraph
+{
+public:
+    RenderGraph() : m_resources{}, m_passes{}, m_compiledPasses{}, m_physicalTextures{}, m_isCompiled{} {}
+    ~RenderGraph() = default;
+
+    void reset();
+    uint32_t createTexture(std::string_view name, const RenderGraphTextureDesc& desc);
+    uint32_t importTexture(std::string_view name, bool isOutput = false);
+    uint32_t addPass(std::string_view name, std::function<void()> execute, bool isRepeated = false);
+    bool read(uint32_t pass, uint32_t resource);
+    bool write(uint32_t pass, uint32_t resource);
+    void setSideEffect(uint32_t pass);
+    bool compile();
+    void execute(bool isRepeated, const std::function<void(const RenderGraphCompiledPass&)>& prepare) const;
+
+    bool isCompiled() const { return m_isCompiled; }
+    bool isPassAlive(uint32_t pass) const { return pass < m_passes.size() && m_passes[pass].isAlive; }
+    std::span<const RenderGraphCompiledPass> getCompiledPasses() const { return m_compiledPasses; }
+    std::span<const RenderGraphTextureDesc> getPhysicalTextures() const { return m_physicalTextures; }
+    uint32_t getPhysicalIndex(uint32_t resource) const { return resource < m_resources.size() ? m_resources[resource].physical : render_graph::NO_INDEX; }
+    std::string_view getPassName(uint32_t pass) const { return pass < m_passes.size() ? std::string_view(m_passes[pass].name) : std::string_view(); }
+    std::string_view getResourceName(uint32_t resource) const { return resource < m_resources.size() ? std::string_view(m_resources[resource].name) : std::string_view(); }
+
+private:
+    // 描画先
+    struct Resource
+    {
+        std::string name;            // 名前 (確認用)
+        RenderGraphTextureDesc desc; // 作り方
+        bool isImported;             // 外で持っている (使い回さない,クリアしない)
+        bool isOutput;               // フレームの結果 (書くパスは除かない)
+        uint32_t firstPass;          // 最初に使う実行順
+        uint32_t lastPass;           // 最後に使う実行順
+        uint32_t physical;           // 実体の番号
+
+        Resource() : name{}, desc{}, isImported{}, isOutput{}, firstPass{}, lastPass{}, physical{ render_graph::NO_INDEX } {}
+        ~Resource() = default;
+    };
+
+    // パス
+    struct Pass
+    {
+        std::string name;               // 名前 (確認用)
+        std::function<void()> execute;  // 描画
+        std::vector<uint32_t> reads;    // 読む描画先
+        std::vector<uint32_t> writes;   // 書く描画先
+        bool isRepeated;                // カメラごとに繰り返す (繰り返すパスは並べて登録する)
+        bool hasSideEffect;             // 結果を読むパスがなくても除かない
+        bool isAlive;                   // コンパイルで残った
+
+        Pass() : name{}, execute{}, reads{}, writes{}, isRepeated{}, hasSideEffect{}, isAlive{} {}
+        ~Pass() = default;
+    };
+
+    void cullPasses();
+    bool assignLifetimes();
+    void assignPhysicalTextures();
+    void buildBarriers();
+
+    std::vector<Resource> m_resources;                     // 描画先
+    std::vector<Pass> m_passes;                            // パス (登録順)
+    std::vector<RenderGraphCompiledPass> m_compiledPasses; // 実行するパス (実行順)
+    std::vector<RenderGraphTextureDesc> m_physicalTextures; // 実体の作り方
+    bool m_isCompiled;                                     // コンパイル済み
+};
@@ -10,6 +10,28 @@
 #include "trans_comp.h"
 #include "log.h"
 
+namespace
+{
+    //--------------
+    // マテリアルを16bitにまとめる関数 (FNV-1a 同じ値なら同じキー)
+    //--------------
+    uint16_t HashMaterial(const Material& material)
+    {
+        const float values[] = { material.Diffuse.r, material.Diffuse.g, material.Diffuse.b, material.Diffuse.a,
+            material.Specular.r, material.Specular.g, material.Specular.b, material.Emissive.r, material.Emissive.g, material.Emissive.b,
+            material.Power, material.AlphaCutoff, static_cast<float>(material.pixelShaderType) };
+
+        uint64_t h = 2166136261u;
+        const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(values);
+        for (size_t cnt = 0; cnt < sizeof(values); ++cnt)
+        {
+            h ^= pBytes[cnt];
+            h *= 16777619u;
+        }
+        return static_cast<uint16_t>(h ^ (h >> 16));
+    }
+}
+
 //-------------------------------------
 // 
 // Mesh描画用コンポーネントクラス
@@ -22,6 +44,36 @@
 void MeshRenderComponent::render(Renderer& renderer)
 {
     // ワールド変換の設定
+    renderer.setTransformWorld(getWorldTransform().toMatrix());
+
+    // マテリアルとテクスチャの設定
+    renderer.setMaterial(m_material);
+    renderer.setTexture(m_texture);
+
+    // 描画
+    renderer.setRasMode(getRasMode());
+    renderer.drawMesh(m_mesh);
+    renderer.setRasMode(RasMode::Back);
+}
+
+//----------------------------
+// インスタンシング描画の情報
+//----------------------------
+bool MeshRenderComponent::getInstanceDraw(InstanceDrawDesc& outDesc)
+{
+    outDesc.mesh = m_mesh;
+    outDesc.material = m_material;
+    outDesc.texture = m_texture;
+    outDesc.rasMode = getRasMode();
+    outDesc.instance = InstanceData(getWorldTransform().toMatrix(), Color::White());
+    return m_mesh.isValid();
+}
+
+//----------------------------
+// オーナーのワールド変換
+//----------------------------
+Transform MeshRenderComponent::getWorldTransform()
+{
     Transform transform{};
     auto& owner = getOwner();
     if (owner.Has<TransformComponent>())
@@ -37,14 +89,51 @@ void MeshRenderComponent::render(Renderer& renderer)
         transform.identity();
         spdlog::warn("MeshRenderComponent: Owner does not have TransformComponent. Using identity transform.");
     }
-    renderer.setTransformWorld(transform.toMatrix());
+    return transform;
+}
 
-    // マテリアルとテクスチャの設定
-    renderer.setMaterial(m_material);
-    renderer.setTexture(m_texture);
+//----------------------------
+// ソートキー用の状態
+//----------------------------
+DrawKeyState MeshRenderComponent::getDrawKeyState() const
+{
+    DrawKeyState state{};
+    state.shader = static_cast<uint16_t>(m_material.pixelShaderType);
+    state.texture = static_cast<uint16_t>(m_texture.id);
+    state.material = HashMaterial(m_material);
+    state.mesh = static_cast<uint16_t>(m_mesh.id);
+    return state;
+}
 
-    // 描画
-    renderer.setRasMode(getRasMode());
-    renderer.drawMesh(m_mesh);
-    renderer.setRasMode(RasMode::Back);
+//----------------------------
+// カリング用のワールド境界ボックス
+//----------------------------
+bool MeshRenderComponent::getWorldBounds(const Renderer& renderer, AABB& outBounds)
+{
+    if (!renderer.getMeshBounds(m_mesh, outBounds))
+    {
+        return false;
+    }
+
+    auto comps = getOwner().Get<TransformComponent>();
+    if (comps.size() == 1)
+    {
+        outBounds.transform(comps[0]->get().toMatrix());
+    }
+    return true;
+}
+
+//----------------------------
+// 遮蔽物の箱 (メッシュのローカル境界ボックスをそのまま使う 箱のメッシュや壁に指定する)
+//----------------------------
+bool MeshRenderComponent::getOccluderBox(const Renderer& renderer, Matrix& outWorld, AABB& outLocal)
+{
+    if (!renderer.getMeshBounds(m_mesh, outLocal))
+    {
+        return false;
+    }
+
+    auto comps = getOwner().Get<TransformComponent>();
+    outWorld = (comps.size() == 1) ? comps[0]->get().toMatrix() : Matrix();
+    return true;
 }
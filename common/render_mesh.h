@@ -17,12 +17,18 @@ public:
     ~MeshRenderComponent() = default;
 
     void render(Renderer& renderer) override;
+    DrawKeyState getDrawKeyState() const override;
+    bool getWorldBounds(const Renderer& renderer, AABB& outBounds) override;
+    bool getOccluderBox(const Renderer& renderer, Matrix& outWorld, AABB& outLocal) override;
+    bool getInstanceDraw(InstanceDrawDesc& outDesc) override;
 
     void SetMeshHandle(const MeshHandle& mesh) { m_mesh = mesh; }
     void SetMaterial(const Material& material) { m_material = material; }
     void SetTextureHandle(const TextureHandle& texture) { m_texture = texture; }
 
 private:
+    Transform getWorldTransform();
+
     MeshHandle m_mesh;       // 描画するメッシュのハンドル
     Material m_material;     // 描画に使用するマテリアル
     TextureHandle m_texture; // 描画に使用するテクスチャ
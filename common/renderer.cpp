@@ -5,15 +5,15 @@
 //
 //--------------------------------------------
 
-#include <d3dcompiler.h> // シェーダーコンパイル用
+#include <d3d11_1.h>     // 定数バッファのオフセット指定 (VSSetConstantBuffers1)
 #include <DirectXMath.h> // 本来は数学用だがこのrendererではTextでの受け渡しにのみ使用
 #include <DirectXTex.h>  // テクスチャ用
+#include <shared_mutex>  // メッシュとテクスチャの読み取りを並列に
+#include <cwctype>       // 文字の配置で空白を飛ばす
 
 #include <DirectXTK/SpriteBatch.h> // Text用
 #include <DirectXTK/SpriteFont.h>  //
 
-#pragma comment(lib, "d3dcompiler.lib")
-
 // ComPtrを使います
 using Microsoft::WRL::ComPtr;
 
@@ -30,6 +30,7 @@ namespace
 }
 
 #include "renderer.h"
+#include "render_backend.h"
 #include "texture.h"
 #include "mymath.h"
 #include "scene.h"
@@ -37,6 +38,16 @@ namespace
 #include "render.h"
 #include "camera_comp.h"
 #include "light_comp.h"
+#include "draw_list.h"
+#include "shadow_cascade.h"
+#include "light_cluster.h"
+#include "occlusion_culling.h"
+#include "texture_streaming.h"
+#include "offset_allocator.h"
+#include "render_graph.h"
+#include "shader_cache.h"
+#include "shader_compiler.h"
+#include "dynamic_resolution.h"
 
 static constexpr wchar_t SHADER_DIRECTORY[] = L"data/SHADER";
 
@@ -64,6 +75,29 @@ enum class ForwardSubPass
     Max
 };
 
+//------------------------
+// 定数ブロック (描画ごとに変わり得るもの 書き換えたときだけ送る)
+//------------------------
+enum class ConstantBlockType : unsigned char
+{
+    World,    // ワールド行列
+    Material, // マテリアル
+    Bone,     // ボーン行列
+    Outline,  // アウトライン
+    Fog,      // フォグ
+    Max
+};
+
+//------------------------
+// 定数バッファを設定するシェーダーステージ
+//------------------------
+enum class ShaderStage : unsigned char
+{
+    Vertex, // 頂点シェーダー
+    Pixel,  // ピクセルシェーダー
+    Max
+};
+
 //------------------------
 // ポストプロセスシェーダーの種類
 //------------------------
@@ -97,11 +131,15 @@ struct LightBufferData
 {
     Color GlobalAmbient;          // 環境光 (全体で1つ)
     Vector4 CameraPos;            // カメラ位置
-    int     LightCount;           // 現在有効なライトの数
-    float   padding[3];           // 16バイト境界合わせ用パディング
-    LightData Lights[MAX_LIGHT];  // ライトの配列
-
-    LightBufferData() : GlobalAmbient{}, CameraPos{}, LightCount{}, padding{}, Lights{} {}
+    int     LightCount;           // 現在有効な平行光源の数
+    int     PointLightCount;      // クラスターに振り分けた点光源の数
+    float   padding[2];           // 16バイト境界合わせ用パディング
+    Vector4 ClusterViewDepthRow;  // ワールド座標からカメラの奥行きを出す (View行列の3列目)
+    Vector4 ClusterScale;         // xy: 画素→タイル, zw: 奥行き→スライス
+    int     ClusterDims[4];       // xyz: クラスターの分割数, w: 1なら奥行きは対数
+    LightData Lights[MAX_LIGHT];  // 平行光源の配列
+
+    LightBufferData() : GlobalAmbient{}, CameraPos{}, LightCount{}, PointLightCount{}, padding{}, ClusterViewDepthRow{}, ClusterScale{}, ClusterDims{}, Lights{} {}
     ~LightBufferData() = default;
 };
 
@@ -114,12 +152,16 @@ struct WorldMatBufferData
     ~WorldMatBufferData() = default;
 };
 
-// シャドウ用
+// シャドウ用 (カスケードシャドウ)
 struct ShadowBufferData
 {
-    Matrix LightViewProj; // ライトの View * Proj 行列
+    Matrix CascadeViewProj[MAX_SHADOW_CASCADES]; // カスケードごとのライトの View * Proj 行列
+    Vector4 CascadeSplits;                        // カスケードの奥 (カメラのビュー空間の奥行き)
+    Vector4 ViewDepthRow;                         // ワールド座標からカメラの奥行きを出す (View行列の3列目)
+    int CascadeCount;                             // カスケード数 (0なら影なし)
+    float padding[3];                             // 16バイト境界合わせ用
 
-    ShadowBufferData() : LightViewProj{} {}
+    ShadowBufferData() : CascadeViewProj{}, CascadeSplits{}, ViewDepthRow{}, CascadeCount{}, padding{} {}
     ~ShadowBufferData() = default;
 };
 
@@ -193,9 +235,10 @@ struct PostProcessBufferData
     float bloomThreshold; // ブルームで抽出する明るさの閾値
     float bloomIntensity; // ブルーム強度
     int toneMappingType;  // トーンマッピングの種類
-    float padding[3];
+    float padding;
+    Vector2 UVScale;      // 3Dを描いた範囲 (動的解像度で縮めた割合 読むUVにかける)
 
-    PostProcessBufferData() : ScreenSize{}, BlurDir{}, bloomThreshold{}, bloomIntensity{}, toneMappingType{}, padding{} {}
+    PostProcessBufferData() : ScreenSize{}, BlurDir{}, bloomThreshold{}, bloomIntensity{}, toneMappingType{}, padding{}, UVScale{ 1.0f, 1.0f } {}
     ~PostProcessBufferData() = default;
 };
 
@@ -203,42 +246,434 @@ struct PostProcessBufferData
 struct MeshData
 {
     VertexShaderType vertexhaderType; // 頂点シェーダーの種類
-    ComPtr<ID3D11Buffer> pVertex;     // 頂点バッファ
-    ComPtr<ID3D11Buffer> pIndex;      // インデックスバッファ
+    ComPtr<ID3D11Buffer> pVertex;     // 頂点バッファ (アリーナの本体か動的メッシュ専用のもの)
+    ComPtr<ID3D11Buffer> pIndex;      // インデックスバッファ (アリーナの本体)
     unsigned int stride;              // 頂点サイズ
+    size_t verticesCount;             // 頂点カウント
     size_t indicesCount;              // インデックスカウント
-
-    MeshData() : pVertex{}, pIndex{}, stride{}, indicesCount{} {}
+    uint32_t vertexArena;             // 頂点を借りているアリーナ (NO_ARENAなら専用のバッファ)
+    uint32_t indexArena;              // インデックスを借りているアリーナ
+    UINT baseVertex;                  // アリーナの中の先頭の頂点
+    UINT startIndex;                  // アリーナの中の先頭のインデックス
+    uint32_t sourceId;                // 動的メッシュのインデックスの借り元 (~0uならなし)
+    uint32_t dynamicUsers;            // インデックスを借りている動的メッシュの数
+    bool isDynamic;                   // CPUから頂点を書き換えるか
+    bool isResident;                  // 頂点とインデックスがアリーナに書き込まれたか (フレームの先頭で書く)
+    bool isReleased;                  // 解放済み (借りている動的メッシュがなくなったら範囲を返す)
+    AABB bounds;                      // ローカル空間の境界ボックス (カリング用)
+
+    MeshData() : vertexhaderType{ VertexShaderType::Max }, pVertex{}, pIndex{}, stride{}, verticesCount{}, indicesCount{}, vertexArena{ ~0u }, indexArena{ ~0u }, baseVertex{}, startIndex{}, sourceId{ ~0u }, dynamicUsers{},
+        isDynamic{}, isResident{}, isReleased{}, bounds{} {}
     ~MeshData() = default;
 };
 
-static constexpr std::array<const wchar_t*, size_t(PostProcessShaderType::Max)> POST_PROCESS_SHADER_FILE_NAMES =
+// メッシュの頂点かインデックスをまとめて置くバッファ (メッシュは範囲を借りて先頭をずらして描画するのでバッファの設定が減る)
+struct GeometryArena
+{
+    ComPtr<ID3D11Buffer> pBuffer; // 本体 (DEFAULT)
+    OffsetAllocator allocator;    // 範囲の管理 (要素単位)
+    UINT bindFlags;               // 頂点かインデックスか
+    UINT stride;                  // 要素のサイズ (インデックスは4)
+
+    GeometryArena() : pBuffer{}, allocator{}, bindFlags{}, stride{} {}
+    ~GeometryArena() = default;
+};
+
+// アリーナへの書き込み待ち (メッシュは読み込みスレッドからも作られるのでフレームの先頭に即時コンテキストで書く)
+struct GeometryUpload
+{
+    uint32_t arena;            // 書き込み先のアリーナ
+    UINT offset;               // 先頭 (要素単位)
+    std::vector<uint8_t> data; // 中身
+
+    GeometryUpload() : arena{}, offset{}, data{} {}
+    ~GeometryUpload() = default;
+};
+
+// ストリーミングするテクスチャ (低いミップだけ常駐させ,必要になったら展開元から作り直す)
+struct StreamingTexture
+{
+    std::shared_ptr<TextureData> spSource; // 展開元 (ファイルの中身 CPUリソースを解放すると以後は今のミップのまま)
+    ComPtr<ID3D11Texture2D> pTexture;      // 今のテクスチャ (ミップを捨てるときはGPU上でコピーする)
+    unsigned int residentMip;              // ↑の一番細かいミップ
+
+    StreamingTexture() : spSource{}, pTexture{}, residentMip{} {}
+    ~StreamingTexture() = default;
+};
+
+// ミップの読み込み (ワーカースレッドで展開してテクスチャを作る)
+struct StreamingTask
+{
+    uint32_t id;                             // テクスチャID
+    unsigned int mip;                        // 作る一番細かいミップ
+    ComPtr<ID3D11Texture2D> pTexture;        // 作ったテクスチャ
+    ComPtr<ID3D11ShaderResourceView> pSRV;   // ↑のSRV
+    std::future<bool> result;                // 終わったか
+
+    StreamingTask() : id{}, mip{}, pTexture{}, pSRV{}, result{} {}
+    ~StreamingTask() = default;
+};
+
+// 並べ終わったグリフ (位置,回転,拡大は描画時にSpriteBatchがかけるので文字列の原点からのずらしだけ持つ)
+struct TextGlyph
+{
+    RECT subrect;             // フォントのシート上の範囲
+    DirectX::XMFLOAT2 origin; // SpriteBatchのorigin (文字列の原点からのずらしの符号反転)
+
+    TextGlyph() : subrect{}, origin{} {}
+    ~TextGlyph() = default;
+};
+
+// 文字列の配置のキャッシュ (同じ文字列なら並べ直さずコピーだけ)
+struct TextLayout
+{
+    std::string text;              // 文字列 (ハッシュの衝突を確かめる)
+    std::vector<TextGlyph> glyphs; // 並べ終わったグリフ
+    uint64_t lastUsedBatch;        // 最後に使ったバッチ
+
+    TextLayout() : text{}, glyphs{}, lastUsedBatch{} {}
+    ~TextLayout() = default;
+};
+
+//------------------------
+// フレームの描画先 (レンダーグラフに登録する順 書き込むたびに別の描画先にし,実体はグラフが使い回す)
+//------------------------
+enum class FrameTarget : unsigned char
+{
+    GBuffer0,   // Albedo (色)
+    GBuffer1,   // Normal (法線)
+    GBuffer2,   // Position (座標)
+    GBuffer3,   // Emissive (発光)
+    Scene,      // ライティングとフォワードの結果
+    Bloom,      // 光の抽出 (1/4サイズ)
+    BloomWork,  // 横ぼかし (1/4サイズ)
+    BloomBlur,  // 縦ぼかし (1/4サイズ)
+    Gray,       // グレースケール
+    Composite,  // 合成,色調補正後
+    ShadowMap,  // シャドウマップ (外で持つ)
+    Depth,      // Zバッファ (外で持つ)
+    BackBuffer, // バックバッファ (外で持つ フレームの結果)
+    Max
+};
+
+// 描画先の実体 (レンダーグラフの実体の番号順)
+struct GraphTexture
+{
+    ComPtr<ID3D11Texture2D> pTexture;      // 実体 (テクスチャ)
+    ComPtr<ID3D11RenderTargetView> pRTV;   // 書き込み用
+    ComPtr<ID3D11ShaderResourceView> pSRV; // 読み込み用
+
+    GraphTexture() : pTexture{}, pRTV{}, pSRV{} {}
+    ~GraphTexture() = default;
+};
+
+// カメラごとのパスが描くカメラ
+struct FrameCamera
+{
+    Matrix view;                             // ビュー行列
+    Matrix proj;                             // プロジェクション行列
+    size_t index;                            // 何番目のカメラか
+    std::span<LightComponent* const> lights; // ライト (最初の影を落とすライトを描く)
+    Renderer* pInter;                        // 描画の窓口
+
+    FrameCamera() : view{}, proj{}, index{}, lights{}, pInter{} {}
+    ~FrameCamera() = default;
+};
+
+// GPUのフレーム時間を測るクエリ (数フレーム後に待たずに読む)
+struct FrameTimer
+{
+    ComPtr<ID3D11Query> pDisjoint; // 周波数と測れたか
+    ComPtr<ID3D11Query> pBegin;    // フレームの始めのタイムスタンプ
+    ComPtr<ID3D11Query> pEnd;      // フレームの終わりのタイムスタンプ
+    bool isIssued;                 // 発行してまだ読んでいない
+
+    FrameTimer() : pDisjoint{}, pBegin{}, pEnd{}, isIssued{} {}
+    ~FrameTimer() = default;
+};
+
+// 定数ブロックの送り先 (リングのどこに置いたか)
+struct ConstantBlock
+{
+    ID3D11Buffer* pBuffer; // 送り先 (借用)
+    UINT firstConstant;    // 先頭 (定数16byte単位 リングでないなら0)
+    UINT numConstants;     // 大きさ (定数16byte単位 リングでないなら0)
+    bool isDirty;          // 書き換えられて未送信
+
+    ConstantBlock() : pBuffer{}, firstConstant{}, numConstants{}, isDirty{ true } {}
+    ~ConstantBlock() = default;
+};
+
+// スロットに設定中の定数バッファ (同じなら設定しない)
+struct ConstantBinding
+{
+    ID3D11Buffer* pBuffer; // 設定中のバッファ (借用)
+    UINT firstConstant;    // 先頭
+    UINT numConstants;     // 大きさ
+
+    ConstantBinding() : pBuffer{}, firstConstant{}, numConstants{} {}
+    ~ConstantBinding() = default;
+
+    bool operator==(const ConstantBinding& other) const { return pBuffer == other.pBuffer && firstConstant == other.firstConstant && numConstants == other.numConstants; }
+};
+
+// スロットに設定中の頂点バッファ
+struct VertexStreamBinding
+{
+    ID3D11Buffer* pBuffer; // 設定中のバッファ (借用)
+    UINT stride;           // 頂点の大きさ
+    UINT offset;           // 先頭
+
+    VertexStreamBinding() : pBuffer{}, stride{}, offset{} {}
+    VertexStreamBinding(ID3D11Buffer* pBuffer, UINT stride, UINT offset) : pBuffer{ pBuffer }, stride{ stride }, offset{ offset } {}
+    ~VertexStreamBinding() = default;
+
+    bool operator==(const VertexStreamBinding& other) const { return pBuffer == other.pBuffer && stride == other.stride && offset == other.offset; }
+};
+
+// 設定中のインデックスバッファ
+struct IndexBufferBinding
+{
+    ID3D11Buffer* pBuffer; // 設定中のバッファ (借用)
+    DXGI_FORMAT format;    // インデックスの形式
+    UINT offset;           // 先頭
+
+    IndexBufferBinding() : pBuffer{}, format{ DXGI_FORMAT_UNKNOWN }, offset{} {}
+    IndexBufferBinding(ID3D11Buffer* pBuffer, DXGI_FORMAT format, UINT offset) : pBuffer{ pBuffer }, format{ format }, offset{ offset } {}
+    ~IndexBufferBinding() = default;
+
+    bool operator==(const IndexBufferBinding& other) const { return pBuffer == other.pBuffer && format == other.format && offset == other.offset; }
+};
+
+// 設定中の値 (分からない間は必ず設定する)
+template<typename T>
+struct CachedState
+{
+    T value;      // 設定中の値
+    bool isKnown; // 値が分かっている
+
+    CachedState() : value{}, isKnown{} {}
+    ~CachedState() = default;
+
+    // 変わるならtrue
+    bool update(const T& newValue)
+    {
+        if (isKnown && value == newValue)
+        {
+            return false;
+        }
+        value = newValue;
+        isKnown = true;
+        return true;
+    }
+};
+
+// 設定中のパイプラインステート (同じ設定を省くための影)
+struct PipelineStateCache
+{
+    static constexpr size_t PS_RESOURCE_SLOTS = 16u; // 覚えておくSRVのスロット数 (それ以上は毎回設定)
+
+    CachedState<ID3D11VertexShader*> vertexShader;                                                  // 頂点シェーダー
+    CachedState<ID3D11PixelShader*> pixelShader;                                                    // ピクセルシェーダー
+    CachedState<ID3D11InputLayout*> inputLayout;                                                    // 入力レイアウト
+    CachedState<D3D11_PRIMITIVE_TOPOLOGY> topology;                                                 // プリミティブトポロジー
+    std::array<CachedState<VertexStreamBinding>, D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT> vertexStreams; // 頂点バッファ
+    CachedState<IndexBufferBinding> indexBuffer;                                                    // インデックスバッファ
+    std::array<CachedState<ID3D11ShaderResourceView*>, PS_RESOURCE_SLOTS> psResources;             // ピクセルシェーダーのSRV
+    std::array<CachedState<ID3D11SamplerState*>, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT> psSamplers; // ピクセルシェーダーのサンプラー
+    CachedState<ID3D11BlendState*> blendState;                                                      // ブレンドステート
+    CachedState<ID3D11DepthStencilState*> depthState;                                               // Zバッファステート
+    CachedState<ID3D11RasterizerState*> rasState;                                                   // ラスタライザーステート
+
+    PipelineStateCache() : vertexShader{}, pixelShader{}, inputLayout{}, topology{}, vertexStreams{}, indexBuffer{}, psResources{}, psSamplers{}, blendState{}, depthState{}, rasState{} {}
+    ~PipelineStateCache() = default;
+};
+
+// 描画を記録するコンテキストごとの状態 (即時コンテキストと記録スレッドごとの遅延コンテキスト)
+struct DrawContext
+{
+    ComPtr<ID3D11DeviceContext> pContext;   // 記録先
+    ComPtr<ID3D11DeviceContext1> pContext1; // 11.1 (定数バッファのオフセット指定用 なければnull)
+    ComPtr<ID3D11CommandList> pCommandList; // 記録結果 (遅延コンテキストのみ)
+
+    // 描画ごとの定数のキャッシュ
+    WorldMatBufferData wMatData;            // ワールド行列
+    MaterialBufferData mtlData;             // マテリアル
+    BoneBufferData boneData;                // ボーン行列
+    UINT boneCount;                         // ↑の使っている数 (この分だけ送る)
+    OutlineBufferData outlineData;          // アウトライン
+
+    // 設定中のメッシュ (アリーナの中の位置 描画は先頭をずらす)
+    UINT meshStartIndex;                    // 先頭のインデックス
+    UINT meshBaseVertex;                    // 先頭の頂点
+    bool isMeshReady;                       // 描画できるか (アリーナへの書き込み前や解放済みならfalse)
+
+    // テクスチャストリーミングの要求用
+    uint32_t textureId;                     // 設定中のテクスチャ (なければ~0u)
+    AABB meshBounds;                        // 設定中のメッシュの境界ボックス
+
+    // 定数バッファリング (描画ごとの定数をNO_OVERWRITEで追記してオフセットで設定する)
+    ComPtr<ID3D11Buffer> pConstantRing;                                       // リング本体 (なければ従来の定数バッファへUpdateSubresource)
+    UINT constantRingOffset;                                                  // 次に書き込む位置
+    bool isConstantRingDiscard;                                               // 次の書き込みでDISCARDする
+    std::array<ConstantBlock, size_t(ConstantBlockType::Max)> constantBlocks; // ブロックごとの送り先
+    std::array<std::array<CachedState<ConstantBinding>, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT>, size_t(ShaderStage::Max)> constantBindings; // 設定中の定数バッファ
+
+    // ステートの影 (同じ設定をD3Dに送らない)
+    PipelineStateCache stateCache;          // 設定中のステート
+    RenderStateStats stateStats;            // 今のフレームの統計
+
+    // インスタンシング
+    ComPtr<ID3D11Buffer> pInstanceBuffer;   // インスタンスバッファ (動的)
+    size_t instanceCapacity;                // ↑の要素数
+    std::vector<InstanceData> instanceBatch; // まとめているインスタンス
+
+    DrawContext() : pContext{}, pContext1{}, pCommandList{}, wMatData{}, mtlData{}, boneData{}, boneCount{ UINT(MAX_BONES) }, outlineData{}, meshStartIndex{}, meshBaseVertex{}, isMeshReady{}, textureId{ ~0u }, meshBounds{}, pConstantRing{}, constantRingOffset{}, isConstantRingDiscard{ true },
+        constantBlocks{}, constantBindings{}, stateCache{}, stateStats{}, pInstanceBuffer{}, instanceCapacity{}, instanceBatch{} {}
+    ~DrawContext() = default;
+};
+
+// パスの設定 (遅延コンテキストは即時コンテキストの設定を引き継がないので写す)
+struct PassState
 {
-    L"PP_None.hlsl",
-    L"PP_Fxaa.hlsl",
-    L"PP_Gray.hlsl",
-    L"PP_BloomExtract.hlsl",
-    L"PP_GaussianBlur.hlsl",
-    L"PP_Composite.hlsl"
+    static constexpr size_t CONSTANT_SLOTS = 6u; // 写す定数バッファのスロット数 (b0~b5)
+    static constexpr size_t SAMPLER_SLOTS = 4u;  // 写すサンプラーのスロット数
+
+    std::array<ComPtr<ID3D11RenderTargetView>, D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT> pRTVs;                   // レンダーターゲット
+    ComPtr<ID3D11DepthStencilView> pDSV;                                                                        // Zバッファ
+    std::array<D3D11_VIEWPORT, D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE> viewports;            // ビューポート
+    UINT numViewports;                                                                                          // ↑の数
+    std::array<D3D11_RECT, D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE> scissorRects;             // シザー
+    UINT numScissorRects;                                                                                       // ↑の数
+    D3D11_PRIMITIVE_TOPOLOGY topology;                                                                          // プリミティブトポロジー
+    ComPtr<ID3D11BlendState> pBlendState;                                                                       // ブレンド
+    std::array<float, 4> blendFactor;                                                                           // ブレンド係数
+    UINT sampleMask;                                                                                            // サンプルマスク
+    ComPtr<ID3D11DepthStencilState> pDepthState;                                                                // Zバッファ
+    UINT stencilRef;                                                                                            // ステンシル参照値
+    ComPtr<ID3D11RasterizerState> pRasState;                                                                    // ラスタライザー
+    std::array<ComPtr<ID3D11Buffer>, CONSTANT_SLOTS> pVSConstants, pPSConstants;                                // 定数バッファ
+    std::array<UINT, CONSTANT_SLOTS> vsFirstConstants, vsNumConstants, psFirstConstants, psNumConstants;        // ↑のリング内の範囲
+    std::array<ComPtr<ID3D11ShaderResourceView>, PipelineStateCache::PS_RESOURCE_SLOTS> pPSResources;           // SRV
+    std::array<ComPtr<ID3D11SamplerState>, SAMPLER_SLOTS> pPSSamplers;                                          // サンプラー
+
+    PassState() : pRTVs{}, pDSV{}, viewports{}, numViewports{}, scissorRects{}, numScissorRects{}, topology{}, pBlendState{}, blendFactor{}, sampleMask{}, pDepthState{}, stencilRef{}, pRasState{},
+        pVSConstants{}, pPSConstants{}, vsFirstConstants{}, vsNumConstants{}, psFirstConstants{}, psNumConstants{}, pPSResources{}, pPSSamplers{} {}
+    ~PassState() = default;
 };
 
+// ポストプロセスのシェーダーはShaderProgramにPostProcessShaderTypeの順で並べる
+static_assert(size_t(ShaderProgram::PostProcessComposite) - size_t(ShaderProgram::PostProcessNone) + 1u == size_t(PostProcessShaderType::Max), "post process shader programs must match PostProcessShaderType");
+
+namespace
+{
+    constexpr UINT CONSTANT_RING_SIZE = 4u * 1024u * 1024u; // 定数バッファリングの大きさ (1フレーム分)
+    constexpr UINT CONSTANT_ALIGNMENT = 256u;               // オフセット指定の単位 (定数16個)
+    constexpr UINT MAX_DRAW_CONSTANT_BYTES = 32u * 1024u;   // 1回の描画で送り得る最大量 (全ブロック)
+    constexpr size_t MAX_RECORD_THREADS = 8u;                // 描画を記録するスレッドの最大数 (メインスレッド込み)
+    constexpr size_t MIN_RECORD_ITEMS = 128u;                // 1スレッドに任せる最小の描画アイテム数 (少ないと記録の手間が勝つ)
+    constexpr UINT VERTEX_ARENA_BYTES = 16u * 1024u * 1024u; // 頂点のアリーナ1つの大きさ (これより大きいメッシュは専用の大きさで作る)
+    constexpr UINT INDEX_ARENA_BYTES = 8u * 1024u * 1024u;   // インデックスのアリーナ1つの大きさ
+    constexpr uint32_t NO_ARENA = ~0u;                       // アリーナを使っていない
+    constexpr float DEFRAGMENT_FREE_RATIO = 0.25f;           // 空きがこれ以上で
+    constexpr float DEFRAGMENT_FRAGMENTATION = 0.5f;         // 細切れならフレームの先頭で詰め直す
+    constexpr uint64_t TEXT_LAYOUT_KEEP_BATCHES = 300u;      // この回数のバッチで使われなかった文字列の配置は捨てる
+    constexpr size_t MAX_TEXT_LAYOUTS = 4096u;               // 覚えておく文字列の配置の上限 (超えたら全部捨てる)
+
+    thread_local DrawContext* t_pDrawContext = nullptr;      // このスレッドが記録中のコンテキスト (nullなら即時コンテキスト)
+
+    //--------------
+    // 遅延コンテキストで並列に記録するキューか (UIとStringは外部の描画があるので即時)
+    //--------------
+    constexpr bool IsParallelQueue(RenderQueue queue)
+    {
+        return queue != RenderQueue::UI && queue != RenderQueue::String;
+    }
+
+    //--------------
+    // 文字列のハッシュ (FNV-1a フォントが1つなので文字列だけで引く)
+    //--------------
+    uint64_t HashText(std::string_view text)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : text)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    //--------------
+    // UTF-8から1文字取り出す (壊れたバイトは1バイトを'?'にする)
+    //--------------
+    char32_t DecodeUtf8(std::string_view text, size_t& index)
+    {
+        uint8_t lead = static_cast<uint8_t>(text[index++]);
+        if (lead < 0x80u) return lead;
+
+        size_t follow = lead >= 0xF0u ? 3u : lead >= 0xE0u ? 2u : lead >= 0xC0u ? 1u : 0u;
+        if (follow == 0u || index + follow > text.size()) return U'?';
+
+        char32_t code = lead & (0x3Fu >> follow);
+        for (size_t cnt = 0u; cnt < follow; ++cnt)
+        {
+            uint8_t trail = static_cast<uint8_t>(text[index]);
+            if ((trail & 0xC0u) != 0x80u) return U'?';
+            code = (code << 6) | (trail & 0x3Fu);
+            ++index;
+        }
+        return code;
+    }
+
+    //--------------
+    // 定数バッファの大きさを揃える関数
+    //--------------
+    constexpr UINT AlignConstantSize(UINT size)
+    {
+        return (size + CONSTANT_ALIGNMENT - 1u) & ~(CONSTANT_ALIGNMENT - 1u);
+    }
+
+    //--------------
+    // 色のテクスチャはTYPELESSで作りSRGBで読む (対応していない形式はそのまま)
+    //--------------
+    void SelectSrgbFormats(DXGI_FORMAT format, DXGI_FORMAT& outResourceFormat, DXGI_FORMAT& outViewFormat)
+    {
+        outResourceFormat = format;
+        outViewFormat = format;
+        switch (format)
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM: outResourceFormat = DXGI_FORMAT_R8G8B8A8_TYPELESS; outViewFormat = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; break;
+        case DXGI_FORMAT_B8G8R8A8_UNORM: outResourceFormat = DXGI_FORMAT_B8G8R8A8_TYPELESS; outViewFormat = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB; break;
+        case DXGI_FORMAT_BC1_UNORM:      outResourceFormat = DXGI_FORMAT_BC1_TYPELESS;      outViewFormat = DXGI_FORMAT_BC1_UNORM_SRGB;      break;
+        case DXGI_FORMAT_BC2_UNORM:      outResourceFormat = DXGI_FORMAT_BC2_TYPELESS;      outViewFormat = DXGI_FORMAT_BC2_UNORM_SRGB;      break;
+        case DXGI_FORMAT_BC3_UNORM:      outResourceFormat = DXGI_FORMAT_BC3_TYPELESS;      outViewFormat = DXGI_FORMAT_BC3_UNORM_SRGB;      break;
+        default: break;
+        }
+    }
+}
+
 //----------------------------
 // レンダラー
 //----------------------------
-class RendererImpl
+class RendererImpl final : public RenderBackend
 {
 public:
     // MRT用の定数
     static constexpr int GBUFFER_COUNT = 4;     // ColorD, Normal, Position, ColorE
-    static constexpr int SHADOWMAP_SIZE = 8192; // シャドウマップの解像度 2048,4096,8192
+    static constexpr UINT PASS_INPUT_SLOTS = 6u; // パスの入力に使うSRVスロット (0:テクスチャ 1-4:Gバッファ 5:シャドウ)
+    static constexpr unsigned int MIN_SHADOWMAP_SIZE = 512u;  // シャドウマップの解像度の範囲
+    static constexpr unsigned int MAX_SHADOWMAP_SIZE = 8192u; //
+    static constexpr size_t FRAME_TIMER_COUNT = 4u;           // GPUのフレーム時間を読むまでのフレーム数 (終わるのを待たないで読めるように)
 
     RendererImpl();
-    ~RendererImpl();
+    ~RendererImpl() override;
 
-    void init(HWND handle, long width, long height);
-    void uninit();
-    bool render(const Scene& scene, std::function<void()> guiRender, Renderer& inter);
-    void beginShadow(Matrix lightView, Matrix lightProj);
+    void init(HWND handle, long width, long height) override;
+    void uninit() override;
+    bool render(const Scene& scene, std::function<void()> guiRender, Renderer& inter) override;
+    void beginShadow(const ShadowCascade& cascade, UINT cascadeIndex, ID3D11DepthStencilView* pDSV, bool isClear);
+    void drawShadowCascade(const ShadowCascade& cascade, UINT cascadeIndex, bool isCacheable, Renderer& inter);
     void endShadow();
     void beginGeometry(Matrix cameraView, Matrix cameraProj);
     void endGeometry();
@@ -255,24 +690,34 @@ public:
 
     bool uploadTextures(const TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback = {});
 
-    MeshHandle createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount);
-    bool setMesh(const MeshHandle& handle);
-
-    bool setTexture(const TextureHandle& handle);
-    bool setTransformWorld(const Matrix& matrix);
-    bool setTransformView(const Matrix& matrix);
-    bool setTransformProjection(const Matrix& matrix);
-    bool setCameraPosition(const Vector3& cameraPos);
-    bool setMaterial(const Material& material);
-    bool setLight(std::span<const LightData> lights, const Color& ambient);
-    bool setFog(const FogData& fog);
-    bool drawMesh(const MeshHandle& handle);
-    bool drawIndexedPrimitive(VertexShaderType vertexShaderType, unsigned int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation);
-    bool setBoneTransforms(std::span<const Matrix> boneTransforms);
-    void drawDecal(Matrix transform, const MeshHandle& handle, Color color);
+    MeshHandle createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount) override;
+    MeshHandle createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount) override;
+    bool updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount) override;
+    void releaseMesh(const MeshHandle& handle) override;
+    bool setMesh(const MeshHandle& handle) override;
+    bool getMeshBounds(const MeshHandle& handle, AABB& outBounds) const override;
+
+    bool setTexture(const TextureHandle& handle) override;
+    bool setTransformWorld(const Matrix& matrix) override;
+    bool setTransformView(const Matrix& matrix) override;
+    bool setTransformProjection(const Matrix& matrix) override;
+    bool setCameraPosition(const Vector3& cameraPos) override;
+    bool setMaterial(const Material& material) override;
+    bool setLight(std::span<const LightData> lights, const Color& ambient) override;
+    bool setFog(const FogData& fog) override;
+    bool drawMesh(const MeshHandle& handle) override;
+    bool drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances) override;
+    bool drawIndexedPrimitive(VertexShaderType vertexShaderType, unsigned int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation) override;
+    bool setBoneTransforms(std::span<const Matrix> boneTransforms) override;
+    void drawDecal(Matrix transform, const MeshHandle& handle, Color color) override;
+    void drawShadowPass();
     void drawLightingPass();
-    void drawPostProcessPass(PostProcessShaderMask mask, ToneMappingType type);
+    void drawForwardPass();
+    void drawPostProcess(PostProcessShaderType type, FrameTarget target, std::span<ID3D11ShaderResourceView* const> sources, const Vector2& blurDir = Vector2::Zero(), float bloomThreshold = 0.1f);
     void drawString(std::string_view string, Vector2 pos = { 0,0 }, Color color = Color::White(), float angle = 0.0f, Vector2 scale = { 1,1 });
+    void beginString();
+    void endString();
+    const TextLayout& findTextLayout(std::string_view string);
 
     void setShadowMode();
     void setGeometryMode();
@@ -282,42 +727,97 @@ public:
     void setOutlineMode();
     void setSkyMode();
     void setBlendMode(BlendMode blendMode);
-    void setRasMode(RasMode rasMode);
+    void setRasMode(RasMode rasMode) override;
     void setDepthMode(DepthMode depthMode);
     void setSampMode(SampMode sampMode);
-    void setOutlineData(Color color, float width);
+    void setOutlineData(Color color, float width) override;
     void setScissorRect(int left, int top, int right, int bottom);
     void setPass(RenderPass pass) { m_currentPass = pass; }
     void setForwardPass(ForwardSubPass subPass) { m_currentForwardSubPass = subPass; }
 
-    void setPostProcessShaderMask(PostProcessShaderMask mask) { m_postProcessMask = mask; }
-    void setToneMappingType(ToneMappingType type) { m_toneMappingType = type; }
-
-    void onResize(int width, int height);
-    void getViewportSize(Vector2& size) const { size = m_viewportSize; }
-    void getScreenSizeMagnification(Vector2& magnification) const { magnification = m_screenMagnification; }
-
-    ID3D11Device* getDevice() const;
-    ID3D11DeviceContext* getContext() const;
-    HWND getRegisteredHWND() const;
+    void setPostProcessShaderMask(PostProcessShaderMask mask) override { m_postProcessMask = mask; }
+    void setToneMappingType(ToneMappingType type) override { m_toneMappingType = type; }
+    void setShadowSettings(const ShadowSettings& settings) override;
+    void setTextureStreamingSettings(const TextureStreamingSettings& settings) override;
+    void setOcclusionCullingSettings(const OcclusionCullingSettings& settings) override { m_occlusionCuller.setSettings(settings); }
+    void setDynamicResolutionSettings(const DynamicResolutionSettings& settings) override { m_dynamicResolution.setSettings(settings); }
+
+    void onResize(int width, int height) override;
+    void getViewportSize(Vector2& size) const override { size = m_viewportSize; }
+    void getStateStats(RenderStateStats& stats) const override { stats = m_lastStateStats; }
+    void getTextureStreamingStats(TextureStreamingStats& stats) const override;
+    void getOcclusionCullingStats(OcclusionCullingStats& stats) const override { m_occlusionCuller.getStats(stats); }
+    void getDynamicResolutionStats(DynamicResolutionStats& stats) const override;
+    void getScreenSizeMagnification(Vector2& magnification) const override { magnification = m_screenMagnification; }
+
+    ID3D11Device* getDevice() const override;
+    ID3D11DeviceContext* getContext() const override;
+    HWND getRegisteredHWND() const override;
 
 private:
     void setupDevice(HWND handle);
     void setupShader();
     void setupDummy();
     void setupState();
-    void setupSceneBuffer();
-    void setupGBuffer();
+    void compileRenderGraph(PostProcessShaderMask mask);
+    void setupGraphTextures();
     void setupShadowMap();
+    void setupLightClusters();
     void setupFont();
-    void releaseSceneBuffer();
-    void releaseGBuffer();
+    void releaseGraphTextures();
+    void setupFrameTimers();
+    void releaseFrameTimers();
+    void beginFrameTimer();
+    void endFrameTimer();
+    void updateDynamicResolution();
+    void prepareGraphPass(const RenderGraphCompiledPass& pass);
+    ID3D11RenderTargetView* getTargetRTV(FrameTarget target) const;
+    ID3D11ShaderResourceView* getTargetSRV(FrameTarget target) const;
     void releaseShadowMap();
+    void releaseLightClusters();
+    void updateLightClusters(const Matrix& cameraView, const Matrix& cameraProj);
+    void bindLightClusters();
     void setLightingPassMode();
+    void setPassPixelShader();
+    void setupConstantRing(DrawContext& dc);
+    void resetConstantRing(DrawContext& dc);
+    void setupDrawContexts();
+    DrawContext& currentDrawContext() { return (t_pDrawContext != nullptr) ? *t_pDrawContext : m_immediateDraw; }
+    void capturePassState(PassState& outState);
+    void applyPassState(DrawContext& dc, const PassState& state);
+    void recordDrawItems(RenderQueue queue, std::span<const DrawItem* const> items, Renderer& inter);
+    VertexShaderType getMeshShaderType(const MeshHandle& handle) const;
+    void reserveConstantRing(UINT size = MAX_DRAW_CONSTANT_BYTES);
+    const ConstantBlock& commitConstantBlock(ConstantBlockType type, ID3D11Buffer* pStaticBuffer, const void* pData, UINT size, UINT bindSize = 0u);
+    void markConstantDirty(ConstantBlockType type) { currentDrawContext().constantBlocks[size_t(type)].isDirty = true; }
+    void bindConstantBuffer(ShaderStage stage, UINT slot, ID3D11Buffer* pBuffer, UINT firstConstant = 0u, UINT numConstants = 0u);
+    void bindConstantBuffer(ShaderStage stage, UINT slot, const ConstantBlock& block) { bindConstantBuffer(stage, slot, block.pBuffer, block.firstConstant, block.numConstants); }
+    void invalidateStateCache();
+    template<typename T> bool filterState(CachedState<T>& state, const T& value);
+    void bindVertexShader(ID3D11VertexShader* pShader);
+    void bindPixelShader(ID3D11PixelShader* pShader);
+    void bindInputLayout(ID3D11InputLayout* pInputLayout);
+    void bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+    void bindVertexBuffer(UINT slot, ID3D11Buffer* pBuffer, UINT stride, UINT offset = 0u);
+    void bindIndexBuffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, UINT offset = 0u);
+    void bindPSResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* ppResources);
+    void bindPSSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* ppSamplers);
+    void bindRenderTargets(UINT count, ID3D11RenderTargetView* const* ppRTVs, ID3D11DepthStencilView* pDSV);
     void setPostProcessMode();
     void setVPMatrix(Matrix view, Matrix proj);
     void setOrthographic();
     void createTexture(std::shared_ptr<TextureData> spTextureData, uint32_t id);
+    bool decodeTexture(const TextureData& textureData, DirectX::ScratchImage& outImage) const;
+    bool createTextureResource(const DirectX::ScratchImage& image, unsigned int firstMip, bool isColor, ComPtr<ID3D11Texture2D>& outTexture, ComPtr<ID3D11ShaderResourceView>& outSRV) const;
+    void updateTextureStreaming();
+    bool evictTextureMips(uint32_t id, unsigned int mip);
+    void replaceStreamingTexture(uint32_t id, unsigned int mip, const ComPtr<ID3D11Texture2D>& pTexture, const ComPtr<ID3D11ShaderResourceView>& pSRV);
+    void requestTextureMips(const DrawContext& dc, VertexShaderType type, const Matrix& world);
+    bool allocateGeometry(UINT bindFlags, UINT stride, const void* data, size_t count, uint32_t& outArena, UINT& outOffset);
+    void releaseMeshGeometry(MeshData& mesh);
+    void flushGeometryUploads();
+    void defragmentGeometryArena(uint32_t arenaId);
+    void drawQueue(RenderQueue queue, Renderer& inter, std::span<const uint8_t> visible = {});
 
     // 核
     ComPtr<ID3D11Device> m_pDevice;         // デバイス
@@ -331,29 +831,39 @@ private:
     ComPtr<ID3D11Texture2D> m_pDepthStencilTexture;     // Zバッファ
     ComPtr<ID3D11DepthStencilView> m_pDepthStencilView; // Zバッファ書き込み
 
-    // scene描画先
-    ComPtr<ID3D11Texture2D> m_pSceneTexture;      // シーン画像本体
-    ComPtr<ID3D11RenderTargetView> m_pSceneRTV;   // 書き込み用
-    ComPtr<ID3D11ShaderResourceView> m_pSceneSRV; // 読み込み用
-
-    // scene加工用描画先
-    ComPtr<ID3D11Texture2D> m_pWorkTexture;      // シーン画像本体
-    ComPtr<ID3D11RenderTargetView> m_pWorkRTV;   // 書き込み用
-    ComPtr<ID3D11ShaderResourceView> m_pWorkSRV; //　読み込み用
-
-    // ブルーム用描画先
-    std::array<ComPtr<ID3D11RenderTargetView>, 2> m_pBloomRTVs;
-    std::array<ComPtr<ID3D11ShaderResourceView>, 2> m_pBloomSRVs;
-
-    // G-Buffer描画先
-    std::array<ComPtr<ID3D11Texture2D>, GBUFFER_COUNT> m_pGBufferTextures;      // 実体 (テクスチャ)
-    std::array<ComPtr<ID3D11RenderTargetView>, GBUFFER_COUNT> m_pGBufferRTVs;   // 書き込み用
-    std::array<ComPtr<ID3D11ShaderResourceView>, GBUFFER_COUNT> m_pGBufferSRVs; // 読み込み用
-
-    // シャドウマップ描画先
-    ComPtr<ID3D11Texture2D> m_pShadowTexture;      // 実体 (テクスチャ)
-    ComPtr<ID3D11DepthStencilView> m_pShadowDSV;   // 書き込み用
-    ComPtr<ID3D11ShaderResourceView> m_pShadowSRV; // 読み込み用
+    // フレームのパスと描画先 (Gバッファ,シーン,ポストプロセスの描画先はグラフが寿命の重ならないものに実体を使い回す)
+    RenderGraph m_renderGraph;                                           // パスの読み書き (ポストプロセスの設定ごとにコンパイルする)
+    std::array<uint32_t, size_t(FrameTarget::Max)> m_frameTargets;       // 描画先のグラフでの番号
+    std::vector<GraphTexture> m_graphTextures;                           // 描画先の実体 (画面サイズが変わったら作り直す)
+    PostProcessShaderMask m_graphMask;                                   // コンパイルした時のポストプロセス
+    bool m_isGraphDirty;                                                 // コンパイルし直す
+    FrameCamera m_frameCamera;                                           // カメラごとのパスが描くカメラ
+
+    // 動的解像度 (GPUのフレーム時間から3Dを描く大きさを決め,描画先の左上だけに描いて最後のパスで画面に引き伸ばす)
+    DynamicResolution m_dynamicResolution;                               // 割合の制御
+    std::array<FrameTimer, FRAME_TIMER_COUNT> m_frameTimers;             // GPUのフレーム時間のクエリ (フレームごとに順に使う)
+    size_t m_frameTimerIndex;                                            // 今のフレームのクエリ
+    Vector2 m_sceneSize;                                                 // 3Dを描く大きさ (ビューポート 描画先は画面サイズのまま)
+
+    // シャドウマップ描画先 (カスケードごとのスライスを持つ配列テクスチャ)
+    ComPtr<ID3D11Texture2D> m_pShadowTexture;                                        // 実体 (テクスチャ)
+    std::array<ComPtr<ID3D11DepthStencilView>, MAX_SHADOW_CASCADES> m_pShadowDSVs;  // 書き込み用 (スライスごと)
+    ComPtr<ID3D11ShaderResourceView> m_pShadowSRV;                                   // 読み込み用 (全スライス)
+    ShadowSettings m_shadowSettings;                                                 // 影の設定
+    ShadowCascadeSet m_shadowCascades;                                               // 今のカメラのカスケード
+
+    // 動かない影のキャッシュ (ライトとキャッシュする影が変わらない限り描き直さず,シャドウマップに写して動く影を重ねる)
+    ComPtr<ID3D11Texture2D> m_pStaticShadowTexture;                                  // 実体 (シャドウマップと同じ形式)
+    std::array<ComPtr<ID3D11DepthStencilView>, MAX_SHADOW_CASCADES> m_pStaticShadowDSVs; // 書き込み用 (スライスごと)
+    StaticShadowCache m_staticShadowCache;                                           // キャッシュを描いたときの状態
+
+    // クラスターライト (点光源はカメラごとにクラスターへ振り分けてStructuredBufferで渡す)
+    std::vector<LightData> m_pointLights;                                            // setLightで渡された点光源
+    LightClusterGrid m_lightClusters;                                                // 今のカメラの振り分け
+    ComPtr<ID3D11Buffer> m_pPointLightBuffer;                                        // 点光源 (t6)
+    ComPtr<ID3D11Buffer> m_pLightClusterBuffer;                                      // クラスターごとの範囲 (t7)
+    ComPtr<ID3D11Buffer> m_pLightIndexBuffer;                                        // ライト番号リスト (t8)
+    std::array<ComPtr<ID3D11ShaderResourceView>, 3> m_pLightClusterSRVs;             // ↑の読み込み用
 
     // 影用シェーダ
     ComPtr<ID3D11PixelShader> m_pShadowPS;         // アルファテストして深度を返す
@@ -361,6 +871,7 @@ private:
     // シェーダ (G-Buffer)
     ComPtr<ID3D11VertexShader> m_pVertexShader2D;    // 2D頂点シェーダ
     ComPtr<ID3D11VertexShader> m_pVertexShader3D;    // 3D頂点シェーダ
+    ComPtr<ID3D11VertexShader> m_pVertexShader3DInstanced; // 3D頂点シェーダ (インスタンシング)
     ComPtr<ID3D11VertexShader> m_pVertexShaderModel; // スキニング頂点シェーダ
     ComPtr<ID3D11PixelShader> m_pGeometryPS;         // ピクセルシェーダ (G-Bufferに分割して送るためのシェーダ)
 
@@ -388,6 +899,7 @@ private:
     // レイアウト
     ComPtr<ID3D11InputLayout> m_pInputLayout2D;    // 2D頂点レイアウト
     ComPtr<ID3D11InputLayout> m_pInputLayout3D;    // 3D頂点レイアウト
+    ComPtr<ID3D11InputLayout> m_pInputLayout3DInstanced; // 3D頂点レイアウト (インスタンシング)
     ComPtr<ID3D11InputLayout> m_pInputLayoutModel; // スキニング頂点レイアウト
 
     // 定数バッファ
@@ -395,16 +907,12 @@ private:
     VPMatBufferData m_vpMatData;                  // 行列のキャッシュ
     ComPtr<ID3D11Buffer> m_pLightBuffer;          // ライトのバッファ
     LightBufferData m_lightData;                  // ライトのキャッシュ
-    ComPtr<ID3D11Buffer> m_pWMatBuffer;           // 行列のバッファ
-    WorldMatBufferData m_wMatData;                // 行列のキャッシュ
-    ComPtr<ID3D11Buffer> m_pMtlBuffer;            // マテリアルのバッファ
-    MaterialBufferData m_mtlData;                 // マテリアルのキャッシュ
+    ComPtr<ID3D11Buffer> m_pWMatBuffer;           // 行列のバッファ (キャッシュはDrawContext)
+    ComPtr<ID3D11Buffer> m_pMtlBuffer;            // マテリアルのバッファ (キャッシュはDrawContext)
     ComPtr<ID3D11Buffer> m_pShadowConstantBuffer; // シャドウのバッファ
-    Matrix m_lightVPMatrix;                       // ライトの View * Proj
-    ComPtr<ID3D11Buffer> m_pBoneBuffer;           // ボーン行列のバッファ
-    BoneBufferData m_boneData;                    // ボーン行列のキャッシュ
-    ComPtr<ID3D11Buffer> m_pOutlineBuffer;        // アウトラインのバッファ
-    OutlineBufferData m_outlineData;              // アウトラインのキャッシュ
+    ShadowBufferData m_shadowData;                // シャドウのキャッシュ
+    ComPtr<ID3D11Buffer> m_pBoneBuffer;           // ボーン行列のバッファ (キャッシュはDrawContext)
+    ComPtr<ID3D11Buffer> m_pOutlineBuffer;        // アウトラインのバッファ (キャッシュはDrawContext)
     ComPtr<ID3D11Buffer> m_pFogBuffer;            // フォグのバッファ
     FogBufferData m_fogData;                      // フォグのキャッシュ
     ComPtr<ID3D11Buffer> m_pDecalBuffer;          // デカールのバッファ
@@ -425,10 +933,23 @@ private:
 
     // 登録されたメッシュのキャッシュ
     std::vector<MeshData> m_meshs;
+    std::vector<GeometryArena> m_geometryArenas;       // 頂点とインデックスのアリーナ
+    std::vector<GeometryUpload> m_geometryUploads;     // アリーナへの書き込み待ち
+    std::vector<uint32_t> m_pendingMeshes;             // ↑が終われば描画できるメッシュ
+    std::vector<OffsetAllocator::Move> m_arenaMoves;   // 詰め直しの作業用
+    mutable std::shared_mutex m_meshMutex; // ↑5つのmutex (記録スレッドは読むだけ)
 
     // 登録されたテクスチャのキャッシュ
     std::unordered_map<uint32_t, ComPtr<ID3D11ShaderResourceView>> m_textures;
-    std::mutex m_texMutex;
+    std::shared_mutex m_texMutex;          // ↑のmutex (記録スレッドは読むだけ)
+
+    // テクスチャストリーミング (SRVの差し替えはフレームの先頭だけ)
+    TextureResidency m_textureResidency;                                   // ミップの常駐管理 (要求は記録スレッドからも来る)
+    std::unordered_map<uint32_t, StreamingTexture> m_streamingTextures;    // ストリーミングするテクスチャ
+    std::vector<std::unique_ptr<StreamingTask>> m_streamingTasks;          // 読み込み中のミップ
+    std::vector<TextureResidencyChange> m_residencyChanges;                // このフレームの常駐の変更
+    mutable std::mutex m_streamMutex;                                      // ↑4つのmutex (読み込みスレッドから登録される)
+    Matrix m_streamingViewProj;                                            // 画面上の大きさを測るカメラの View * Proj
 
     // テクスチャなしの時に使うテクスチャ
     ComPtr<ID3D11ShaderResourceView> m_pDummyTextureWhite; // 白
@@ -441,9 +962,29 @@ private:
     // スプライトバッチとフォント
     std::unique_ptr<DirectX::SpriteBatch> m_spriteBatch;
     std::unique_ptr<DirectX::SpriteFont> m_spriteFont;
+    ComPtr<ID3D11ShaderResourceView> m_pFontSheet;                     // フォントのシート
+    std::unordered_map<uint64_t, TextLayout> m_textLayouts;            // 文字列の配置のキャッシュ (文字列のハッシュ)
+    uint64_t m_textBatchCount;                                         // 開いたバッチの数 (キャッシュの古さを測る)
+    bool m_isTextBatchOpen;                                            // Stringキューのバッチを開いている (drawStringは積むだけ)
+
+    // 描画アイテム (毎フレーム作り直す)
+    DrawList m_drawList;                                               // カリングとソート済みの描画アイテム
+
+    // カリング (境界ボックスはフレームごと,可視判定はカメラとライトごと)
+    std::vector<uint8_t> m_cameraVisible;                              // カメラから見えるか
+    OcclusionCuller m_occlusionCuller;                                 // 遮蔽物の奥に隠れたものを除く (カメラごと)
+    std::vector<uint8_t> m_shadowVisible;                              // ライトから見えるか
+    std::vector<uint8_t> m_staticShadowVisible;                        // ↑のうち動かない影
+    std::vector<uint8_t> m_dynamicShadowVisible;                       // ↑のうち動く影
+
+    // 描画を記録するコンテキスト (描画ごとの定数,定数バッファリング,ステートの影,インスタンスバッファを持つ)
+    DrawContext m_immediateDraw;                                       // 即時コンテキスト
+    std::vector<std::unique_ptr<DrawContext>> m_deferredDraws;         // 記録スレッドごとの遅延コンテキスト (2つ未満なら並列にしない)
+    std::vector<const DrawItem*> m_queueItems;                         // 記録するキューの見えている描画アイテム
+    RenderStateStats m_lastStateStats;                                 // 前のフレームのステート設定の統計 (全コンテキストの合計)
 };
 
-RendererImpl::RendererImpl() : m_pDevice(nullptr), m_pContext(nullptr), m_pSwapChain(nullptr), m_hWnd{}, m_pRenderTargetView(nullptr), m_pDepthStencilView(nullptr), m_pDepthStencilTexture(nullptr), m_pSceneTexture{}, m_pSceneRTV{}, m_pSceneSRV{}, m_pVertexShader2D(nullptr), m_pVertexShader3D(nullptr), m_pGeometryPS(nullptr), m_pInputLayout2D(nullptr), m_pInputLayout3D(nullptr), m_pWMatBuffer(nullptr), m_wMatData{}, m_pMtlBuffer(nullptr), m_mtlData{}, m_pVPMatBuffer(nullptr), m_vpMatData{}, m_pLightBuffer(nullptr), m_lightData{}, m_samplerStates{}, m_pDummyTextureWhite(nullptr), m_pDummyTextureBlack(nullptr), m_pInputLayoutModel(nullptr), m_pBoneBuffer(nullptr), m_boneData{}, m_pVertexShaderModel(nullptr), m_pGBufferTextures{}, m_pGBufferRTVs{}, m_pGBufferSRVs{}, m_pScreenVS{}, m_blendStates{}, m_depthStates{}, m_rasStates{}, m_textures{}, m_screenSize{}, m_screenMagnification{}, m_viewportSize{}, m_pShadowTexture{}, m_pShadowDSV{}, m_pShadowSRV{}, m_currentPass{}, m_currentForwardSubPass{}, m_pShadowConstantBuffer{}, m_lightVPMatrix{}, m_pSkyPS{}, m_pTransparentPS{}, m_pOutline3DVS{}, m_pOutlineModelVS{}, m_pOutlinePS{}, m_pOutlineBuffer{}, m_outlineData{}, m_pShadowPS{}, m_pFogBuffer{}, m_texMutex{}, m_spriteBatch{}, m_spriteFont{}, m_pDecalBuffer(nullptr), m_pDecalVS(nullptr), m_pDecalPS(nullptr), m_pPostProcessShaders{}, m_pPostProcessBuffer{}, m_pWorkTexture{}, m_pWorkRTV{}, m_pWorkSRV{}, m_pBloomRTVs{}, m_pBloomSRVs{}, m_meshs{}, m_pUnifiedLighting_DL_PS{}, m_pUIPS{}, m_postProcessMask{}, m_toneMappingType{} {}
+RendererImpl::RendererImpl() : m_pDevice(nullptr), m_pContext(nullptr), m_pSwapChain(nullptr), m_hWnd{}, m_pRenderTargetView(nullptr), m_pDepthStencilView(nullptr), m_pDepthStencilTexture(nullptr), m_renderGraph{}, m_frameTargets{}, m_graphTextures{}, m_graphMask{}, m_isGraphDirty{ true }, m_frameCamera{}, m_dynamicResolution{}, m_frameTimers{}, m_frameTimerIndex{}, m_sceneSize{}, m_pVertexShader2D(nullptr), m_pVertexShader3D(nullptr), m_pGeometryPS(nullptr), m_pInputLayout2D(nullptr), m_pInputLayout3D(nullptr), m_pWMatBuffer(nullptr), m_pMtlBuffer(nullptr), m_pVPMatBuffer(nullptr), m_vpMatData{}, m_pLightBuffer(nullptr), m_lightData{}, m_samplerStates{}, m_pDummyTextureWhite(nullptr), m_pDummyTextureBlack(nullptr), m_pInputLayoutModel(nullptr), m_pBoneBuffer(nullptr), m_pVertexShaderModel(nullptr), m_pScreenVS{}, m_blendStates{}, m_depthStates{}, m_rasStates{}, m_textures{}, m_screenSize{}, m_screenMagnification{}, m_viewportSize{}, m_pShadowTexture{}, m_pShadowDSVs{}, m_pShadowSRV{}, m_shadowSettings{}, m_shadowCascades{}, m_pStaticShadowTexture{}, m_pStaticShadowDSVs{}, m_staticShadowCache{}, m_pointLights{}, m_lightClusters{}, m_pPointLightBuffer{}, m_pLightClusterBuffer{}, m_pLightIndexBuffer{}, m_pLightClusterSRVs{}, m_currentPass{}, m_currentForwardSubPass{}, m_pShadowConstantBuffer{}, m_shadowData{}, m_pSkyPS{}, m_pTransparentPS{}, m_pOutline3DVS{}, m_pOutlineModelVS{}, m_pOutlinePS{}, m_pOutlineBuffer{}, m_pShadowPS{}, m_pFogBuffer{}, m_meshMutex{}, m_texMutex{}, m_spriteBatch{}, m_spriteFont{}, m_pFontSheet{}, m_textLayouts{}, m_textBatchCount{}, m_isTextBatchOpen{}, m_pDecalBuffer(nullptr), m_pDecalVS(nullptr), m_pDecalPS(nullptr), m_pPostProcessShaders{}, m_pPostProcessBuffer{}, m_meshs{}, m_geometryArenas{}, m_geometryUploads{}, m_pendingMeshes{}, m_arenaMoves{}, m_pUnifiedLighting_DL_PS{}, m_pUIPS{}, m_postProcessMask{}, m_toneMappingType{}, m_drawList{}, m_cameraVisible{}, m_occlusionCuller{}, m_shadowVisible{}, m_staticShadowVisible{}, m_dynamicShadowVisible{}, m_pVertexShader3DInstanced{}, m_pInputLayout3DInstanced{}, m_immediateDraw{}, m_deferredDraws{}, m_queueItems{}, m_lastStateStats{}, m_textureResidency{}, m_streamingTextures{}, m_streamingTasks{}, m_residencyChanges{}, m_streamMutex{}, m_streamingViewProj{} {}
 RendererImpl::~RendererImpl() { uninit(); }
 
 //-------------------------------------------
@@ -456,22 +997,28 @@ void RendererImpl::init(HWND handle, long width, long height)
     // サイズと倍率を保存する
     m_screenSize = Vector2(static_cast<float>(width), static_cast<float>(height));
     m_screenMagnification = Vector2(static_cast<float>(width) / DEFAULT_SCREEN_SIZE.x, static_cast<float>(height) / DEFAULT_SCREEN_SIZE.y);
+    m_sceneSize = m_screenSize;
 
     // デバイスなどの核を生成する
     setupDevice(handle);
 
+    // GPUのフレーム時間を測るクエリを生成する (動的解像度は上限から始める)
+    setupFrameTimers();
+    m_dynamicResolution.reset();
+
     // シェーダーを生成する
     setupShader();
 
-    // シーン描画先を生成する
-    setupSceneBuffer();
-
-    // MRTを生成する
-    setupGBuffer();
+    // フレームのパスを組み,描画先を生成する
+    compileRenderGraph(m_postProcessMask);
+    setupGraphTextures();
 
     // シャドウマップを生成する
     setupShadowMap();
 
+    // クラスターライトのバッファを生成する
+    setupLightClusters();
+
     // ダミーテクスチャを生成する
     setupDummy();
 
@@ -491,11 +1038,32 @@ void RendererImpl::uninit()
     m_pDummyTextureBlack.Reset();
     m_pDummyTextureWhite.Reset();
 
+    // ストリーミングの読み込みを待って破棄
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        for (auto& upTask : m_streamingTasks)
+        {
+            if (upTask->result.valid()) upTask->result.wait();
+        }
+        m_streamingTasks.clear();
+        m_streamingTextures.clear();
+        m_textureResidency.unregisterAll();
+    }
+
     // 登録テクスチャ破棄
-    m_textures.clear();
+    {
+        std::lock_guard<std::shared_mutex> lock(m_texMutex);
+        m_textures.clear();
+    }
 
     // メッシュ破棄
-    m_meshs.clear();
+    {
+        std::lock_guard<std::shared_mutex> lock(m_meshMutex);
+        m_meshs.clear();
+        m_geometryArenas.clear();
+        m_geometryUploads.clear();
+        m_pendingMeshes.clear();
+    }
 
     // State破棄
     m_samplerStates.fill(nullptr);
@@ -506,11 +1074,20 @@ void RendererImpl::uninit()
     // シャドウマップ破棄
     releaseShadowMap();
 
-    // MRT破棄
-    releaseGBuffer();
+    // クラスターライト破棄
+    releaseLightClusters();
+
+    // フレームの描画先破棄
+    releaseGraphTextures();
+    m_renderGraph.reset();
+    m_isGraphDirty = true;
 
-    // シーン描画先破棄
-    releaseSceneBuffer();
+    // フレーム時間のクエリ破棄
+    releaseFrameTimers();
+
+    // 描画を記録するコンテキスト破棄 (定数バッファリングとインスタンスバッファも)
+    m_deferredDraws.clear();
+    m_immediateDraw = DrawContext();
 
     // 定数バッファ破棄
     m_pPostProcessBuffer.Reset();
@@ -527,6 +1104,7 @@ void RendererImpl::uninit()
     // 入力レイアウト破棄
     m_pInputLayout2D.Reset();
     m_pInputLayout3D.Reset();
+    m_pInputLayout3DInstanced.Reset();
     m_pInputLayoutModel.Reset();
 
     // シェーダー破棄
@@ -549,6 +1127,7 @@ void RendererImpl::uninit()
     m_pVertexShaderModel.Reset();
     m_pVertexShader2D.Reset();
     m_pVertexShader3D.Reset();
+    m_pVertexShader3DInstanced.Reset();
 
     // 深度ステンシルビュー破棄
     m_pDepthStencilView.Reset();
@@ -578,138 +1157,93 @@ bool RendererImpl::render(const Scene& scene, std::function<void()> guiRender, R
     auto lights = scene.getGameObjectsOfType<LightComponent>();
     auto renderComponents = scene.getGameObjectsOfType<RenderComponent>();
 
-    for (size_t cnt = 0; cnt < cameras.size(); cnt++)
-    {
-        // レンダラーにカメラの位置を渡す(スペキュラー用)
-        setCameraPosition(cameras[cnt]->get().GetPosition());
-
-        // Cameraの行列
-        Matrix CameraView = cameras[cnt]->get().GetViewMatrix(), CameraProj = cameras[cnt]->get().GetProjectionMatrix();
-
-        //-------------------------
-        // シャドウ開始
-        //-------------------------
-        for (const auto& light : lights)
-        {
-            Vector3 eye{}, target, up{};
-            if (light->getShadowInfo(&eye, &target, &up))
-            {
-                beginShadow(Matrix::LookAtLH(eye, target, up), Matrix::Orthographic(40.0f, 40.0f, 0.5f, 100.0f)); // シャドウマップ範囲
-
-                for (auto& renderComponent : renderComponents)
-                {
-                    if (renderComponent->getRenderQueue() == RenderQueue::Shadow)
-                        renderComponent->render(inter);
-                }
-
-                endShadow();
-            }
-        }
-        //-------------------------
-        // シャドウ終了
-        //-------------------------
-
-        //------------------
-        // ジオメトリ開始
-        //------------------
-        beginGeometry(CameraView, CameraProj);
-
-        // プレイヤー
-        setRasMode(RasMode::None);
-        setRasMode(RasMode::Back);
-
-        for (auto& renderComponent : renderComponents)
+    // 前のフレームの統計を全コンテキスト分合わせて残し,数え直す
+    m_lastStateStats = RenderStateStats();
+    auto collectStats = [this](DrawContext& dc)
         {
-            if (renderComponent->getRenderQueue() == RenderQueue::Geometry)
-                renderComponent->render(inter);
-        }
-
-        endGeometry();
-        //-------------------------
-        // ジオメトリ終了
-        //-------------------------
-
-        //------------------
-        // デカール開始
-        //------------------
-        beginDecal(CameraView, CameraProj);
+            m_lastStateStats.issuedCalls += dc.stateStats.issuedCalls;
+            m_lastStateStats.redundantCalls += dc.stateStats.redundantCalls;
+            dc.stateStats = RenderStateStats();
+        };
+    collectStats(m_immediateDraw);
+    for (auto& upDrawContext : m_deferredDraws)
+    {
+        collectStats(*upDrawContext);
+    }
 
-        for (auto& renderComponent : renderComponents)
-        {
-            if (renderComponent->getRenderQueue() == RenderQueue::Decal)
-                renderComponent->render(inter);
-        }
+    // 前に測ったGPUのフレーム時間から3Dを描く大きさを決め,このフレームを測り始める
+    updateDynamicResolution();
+    beginFrameTimer();
 
-        endDecal();
-        //-------------------------
-        // デカール終了
-        //-------------------------
+    // 前のフレームの要求からテクスチャのミップを読み込む,捨てる (SRVを差し替えるのでステートを忘れる前に)
+    updateTextureStreaming();
 
-        //------------------
-        // ライティング
-        //------------------
-        drawLightingPass();
+    // 作られたメッシュをアリーナに書き込み,細切れのアリーナを詰め直す
+    flushGeometryUploads();
 
-        //----------
-        // フォワード開始
-        //----------
-        beginForward(CameraView, CameraProj);
+    // 定数バッファリングをフレームの先頭に戻す (外部の描画が触ったかもしれないのでステートも忘れる)
+    resetConstantRing(m_immediateDraw);
+    invalidateStateCache();
 
-        // 空
-        setSkyMode();
+    // カリング用の境界ボックスを集める (カメラとライトで共有)
+    m_drawList.buildBounds(renderComponents, inter);
+    m_staticShadowCache.beginFrame(m_drawList.getStaticCasterKey()); // 動かない影が動いたり増減したらキャッシュを捨てる
 
-        for (auto& renderComponent : renderComponents)
-        {
-            if (renderComponent->getRenderQueue() == RenderQueue::Sky)
-                renderComponent->render(inter);
-        }
+    // ポストプロセスの設定が変わったらフレームのパスを組み直す (使わないパスを除き,描画先の実体を割り当て直す)
+    if (m_isGraphDirty || m_graphMask != m_postProcessMask)
+    {
+        compileRenderGraph(m_postProcessMask);
+    }
+    setupGraphTextures();
 
-        setForwardMode();
+    for (size_t cnt = 0; cnt < cameras.size(); cnt++)
+    {
+        // レンダラーにカメラの位置を渡す(スペキュラー用)
+        setCameraPosition(cameras[cnt]->get().GetPosition());
 
-        //-----------------------------------------------------------------------
-        // アウトライン (フォワードの中でsetOutlineModeを呼ぶとアウトライン)
-        //-----------------------------------------------------------------------
-        setOutlineMode();
-        setOutlineData(Color::Black(), 0.0005f);
+        // Cameraの行列
+        Matrix CameraView = cameras[cnt]->get().GetViewMatrix(), CameraProj = cameras[cnt]->get().GetProjectionMatrix();
 
-        for (auto& renderComponent : renderComponents)
-        {
-            if (renderComponent->getRenderQueue() == RenderQueue::Outline)
-                renderComponent->render(inter);
-        }
+        // 視錐台の外を除いて描画アイテムをカメラの奥行きでソートする
+        m_streamingViewProj = Matrix::Multiply(CameraView, CameraProj);
+        m_drawList.cull(Frustum(m_streamingViewProj), m_cameraVisible);
 
-        setForwardMode();
-        //-----------------------------------------------------------------------
-        // アウトライン終了
-        //-----------------------------------------------------------------------
+        // 遮蔽物をCPUの深度バッファに描き,その奥に隠れたものを除く (影はライトごとに判定するので影響しない)
+        m_occlusionCuller.build(m_streamingViewProj, m_drawList.getOccluders(), m_cameraVisible, std::max(1u, std::thread::hardware_concurrency()));
+        m_occlusionCuller.cull(m_drawList.getCullBounds(), m_cameraVisible);
+        m_drawList.build(renderComponents, CameraView, m_cameraVisible);
 
-        for (auto& renderComponent : renderComponents)
-        {
-            if (renderComponent->getRenderQueue() == RenderQueue::Transparent)
-                renderComponent->render(inter);
-        }
+        // 点光源をこのカメラのクラスターに振り分ける
+        updateLightClusters(CameraView, CameraProj);
 
-        endForward();
         //-------------------------
-        // フォワード終了
+        // カメラごとのパス (シャドウ,ジオメトリ,デカール,ライティング,フォワード)
         //-------------------------
+        m_frameCamera.view = CameraView;
+        m_frameCamera.proj = CameraProj;
+        m_frameCamera.index = cnt;
+        m_frameCamera.lights = lights;
+        m_frameCamera.pInter = &inter;
+        m_renderGraph.execute(true, [this](const RenderGraphCompiledPass& pass) { prepareGraphPass(pass); });
     }
 
     //------------------
     // ポストプロセス
     //------------------
-    drawPostProcessPass(m_postProcessMask, m_toneMappingType);
+    m_renderGraph.execute(false, [this](const RenderGraphCompiledPass& pass) { prepareGraphPass(pass); });
+
+    // カメラがない場合はUIとStringのためだけに作る
+    if (cameras.empty())
+    {
+        m_drawList.build(renderComponents, Matrix(), {});
+    }
 
     //----------
     // UI開始
     //----------
     beginUI();
 
-    for (auto& renderComponent : renderComponents)
-    {
-        if (renderComponent->getRenderQueue() == RenderQueue::UI)
-            renderComponent->render(inter);
-    }
+    drawQueue(RenderQueue::UI, inter);
 
     endUI();
     //-------------------------
@@ -719,13 +1253,11 @@ bool RendererImpl::render(const Scene& scene, std::function<void()> guiRender, R
     //----------
     // String開始
     //----------
+    beginString();
 
-    for (auto& renderComponent : renderComponents)
-    {
-        if (renderComponent->getRenderQueue() == RenderQueue::String)
-            renderComponent->render(inter);
-    }
+    drawQueue(RenderQueue::String, inter);
 
+    endString();
     //-------------------------
     // String終了
     //-------------------------
@@ -733,6 +1265,12 @@ bool RendererImpl::render(const Scene& scene, std::function<void()> guiRender, R
     // Gui描画(あれば)
     if (guiRender!=nullptr) guiRender();
 
+    // 外部の描画がステートを差し替えているので設定状態を忘れる
+    invalidateStateCache();
+
+    // GPUのフレーム時間を測り終える (読むのは数フレーム後)
+    endFrameTimer();
+
     // 全描画を終了し切り替えを行う
     present();
 
@@ -740,74 +1278,251 @@ bool RendererImpl::render(const Scene& scene, std::function<void()> guiRender, R
 }
 
 //-------------------------------------------
-// 影描画開始
+// キューの描画アイテムを順番に描画 (多ければ遅延コンテキストに分けて並列に記録する)
 //-------------------------------------------
-void RendererImpl::beginShadow(Matrix lightView, Matrix lightProj)
+void RendererImpl::drawQueue(RenderQueue queue, Renderer& inter, std::span<const uint8_t> visible)
 {
-    // 行列のセット
-    setVPMatrix(lightView, lightProj);
-
-    // シャドウマップ用のライトのVP行列をセット
-    setTransformView(lightView);
-    setTransformProjection(lightProj);
-
-    // 影用デプスステンシルビューを設定 (RTVはなし)
-    m_pContext->OMSetRenderTargets(0, nullptr, m_pShadowDSV.Get());
-
-    // デプスクリア
-    clearDepthStencil(m_pShadowDSV.Get());
+    // 見えているものを集める
+    m_queueItems.clear();
+    for (const DrawItem& item : m_drawList.getQueue(queue))
+    {
+        if (item.index < visible.size() && visible[item.index] == 0u)
+        {
+            continue; // カリング済み
+        }
+        m_queueItems.push_back(&item);
+    }
 
-    // シャドウマップ用ビューポート
-    D3D11_VIEWPORT vp = {};
-    vp.Width = (float)SHADOWMAP_SIZE;
-    vp.Height = (float)SHADOWMAP_SIZE;
-    vp.MinDepth = 0.0f;
-    vp.MaxDepth = 1.0f;
-    vp.TopLeftX = 0.0f;
-    vp.TopLeftY = 0.0f;
-    m_pContext->RSSetViewports(1, &vp);
+    // 少ないなら即時コンテキストにそのまま記録
+    size_t chunkCount = IsParallelQueue(queue) ? std::min(m_deferredDraws.size(), m_queueItems.size() / MIN_RECORD_ITEMS) : 0u;
+    if (chunkCount < 2u)
+    {
+        recordDrawItems(queue, m_queueItems, inter);
+        return;
+    }
 
-    // プリミティブトポロジーの設定 (三角形リスト)
-    m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // パスの設定と描画ごとの定数を写してから記録を始める
+    PassState passState{};
+    capturePassState(passState);
+    size_t chunkSize = (m_queueItems.size() + chunkCount - 1u) / chunkCount;
+    auto record = [this, queue, &inter, &passState, chunkSize](size_t chunk)
+        {
+            DrawContext& dc = *m_deferredDraws[chunk];
+            dc.wMatData = m_immediateDraw.wMatData;
+            dc.mtlData = m_immediateDraw.mtlData;
+            dc.boneData = m_immediateDraw.boneData;
+            dc.boneCount = m_immediateDraw.boneCount;
+            dc.outlineData = m_immediateDraw.outlineData;
+            resetConstantRing(dc);
+            applyPassState(dc, passState);
+
+            size_t first = chunk * chunkSize;
+            std::span<const DrawItem* const> items(m_queueItems.data() + first, std::min(chunkSize, m_queueItems.size() - first));
+
+            t_pDrawContext = &dc;
+            recordDrawItems(queue, items, inter);
+            t_pDrawContext = nullptr;
+
+            dc.pContext->FinishCommandList(FALSE, dc.pCommandList.ReleaseAndGetAddressOf());
+        };
+
+    {// 先頭以外をワーカーに任せてメインスレッドは先頭を記録する (抜けるときに全部待つ)
+        std::vector<std::future<void>> tasks;
+        tasks.reserve(chunkCount - 1u);
+        for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+        {
+            tasks.push_back(std::async(std::launch::async, record, chunk));
+        }
+        record(0u);
+        for (auto& task : tasks)
+        {
+            task.get();
+        }
+    }
 
-    // ライトのVP行列を保存
-    m_lightVPMatrix = m_vpMatData.View * m_vpMatData.Proj;
+    // 記録した順に実行する
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        DrawContext& dc = *m_deferredDraws[chunk];
+        if (dc.pCommandList != nullptr)
+        {
+            m_pContext->ExecuteCommandList(dc.pCommandList.Get(), FALSE);
+            dc.pCommandList.Reset();
+        }
+    }
 
-    // 影用モードに変更
-    setShadowMode();
+    // 実行で即時コンテキストの設定は初期状態に戻るので元に戻す
+    applyPassState(m_immediateDraw, passState);
 }
 
 //-------------------------------------------
-// 影描画終了
+// 描画アイテムを今のスレッドのコンテキストに記録 (同じ状態が続く間はインスタンシングでまとめる)
 //-------------------------------------------
-void RendererImpl::endShadow()
+void RendererImpl::recordDrawItems(RenderQueue queue, std::span<const DrawItem* const> items, Renderer& inter)
 {
-    // ターゲット解除
-    m_pContext->OMSetRenderTargets(0, nullptr, nullptr);
+    DrawContext& dc = currentDrawContext();
+    bool isInstancing = draw::IsInstancingQueue(queue);
+
+    InstanceDrawDesc batchDesc{};
+    RenderComponent* pBatchFirst = nullptr; // まとめ始めのコンポーネント (1つだけならrenderで描画)
+
+    // まとめたものを描画する
+    auto flush = [&]()
+        {
+            if (dc.instanceBatch.size() >= draw::MIN_INSTANCE_BATCH)
+            {
+                setMaterial(batchDesc.material);
+                setTexture(batchDesc.texture);
+                setRasMode(batchDesc.rasMode);
+                drawMeshInstanced(batchDesc.mesh, dc.instanceBatch);
+                setRasMode(RasMode::Back);
+            }
+            else if (pBatchFirst != nullptr)
+            {
+                pBatchFirst->render(inter);
+            }
+            dc.instanceBatch.clear();
+            pBatchFirst = nullptr;
+        };
+
+    for (const DrawItem* pItem : items)
+    {
+        // ソートで同じ状態が隣り合うので,続いている間はまとめる
+        InstanceDrawDesc desc{};
+        if (isInstancing && pItem->pComponent->getInstanceDraw(desc) && getMeshShaderType(desc.mesh) == VertexShaderType::Vertex3D)
+        {
+            if (pBatchFirst != nullptr && !draw::IsSameInstanceState(batchDesc, desc))
+            {
+                flush();
+            }
+            if (pBatchFirst == nullptr)
+            {
+                pBatchFirst = pItem->pComponent;
+                batchDesc = desc;
+            }
+            dc.instanceBatch.push_back(desc.instance);
+            continue;
+        }
+
+        flush();
+        pItem->pComponent->render(inter);
+    }
+    flush();
 }
 
 //-------------------------------------------
-// ジオメトリ描画開始
+// カスケード1つ分の影を描く (キャッシュできるなら動かない影はキャッシュから写し,動く影だけ描く)
+// キャッシュするカスケードはキャッシュを描いた広めの範囲で描き,カメラが少し動いても同じ範囲を使い続ける
 //-------------------------------------------
-void RendererImpl::beginGeometry(Matrix cameraView, Matrix cameraProj)
+void RendererImpl::drawShadowCascade(const ShadowCascade& cascade, UINT cascadeIndex, bool isCacheable, Renderer& inter)
 {
-    // 行列のセット
-    setVPMatrix(cameraView, cameraProj);
+    if (!isCacheable || m_pStaticShadowTexture == nullptr)
+    {
+        // 影を落とすものはカスケードの正射影の範囲でカリングする
+        m_drawList.cull(Frustum(Matrix::Multiply(cascade.view, cascade.proj)), m_shadowVisible);
 
-    // レンダーターゲットビューとデプスステンシルビューを設定
-    m_pContext->OMSetRenderTargets(GBUFFER_COUNT, MakeRawArray(m_pGBufferRTVs).data(), m_pDepthStencilView.Get());
+        beginShadow(cascade, cascadeIndex, m_pShadowDSVs[cascadeIndex].Get(), true);
+        drawQueue(RenderQueue::Shadow, inter, m_shadowVisible);
+        endShadow();
+        return;
+    }
+
+    // ライトの向きか動かない影の顔ぶれが変わったか,カスケードがキャッシュの範囲から出たときだけ範囲を作り直す
+    bool isRedraw = !m_staticShadowCache.isReusable(cascadeIndex, cascade);
+    if (isRedraw)
+    {
+        m_staticShadowCache.store(cascadeIndex, BuildStaticShadowRegion(cascade, m_shadowSettings));
+    }
+    const ShadowCascade& region = m_staticShadowCache.regions[cascadeIndex];
+
+    m_drawList.cull(Frustum(Matrix::Multiply(region.view, region.proj)), m_shadowVisible);
+    m_drawList.splitStaticCasters(m_shadowVisible, m_staticShadowVisible, m_dynamicShadowVisible);
+
+    if (isRedraw)
+    {
+        beginShadow(region, cascadeIndex, m_pStaticShadowDSVs[cascadeIndex].Get(), true);
+        drawQueue(RenderQueue::Shadow, inter, m_staticShadowVisible);
+        endShadow();
+    }
+
+    // キャッシュをシャドウマップに写して動く影を重ねる (ライティングで使う行列もキャッシュの範囲)
+    UINT subresource = D3D11CalcSubresource(0u, cascadeIndex, 1u);
+    m_pContext->CopySubresourceRegion(m_pShadowTexture.Get(), subresource, 0u, 0u, 0u, m_pStaticShadowTexture.Get(), subresource, nullptr);
+
+    beginShadow(region, cascadeIndex, m_pShadowDSVs[cascadeIndex].Get(), false);
+    drawQueue(RenderQueue::Shadow, inter, m_dynamicShadowVisible);
+    endShadow();
+}
+
+//-------------------------------------------
+// 影描画開始 (カスケードのスライスに描く)
+//-------------------------------------------
+void RendererImpl::beginShadow(const ShadowCascade& cascade, UINT cascadeIndex, ID3D11DepthStencilView* pDSV, bool isClear)
+{
+    // 行列のセット
+    setVPMatrix(cascade.view, cascade.proj);
+
+    // シャドウマップ用のライトのVP行列をセット
+    setTransformView(cascade.view);
+    setTransformProjection(cascade.proj);
+
+    // 影用デプスステンシルビューを設定 (RTVはなし)
+    bindRenderTargets(0, nullptr, pDSV);
 
-    // 画面クリア (Clear)
-    for (auto& pRTV : m_pGBufferRTVs)
+    // デプスクリア (キャッシュを写した後は重ねるのでクリアしない)
+    if (isClear)
     {
-        clearRenderTarget(pRTV.Get());
+        clearDepthStencil(pDSV);
     }
+
+    // シャドウマップ用ビューポート
+    D3D11_VIEWPORT vp = {};
+    vp.Width = static_cast<float>(m_shadowSettings.resolution);
+    vp.Height = static_cast<float>(m_shadowSettings.resolution);
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    vp.TopLeftX = 0.0f;
+    vp.TopLeftY = 0.0f;
+    m_pContext->RSSetViewports(1, &vp);
+
+    // プリミティブトポロジーの設定 (三角形リスト)
+    bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    // ライトのVP行列を保存
+    m_shadowData.CascadeViewProj[cascadeIndex] = m_vpMatData.View * m_vpMatData.Proj;
+
+    // 影用モードに変更
+    setShadowMode();
+}
+
+//-------------------------------------------
+// 影描画終了
+//-------------------------------------------
+void RendererImpl::endShadow()
+{
+    // ターゲット解除
+    bindRenderTargets(0, nullptr, nullptr);
+}
+
+//-------------------------------------------
+// ジオメトリ描画開始
+//-------------------------------------------
+void RendererImpl::beginGeometry(Matrix cameraView, Matrix cameraProj)
+{
+    // 行列のセット
+    setVPMatrix(cameraView, cameraProj);
+
+    // レンダーターゲットビューとデプスステンシルビューを設定
+    ID3D11RenderTargetView* rtvs[GBUFFER_COUNT] = { getTargetRTV(FrameTarget::GBuffer0), getTargetRTV(FrameTarget::GBuffer1), getTargetRTV(FrameTarget::GBuffer2), getTargetRTV(FrameTarget::GBuffer3) };
+    bindRenderTargets(GBUFFER_COUNT, rtvs, m_pDepthStencilView.Get());
+
+    // 画面クリア (Gバッファはレンダーグラフが最初の書き込みでクリアする)
     clearDepthStencil(m_pDepthStencilView.Get());
 
     // ビューポート設定
     D3D11_VIEWPORT vp = {};
-    vp.Width = m_screenSize.x;
-    vp.Height = m_screenSize.y;
+    vp.Width = m_sceneSize.x;   // 動的解像度で縮めた大きさ (左上に描く)
+    vp.Height = m_sceneSize.y;
     vp.MinDepth = 0.0f;
     vp.MaxDepth = 1.0f;
     vp.TopLeftX = 0.0f;
@@ -815,7 +1530,7 @@ void RendererImpl::beginGeometry(Matrix cameraView, Matrix cameraProj)
     m_pContext->RSSetViewports(1, &vp);
 
     // プリミティブトポロジーの設定 (三角形リスト)
-    m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     // Geometry描画モードにする
     setGeometryMode();
@@ -828,7 +1543,7 @@ void RendererImpl::endGeometry()
 {
     // 書き込みターゲットを解除する
     ID3D11RenderTargetView* nullRTVs[GBUFFER_COUNT + 1] = { nullptr, nullptr, nullptr,nullptr,nullptr };
-    m_pContext->OMSetRenderTargets(GBUFFER_COUNT + 1, nullRTVs, nullptr);
+    bindRenderTargets(GBUFFER_COUNT + 1, nullRTVs, nullptr);
 }
 
 //-------------------------------------------
@@ -841,25 +1556,25 @@ void RendererImpl::beginDecal(Matrix cameraView, Matrix cameraProj)
 
     // Viewリセット
     ID3D11RenderTargetView* nullRTVs[4] = { nullptr, nullptr, nullptr, nullptr };
-    m_pContext->OMSetRenderTargets(4, nullRTVs, nullptr);
+    bindRenderTargets(4, nullRTVs, nullptr);
 
     ID3D11ShaderResourceView* nullSRVs[5] = { nullptr, nullptr, nullptr, nullptr, nullptr };
-    m_pContext->PSSetShaderResources(0, 5, nullSRVs);
+    bindPSResources(0, 5, nullSRVs);
 
     // 書き込み設定
     // 色を上書きする
-    ID3D11RenderTargetView* rtv = m_pGBufferRTVs[0].Get();
-    m_pContext->OMSetRenderTargets(1, &rtv, m_pDepthStencilView.Get());
+    ID3D11RenderTargetView* rtv = getTargetRTV(FrameTarget::GBuffer0);
+    bindRenderTargets(1, &rtv, m_pDepthStencilView.Get());
 
     // 読み込み(設定
     // 位置を参照する
-    ID3D11ShaderResourceView* srv = m_pGBufferSRVs[2].Get();
-    m_pContext->PSSetShaderResources(1, 1, &srv);
+    ID3D11ShaderResourceView* srv = getTargetSRV(FrameTarget::GBuffer2);
+    bindPSResources(1, 1, &srv);
 
     // ビューポート設定
     D3D11_VIEWPORT vp = {};
-    vp.Width = m_screenSize.x;
-    vp.Height = m_screenSize.y;
+    vp.Width = m_sceneSize.x;
+    vp.Height = m_sceneSize.y;
     vp.MinDepth = 0.0f;
     vp.MaxDepth = 1.0f;
     vp.TopLeftX = 0.0f;
@@ -867,7 +1582,7 @@ void RendererImpl::beginDecal(Matrix cameraView, Matrix cameraProj)
     m_pContext->RSSetViewports(1, &vp);
 
     // プリミティブトポロジーの設定 (三角形リスト)
-    m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     // Decal描画モードにする
     setDecalMode();
@@ -880,7 +1595,7 @@ void RendererImpl::endDecal()
 {
     // リソース解除
     ID3D11ShaderResourceView* nullSRV = nullptr;
-    m_pContext->PSSetShaderResources(1, 1, &nullSRV);
+    bindPSResources(1, 1, &nullSRV);
 }
 
 //-------------------------------------------
@@ -892,13 +1607,13 @@ void RendererImpl::beginForward(Matrix cameraView, Matrix cameraProj)
     setVPMatrix(cameraView, cameraProj);
 
     // レンダーターゲットビューとデプスステンシルビューを設定
-    ID3D11RenderTargetView* rtv = m_pSceneRTV.Get();
-    m_pContext->OMSetRenderTargets(1, &rtv, m_pDepthStencilView.Get());
+    ID3D11RenderTargetView* rtv = getTargetRTV(FrameTarget::Scene);
+    bindRenderTargets(1, &rtv, m_pDepthStencilView.Get());
 
     // ビューポート設定
     D3D11_VIEWPORT vp = {};
-    vp.Width = m_screenSize.x;
-    vp.Height = m_screenSize.y;
+    vp.Width = m_sceneSize.x;
+    vp.Height = m_sceneSize.y;
     vp.MinDepth = 0.0f;
     vp.MaxDepth = 1.0f;
     vp.TopLeftX = 0.0f;
@@ -906,7 +1621,7 @@ void RendererImpl::beginForward(Matrix cameraView, Matrix cameraProj)
     m_pContext->RSSetViewports(1, &vp);
 
     // プリミティブトポロジーの設定 (三角形リスト)
-    m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     // Forward描画モードにする
     setForwardMode();
@@ -918,7 +1633,7 @@ void RendererImpl::beginForward(Matrix cameraView, Matrix cameraProj)
 void RendererImpl::endForward()
 {
     // ターゲット解除
-    m_pContext->OMSetRenderTargets(0, nullptr, nullptr);
+    bindRenderTargets(0, nullptr, nullptr);
 }
 
 //-------------------------------------------
@@ -931,7 +1646,7 @@ void RendererImpl::beginUI()
 
     // レンダーターゲットビューを設定
     ID3D11RenderTargetView* rtv = m_pRenderTargetView.Get();
-    m_pContext->OMSetRenderTargets(1, &rtv, nullptr);
+    bindRenderTargets(1, &rtv, nullptr);
 
     // ビューポート設定
     D3D11_VIEWPORT vp = {};
@@ -944,7 +1659,7 @@ void RendererImpl::beginUI()
     m_pContext->RSSetViewports(1, &vp);
 
     // プリミティブトポロジーの設定 (三角形リスト)
-    m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     // UI描画モードにする
     setUIMode();
@@ -1003,7 +1718,10 @@ bool RendererImpl::uploadTextures(const TextureManager& textureManager, unsigned
     size_t cnt{};
     while (true)
     {
-        if (m_textures.contains(uint32_t(cnt))){ ++cnt; continue; } // すでに登録されている
+        {
+            std::shared_lock<std::shared_mutex> lock(m_texMutex);
+            if (m_textures.contains(uint32_t(cnt))){ ++cnt; continue; } // すでに登録されている
+        }
 
         auto textureData = textureManager.getTextureData(cnt);
         if (!(spTextureData = textureData.lock())) break;
@@ -1092,13 +1810,16 @@ bool RendererImpl::uploadTextures(const TextureManager& textureManager, unsigned
 }
 
 //-------------------------------------------
-// メッシュデータを生成
+// メッシュデータを生成 (頂点とインデックスはアリーナの範囲を借りる 書き込みは次のフレームの先頭)
 //-------------------------------------------
 MeshHandle RendererImpl::createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount)
 {
-    MeshData mesh{};                   // メッシュ
-    D3D11_BUFFER_DESC bd{};            // バッファ設定
-    D3D11_SUBRESOURCE_DATA initData{}; // データ
+    if (vertices == nullptr || indices == nullptr || verticesCount == 0u || indicesCount == 0u)
+    {
+        return MeshHandle();
+    }
+
+    MeshData mesh{}; // メッシュ
 
     unsigned int stride{}; // 頂点のサイズ (ストライド)
     switch (type)
@@ -1112,82 +1833,404 @@ MeshHandle RendererImpl::createMesh(VertexShaderType type, const void* vertices,
     case VertexShaderType::VertexModel:
         stride = sizeof(VertexModel);
         break;
+    default:
+        return MeshHandle();
     }
 
-    // 頂点バッファ
-    bd.ByteWidth = static_cast<UINT>(stride * verticesCount);
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.CPUAccessFlags = 0;
+    mesh.vertexhaderType = type;
+    mesh.stride = stride;
+    mesh.verticesCount = verticesCount;
+    mesh.indicesCount = indicesCount;
 
-    // 初期化データ
-    initData.pSysMem = vertices;
+    // 境界ボックス (3D頂点は先頭が座標)
+    if (type != VertexShaderType::Vertex2D)
+    {
+        const uint8_t* pVertex = static_cast<const uint8_t*>(vertices);
+        for (size_t cnt = 0; cnt < verticesCount; ++cnt)
+        {
+            mesh.bounds.expand(*reinterpret_cast<const Vector3*>(pVertex + cnt * stride));
+        }
+    }
 
-    if (FAILED(m_pDevice->CreateBuffer(&bd, &initData, mesh.pVertex.GetAddressOf())))
+    std::lock_guard<std::shared_mutex> lock(m_meshMutex);
+    if (!allocateGeometry(D3D11_BIND_VERTEX_BUFFER, stride, vertices, verticesCount, mesh.vertexArena, mesh.baseVertex))
+    {
+        return MeshHandle();
+    }
+    if (!allocateGeometry(D3D11_BIND_INDEX_BUFFER, sizeof(unsigned int), indices, indicesCount, mesh.indexArena, mesh.startIndex))
     {
+        releaseMeshGeometry(mesh);
         return MeshHandle();
     }
+    mesh.pVertex = m_geometryArenas[mesh.vertexArena].pBuffer;
+    mesh.pIndex = m_geometryArenas[mesh.indexArena].pBuffer;
 
-    // インデックスバッファに切り替え
-    bd.ByteWidth = static_cast<UINT>(sizeof(unsigned int) * indicesCount);
-    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    MeshHandle handle{};
+    handle.id = uint32_t(m_meshs.size());
+    m_meshs.push_back(mesh);
+    m_pendingMeshes.push_back(handle.id);
+    return handle;
+}
 
-    // 初期化データ
-    initData.pSysMem = indices;
+//-------------------------------------------
+// メッシュの境界ボックスを取得
+//-------------------------------------------
+bool RendererImpl::getMeshBounds(const MeshHandle& handle, AABB& outBounds) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+    if (m_meshs.size() <= handle.id || !m_meshs[handle.id].bounds.isValid())
+    {
+        return false;
+    }
+    outBounds = m_meshs[handle.id].bounds;
+    return true;
+}
+
+//-------------------------------------------
+// メッシュの頂点シェーダーの種類を取得 (なければMax)
+//-------------------------------------------
+VertexShaderType RendererImpl::getMeshShaderType(const MeshHandle& handle) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+    return (m_meshs.size() > handle.id) ? m_meshs[handle.id].vertexhaderType : VertexShaderType::Max;
+}
 
-    if (FAILED(m_pDevice->CreateBuffer(&bd, &initData, mesh.pIndex.GetAddressOf())))
+//-------------------------------------------
+// インデックスバッファを共有する書き換え可能なメッシュを生成 (インスタンスごとの頂点ストリーム 頂点は専用のバッファ)
+//-------------------------------------------
+MeshHandle RendererImpl::createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount)
+{
+    MeshData mesh{};
+    {
+        std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+        if (m_meshs.size() <= source.id || m_meshs[source.id].isReleased || m_meshs[source.id].isDynamic)
+        {
+            return MeshHandle();
+        }
+        mesh = m_meshs[source.id]; // インデックスの範囲と形式を引き継ぐ
+    }
+    if (verticesCount != mesh.verticesCount)
     {
         return MeshHandle();
     }
 
-    mesh.vertexhaderType = type;
-    mesh.stride = stride;
-    mesh.indicesCount = indicesCount;
+    D3D11_BUFFER_DESC bd{};            // バッファ設定
+    D3D11_SUBRESOURCE_DATA initData{}; // データ
+
+    // 頂点バッファ
+    bd.ByteWidth = static_cast<UINT>(mesh.stride * verticesCount);
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    // 初期化データ
+    initData.pSysMem = vertices;
+
+    mesh.pVertex.Reset();
+    if (FAILED(m_pDevice->CreateBuffer(&bd, &initData, mesh.pVertex.GetAddressOf())))
+    {
+        return MeshHandle();
+    }
+    mesh.vertexArena = NO_ARENA;
+    mesh.baseVertex = 0u;
+    mesh.sourceId = source.id;
+    mesh.dynamicUsers = 0u;
+    mesh.isDynamic = true;
+
+    std::lock_guard<std::shared_mutex> lock(m_meshMutex);
+    if (m_meshs[source.id].isReleased)
+    {// 作っている間に解放された
+        return MeshHandle();
+    }
+    ++m_meshs[source.id].dynamicUsers;
 
     MeshHandle handle{};
     handle.id = uint32_t(m_meshs.size());
     m_meshs.push_back(mesh);
+    if (!mesh.isResident)
+    {// 借り元のインデックスがまだ書き込まれていない
+        m_pendingMeshes.push_back(handle.id);
+    }
     return handle;
 }
 
 //-------------------------------------------
-// メッシュデータを設定
+// 書き換え可能なメッシュの頂点を更新
+//-------------------------------------------
+bool RendererImpl::updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount)
+{
+    DrawContext& dc = currentDrawContext();
+    std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+    if (m_meshs.size() <= handle.id)
+    {
+        return false;
+    }
+
+    const auto& mesh = m_meshs[handle.id];
+    if (!mesh.isDynamic || mesh.isReleased || verticesCount > mesh.verticesCount)
+    {
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(dc.pContext->Map(mesh.pVertex.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    {
+        return false;
+    }
+    memcpy(mapped.pData, vertices, mesh.stride * verticesCount);
+    dc.pContext->Unmap(mesh.pVertex.Get(), 0);
+    return true;
+}
+
+//-------------------------------------------
+// メッシュを解放 (アリーナの範囲を返す IDは使い回さない)
+//-------------------------------------------
+void RendererImpl::releaseMesh(const MeshHandle& handle)
+{
+    std::lock_guard<std::shared_mutex> lock(m_meshMutex);
+    if (m_meshs.size() <= handle.id || m_meshs[handle.id].isReleased)
+    {
+        return;
+    }
+
+    MeshData& mesh = m_meshs[handle.id];
+    mesh.isReleased = true;
+    if (mesh.isDynamic)
+    {// 借りていたインデックスを返す (借り元が先に解放されていれば範囲を返す)
+        mesh.pVertex.Reset();
+        MeshData& source = m_meshs[mesh.sourceId];
+        --source.dynamicUsers;
+        if (source.isReleased && source.dynamicUsers == 0u)
+        {
+            releaseMeshGeometry(source);
+        }
+    }
+    else if (mesh.dynamicUsers == 0u)
+    {
+        releaseMeshGeometry(mesh);
+    }
+}
+
+//-------------------------------------------
+// メッシュデータを設定 (アリーナは共有なので同じアリーナのメッシュ同士ではバッファを設定し直さない)
 //-------------------------------------------
 bool RendererImpl::setMesh(const MeshHandle& handle)
 {
-    if (m_meshs.size() > handle.id)
+    DrawContext& dc = currentDrawContext();
+    std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+    if (m_meshs.size() > handle.id && m_meshs[handle.id].isResident && !m_meshs[handle.id].isReleased)
     {
         const auto& mesh = m_meshs[handle.id];
-        UINT offset = 0;
-        const auto& pVertex = mesh.pVertex.Get();
-        m_pContext->IASetVertexBuffers(0, 1, &pVertex, &mesh.stride, &offset);
-        m_pContext->IASetIndexBuffer(mesh.pIndex.Get(), DXGI_FORMAT_R32_UINT, 0); // 32bit Index
+        bindVertexBuffer(0, mesh.pVertex.Get(), mesh.stride);
+        bindIndexBuffer(mesh.pIndex.Get(), DXGI_FORMAT_R32_UINT); // 32bit Index
+        dc.meshStartIndex = mesh.startIndex;
+        dc.meshBaseVertex = mesh.baseVertex;
+        dc.isMeshReady = true;
+        dc.meshBounds = mesh.bounds;                              // テクスチャの画面上の大きさを測る用
         return true;
     }
+    dc.isMeshReady = false;
     return false;
 }
 
+//-------------------------------------------
+// アリーナから範囲を借りて書き込みを予約する (m_meshMutexを持って呼ぶ 空きがなければアリーナを足す)
+//-------------------------------------------
+bool RendererImpl::allocateGeometry(UINT bindFlags, UINT stride, const void* data, size_t count, uint32_t& outArena, UINT& outOffset)
+{
+    if (count == 0u || count > OffsetAllocator::NO_OFFSET - 1u)
+    {
+        return false;
+    }
+    const uint32_t size = static_cast<uint32_t>(count);
+
+    // 同じ形式のアリーナの空きから
+    outArena = NO_ARENA;
+    outOffset = OffsetAllocator::NO_OFFSET;
+    for (uint32_t arenaId = 0; arenaId < m_geometryArenas.size(); ++arenaId)
+    {
+        GeometryArena& arena = m_geometryArenas[arenaId];
+        if (arena.bindFlags != bindFlags || arena.stride != stride) continue;
+
+        outOffset = arena.allocator.allocate(size);
+        if (outOffset != OffsetAllocator::NO_OFFSET)
+        {
+            outArena = arenaId;
+            break;
+        }
+    }
+
+    // なければ作る (作成はデバイスだけなので読み込みスレッドからでもよい)
+    if (outArena == NO_ARENA)
+    {
+        UINT arenaBytes = (bindFlags == D3D11_BIND_INDEX_BUFFER) ? INDEX_ARENA_BYTES : VERTEX_ARENA_BYTES;
+        uint32_t capacity = std::max(size, arenaBytes / stride);
+
+        GeometryArena arena{};
+        D3D11_BUFFER_DESC bd{};
+        bd.ByteWidth = capacity * stride;
+        bd.Usage = D3D11_USAGE_DEFAULT;
+        bd.BindFlags = bindFlags;
+        if (FAILED(m_pDevice->CreateBuffer(&bd, nullptr, arena.pBuffer.GetAddressOf())))
+        {
+            return false;
+        }
+        arena.allocator.reset(capacity);
+        arena.bindFlags = bindFlags;
+        arena.stride = stride;
+
+        outArena = uint32_t(m_geometryArenas.size());
+        outOffset = arena.allocator.allocate(size);
+        m_geometryArenas.push_back(std::move(arena));
+    }
+
+    GeometryUpload upload{};
+    upload.arena = outArena;
+    upload.offset = outOffset;
+    upload.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size_t(size) * stride);
+    m_geometryUploads.push_back(std::move(upload));
+    return true;
+}
+
+//-------------------------------------------
+// メッシュが借りている範囲を返す (m_meshMutexを持って呼ぶ)
+//-------------------------------------------
+void RendererImpl::releaseMeshGeometry(MeshData& mesh)
+{
+    if (mesh.vertexArena != NO_ARENA)
+    {
+        m_geometryArenas[mesh.vertexArena].allocator.release(mesh.baseVertex);
+        mesh.vertexArena = NO_ARENA;
+    }
+    if (mesh.indexArena != NO_ARENA)
+    {
+        m_geometryArenas[mesh.indexArena].allocator.release(mesh.startIndex);
+        mesh.indexArena = NO_ARENA;
+    }
+    mesh.pVertex.Reset();
+    mesh.pIndex.Reset();
+    mesh.isResident = false;
+}
+
+//-------------------------------------------
+// アリーナへの書き込みと詰め直し (フレームの先頭で呼ぶ 記録スレッドが動いていない時)
+//-------------------------------------------
+void RendererImpl::flushGeometryUploads()
+{
+    std::lock_guard<std::shared_mutex> lock(m_meshMutex);
+
+    // 解放済みのメッシュの範囲に書いても描画されないので,そのまま書く
+    for (const auto& upload : m_geometryUploads)
+    {
+        const GeometryArena& arena = m_geometryArenas[upload.arena];
+        D3D11_BOX box{};
+        box.left = upload.offset * arena.stride;
+        box.right = box.left + static_cast<UINT>(upload.data.size());
+        box.top = 0u;
+        box.bottom = 1u;
+        box.front = 0u;
+        box.back = 1u;
+        m_pContext->UpdateSubresource(arena.pBuffer.Get(), 0, &box, upload.data.data(), 0, 0);
+    }
+    m_geometryUploads.clear();
+
+    for (uint32_t id : m_pendingMeshes)
+    {
+        MeshData& mesh = m_meshs[id];
+        mesh.isResident = !mesh.isReleased;
+    }
+    m_pendingMeshes.clear();
+
+    // 空きが多く細切れのアリーナを詰め直す
+    for (uint32_t arenaId = 0; arenaId < m_geometryArenas.size(); ++arenaId)
+    {
+        const OffsetAllocator& allocator = m_geometryArenas[arenaId].allocator;
+        if (allocator.getAllocationCount() > 0u &&
+            allocator.getFreeSize() >= static_cast<uint32_t>(allocator.getCapacity() * DEFRAGMENT_FREE_RATIO) &&
+            allocator.getFragmentation() >= DEFRAGMENT_FRAGMENTATION)
+        {
+            defragmentGeometryArena(arenaId);
+        }
+    }
+}
+
+//-------------------------------------------
+// アリーナを詰め直す (新しいバッファに前から並べてGPU上でコピーし,借りているメッシュの位置を書き換える m_meshMutexを持って呼ぶ)
+//-------------------------------------------
+void RendererImpl::defragmentGeometryArena(uint32_t arenaId)
+{
+    GeometryArena& arena = m_geometryArenas[arenaId];
+
+    D3D11_BUFFER_DESC bd{};
+    arena.pBuffer->GetDesc(&bd);
+    ComPtr<ID3D11Buffer> pBuffer = nullptr;
+    if (FAILED(m_pDevice->CreateBuffer(&bd, nullptr, pBuffer.GetAddressOf())))
+    {
+        return; // 今のまま使う
+    }
+
+    arena.allocator.defragment(m_arenaMoves);
+    for (const auto& move : m_arenaMoves)
+    {
+        D3D11_BOX box{};
+        box.left = move.from * arena.stride;
+        box.right = box.left + move.size * arena.stride;
+        box.top = 0u;
+        box.bottom = 1u;
+        box.front = 0u;
+        box.back = 1u;
+        m_pContext->CopySubresourceRegion(pBuffer.Get(), 0, move.to * arena.stride, 0, 0, arena.pBuffer.Get(), 0, &box);
+    }
+    arena.pBuffer = pBuffer;
+
+    // 移動は元の位置順なので二分探索で引く
+    auto remap = [this](UINT offset)
+        {
+            auto itr = std::lower_bound(m_arenaMoves.begin(), m_arenaMoves.end(), offset, [](const OffsetAllocator::Move& move, UINT value) { return move.from < value; });
+            return (itr != m_arenaMoves.end() && itr->from == offset) ? static_cast<UINT>(itr->to) : offset;
+        };
+    for (auto& mesh : m_meshs)
+    {
+        if (mesh.vertexArena == arenaId)
+        {
+            mesh.baseVertex = remap(mesh.baseVertex);
+            mesh.pVertex = pBuffer;
+        }
+        if (mesh.indexArena == arenaId)
+        {// 動的メッシュも借り元と同じ位置なので一緒に書き換わる
+            mesh.startIndex = remap(mesh.startIndex);
+            mesh.pIndex = pBuffer;
+        }
+    }
+}
+
 //-------------------------------------------
 // テクスチャデータを設定
 //-------------------------------------------
 bool RendererImpl::setTexture(const TextureHandle& handle)
 {
+    DrawContext& dc = currentDrawContext();
+    dc.textureId = ~0u;
     ID3D11ShaderResourceView* pSRV = nullptr;
     if (handle.isValid())
     {// テクスチャが指定されている場合
-        if (m_textures.find(handle.id) == m_textures.end())
+        std::shared_lock<std::shared_mutex> lock(m_texMutex);
+        auto itr = m_textures.find(handle.id);
+        if (itr == m_textures.end())
         {// 未登録の場合は失敗
+            lock.unlock();
             pSRV = m_pDummyTextureWhite.Get();
-            m_pContext->PSSetShaderResources(0, 1, &pSRV);
+            bindPSResources(0, 1, &pSRV);
             return false;
         }
-        pSRV = m_textures[handle.id].Get();; // 登録されたテクスチャを使用
+        pSRV = itr->second.Get(); // 登録されたテクスチャを使用 (ストリーミングの差し替えはフレームの先頭だけなので描画中は解放されない)
+        dc.textureId = handle.id;
     }
     else
     {// テクスチャが指定されていない場合
         pSRV = m_pDummyTextureWhite.Get(); // ダミーテクスチャを使用
     }
-    m_pContext->PSSetShaderResources(0, 1, &pSRV);
+    bindPSResources(0, 1, &pSRV);
     return true;
 }
 
@@ -1196,7 +2239,12 @@ bool RendererImpl::setTexture(const TextureHandle& handle)
 //-------------------------------------------
 bool RendererImpl::setTransformWorld(const Matrix& matrix)
 {
-    m_wMatData.World = matrix;
+    DrawContext& dc = currentDrawContext();
+    if (std::memcmp(&dc.wMatData.World, &matrix, sizeof(Matrix)) != 0)
+    {// 変わったときだけ送り直す
+        dc.wMatData.World = matrix;
+        markConstantDirty(ConstantBlockType::World);
+    }
     return true;
 }
 
@@ -1232,12 +2280,19 @@ bool RendererImpl::setCameraPosition(const Vector3& cameraPos)
 //-------------------------------------------
 bool RendererImpl::setMaterial(const Material& material)
 {
-    m_mtlData.Diffuse = material.Diffuse;
-    m_mtlData.Specular = material.Specular;
-    m_mtlData.Emissive = material.Emissive;
-    m_mtlData.Power = material.Power;
-    m_mtlData.AlphaCutoff = material.AlphaCutoff;
-    m_mtlData.PixelShaderType = int(material.pixelShaderType);
+    DrawContext& dc = currentDrawContext();
+    MaterialBufferData mtlData = dc.mtlData;
+    mtlData.Diffuse = material.Diffuse;
+    mtlData.Specular = material.Specular;
+    mtlData.Emissive = material.Emissive;
+    mtlData.Power = material.Power;
+    mtlData.AlphaCutoff = material.AlphaCutoff;
+    mtlData.PixelShaderType = int(material.pixelShaderType);
+    if (std::memcmp(&dc.mtlData, &mtlData, sizeof(MaterialBufferData)) != 0)
+    {// 変わったときだけ送り直す
+        dc.mtlData = mtlData;
+        markConstantDirty(ConstantBlockType::Material);
+    }
     return true;
 }
 
@@ -1246,11 +2301,23 @@ bool RendererImpl::setMaterial(const Material& material)
 //-------------------------------------------
 bool RendererImpl::setLight(std::span<const LightData> lights, const Color& ambient)
 {
+    // 平行光源は定数バッファ,点光源はクラスターに振り分ける
     m_lightData.GlobalAmbient = ambient;
-    m_lightData.LightCount = int(std::min(lights.size(), MAX_LIGHT));
-    for (size_t cnt = 0; cnt < m_lightData.LightCount; cnt++)
+    m_lightData.LightCount = 0;
+    m_pointLights.clear();
+    for (const auto& light : lights)
     {
-        m_lightData.Lights[cnt] = lights[cnt];
+        if (light.position.w == 0.0f)
+        {
+            if (size_t(m_lightData.LightCount) < MAX_LIGHT)
+            {
+                m_lightData.Lights[m_lightData.LightCount++] = light;
+            }
+        }
+        else if (m_pointLights.size() < MAX_POINT_LIGHT)
+        {
+            m_pointLights.push_back(light);
+        }
     }
     return true;
 }
@@ -1267,6 +2334,7 @@ bool RendererImpl::setFog(const FogData& fog)
     m_fogData.skyFogHeight = fog.skyFogHeight;
     m_fogData.fogPower = fog.fogPower;
     m_fogData.skyFogPower = fog.skyFogPower;
+    markConstantDirty(ConstantBlockType::Fog);
     return true;
 }
 
@@ -1275,6 +2343,7 @@ bool RendererImpl::setFog(const FogData& fog)
 //-------------------------------------------
 bool RendererImpl::setBoneTransforms(std::span<const Matrix> boneTransforms)
 {
+    DrawContext& dc = currentDrawContext();
     size_t count = boneTransforms.size();
     if (count > MAX_BONES)
     {
@@ -1282,8 +2351,10 @@ bool RendererImpl::setBoneTransforms(std::span<const Matrix> boneTransforms)
     }
     for (size_t i = 0; i < count; ++i)
     {
-        m_boneData.BoneTransforms[i] = boneTransforms[i];
+        dc.boneData.BoneTransforms[i] = boneTransforms[i];
     }
+    dc.boneCount = static_cast<UINT>(std::max<size_t>(count, 1u)); // 使う分だけ送る
+    markConstantDirty(ConstantBlockType::Bone);
     return true;
 }
 
@@ -1292,8 +2363,10 @@ bool RendererImpl::setBoneTransforms(std::span<const Matrix> boneTransforms)
 //-------------------------------------------
 void RendererImpl::setOutlineData(Color color, float width)
 {
-    m_outlineData.OutlineColor = color;
-    m_outlineData.OutlineWidth = width;
+    DrawContext& dc = currentDrawContext();
+    dc.outlineData.OutlineColor = color;
+    dc.outlineData.OutlineWidth = width;
+    markConstantDirty(ConstantBlockType::Outline);
 }
 
 //-------------------------------------------
@@ -1303,12 +2376,21 @@ bool RendererImpl::drawMesh( const MeshHandle& handle)
 {
     if (handle.isValid())
     {
-        if (m_meshs.size() > handle.id)
+        VertexShaderType type = VertexShaderType::Max;
+        unsigned int indicesCount = 0u;
         {
-            setMesh(handle);
+            std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+            if (m_meshs.size() > handle.id)
+            {
+                type = m_meshs[handle.id].vertexhaderType;
+                indicesCount = static_cast<unsigned int>(m_meshs[handle.id].indicesCount);
+            }
+        }
 
+        if (type != VertexShaderType::Max && setMesh(handle))
+        {
             // 描画
-            drawIndexedPrimitive(m_meshs[handle.id].vertexhaderType, unsigned int(m_meshs[handle.id].indicesCount), 0, 0);
+            drawIndexedPrimitive(type, indicesCount, 0, 0);
             return true;
         }
     }
@@ -1320,70 +2402,159 @@ bool RendererImpl::drawMesh( const MeshHandle& handle)
 //-------------------------------------------
 bool RendererImpl::drawIndexedPrimitive(VertexShaderType vertexShaderType, unsigned int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation)
 {
-    ID3D11Buffer* buffer = nullptr; // 借用
+    DrawContext& dc = currentDrawContext();
+    if (!dc.isMeshReady)
+    {// アリーナに書き込まれる前のメッシュ
+        return false;
+    }
 
-    // 定数バッファ更新
-    m_pContext->UpdateSubresource(m_pWMatBuffer.Get(), 0, nullptr, &m_wMatData, 0, 0);   // ワールド行列
-    m_pContext->UpdateSubresource(m_pMtlBuffer.Get(), 0, nullptr, &m_mtlData, 0, 0);     // Material
+    // 使うテクスチャのミップを要求する
+    requestTextureMips(dc, vertexShaderType, dc.wMatData.World);
+
+    // 定数バッファ更新 (書き換えたブロックだけ送る)
+    reserveConstantRing();
 
     // 頂点シェーダーに送る
-    buffer = m_pWMatBuffer.Get();
-    m_pContext->VSSetConstantBuffers(1, 1, &buffer);  // スロット1にセット
+    bindConstantBuffer(ShaderStage::Vertex, 1, commitConstantBlock(ConstantBlockType::World, m_pWMatBuffer.Get(), &dc.wMatData, sizeof(dc.wMatData)));  // スロット1にセット
 
     // ピクセルシェーダーに送る
-    buffer = m_pMtlBuffer.Get();
-    m_pContext->PSSetConstantBuffers(2, 1, &buffer);   // スロット2にセット
+    bindConstantBuffer(ShaderStage::Pixel, 2, commitConstantBlock(ConstantBlockType::Material, m_pMtlBuffer.Get(), &dc.mtlData, sizeof(dc.mtlData))); // スロット2にセット
 
     // シェーダータイプごとの設定
     switch (vertexShaderType)
     {
     case VertexShaderType::Vertex2D:
-        m_pContext->IASetInputLayout(m_pInputLayout2D.Get());         // 入力レイアウト設定
-        m_pContext->VSSetShader(m_pVertexShader2D.Get(), nullptr, 0); // 頂点シェーダー設定
+        bindInputLayout(m_pInputLayout2D.Get());         // 入力レイアウト設定
+        bindVertexShader(m_pVertexShader2D.Get()); // 頂点シェーダー設定
         break;
     case VertexShaderType::Vertex3D:
-        m_pContext->IASetInputLayout(m_pInputLayout3D.Get());         // 入力レイアウト設定
+        bindInputLayout(m_pInputLayout3D.Get());         // 入力レイアウト設定
         if (m_currentPass == RenderPass::Forward && m_currentForwardSubPass == ForwardSubPass::Outline)
         {// アウトライン描画
-            m_pContext->UpdateSubresource(m_pOutlineBuffer.Get(), 0, nullptr, &m_outlineData, 0, 0);   // アウトライン
-            buffer = m_pOutlineBuffer.Get();                                                           // 借りる
-            m_pContext->VSSetConstantBuffers(3, 1, &buffer);                                           // スロット3にセット
-            m_pContext->VSSetShader(m_pOutline3DVS.Get(), nullptr, 0);                                 // アウトライン3D頂点シェーダー設定
+            bindConstantBuffer(ShaderStage::Vertex, 3, commitConstantBlock(ConstantBlockType::Outline, m_pOutlineBuffer.Get(), &dc.outlineData, sizeof(dc.outlineData))); // スロット3にセット
+            bindVertexShader(m_pOutline3DVS.Get());                                 // アウトライン3D頂点シェーダー設定
         }
         else
         {
-            m_pContext->VSSetShader(m_pVertexShader3D.Get(), nullptr, 0); // 頂点シェーダー設定
+            bindVertexShader(m_pVertexShader3D.Get()); // 頂点シェーダー設定
         }
         break;
     case VertexShaderType::VertexModel:
-        m_pContext->IASetInputLayout(m_pInputLayoutModel.Get());                             // 入力レイアウト設定
-        m_pContext->UpdateSubresource(m_pBoneBuffer.Get(), 0, nullptr, &m_boneData, 0, 0);   // ボーン
-        buffer = m_pBoneBuffer.Get();                                                        // 借りる
-        m_pContext->VSSetConstantBuffers(3, 1, &buffer);                                     // スロット3にセット
+        bindInputLayout(m_pInputLayoutModel.Get());                             // 入力レイアウト設定
+        bindConstantBuffer(ShaderStage::Vertex, 3, commitConstantBlock(ConstantBlockType::Bone, m_pBoneBuffer.Get(), &dc.boneData, dc.boneCount * sizeof(Matrix), sizeof(dc.boneData))); // スロット3にセット (送るのは使っているボーンだけ 見える範囲はシェーダーの配列全体)
         if (m_currentPass == RenderPass::Forward && m_currentForwardSubPass == ForwardSubPass::Outline)
         {// アウトライン描画
-            m_pContext->UpdateSubresource(m_pOutlineBuffer.Get(), 0, nullptr, &m_outlineData, 0, 0);   // アウトライン
-            buffer = m_pOutlineBuffer.Get();                                                           // 借りる
-            m_pContext->VSSetConstantBuffers(4, 1, &buffer);                                           // スロット4にセット
-            m_pContext->VSSetShader(m_pOutlineModelVS.Get(), nullptr, 0);                              // アウトラインModel頂点シェーダー設定
+            bindConstantBuffer(ShaderStage::Vertex, 4, commitConstantBlock(ConstantBlockType::Outline, m_pOutlineBuffer.Get(), &dc.outlineData, sizeof(dc.outlineData))); // スロット4にセット
+            bindVertexShader(m_pOutlineModelVS.Get());                              // アウトラインModel頂点シェーダー設定
         }
         else
         {
-            m_pContext->VSSetShader(m_pVertexShaderModel.Get(), nullptr, 0);                     // Model頂点シェーダー設定
+            bindVertexShader(m_pVertexShaderModel.Get());                     // Model頂点シェーダー設定
         }
         break;
     }
 
     // ピクセルシェーダー設定
-    switch (m_currentPass)
+    setPassPixelShader();
+
+    // 描画 (メッシュのアリーナの中の位置をずらす)
+    dc.pContext->DrawIndexed(indexCount, dc.meshStartIndex + startIndexLocation, static_cast<INT>(dc.meshBaseVertex + baseVertexLocation));
+
+    // シャドウマップ
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    bindPSResources(5, 1, &nullSRV);
+    return true;
+}
+
+//-------------------------------------------
+// インスタンシング描画 (Vertex3Dのメッシュをワールド行列の数だけ1回で描画)
+//-------------------------------------------
+bool RendererImpl::drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances)
+{
+    DrawContext& dc = currentDrawContext();
+    MeshData mesh{};
     {
-        // 影描画
+        std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+        if (!handle.isValid() || m_meshs.size() <= handle.id || instances.empty() || !m_meshs[handle.id].isResident || m_meshs[handle.id].isReleased)
+        {
+            return false;
+        }
+        mesh = m_meshs[handle.id];
+    }
+    if (mesh.vertexhaderType != VertexShaderType::Vertex3D)
+    {
+        return false; // インスタンシング用のシェーダーは3Dのみ
+    }
+
+    // インスタンスバッファが足りなければ作り直す (倍々で確保)
+    if (dc.instanceCapacity < instances.size())
+    {
+        size_t capacity = std::max<size_t>(dc.instanceCapacity * 2u, std::max<size_t>(instances.size(), 256u));
+
+        D3D11_BUFFER_DESC bd{};
+        bd.ByteWidth = static_cast<UINT>(sizeof(InstanceData) * capacity);
+        bd.Usage = D3D11_USAGE_DYNAMIC;
+        bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (FAILED(m_pDevice->CreateBuffer(&bd, nullptr, dc.pInstanceBuffer.ReleaseAndGetAddressOf())))
+        {
+            dc.instanceCapacity = 0u;
+            return false;
+        }
+        dc.instanceCapacity = capacity;
+    }
+
+    // インスタンスデータを書き込む
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(dc.pContext->Map(dc.pInstanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    {
+        return false;
+    }
+    std::memcpy(mapped.pData, instances.data(), sizeof(InstanceData) * instances.size());
+    dc.pContext->Unmap(dc.pInstanceBuffer.Get(), 0);
+
+    // スロット0にメッシュ,スロット1にインスタンス
+    bindVertexBuffer(0, mesh.pVertex.Get(), mesh.stride);
+    bindVertexBuffer(1, dc.pInstanceBuffer.Get(), static_cast<UINT>(sizeof(InstanceData)));
+    bindIndexBuffer(mesh.pIndex.Get(), DXGI_FORMAT_R32_UINT); // 32bit Index
+
+    // マテリアルだけ送る (ワールド行列はインスタンスバッファ)
+    reserveConstantRing();
+    bindConstantBuffer(ShaderStage::Pixel, 2, commitConstantBlock(ConstantBlockType::Material, m_pMtlBuffer.Get(), &dc.mtlData, sizeof(dc.mtlData))); // スロット2にセット
+
+    bindInputLayout(m_pInputLayout3DInstanced.Get());         // 入力レイアウト設定
+    bindVertexShader(m_pVertexShader3DInstanced.Get()); // 頂点シェーダー設定
+    setPassPixelShader();                                                  // ピクセルシェーダー設定
+
+    // 使うテクスチャのミップを要求する (一番大きく映りそうなインスタンスで1回だけ測る)
+    dc.meshBounds = mesh.bounds;
+    requestTextureMips(dc, mesh.vertexhaderType, instances[texture_streaming::FindLargestInstance(instances, m_streamingViewProj)].world);
+
+    // 描画
+    dc.pContext->DrawIndexedInstanced(static_cast<UINT>(mesh.indicesCount), static_cast<UINT>(instances.size()), mesh.startIndex, static_cast<INT>(mesh.baseVertex), 0);
+
+    // スロット1はそのまま (通常の入力レイアウトは読まないので次のインスタンシングまで残しておく)
+
+    // シャドウマップ
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    bindPSResources(5, 1, &nullSRV);
+    return true;
+}
+
+//-------------------------------------------
+// 現在のパスのピクセルシェーダーを設定
+//-------------------------------------------
+void RendererImpl::setPassPixelShader()
+{
+    switch (m_currentPass)
+    {
+        // 影描画
     case RenderPass::Shadow:
-        m_pContext->PSSetShader(m_pShadowPS.Get(), nullptr, 0);        // シャドウ用ピクセルシェーダ
+        bindPixelShader(m_pShadowPS.Get());        // シャドウ用ピクセルシェーダ
         break;
         // ジオメトリ描画
     case RenderPass::Geometry:
-        m_pContext->PSSetShader(m_pGeometryPS.Get(), nullptr, 0); // Geometryシェーダー
+        bindPixelShader(m_pGeometryPS.Get()); // Geometryシェーダー
         break;
         // フォワード描画
     case RenderPass::Forward:
@@ -1392,40 +2563,495 @@ bool RendererImpl::drawIndexedPrimitive(VertexShaderType vertexShaderType, unsig
         {
             // Sky描画
         case ForwardSubPass::Sky:
-            m_pContext->UpdateSubresource(m_pFogBuffer.Get(), 0, nullptr, &m_fogData, 0, 0);     // Fog
-            buffer = m_pFogBuffer.Get();                                                         // 借りる
-            m_pContext->PSSetConstantBuffers(5, 1, &buffer);                                     // スロット5にセット
-            m_pContext->PSSetShader(m_pSkyPS.Get(), nullptr, 0);                                 // Sky用ピクセルシェーダ
+            bindConstantBuffer(ShaderStage::Pixel, 5, commitConstantBlock(ConstantBlockType::Fog, m_pFogBuffer.Get(), &m_fogData, sizeof(m_fogData))); // スロット5にセット
+            bindPixelShader(m_pSkyPS.Get());                                 // Sky用ピクセルシェーダ
             break;
             // アウトライン描画
         case ForwardSubPass::Outline:
-            m_pContext->PSSetShader(m_pOutlinePS.Get(), nullptr, 0);   // アウトライン用ピクセルシェーダ
+            bindPixelShader(m_pOutlinePS.Get());   // アウトライン用ピクセルシェーダ
             break;
             // 半透明描画
         case ForwardSubPass::Transparent:
             // シャドウマップをシェーダーにセット
             ID3D11ShaderResourceView* srv = m_pShadowSRV.Get();
-            m_pContext->PSSetShaderResources(5, 1, &srv);
+            bindPSResources(5, 1, &srv);
+            bindLightClusters();
 
-            m_pContext->PSSetShader(m_pTransparentPS.Get(), nullptr, 0);   // 半透明用ピクセルシェーダ
+            bindPixelShader(m_pTransparentPS.Get());   // 半透明用ピクセルシェーダ
             break;
         }
         break;
         // UI描画
     case RenderPass::UI:
-        m_pContext->PSSetShader(m_pUIPS.Get(), nullptr, 0);   // UI用ピクセルシェーダ
+        bindPixelShader(m_pUIPS.Get());   // UI用ピクセルシェーダ
         break;
     }
+}
 
-    // 描画
-    m_pContext->DrawIndexed(indexCount, startIndexLocation, baseVertexLocation);
+//-------------------------------------------
+// 定数バッファリングの作成
+//-------------------------------------------
+void RendererImpl::setupConstantRing(DrawContext& dc)
+{
+    dc.pConstantRing.Reset();
+    dc.pContext1.Reset();
 
-    // シャドウマップ
-    ID3D11ShaderResourceView* nullSRV = nullptr;
-    m_pContext->PSSetShaderResources(5, 1, &nullSRV);
+    // オフセット指定とNO_OVERWRITEができるか (できなければ従来通りUpdateSubresource)
+    if (FAILED(dc.pContext.As(&dc.pContext1)))
+    {
+        return;
+    }
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+    if (FAILED(m_pDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+        !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+    {
+        dc.pContext1.Reset();
+        return;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.ByteWidth = CONSTANT_RING_SIZE;
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    if (FAILED(m_pDevice->CreateBuffer(&bd, nullptr, dc.pConstantRing.ReleaseAndGetAddressOf())))
+    {
+        dc.pConstantRing.Reset();
+        dc.pContext1.Reset();
+    }
+    resetConstantRing(dc);
+}
+
+//-------------------------------------------
+// 定数バッファリングを先頭に戻す (フレームの先頭と遅延コンテキストの記録開始)
+//-------------------------------------------
+void RendererImpl::resetConstantRing(DrawContext& dc)
+{
+    dc.constantRingOffset = 0u;
+    dc.isConstantRingDiscard = true;
+    for (ConstantBlock& block : dc.constantBlocks)
+    {
+        block.isDirty = true;
+    }
+}
+
+//-------------------------------------------
+// 描画を記録するコンテキストの作成 (即時コンテキストと記録スレッドごとの遅延コンテキスト)
+//-------------------------------------------
+void RendererImpl::setupDrawContexts()
+{
+    m_immediateDraw.pContext = m_pContext;
+    setupConstantRing(m_immediateDraw);
+
+    // メインスレッドも1つ記録するので,使えるコアの数だけ作る
+    m_deferredDraws.clear();
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), MAX_RECORD_THREADS);
+    for (size_t cnt = 0; cnt < threadCount && threadCount > 1u; ++cnt)
+    {
+        auto upDrawContext = std::make_unique<DrawContext>();
+        if (FAILED(m_pDevice->CreateDeferredContext(0, upDrawContext->pContext.GetAddressOf())))
+        {
+            break; // 作れた分だけ使う
+        }
+        setupConstantRing(*upDrawContext);
+        m_deferredDraws.push_back(std::move(upDrawContext));
+    }
+    if (m_deferredDraws.size() < 2u)
+    {// 1つでは並列にならない
+        m_deferredDraws.clear();
+    }
+}
+
+//-------------------------------------------
+// 即時コンテキストのパスの設定を取り出す
+//-------------------------------------------
+void RendererImpl::capturePassState(PassState& outState)
+{
+    std::array<ID3D11RenderTargetView*, D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT> pRTVs{};
+    ID3D11DepthStencilView* pDSV = nullptr;
+    m_pContext->OMGetRenderTargets(UINT(pRTVs.size()), pRTVs.data(), &pDSV);
+    for (size_t cnt = 0; cnt < pRTVs.size(); ++cnt)
+    {
+        outState.pRTVs[cnt].Attach(pRTVs[cnt]);
+    }
+    outState.pDSV.Attach(pDSV);
+
+    outState.numViewports = UINT(outState.viewports.size());
+    m_pContext->RSGetViewports(&outState.numViewports, outState.viewports.data());
+    outState.numScissorRects = UINT(outState.scissorRects.size());
+    m_pContext->RSGetScissorRects(&outState.numScissorRects, outState.scissorRects.data());
+    m_pContext->IAGetPrimitiveTopology(&outState.topology);
+
+    m_pContext->OMGetBlendState(outState.pBlendState.ReleaseAndGetAddressOf(), outState.blendFactor.data(), &outState.sampleMask);
+    m_pContext->OMGetDepthStencilState(outState.pDepthState.ReleaseAndGetAddressOf(), &outState.stencilRef);
+    m_pContext->RSGetState(outState.pRasState.ReleaseAndGetAddressOf());
+
+    // 定数バッファ (リング内の範囲も)
+    std::array<ID3D11Buffer*, PassState::CONSTANT_SLOTS> pVSBuffers{}, pPSBuffers{};
+    if (m_immediateDraw.pContext1 != nullptr)
+    {
+        m_immediateDraw.pContext1->VSGetConstantBuffers1(0, UINT(pVSBuffers.size()), pVSBuffers.data(), outState.vsFirstConstants.data(), outState.vsNumConstants.data());
+        m_immediateDraw.pContext1->PSGetConstantBuffers1(0, UINT(pPSBuffers.size()), pPSBuffers.data(), outState.psFirstConstants.data(), outState.psNumConstants.data());
+    }
+    else
+    {
+        m_pContext->VSGetConstantBuffers(0, UINT(pVSBuffers.size()), pVSBuffers.data());
+        m_pContext->PSGetConstantBuffers(0, UINT(pPSBuffers.size()), pPSBuffers.data());
+    }
+    for (size_t cnt = 0; cnt < PassState::CONSTANT_SLOTS; ++cnt)
+    {
+        outState.pVSConstants[cnt].Attach(pVSBuffers[cnt]);
+        outState.pPSConstants[cnt].Attach(pPSBuffers[cnt]);
+    }
+
+    // SRVとサンプラー
+    std::array<ID3D11ShaderResourceView*, PipelineStateCache::PS_RESOURCE_SLOTS> pResources{};
+    m_pContext->PSGetShaderResources(0, UINT(pResources.size()), pResources.data());
+    for (size_t cnt = 0; cnt < pResources.size(); ++cnt)
+    {
+        outState.pPSResources[cnt].Attach(pResources[cnt]);
+    }
+    std::array<ID3D11SamplerState*, PassState::SAMPLER_SLOTS> pSamplers{};
+    m_pContext->PSGetSamplers(0, UINT(pSamplers.size()), pSamplers.data());
+    for (size_t cnt = 0; cnt < pSamplers.size(); ++cnt)
+    {
+        outState.pPSSamplers[cnt].Attach(pSamplers[cnt]);
+    }
+}
+
+//-------------------------------------------
+// パスの設定をコンテキストに写す (ステートの影は分からなくなる)
+//-------------------------------------------
+void RendererImpl::applyPassState(DrawContext& dc, const PassState& state)
+{
+    ID3D11DeviceContext* pContext = dc.pContext.Get();
+
+    auto pRTVs = MakeRawArray(state.pRTVs);
+    pContext->OMSetRenderTargets(UINT(pRTVs.size()), pRTVs.data(), state.pDSV.Get());
+    pContext->RSSetViewports(state.numViewports, state.viewports.data());
+    pContext->RSSetScissorRects(state.numScissorRects, state.scissorRects.data());
+    pContext->IASetPrimitiveTopology(state.topology);
+
+    pContext->OMSetBlendState(state.pBlendState.Get(), state.blendFactor.data(), state.sampleMask);
+    pContext->OMSetDepthStencilState(state.pDepthState.Get(), state.stencilRef);
+    pContext->RSSetState(state.pRasState.Get());
+
+    auto pVSBuffers = MakeRawArray(state.pVSConstants);
+    auto pPSBuffers = MakeRawArray(state.pPSConstants);
+    if (dc.pContext1 != nullptr && m_immediateDraw.pContext1 != nullptr)
+    {
+        dc.pContext1->VSSetConstantBuffers1(0, UINT(pVSBuffers.size()), pVSBuffers.data(), state.vsFirstConstants.data(), state.vsNumConstants.data());
+        dc.pContext1->PSSetConstantBuffers1(0, UINT(pPSBuffers.size()), pPSBuffers.data(), state.psFirstConstants.data(), state.psNumConstants.data());
+    }
+    else
+    {
+        pContext->VSSetConstantBuffers(0, UINT(pVSBuffers.size()), pVSBuffers.data());
+        pContext->PSSetConstantBuffers(0, UINT(pPSBuffers.size()), pPSBuffers.data());
+    }
+
+    auto pResources = MakeRawArray(state.pPSResources);
+    pContext->PSSetShaderResources(0, UINT(pResources.size()), pResources.data());
+    auto pSamplers = MakeRawArray(state.pPSSamplers);
+    pContext->PSSetSamplers(0, UINT(pSamplers.size()), pSamplers.data());
+
+    // 直接設定したので影は当てにならない
+    for (auto& bindings : dc.constantBindings)
+    {
+        bindings.fill(CachedState<ConstantBinding>());
+    }
+    dc.stateCache = PipelineStateCache();
+}
+
+//-------------------------------------------
+// 1回の描画分の空きを確保する (足りなければDISCARDして先頭から)
+//-------------------------------------------
+void RendererImpl::reserveConstantRing(UINT size)
+{
+    DrawContext& dc = currentDrawContext();
+    if (dc.pConstantRing == nullptr || dc.constantRingOffset + size <= CONSTANT_RING_SIZE)
+    {
+        return;
+    }
+
+    // 先頭から書き直すので前の描画の分も送り直す
+    dc.constantRingOffset = 0u;
+    dc.isConstantRingDiscard = true;
+    for (ConstantBlock& block : dc.constantBlocks)
+    {
+        block.isDirty = true;
+    }
+}
+
+//-------------------------------------------
+// 書き換えられた定数ブロックを送る (bindSizeはシェーダーが宣言した大きさ 送るのはsizeだけでも見える範囲はその大きさにする)
+//-------------------------------------------
+const ConstantBlock& RendererImpl::commitConstantBlock(ConstantBlockType type, ID3D11Buffer* pStaticBuffer, const void* pData, UINT size, UINT bindSize)
+{
+    DrawContext& dc = currentDrawContext();
+    ConstantBlock& block = dc.constantBlocks[size_t(type)];
+    if (!block.isDirty)
+    {
+        return block;
+    }
+    block.isDirty = false;
+
+    if (dc.pConstantRing == nullptr)
+    {// リングがないなら従来の定数バッファを更新
+        dc.pContext->UpdateSubresource(pStaticBuffer, 0, nullptr, pData, 0, 0);
+        block.pBuffer = pStaticBuffer;
+        block.firstConstant = 0u;
+        block.numConstants = 0u;
+        return block;
+    }
+
+    // 追記する (描画中のGPUが読んでいる範囲には触れない)
+    // 見える範囲の後ろは次のブロックと重なるが,シェーダーは送った範囲しか読まない
+    const UINT alignedSize = AlignConstantSize(size);
+    const UINT bindAlignedSize = AlignConstantSize(std::max(size, bindSize));
+    if (dc.constantRingOffset + bindAlignedSize > CONSTANT_RING_SIZE)
+    {
+        dc.constantRingOffset = 0u;
+        dc.isConstantRingDiscard = true;
+    }
+    D3D11_MAP mapType = dc.isConstantRingDiscard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(dc.pContext->Map(dc.pConstantRing.Get(), 0, mapType, 0, &mapped)))
+    {// 書けなければ従来の定数バッファ
+        dc.pContext->UpdateSubresource(pStaticBuffer, 0, nullptr, pData, 0, 0);
+        block.pBuffer = pStaticBuffer;
+        block.firstConstant = 0u;
+        block.numConstants = 0u;
+        return block;
+    }
+    std::memcpy(static_cast<unsigned char*>(mapped.pData) + dc.constantRingOffset, pData, size);
+    dc.pContext->Unmap(dc.pConstantRing.Get(), 0);
+    dc.isConstantRingDiscard = false;
+
+    block.pBuffer = dc.pConstantRing.Get();
+    block.firstConstant = dc.constantRingOffset / 16u;
+    block.numConstants = bindAlignedSize / 16u;
+    dc.constantRingOffset += alignedSize;
+    return block;
+}
+
+//-------------------------------------------
+// 定数バッファを設定する (設定済みと同じなら何もしない)
+//-------------------------------------------
+void RendererImpl::bindConstantBuffer(ShaderStage stage, UINT slot, ID3D11Buffer* pBuffer, UINT firstConstant, UINT numConstants)
+{
+    DrawContext& dc = currentDrawContext();
+    ConstantBinding binding;
+    binding.pBuffer = pBuffer;
+    binding.firstConstant = firstConstant;
+    binding.numConstants = numConstants;
+
+    if (!filterState(dc.constantBindings[size_t(stage)][slot], binding))
+    {
+        return;
+    }
+
+    if (numConstants > 0u && dc.pContext1 != nullptr)
+    {// リング内の範囲を設定
+        if (stage == ShaderStage::Vertex)
+        {
+            dc.pContext1->VSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants);
+        }
+        else
+        {
+            dc.pContext1->PSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants);
+        }
+        return;
+    }
+
+    if (dc.pContext1 != nullptr)
+    {// オフセット付きで設定したスロットに通常の設定をすると範囲が残るので全体を明示する
+        UINT first = 0u;
+        UINT num = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT;
+        if (stage == ShaderStage::Vertex)
+        {
+            dc.pContext1->VSSetConstantBuffers1(slot, 1, &pBuffer, &first, &num);
+        }
+        else
+        {
+            dc.pContext1->PSSetConstantBuffers1(slot, 1, &pBuffer, &first, &num);
+        }
+        return;
+    }
+
+    if (stage == ShaderStage::Vertex)
+    {
+        dc.pContext->VSSetConstantBuffers(slot, 1, &pBuffer);
+    }
+    else
+    {
+        dc.pContext->PSSetConstantBuffers(slot, 1, &pBuffer);
+    }
+}
+
+//-------------------------------------------
+// 設定中のステートを忘れる (外部の描画が差し替えたとき)
+//-------------------------------------------
+void RendererImpl::invalidateStateCache()
+{
+    DrawContext& dc = currentDrawContext();
+    for (auto& bindings : dc.constantBindings)
+    {
+        bindings.fill(CachedState<ConstantBinding>());
+    }
+    dc.stateCache = PipelineStateCache();
+}
+
+//-------------------------------------------
+// ステートの変更を数えて変わるかどうかを返す
+//-------------------------------------------
+template<typename T>
+bool RendererImpl::filterState(CachedState<T>& state, const T& value)
+{
+    DrawContext& dc = currentDrawContext();
+    if (!state.update(value))
+    {
+        dc.stateStats.redundantCalls++;
+        return false;
+    }
+    dc.stateStats.issuedCalls++;
     return true;
 }
 
+//-------------------------------------------
+// 頂点シェーダーを設定
+//-------------------------------------------
+void RendererImpl::bindVertexShader(ID3D11VertexShader* pShader)
+{
+    DrawContext& dc = currentDrawContext();
+    if (filterState(dc.stateCache.vertexShader, pShader))
+    {
+        dc.pContext->VSSetShader(pShader, nullptr, 0);
+    }
+}
+
+//-------------------------------------------
+// ピクセルシェーダーを設定
+//-------------------------------------------
+void RendererImpl::bindPixelShader(ID3D11PixelShader* pShader)
+{
+    DrawContext& dc = currentDrawContext();
+    if (filterState(dc.stateCache.pixelShader, pShader))
+    {
+        dc.pContext->PSSetShader(pShader, nullptr, 0);
+    }
+}
+
+//-------------------------------------------
+// 入力レイアウトを設定
+//-------------------------------------------
+void RendererImpl::bindInputLayout(ID3D11InputLayout* pInputLayout)
+{
+    DrawContext& dc = currentDrawContext();
+    if (filterState(dc.stateCache.inputLayout, pInputLayout))
+    {
+        dc.pContext->IASetInputLayout(pInputLayout);
+    }
+}
+
+//-------------------------------------------
+// プリミティブトポロジーを設定
+//-------------------------------------------
+void RendererImpl::bindPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    DrawContext& dc = currentDrawContext();
+    if (filterState(dc.stateCache.topology, topology))
+    {
+        dc.pContext->IASetPrimitiveTopology(topology);
+    }
+}
+
+//-------------------------------------------
+// 頂点バッファを設定
+//-------------------------------------------
+void RendererImpl::bindVertexBuffer(UINT slot, ID3D11Buffer* pBuffer, UINT stride, UINT offset)
+{
+    DrawContext& dc = currentDrawContext();
+    if (filterState(dc.stateCache.vertexStreams[slot], VertexStreamBinding(pBuffer, stride, offset)))
+    {
+        dc.pContext->IASetVertexBuffers(slot, 1, &pBuffer, &stride, &offset);
+    }
+}
+
+//-------------------------------------------
+// インデックスバッファを設定
+//-------------------------------------------
+void RendererImpl::bindIndexBuffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, UINT offset)
+{
+    DrawContext& dc = currentDrawContext();
+    if (filterState(dc.stateCache.indexBuffer, IndexBufferBinding(pBuffer, format, offset)))
+    {
+        dc.pContext->IASetIndexBuffer(pBuffer, format, offset);
+    }
+}
+
+//-------------------------------------------
+// ピクセルシェーダーのSRVを設定 (1つでも変わるならまとめて設定)
+//-------------------------------------------
+void RendererImpl::bindPSResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* ppResources)
+{
+    DrawContext& dc = currentDrawContext();
+    bool isChanged = false;
+    for (UINT cnt = 0; cnt < count; cnt++)
+    {
+        const size_t slot = size_t(startSlot) + cnt;
+        if (slot >= dc.stateCache.psResources.size() || dc.stateCache.psResources[slot].update(ppResources[cnt]))
+        {
+            isChanged = true;
+        }
+    }
+
+    if (!isChanged)
+    {
+        dc.stateStats.redundantCalls++;
+        return;
+    }
+    dc.stateStats.issuedCalls++;
+    dc.pContext->PSSetShaderResources(startSlot, count, ppResources);
+}
+
+//-------------------------------------------
+// ピクセルシェーダーのサンプラーを設定 (1つでも変わるならまとめて設定)
+//-------------------------------------------
+void RendererImpl::bindPSSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* ppSamplers)
+{
+    DrawContext& dc = currentDrawContext();
+    bool isChanged = false;
+    for (UINT cnt = 0; cnt < count; cnt++)
+    {
+        if (dc.stateCache.psSamplers[size_t(startSlot) + cnt].update(ppSamplers[cnt]))
+        {
+            isChanged = true;
+        }
+    }
+
+    if (!isChanged)
+    {
+        dc.stateStats.redundantCalls++;
+        return;
+    }
+    dc.stateStats.issuedCalls++;
+    dc.pContext->PSSetSamplers(startSlot, count, ppSamplers);
+}
+
+//-------------------------------------------
+// レンダーターゲットを設定
+//-------------------------------------------
+void RendererImpl::bindRenderTargets(UINT count, ID3D11RenderTargetView* const* ppRTVs, ID3D11DepthStencilView* pDSV)
+{
+    DrawContext& dc = currentDrawContext();
+
+    // ターゲットにしたリソースのSRVはD3Dが勝手に外すので覚えているSRVは当てにならない
+    dc.stateCache.psResources.fill(CachedState<ID3D11ShaderResourceView*>());
+
+    dc.stateStats.issuedCalls++;
+    dc.pContext->OMSetRenderTargets(count, ppRTVs, pDSV);
+}
+
 //-------------------------------------------
 // シャドウマップ描画モードに設定
 //-------------------------------------------
@@ -1540,8 +3166,13 @@ void RendererImpl::setPostProcessMode()
 //-------------------------------------------
 void RendererImpl::setBlendMode(BlendMode blendMode)
 {
-    float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    m_pContext->OMSetBlendState(m_blendStates[size_t(blendMode)].Get(), blendFactor, 0xffffffff);
+    DrawContext& dc = currentDrawContext();
+    ID3D11BlendState* pBlendState = m_blendStates[size_t(blendMode)].Get();
+    if (filterState(dc.stateCache.blendState, pBlendState))
+    {
+        float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        dc.pContext->OMSetBlendState(pBlendState, blendFactor, 0xffffffff);
+    }
 }
 
 //-------------------------------------------
@@ -1549,7 +3180,12 @@ void RendererImpl::setBlendMode(BlendMode blendMode)
 //-------------------------------------------
 void RendererImpl::setRasMode(RasMode rasMode)
 {
-    m_pContext->RSSetState(m_rasStates[size_t(rasMode)].Get());
+    DrawContext& dc = currentDrawContext();
+    ID3D11RasterizerState* pRasState = m_rasStates[size_t(rasMode)].Get();
+    if (filterState(dc.stateCache.rasState, pRasState))
+    {
+        dc.pContext->RSSetState(pRasState);
+    }
 }
 
 //-------------------------------------------
@@ -1557,7 +3193,12 @@ void RendererImpl::setRasMode(RasMode rasMode)
 //-------------------------------------------
 void RendererImpl::setDepthMode(DepthMode depthMode)
 {
-    m_pContext->OMSetDepthStencilState(m_depthStates[size_t(depthMode)].Get(), 1);
+    DrawContext& dc = currentDrawContext();
+    ID3D11DepthStencilState* pDepthState = m_depthStates[size_t(depthMode)].Get();
+    if (filterState(dc.stateCache.depthState, pDepthState))
+    {
+        dc.pContext->OMSetDepthStencilState(pDepthState, 1);
+    }
 }
 
 //-------------------------------------------
@@ -1566,7 +3207,7 @@ void RendererImpl::setDepthMode(DepthMode depthMode)
 void RendererImpl::setSampMode(SampMode sampMode)
 {
     ID3D11SamplerState* samp = m_samplerStates[size_t(sampMode)].Get();
-    m_pContext->PSSetSamplers(0, 1, &samp);
+    bindPSSamplers(0, 1, &samp);
 }
 
 //-------------------------------------------
@@ -1582,12 +3223,13 @@ void setOutlineData(Color color, float width)
 //-------------------------------------------
 void RendererImpl::setScissorRect(int left, int top, int right, int bottom)
 {
+    DrawContext& dc = currentDrawContext();
     D3D11_RECT rect;
     rect.left = left;
     rect.top = top;
     rect.right = right;
     rect.bottom = bottom;
-    m_pContext->RSSetScissorRects(1, &rect);
+    dc.pContext->RSSetScissorRects(1, &rect);
 }
 
 //-------------------------------------------
@@ -1604,7 +3246,7 @@ void RendererImpl::onResize(int width, int height)
     m_screenMagnification.y = static_cast<float>(height) / DEFAULT_SCREEN_SIZE.y;
 
     // コンテキストからターゲットを外す
-    m_pContext->OMSetRenderTargets(0, nullptr, nullptr);
+    bindRenderTargets(0, nullptr, nullptr);
     m_pContext->ClearState();
     m_pContext->Flush();
 
@@ -1644,18 +3286,16 @@ void RendererImpl::onResize(int width, int height)
         m_pDevice->CreateDepthStencilView(m_pDepthStencilTexture.Get(), nullptr, m_pDepthStencilView.ReleaseAndGetAddressOf());
     }
 
-    // シーンバッファ再生成
-    setupSceneBuffer();
+    // フレームの描画先再生成 (パスは変わらないので実体だけ)
+    releaseGraphTextures();
+    setupGraphTextures();
 
     // シャドウマップ再生成
     setupShadowMap();
 
-    // MRT再生成
-    setupGBuffer();
-
     // ターゲットをセットし直す
     ID3D11RenderTargetView* rtv = m_pRenderTargetView.Get();
-    m_pContext->OMSetRenderTargets(1, &rtv, m_pDepthStencilView.Get());
+    bindRenderTargets(1, &rtv, m_pDepthStencilView.Get());
 
     // ビューポート設定の更新
     D3D11_VIEWPORT vp = {};
@@ -1790,13 +3430,31 @@ void RendererImpl::setupDevice(HWND handle)
 //-----------------------------------
 void RendererImpl::setupShader()
 {
-    // シェーダーのコンパイルと作成
-    ComPtr<ID3DBlob> pBlob = nullptr;
-
-    // 2D頂点シェーダー
-    std::filesystem::path path = std::filesystem::path(SHADER_DIRECTORY) / L"2DPolygonVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pVertexShader2D.ReleaseAndGetAddressOf());
+    // シェーダーの読み込み (キャッシュに当たればバイトコードを読むだけ 外れたものはスレッドに分けてコンパイルして残す)
+    std::filesystem::path shaderDirectory = std::filesystem::path(SHADER_DIRECTORY);
+    std::vector<ShaderCompileRequest> requests = shader_cache::MakeProgramRequests(shaderDirectory);
+    std::vector<std::vector<uint8_t>> bytecodes{};
+    ShaderCache shaderCache(shaderDirectory / shader_cache::CACHE_DIRECTORY_NAME, shader_compiler::CompileFromFile);
+    shaderCache.load(requests, std::max(1u, std::thread::hardware_concurrency()), bytecodes, [](std::string_view message)
+        {
+            OutputDebugStringA(("ShaderCache::" + std::string(message) + "\n").c_str());
+        });
+
+    // 作成 (失敗したものは空なので作られない)
+    auto createVS = [&](ShaderProgram program, ComPtr<ID3D11VertexShader>& outShader) -> const std::vector<uint8_t>&
+        {
+            const std::vector<uint8_t>& bytecode = bytecodes[size_t(program)];
+            m_pDevice->CreateVertexShader(bytecode.data(), bytecode.size(), nullptr, outShader.ReleaseAndGetAddressOf());
+            return bytecode;
+        };
+    auto createPS = [&](ShaderProgram program, ComPtr<ID3D11PixelShader>& outShader)
+        {
+            const std::vector<uint8_t>& bytecode = bytecodes[size_t(program)];
+            m_pDevice->CreatePixelShader(bytecode.data(), bytecode.size(), nullptr, outShader.ReleaseAndGetAddressOf());
+        };
+
+    // 2D頂点シェーダー
+    const std::vector<uint8_t>& vs2D = createVS(ShaderProgram::Polygon2DVS, m_pVertexShader2D);
 
     // 2D入力レイアウトの作成 (Vertex2D構造体とHLSLの紐づけ)
     D3D11_INPUT_ELEMENT_DESC layout2D[] =
@@ -1805,12 +3463,10 @@ void RendererImpl::setupShader()
         { "COLOR",    0, DXGI_FORMAT_R32G32B32A32_FLOAT,  0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 }
     };
-    m_pDevice->CreateInputLayout(layout2D, ARRAYSIZE(layout2D), pBlob->GetBufferPointer(), pBlob->GetBufferSize(), m_pInputLayout2D.ReleaseAndGetAddressOf());
+    m_pDevice->CreateInputLayout(layout2D, ARRAYSIZE(layout2D), vs2D.data(), vs2D.size(), m_pInputLayout2D.ReleaseAndGetAddressOf());
 
     // 3D頂点シェーダー
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"3DPolygonVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pVertexShader3D.ReleaseAndGetAddressOf());
+    const std::vector<uint8_t>& vs3D = createVS(ShaderProgram::Polygon3DVS, m_pVertexShader3D);
 
     // 3D入力レイアウトの作成 (Vertex3D構造体とHLSLの紐づけ)
     D3D11_INPUT_ELEMENT_DESC layout3D[] =
@@ -1820,12 +3476,28 @@ void RendererImpl::setupShader()
         { "COLOR",    0, DXGI_FORMAT_R32G32B32A32_FLOAT,  0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 40, D3D11_INPUT_PER_VERTEX_DATA, 0 }
     };
-    m_pDevice->CreateInputLayout(layout3D, ARRAYSIZE(layout3D), pBlob->GetBufferPointer(), pBlob->GetBufferSize(), m_pInputLayout3D.ReleaseAndGetAddressOf());
+    m_pDevice->CreateInputLayout(layout3D, ARRAYSIZE(layout3D), vs3D.data(), vs3D.size(), m_pInputLayout3D.ReleaseAndGetAddressOf());
+
+    // 3D頂点シェーダー (インスタンシング)
+    const std::vector<uint8_t>& vs3DInstanced = createVS(ShaderProgram::Polygon3DInstancedVS, m_pVertexShader3DInstanced);
+
+    // 3D入力レイアウトの作成 (Vertex3D構造体 + InstanceData構造体とHLSLの紐づけ)
+    D3D11_INPUT_ELEMENT_DESC layout3DInstanced[] =
+    {
+        { "POSITION",       0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,  D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "NORMAL",         0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "COLOR",          0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "TEXCOORD",       0, DXGI_FORMAT_R32G32_FLOAT,       0, 40, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "INSTANCE_WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+    };
+    m_pDevice->CreateInputLayout(layout3DInstanced, ARRAYSIZE(layout3DInstanced), vs3DInstanced.data(), vs3DInstanced.size(), m_pInputLayout3DInstanced.ReleaseAndGetAddressOf());
 
     // Model頂点シェーダー
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"ModelVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pVertexShaderModel.ReleaseAndGetAddressOf());
+    const std::vector<uint8_t>& vsModel = createVS(ShaderProgram::ModelVS, m_pVertexShaderModel);
 
     // 入力レイアウトの作成 (VertexModel構造体とHLSLの紐づけ)
     D3D11_INPUT_ELEMENT_DESC layoutModel[] =
@@ -1837,78 +3509,52 @@ void RendererImpl::setupShader()
         { "WEIGHTS",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 48, D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "BONES",    0, DXGI_FORMAT_R8G8B8A8_UINT,      0, 64, D3D11_INPUT_PER_VERTEX_DATA, 0 }
     };
-    m_pDevice->CreateInputLayout(layoutModel, ARRAYSIZE(layoutModel), pBlob->GetBufferPointer(), pBlob->GetBufferSize(), m_pInputLayoutModel.ReleaseAndGetAddressOf());
+    m_pDevice->CreateInputLayout(layoutModel, ARRAYSIZE(layoutModel), vsModel.data(), vsModel.size(), m_pInputLayoutModel.ReleaseAndGetAddressOf());
 
     // シャドウ用ピクセルシェーダー
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"ShadowPS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pShadowPS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::ShadowPS, m_pShadowPS);
 
     // ジオメトリピクセルシェーダー
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"GeometryPS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pGeometryPS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::GeometryPS, m_pGeometryPS);
 
     // デカール頂点シェーダー
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"DecalVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pDecalVS.ReleaseAndGetAddressOf());
+    createVS(ShaderProgram::DecalVS, m_pDecalVS);
 
     // デカールピクセルシェーダー
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"DecalPS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pDecalPS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::DecalPS, m_pDecalPS);
 
     // DeferredLighting用
     // VS
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"ScreenVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pScreenVS.ReleaseAndGetAddressOf());
+    createVS(ShaderProgram::ScreenVS, m_pScreenVS);
 
     // UnifiedLightingPS
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"UnifiedLighting_DL.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pUnifiedLighting_DL_PS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::UnifiedLightingPS, m_pUnifiedLighting_DL_PS);
 
     // Forward用
 
     // アウトライン用3D頂点シェーダ
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"Outline3DVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pOutline3DVS.ReleaseAndGetAddressOf());
+    createVS(ShaderProgram::Outline3DVS, m_pOutline3DVS);
 
     // アウトライン用Model頂点シェーダ
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"OutlineModelVS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pOutlineModelVS.ReleaseAndGetAddressOf());
+    createVS(ShaderProgram::OutlineModelVS, m_pOutlineModelVS);
 
     // ピクセルシェーダ
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"SkyPS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pSkyPS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::SkyPS, m_pSkyPS);
 
     // アウトライン用ピクセルシェーダ
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"OutlinePS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pOutlinePS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::OutlinePS, m_pOutlinePS);
 
     // 半透明シェーダ
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"TransparentPS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pTransparentPS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::TransparentPS, m_pTransparentPS);
 
-    // ポストプロセス用シェーダー
+    // ポストプロセス用シェーダー (PostProcessShaderTypeの順に並んでいる)
     for (size_t cnt = 0; cnt < m_pPostProcessShaders.size(); ++cnt)
     {
-        path = std::filesystem::path(SHADER_DIRECTORY) / POST_PROCESS_SHADER_FILE_NAMES[cnt];
-        D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-        m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pPostProcessShaders[cnt].ReleaseAndGetAddressOf());
+        createPS(ShaderProgram(size_t(ShaderProgram::PostProcessNone) + cnt), m_pPostProcessShaders[cnt]);
     }
 
     // UIシェーダ
-    path = std::filesystem::path(SHADER_DIRECTORY) / L"UIPS.hlsl";
-    D3DCompileFromFile(path.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_0", 0, 0, pBlob.ReleaseAndGetAddressOf(), nullptr);
-    m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, m_pUIPS.ReleaseAndGetAddressOf());
+    createPS(ShaderProgram::UIPS, m_pUIPS);
 
     //--------------------
     // 定数バッファの作成
@@ -1983,6 +3629,9 @@ void RendererImpl::setupShader()
     ppd.Usage = D3D11_USAGE_DEFAULT;
     ppd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     m_pDevice->CreateBuffer(&ppd, nullptr, m_pPostProcessBuffer.ReleaseAndGetAddressOf());
+
+    // 描画を記録するコンテキスト (定数バッファリングもここで作る)
+    setupDrawContexts();
 }
 
 //-----------------------------------
@@ -2228,115 +3877,218 @@ void RendererImpl::setupState()
 }
 
 //----------------------------------------------------
-// シーンバッファ生成
+// フレームのパスを組む (読み書きする描画先を宣言し,ポストプロセスの設定で使わないパスはグラフが除く)
 //----------------------------------------------------
-void RendererImpl::setupSceneBuffer()
+void RendererImpl::compileRenderGraph(PostProcessShaderMask mask)
 {
-    // テクスチャ作成
-    D3D11_TEXTURE2D_DESC texDesc = {};
-    texDesc.Width = UINT(m_screenSize.x);
-    texDesc.Height = UINT(m_screenSize.y);
-    texDesc.MipLevels = 1;
-    texDesc.ArraySize = 1;
-    texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-    texDesc.SampleDesc.Count = 1;
-    texDesc.Usage = D3D11_USAGE_DEFAULT;
-    texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-
-    // シーン用テクスチャ
-    m_pDevice->CreateTexture2D(&texDesc, nullptr, m_pSceneTexture.ReleaseAndGetAddressOf());
-    if (m_pSceneTexture == nullptr) return;
+    releaseGraphTextures();
+    m_renderGraph.reset();
+    m_graphMask = mask;
+    m_isGraphDirty = false;
 
-    // RTV作成
-    m_pDevice->CreateRenderTargetView(m_pSceneTexture.Get(), nullptr, m_pSceneRTV.ReleaseAndGetAddressOf());
-
-    // SRV作成
-    m_pDevice->CreateShaderResourceView(m_pSceneTexture.Get(), nullptr, m_pSceneSRV.ReleaseAndGetAddressOf());
-
-    // ワーク用テクスチャ
-    m_pDevice->CreateTexture2D(&texDesc, nullptr, m_pWorkTexture.ReleaseAndGetAddressOf());
-    if (m_pWorkTexture == nullptr) return;
+    // 描画先 (FrameTargetの順)
+    auto createTarget = [this](FrameTarget target, std::string_view name, DXGI_FORMAT format, uint32_t sizeShift)
+        {
+            m_frameTargets[size_t(target)] = m_renderGraph.createTexture(name, RenderGraphTextureDesc(uint32_t(format), sizeShift));
+        };
+    auto importTarget = [this](FrameTarget target, std::string_view name, bool isOutput)
+        {
+            m_frameTargets[size_t(target)] = m_renderGraph.importTexture(name, isOutput);
+        };
+    createTarget(FrameTarget::GBuffer0, "GBuffer0", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0u); // Albedo (色) sRGBで保存
+    createTarget(FrameTarget::GBuffer1, "GBuffer1", DXGI_FORMAT_R16G16B16A16_FLOAT, 0u);  // Normal (法線) - 精度が必要
+    createTarget(FrameTarget::GBuffer2, "GBuffer2", DXGI_FORMAT_R32G32B32A32_FLOAT, 0u);  // Position (座標) - かなり精度が必要
+    createTarget(FrameTarget::GBuffer3, "GBuffer3", DXGI_FORMAT_R16G16B16A16_FLOAT, 0u);  // Emissive (発光)
+    createTarget(FrameTarget::Scene, "Scene", DXGI_FORMAT_R16G16B16A16_FLOAT, 0u);
+    createTarget(FrameTarget::Bloom, "Bloom", DXGI_FORMAT_R16G16B16A16_FLOAT, 2u);        // 1/4サイズ
+    createTarget(FrameTarget::BloomWork, "BloomWork", DXGI_FORMAT_R16G16B16A16_FLOAT, 2u);
+    createTarget(FrameTarget::BloomBlur, "BloomBlur", DXGI_FORMAT_R16G16B16A16_FLOAT, 2u);
+    createTarget(FrameTarget::Gray, "Gray", DXGI_FORMAT_R16G16B16A16_FLOAT, 0u);
+    createTarget(FrameTarget::Composite, "Composite", DXGI_FORMAT_R16G16B16A16_FLOAT, 0u);
+    importTarget(FrameTarget::ShadowMap, "ShadowMap", false);
+    importTarget(FrameTarget::Depth, "Depth", false);
+    importTarget(FrameTarget::BackBuffer, "BackBuffer", true);
+
+    // パスと読み書きする描画先 (登録順に実行する)
+    auto addPass = [this](std::string_view name, std::function<void()> execute, bool isRepeated, std::initializer_list<FrameTarget> reads, std::initializer_list<FrameTarget> writes)
+        {
+            uint32_t pass = m_renderGraph.addPass(name, std::move(execute), isRepeated);
+            for (FrameTarget target : reads)
+            {
+                m_renderGraph.read(pass, m_frameTargets[size_t(target)]);
+            }
+            for (FrameTarget target : writes)
+            {
+                m_renderGraph.write(pass, m_frameTargets[size_t(target)]);
+            }
+            return pass;
+        };
 
-    // RTV作成
-    m_pDevice->CreateRenderTargetView(m_pWorkTexture.Get(), nullptr, m_pWorkRTV.ReleaseAndGetAddressOf());
+    // カメラごと
+    addPass("Shadow", [this]() { drawShadowPass(); }, true, {}, { FrameTarget::ShadowMap });
+    addPass("Geometry", [this]()
+        {
+            beginGeometry(m_frameCamera.view, m_frameCamera.proj);
+            drawQueue(RenderQueue::Geometry, *m_frameCamera.pInter);
+            endGeometry();
+        }, true, {}, { FrameTarget::GBuffer0, FrameTarget::GBuffer1, FrameTarget::GBuffer2, FrameTarget::GBuffer3, FrameTarget::Depth });
+    addPass("Decal", [this]()
+        {
+            beginDecal(m_frameCamera.view, m_frameCamera.proj);
+            drawQueue(RenderQueue::Decal, *m_frameCamera.pInter);
+            endDecal();
+        }, true, { FrameTarget::GBuffer2 }, { FrameTarget::GBuffer0, FrameTarget::Depth });
+    addPass("Lighting", [this]() { drawLightingPass(); }, true, { FrameTarget::GBuffer0, FrameTarget::GBuffer1, FrameTarget::GBuffer2, FrameTarget::GBuffer3, FrameTarget::ShadowMap }, { FrameTarget::Scene });
+    addPass("Forward", [this]() { drawForwardPass(); }, true, {}, { FrameTarget::Scene, FrameTarget::Depth });
+
+    // ポストプロセス (合成が読まない描画先を書くパスは除かれる)
+    bool isBloom = HasFlag(mask, PostProcessShaderMask::Bloom), isGray = HasFlag(mask, PostProcessShaderMask::Gray), isFXAA = HasFlag(mask, PostProcessShaderMask::FXAA);
+    addPass("BloomExtract", [this]()
+        {
+            ID3D11ShaderResourceView* srv = getTargetSRV(FrameTarget::Scene);
+            drawPostProcess(PostProcessShaderType::BloomExtract, FrameTarget::Bloom, { &srv, 1 }, Vector2::Zero(), 1.0f); // これ以上の彩度光がブラー対象です
+        }, false, { FrameTarget::Scene }, { FrameTarget::Bloom });
+    addPass("BloomBlurX", [this]()
+        {
+            ID3D11ShaderResourceView* srv = getTargetSRV(FrameTarget::Bloom);
+            drawPostProcess(PostProcessShaderType::GaussianBlur, FrameTarget::BloomWork, { &srv, 1 }, Vector2(1.0f, 0.0f)); // 横方向
+        }, false, { FrameTarget::Bloom }, { FrameTarget::BloomWork });
+    addPass("BloomBlurY", [this]()
+        {
+            ID3D11ShaderResourceView* srv = getTargetSRV(FrameTarget::BloomWork);
+            drawPostProcess(PostProcessShaderType::GaussianBlur, FrameTarget::BloomBlur, { &srv, 1 }, Vector2(0.0f, 1.0f)); // 縦方向
+        }, false, { FrameTarget::BloomWork }, { FrameTarget::BloomBlur });
+    addPass("Gray", [this]()
+        {
+            ID3D11ShaderResourceView* srv = getTargetSRV(FrameTarget::Scene);
+            drawPostProcess(PostProcessShaderType::Gray, FrameTarget::Gray, { &srv, 1 });
+        }, false, { FrameTarget::Scene }, { FrameTarget::Gray });
 
-    // SRV作成
-    m_pDevice->CreateShaderResourceView(m_pWorkTexture.Get(), nullptr, m_pWorkSRV.ReleaseAndGetAddressOf());
+    // ブラー合成,色調調整をしてLDRして最終的なシーンテクスチャを完成させる
+    // ブルームが無効な時は黒ダミーテクスチャで加算をさせないようにする
+    FrameTarget source = isGray ? FrameTarget::Gray : FrameTarget::Scene;
+    uint32_t composite = addPass("Composite", [this, source, isBloom]()
+        {
+            ID3D11ShaderResourceView* srvs[2] = { getTargetSRV(source), isBloom ? getTargetSRV(FrameTarget::BloomBlur) : m_pDummyTextureBlack.Get() };
+            drawPostProcess(PostProcessShaderType::Compossite, FrameTarget::Composite, srvs);
+        }, false, { source }, { FrameTarget::Composite });
+    if (isBloom)
+    {
+        m_renderGraph.read(composite, m_frameTargets[size_t(FrameTarget::BloomBlur)]);
+    }
 
-    // ブルーム用 (1/4サイズ)
-    D3D11_TEXTURE2D_DESC bloomDesc = texDesc; // 設定をコピー
-    bloomDesc.Width /= 4;                     // 幅 1/4
-    bloomDesc.Height /= 4;                    // 高さ 1/4
+    // シーンテクスチャをバックバッファに出力(コピー)する(FXAAが有効な場合FXAAを行いつつ出力)
+    addPass("Present", [this, isFXAA]()
+        {
+            ID3D11ShaderResourceView* srv = getTargetSRV(FrameTarget::Composite);
+            drawPostProcess(isFXAA ? PostProcessShaderType::FXAA : PostProcessShaderType::None, FrameTarget::BackBuffer, { &srv, 1 });
+        }, false, { FrameTarget::Composite }, { FrameTarget::BackBuffer });
 
-    // ブルームのRTVとSRVを生成
-    for (size_t cnt = 0; cnt < std::min(m_pBloomRTVs.size(), m_pBloomSRVs.size()); ++cnt)
+    if (!m_renderGraph.compile())
     {
-        ComPtr<ID3D11Texture2D> pBloomTex = nullptr;
-        m_pDevice->CreateTexture2D(&bloomDesc, nullptr, pBloomTex.GetAddressOf());
-        if (pBloomTex != nullptr)
-        {
-            m_pDevice->CreateRenderTargetView(pBloomTex.Get(), nullptr, m_pBloomRTVs[cnt].ReleaseAndGetAddressOf());
-            m_pDevice->CreateShaderResourceView(pBloomTex.Get(), nullptr, m_pBloomSRVs[cnt].ReleaseAndGetAddressOf());
-        }
+        OutputDebugString(L"ERROR::RenderGraph::compile\n");
     }
 }
 
 //----------------------------------------------------
-// MRT用のバッファを生成する
+// フレームの描画先の実体を生成する (グラフの実体ごとに1つ 作ってあれば何もしない)
 //----------------------------------------------------
-void RendererImpl::setupGBuffer()
+void RendererImpl::setupGraphTextures()
 {
-    // 各バッファのフォーマット
-    DXGI_FORMAT formats[GBUFFER_COUNT]
+    auto physicalTextures = m_renderGraph.getPhysicalTextures();
+    if (m_graphTextures.size() == physicalTextures.size())
     {
-        DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,   // 0: Albedo (色) sRGBで保存
-        DXGI_FORMAT_R16G16B16A16_FLOAT,    // 1: Normal (法線) - 精度が必要
-        DXGI_FORMAT_R32G32B32A32_FLOAT,    // 2: Position (座標) - かなり精度が必要
-        DXGI_FORMAT_R16G16B16A16_FLOAT     // 3: Emissive (発光)
-    };
+        return;
+    }
 
-    for (int cnt = 0; cnt < GBUFFER_COUNT; ++cnt)
+    m_graphTextures.assign(physicalTextures.size(), GraphTexture());
+    for (size_t cnt = 0; cnt < physicalTextures.size(); ++cnt)
     {
         // テクスチャ作成
-        D3D11_TEXTURE2D_DESC texDesc{};
-        texDesc.Width = UINT(m_screenSize.x);
-        texDesc.Height = UINT(m_screenSize.y);
+        D3D11_TEXTURE2D_DESC texDesc = {};
+        texDesc.Width = std::max(1u, UINT(m_screenSize.x) >> physicalTextures[cnt].sizeShift);
+        texDesc.Height = std::max(1u, UINT(m_screenSize.y) >> physicalTextures[cnt].sizeShift);
         texDesc.MipLevels = 1;
         texDesc.ArraySize = 1;
-        texDesc.Format = formats[cnt];
+        texDesc.Format = DXGI_FORMAT(physicalTextures[cnt].format);
         texDesc.SampleDesc.Count = 1;
-        texDesc.SampleDesc.Quality = 0;
         texDesc.Usage = D3D11_USAGE_DEFAULT;
         texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // 書く＆読む
-        texDesc.CPUAccessFlags = 0;
-        m_pDevice->CreateTexture2D(&texDesc, nullptr, m_pGBufferTextures[cnt].ReleaseAndGetAddressOf());
 
-        // RenderTargetView (書き込み用) 作成
-        D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-        rtvDesc.Format = formats[cnt];
-        rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-        m_pDevice->CreateRenderTargetView(m_pGBufferTextures[cnt].Get(), &rtvDesc, m_pGBufferRTVs[cnt].ReleaseAndGetAddressOf());
+        GraphTexture& texture = m_graphTextures[cnt];
+        if (FAILED(m_pDevice->CreateTexture2D(&texDesc, nullptr, texture.pTexture.ReleaseAndGetAddressOf()))) continue;
+
+        // RTV作成
+        m_pDevice->CreateRenderTargetView(texture.pTexture.Get(), nullptr, texture.pRTV.ReleaseAndGetAddressOf());
+
+        // SRV作成
+        m_pDevice->CreateShaderResourceView(texture.pTexture.Get(), nullptr, texture.pSRV.ReleaseAndGetAddressOf());
+    }
+}
+
+//----------------------------------------------------
+// パスを始める前の準備 (D3D11は読み書きを同時に設定できないので状態の切り替えで外し,最初の書き込みをクリアする)
+//----------------------------------------------------
+void RendererImpl::prepareGraphPass(const RenderGraphCompiledPass& pass)
+{
+    for (const auto& barrier : pass.barriers)
+    {
+        if (barrier.after == RenderGraphAccess::Read)
+        {
+            // 書いていたものを読む (ターゲットのまま読むとD3DがSRVを外す)
+            bindRenderTargets(0, nullptr, nullptr);
+        }
+        else
+        {
+            // 読んでいたものに書く (SRVに残っているとD3Dが外して警告を出す)
+            ID3D11ShaderResourceView* nullSRVs[PASS_INPUT_SLOTS] = {};
+            bindPSResources(0, PASS_INPUT_SLOTS, nullSRVs);
+        }
+    }
+
+    for (uint32_t resource : pass.clears)
+    {
+        uint32_t physical = m_renderGraph.getPhysicalIndex(resource);
+        if (physical < m_graphTextures.size() && m_graphTextures[physical].pRTV != nullptr)
+        {
+            clearRenderTarget(m_graphTextures[physical].pRTV.Get());
+        }
+    }
+}
+
+//----------------------------------------------------
+// 描画先の書き込み用ビュー (グラフが割り当てた実体)
+//----------------------------------------------------
+ID3D11RenderTargetView* RendererImpl::getTargetRTV(FrameTarget target) const
+{
+    uint32_t physical = m_renderGraph.getPhysicalIndex(m_frameTargets[size_t(target)]);
+    return (physical < m_graphTextures.size()) ? m_graphTextures[physical].pRTV.Get() : nullptr;
+}
 
-        // ShaderResourceView (読み込み用) 作成
-        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-        srvDesc.Format = formats[cnt];
-        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MipLevels = 1;
-        m_pDevice->CreateShaderResourceView(m_pGBufferTextures[cnt].Get(), &srvDesc, m_pGBufferSRVs[cnt].ReleaseAndGetAddressOf());
+//----------------------------------------------------
+// 描画先の読み込み用ビュー (シャドウマップは外で持つ)
+//----------------------------------------------------
+ID3D11ShaderResourceView* RendererImpl::getTargetSRV(FrameTarget target) const
+{
+    if (target == FrameTarget::ShadowMap)
+    {
+        return m_pShadowSRV.Get();
     }
+    uint32_t physical = m_renderGraph.getPhysicalIndex(m_frameTargets[size_t(target)]);
+    return (physical < m_graphTextures.size()) ? m_graphTextures[physical].pSRV.Get() : nullptr;
 }
 
 //----------------------------------------------------
-// シャドウマップ生成
+// シャドウマップ生成 (カスケード数のスライスを持つ配列テクスチャ)
 //----------------------------------------------------
 void RendererImpl::setupShadowMap()
 {
     // テクスチャの作成
     D3D11_TEXTURE2D_DESC texDesc = {};
-    texDesc.Width = SHADOWMAP_SIZE;
-    texDesc.Height = SHADOWMAP_SIZE;
+    texDesc.Width = m_shadowSettings.resolution;
+    texDesc.Height = m_shadowSettings.resolution;
     texDesc.MipLevels = 1;
-    texDesc.ArraySize = 1;
+    texDesc.ArraySize = m_shadowSettings.cascadeCount;
     texDesc.Format = DXGI_FORMAT_R32_TYPELESS; // 32bit深度
     texDesc.SampleDesc.Count = 1;
     texDesc.SampleDesc.Quality = 0;
@@ -2346,20 +4098,42 @@ void RendererImpl::setupShadowMap()
     texDesc.MiscFlags = 0;
     if (FAILED(m_pDevice->CreateTexture2D(&texDesc, nullptr, m_pShadowTexture.ReleaseAndGetAddressOf()))) return;
 
-    // 書き込み用ビューの作成
-    D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-    dsvDesc.Format = DXGI_FORMAT_D32_FLOAT; // 深度
-    dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-    dsvDesc.Texture2D.MipSlice = 0;
-    m_pDevice->CreateDepthStencilView(m_pShadowTexture.Get(), &dsvDesc, m_pShadowDSV.ReleaseAndGetAddressOf());
+    // 書き込み用ビューの作成 (スライスごと)
+    for (UINT cnt = 0; cnt < m_shadowSettings.cascadeCount; ++cnt)
+    {
+        D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT; // 深度
+        dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+        dsvDesc.Texture2DArray.MipSlice = 0;
+        dsvDesc.Texture2DArray.FirstArraySlice = cnt;
+        dsvDesc.Texture2DArray.ArraySize = 1;
+        m_pDevice->CreateDepthStencilView(m_pShadowTexture.Get(), &dsvDesc, m_pShadowDSVs[cnt].ReleaseAndGetAddressOf());
+    }
 
-    // 読み込み用ビューの作成
+    // 読み込み用ビューの作成 (全スライス)
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Format = DXGI_FORMAT_R32_FLOAT; // 赤色として深度を読む
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = 1;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.Texture2DArray.MostDetailedMip = 0;
+    srvDesc.Texture2DArray.MipLevels = 1;
+    srvDesc.Texture2DArray.FirstArraySlice = 0;
+    srvDesc.Texture2DArray.ArraySize = m_shadowSettings.cascadeCount;
     m_pDevice->CreateShaderResourceView(m_pShadowTexture.Get(), &srvDesc, m_pShadowSRV.ReleaseAndGetAddressOf());
+
+    // 動かない影のキャッシュ (書き込みと写すだけ)
+    texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+    if (FAILED(m_pDevice->CreateTexture2D(&texDesc, nullptr, m_pStaticShadowTexture.ReleaseAndGetAddressOf()))) return;
+    for (UINT cnt = 0; cnt < m_shadowSettings.cascadeCount; ++cnt)
+    {
+        D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT; // 深度
+        dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+        dsvDesc.Texture2DArray.MipSlice = 0;
+        dsvDesc.Texture2DArray.FirstArraySlice = cnt;
+        dsvDesc.Texture2DArray.ArraySize = 1;
+        m_pDevice->CreateDepthStencilView(m_pStaticShadowTexture.Get(), &dsvDesc, m_pStaticShadowDSVs[cnt].ReleaseAndGetAddressOf());
+    }
+    m_staticShadowCache.invalidate();
 }
 
 //----------------------------------------------------
@@ -2374,6 +4148,8 @@ void RendererImpl::setupFont()
 
         // フォントファイルの読み込み
         m_spriteFont = std::make_unique<DirectX::SpriteFont>(m_pDevice.Get(), L"data/FONT/test.spritefont");
+        m_spriteFont->GetSpriteSheet(m_pFontSheet.ReleaseAndGetAddressOf());
+        m_textLayouts.clear();
     }
     catch (const std::exception& e)
     {
@@ -2385,40 +4161,100 @@ void RendererImpl::setupFont()
 }
 
 //----------------------------------------------------
-// シーンバッファ破棄
+// フレームの描画先破棄 (パスはそのまま 次のsetupGraphTexturesで作り直す)
 //----------------------------------------------------
-void RendererImpl::releaseSceneBuffer()
+void RendererImpl::releaseGraphTextures()
 {
-    // ブルーム
-    m_pBloomRTVs.fill(nullptr);
-    m_pBloomSRVs.fill(nullptr);
+    m_graphTextures.clear();
+}
 
-    // リソース
-    m_pWorkSRV.Reset();
-    m_pSceneSRV.Reset();
+//----------------------------------------------------
+// GPUのフレーム時間を測るクエリを生成する (作れなければ測らず,動的解像度は今の割合のまま)
+//----------------------------------------------------
+void RendererImpl::setupFrameTimers()
+{
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0u };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0u };
+    for (auto& timer : m_frameTimers)
+    {
+        timer = FrameTimer();
+        if (FAILED(m_pDevice->CreateQuery(&disjointDesc, timer.pDisjoint.GetAddressOf())) ||
+            FAILED(m_pDevice->CreateQuery(&timestampDesc, timer.pBegin.GetAddressOf())) ||
+            FAILED(m_pDevice->CreateQuery(&timestampDesc, timer.pEnd.GetAddressOf())))
+        {
+            timer = FrameTimer();
+        }
+    }
+    m_frameTimerIndex = 0u;
+}
 
-    // ターゲット
-    m_pWorkRTV.Reset();
-    m_pSceneRTV.Reset();
+//----------------------------------------------------
+// フレーム時間のクエリ破棄
+//----------------------------------------------------
+void RendererImpl::releaseFrameTimers()
+{
+    for (auto& timer : m_frameTimers)
+    {
+        timer = FrameTimer();
+    }
+    m_frameTimerIndex = 0u;
+}
 
-    // テクスチャ
-    m_pWorkTexture.Reset();
-    m_pSceneTexture.Reset();
+//----------------------------------------------------
+// GPUのフレーム時間を測り始める
+//----------------------------------------------------
+void RendererImpl::beginFrameTimer()
+{
+    FrameTimer& timer = m_frameTimers[m_frameTimerIndex];
+    if (timer.pDisjoint == nullptr)
+    {
+        return;
+    }
+    m_pContext->Begin(timer.pDisjoint.Get());
+    m_pContext->End(timer.pBegin.Get());
 }
 
-//---------------------------------
-// MRT破棄
-//---------------------------------
-void RendererImpl::releaseGBuffer()
+//----------------------------------------------------
+// GPUのフレーム時間を測り終える (次のフレームは次のクエリを使う)
+//----------------------------------------------------
+void RendererImpl::endFrameTimer()
 {
-    // リソース
-    m_pGBufferSRVs.fill(nullptr);
+    FrameTimer& timer = m_frameTimers[m_frameTimerIndex];
+    if (timer.pDisjoint != nullptr)
+    {
+        m_pContext->End(timer.pEnd.Get());
+        m_pContext->End(timer.pDisjoint.Get());
+        timer.isIssued = true;
+    }
+    m_frameTimerIndex = (m_frameTimerIndex + 1u) % m_frameTimers.size();
+}
 
-    // ターゲット
-    m_pGBufferRTVs.fill(nullptr);
+//----------------------------------------------------
+// 動的解像度の更新 (これから使うクエリが前に測ったフレーム時間を制御に渡し,3Dを描く大きさを決める)
+//----------------------------------------------------
+void RendererImpl::updateDynamicResolution()
+{
+    // まだ終わっていなければ待たずに捨てる (止まるよりは1フレーム分測れない方がよい)
+    float frameMs = 0.0f;
+    FrameTimer& timer = m_frameTimers[m_frameTimerIndex];
+    if (timer.isIssued)
+    {
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+        UINT64 begin = 0u, end = 0u;
+        if (m_pContext->GetData(timer.pDisjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+            m_pContext->GetData(timer.pBegin.Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+            m_pContext->GetData(timer.pEnd.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+            !disjoint.Disjoint && disjoint.Frequency > 0u && end > begin)
+        {
+            frameMs = static_cast<float>(static_cast<double>(end - begin) * 1000.0 / static_cast<double>(disjoint.Frequency));
+        }
+        timer.isIssued = false;
+    }
+    float scale = m_dynamicResolution.update(frameMs);
 
-    // テクスチャ
-    m_pGBufferTextures.fill(nullptr);
+    // 幅と高さに同じ割合をかける (縦横比は変わらないので射影行列はそのまま)
+    m_sceneSize.x = std::max(1.0f, std::round(m_screenSize.x * scale));
+    m_sceneSize.y = std::max(1.0f, std::round(m_screenSize.y * scale));
 }
 
 //----------------------------------------------------
@@ -2430,10 +4266,141 @@ void RendererImpl::releaseShadowMap()
     m_pShadowSRV.Reset();
 
     // ターゲット
-    m_pShadowDSV.Reset();
+    for (auto& pDSV : m_pShadowDSVs)
+    {
+        pDSV.Reset();
+    }
+    for (auto& pDSV : m_pStaticShadowDSVs)
+    {
+        pDSV.Reset();
+    }
 
     // テクスチャ
     m_pShadowTexture.Reset();
+    m_pStaticShadowTexture.Reset();
+    m_staticShadowCache.invalidate();
+}
+
+//----------------------------------------------------
+// クラスターライトのバッファ生成 (最大数で作り,毎フレーム書き換える)
+//----------------------------------------------------
+void RendererImpl::setupLightClusters()
+{
+    auto createStructured = [this](UINT stride, UINT count, ComPtr<ID3D11Buffer>& pBuffer, ComPtr<ID3D11ShaderResourceView>& pSRV)
+        {
+            D3D11_BUFFER_DESC bd = {};
+            bd.ByteWidth = stride * count;
+            bd.Usage = D3D11_USAGE_DYNAMIC;
+            bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+            bd.StructureByteStride = stride;
+            if (FAILED(m_pDevice->CreateBuffer(&bd, nullptr, pBuffer.ReleaseAndGetAddressOf()))) return;
+
+            D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+            srvDesc.Buffer.FirstElement = 0;
+            srvDesc.Buffer.NumElements = count;
+            m_pDevice->CreateShaderResourceView(pBuffer.Get(), &srvDesc, pSRV.ReleaseAndGetAddressOf());
+        };
+    createStructured(sizeof(PointLightData), UINT(MAX_POINT_LIGHT), m_pPointLightBuffer, m_pLightClusterSRVs[0]);
+    createStructured(sizeof(LightClusterRange), cluster::CLUSTER_COUNT, m_pLightClusterBuffer, m_pLightClusterSRVs[1]);
+    createStructured(sizeof(uint32_t), cluster::MAX_LIGHT_INDICES, m_pLightIndexBuffer, m_pLightClusterSRVs[2]);
+}
+
+//----------------------------------------------------
+// クラスターライトのバッファ破棄
+//----------------------------------------------------
+void RendererImpl::releaseLightClusters()
+{
+    for (auto& pSRV : m_pLightClusterSRVs)
+    {
+        pSRV.Reset();
+    }
+    m_pLightIndexBuffer.Reset();
+    m_pLightClusterBuffer.Reset();
+    m_pPointLightBuffer.Reset();
+}
+
+//----------------------------------------------------
+// 点光源をカメラのクラスターに振り分けて送る
+//----------------------------------------------------
+void RendererImpl::updateLightClusters(const Matrix& cameraView, const Matrix& cameraProj)
+{
+    m_lightData.PointLightCount = 0;
+    if (m_pointLights.empty() || m_pLightClusterSRVs[2] == nullptr)
+    {
+        return;
+    }
+
+    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    if (!m_lightClusters.build(cameraView, cameraProj, m_pointLights, threadCount))
+    {
+        return;
+    }
+
+    // 3つのバッファに写す
+    auto upload = [this](ID3D11Buffer* pBuffer, const void* pData, size_t size)
+        {
+            D3D11_MAPPED_SUBRESOURCE mapped{};
+            if (FAILED(m_pContext->Map(pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+            {
+                return false;
+            }
+            if (size > 0u)
+            {
+                std::memcpy(mapped.pData, pData, size);
+            }
+            m_pContext->Unmap(pBuffer, 0);
+            return true;
+        };
+    auto pointLights = m_lightClusters.getPointLights();
+    auto clusters = m_lightClusters.getClusters();
+    auto indices = m_lightClusters.getLightIndices();
+    if (!upload(m_pPointLightBuffer.Get(), pointLights.data(), pointLights.size_bytes()) ||
+        !upload(m_pLightClusterBuffer.Get(), clusters.data(), clusters.size_bytes()) ||
+        !upload(m_pLightIndexBuffer.Get(), indices.data(), indices.size_bytes()))
+    {
+        return;
+    }
+
+    // シェーダーでクラスターを引くための値
+    bool isLogarithmic = false;
+    m_lightClusters.getShaderParams(m_sceneSize, m_lightData.ClusterViewDepthRow, m_lightData.ClusterScale, isLogarithmic);
+    m_lightData.ClusterDims[0] = int(cluster::COUNT_X);
+    m_lightData.ClusterDims[1] = int(cluster::COUNT_Y);
+    m_lightData.ClusterDims[2] = int(cluster::COUNT_Z);
+    m_lightData.ClusterDims[3] = isLogarithmic ? 1 : 0;
+    m_lightData.PointLightCount = int(pointLights.size());
+}
+
+//----------------------------------------------------
+// クラスターライトをピクセルシェーダーにセット (t6~t8)
+//----------------------------------------------------
+void RendererImpl::bindLightClusters()
+{
+    bindPSResources(6, UINT(m_pLightClusterSRVs.size()), MakeRawArray(m_pLightClusterSRVs).data());
+}
+
+//----------------------------------------------------
+// 影の設定 (カスケード数か解像度が変わったらシャドウマップを作り直す)
+//----------------------------------------------------
+void RendererImpl::setShadowSettings(const ShadowSettings& settings)
+{
+    ShadowSettings clamped = settings;
+    clamped.cascadeCount = std::clamp(clamped.cascadeCount, 1u, static_cast<unsigned int>(MAX_SHADOW_CASCADES));
+    clamped.resolution = std::clamp(clamped.resolution, MIN_SHADOWMAP_SIZE, MAX_SHADOWMAP_SIZE);
+
+    bool isResize = clamped.cascadeCount != m_shadowSettings.cascadeCount || clamped.resolution != m_shadowSettings.resolution;
+    m_shadowSettings = clamped;
+    m_staticShadowCache.invalidate(); // キャッシュの範囲は設定から作るので描き直す
+
+    if (isResize && m_pDevice != nullptr)
+    {
+        releaseShadowMap();
+        setupShadowMap();
+    }
 }
 
 //---------------------------------
@@ -2441,8 +4408,12 @@ void RendererImpl::releaseShadowMap()
 //---------------------------------
 void RendererImpl::drawDecal(Matrix transform, const MeshHandle& handle, Color color)
 {
+    DrawContext& dc = currentDrawContext();
+    if (!setMesh(handle))
+    {
+        return;
+    }
     setTransformWorld(transform);
-    setMesh(handle);
 
     // 逆行列
     DecalBufferData cb;
@@ -2450,29 +4421,98 @@ void RendererImpl::drawDecal(Matrix transform, const MeshHandle& handle, Color c
     cb.DecalColor = color;
 
     // 定数バッファ更新
-    m_pContext->UpdateSubresource(m_pWMatBuffer.Get(), 0, nullptr, &m_wMatData, 0, 0);   // ワールド行列
-    m_pContext->UpdateSubresource(m_pDecalBuffer.Get(), 0, nullptr, &cb, 0, 0);          // デカール情報
+    reserveConstantRing();
+    dc.pContext->UpdateSubresource(m_pDecalBuffer.Get(), 0, nullptr, &cb, 0, 0);          // デカール情報
 
     // 頂点シェーダーに送る
-    ID3D11Buffer* buffer = m_pWMatBuffer.Get();
-    m_pContext->VSSetConstantBuffers(1, 1, &buffer);  // スロット1にセット
+    bindConstantBuffer(ShaderStage::Vertex, 1, commitConstantBlock(ConstantBlockType::World, m_pWMatBuffer.Get(), &dc.wMatData, sizeof(dc.wMatData))); // スロット1にセット
 
     // ピクセルシェーダーに送る
-    buffer = m_pMtlBuffer.Get();
-    m_pContext->PSSetConstantBuffers(2, 1, &buffer); // スロット2にセット
-    buffer = m_pDecalBuffer.Get();
-    m_pContext->PSSetConstantBuffers(4, 1, &buffer); // スロット4にセット
+    bindConstantBuffer(ShaderStage::Pixel, 2, commitConstantBlock(ConstantBlockType::Material, m_pMtlBuffer.Get(), &dc.mtlData, sizeof(dc.mtlData))); // スロット2にセット
+    bindConstantBuffer(ShaderStage::Pixel, 4, m_pDecalBuffer.Get());                                                                                    // スロット4にセット
 
     // シェーダー設定
-    m_pContext->IASetInputLayout(m_pInputLayout3D.Get());  // 入力レイアウト設定
-    m_pContext->VSSetShader(m_pDecalVS.Get(), nullptr, 0); // 頂点シェーダー設定
+    bindInputLayout(m_pInputLayout3D.Get());  // 入力レイアウト設定
+    bindVertexShader(m_pDecalVS.Get()); // 頂点シェーダー設定
 
     // ピクセルシェーダー設定
-    m_pContext->PSSetShader(m_pDecalPS.Get(), nullptr, 0);
+    bindPixelShader(m_pDecalPS.Get());
 
     // 描画
-    if (handle.isValid())
-    m_pContext->DrawIndexed(UINT(m_meshs[handle.id].indicesCount), 0, 0);
+    std::shared_lock<std::shared_mutex> lock(m_meshMutex);
+    dc.pContext->DrawIndexed(UINT(m_meshs[handle.id].indicesCount), dc.meshStartIndex, static_cast<INT>(dc.meshBaseVertex));
+}
+
+//---------------------------------
+// シャドウパス (最初の影を落とすライトをカメラの視錐台に合わせたカスケードに描く)
+//---------------------------------
+void RendererImpl::drawShadowPass()
+{
+    const FrameCamera& camera = m_frameCamera;
+
+    m_shadowData.CascadeCount = 0;
+    for (const auto& light : camera.lights)
+    {
+        Vector3 eye{}, target, up{};
+        if (!light->getShadowInfo(&eye, &target, &up))
+        {
+            continue;
+        }
+
+        if (BuildShadowCascades(camera.view, camera.proj, target - eye, up, m_shadowSettings, m_shadowCascades))
+        {
+            // 動かない影のキャッシュは最初のカメラだけ (カメラごとにカスケードが違うので交互に作り直さないように)
+            bool isCacheable = camera.index == 0u && m_drawList.getStaticCasterCount() > 0u;
+            for (UINT cntCascade = 0; cntCascade < m_shadowCascades.count; ++cntCascade)
+            {
+                drawShadowCascade(m_shadowCascades.cascades[cntCascade], cntCascade, isCacheable, *camera.pInter);
+            }
+
+            // ライティングでカスケードを選ぶための奥行き
+            float* pSplits = &m_shadowData.CascadeSplits.x;
+            for (UINT cntCascade = 0; cntCascade < MAX_SHADOW_CASCADES; ++cntCascade)
+            {
+                pSplits[cntCascade] = (cntCascade < m_shadowCascades.count) ? m_shadowCascades.cascades[cntCascade].splitFar : 0.0f;
+            }
+            m_shadowData.ViewDepthRow = Vector4(camera.view.m[0][2], camera.view.m[1][2], camera.view.m[2][2], camera.view.m[3][2]);
+            m_shadowData.CascadeCount = static_cast<int>(m_shadowCascades.count);
+        }
+        break; // シャドウマップは1つなので2つ目以降のライトは描かない
+    }
+}
+
+//---------------------------------
+// フォワードパス (空,アウトライン,半透明)
+//---------------------------------
+void RendererImpl::drawForwardPass()
+{
+    Renderer& inter = *m_frameCamera.pInter;
+
+    beginForward(m_frameCamera.view, m_frameCamera.proj);
+
+    // 空
+    setSkyMode();
+
+    drawQueue(RenderQueue::Sky, inter);
+
+    setForwardMode();
+
+    //-----------------------------------------------------------------------
+    // アウトライン (フォワードの中でsetOutlineModeを呼ぶとアウトライン)
+    //-----------------------------------------------------------------------
+    setOutlineMode();
+    setOutlineData(Color::Black(), 0.0005f);
+
+    drawQueue(RenderQueue::Outline, inter);
+
+    setForwardMode();
+    //-----------------------------------------------------------------------
+    // アウトライン終了
+    //-----------------------------------------------------------------------
+
+    drawQueue(RenderQueue::Transparent, inter);
+
+    endForward();
 }
 
 //---------------------------------
@@ -2480,43 +4520,47 @@ void RendererImpl::drawDecal(Matrix transform, const MeshHandle& handle, Color c
 //---------------------------------
 void RendererImpl::drawLightingPass()
 {
-    // シーンをセット
-    ID3D11RenderTargetView* rtv = m_pSceneRTV.Get();
-    m_pContext->OMSetRenderTargets(1, &rtv, nullptr);
+    // シーンをセット (クリアはレンダーグラフが最初の書き込みで行う)
+    ID3D11RenderTargetView* rtv = getTargetRTV(FrameTarget::Scene);
+    bindRenderTargets(1, &rtv, nullptr);
 
-    // シーンをクリアする
-    clearRenderTarget(m_pSceneRTV.Get());
+    // ビューポート設定 (Gバッファを描いた範囲)
+    D3D11_VIEWPORT vp = {};
+    vp.Width = m_sceneSize.x;
+    vp.Height = m_sceneSize.y;
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    vp.TopLeftX = 0.0f;
+    vp.TopLeftY = 0.0f;
+    m_pContext->RSSetViewports(1, &vp);
 
     // リソースをシェーダーにセット
-    m_pContext->PSSetShaderResources(1, GBUFFER_COUNT, MakeRawArray(m_pGBufferSRVs).data());
+    ID3D11ShaderResourceView* srvs[GBUFFER_COUNT] = { getTargetSRV(FrameTarget::GBuffer0), getTargetSRV(FrameTarget::GBuffer1), getTargetSRV(FrameTarget::GBuffer2), getTargetSRV(FrameTarget::GBuffer3) };
+    bindPSResources(1, GBUFFER_COUNT, srvs);
 
     // シャドウマップをシェーダーにセット
     ID3D11ShaderResourceView* srv = m_pShadowSRV.Get();
-    m_pContext->PSSetShaderResources(5, 1, &srv);
+    bindPSResources(5, 1, &srv);
 
-    // シェーダー切り替え
-    m_pContext->IASetInputLayout(nullptr);
-    m_pContext->VSSetShader(m_pScreenVS.Get(), nullptr, 0);
-    m_pContext->PSSetShader(m_pUnifiedLighting_DL_PS.Get(), nullptr, 0);
+    // クラスターライトをシェーダーにセット
+    bindLightClusters();
 
-    ID3D11Buffer* buffer = nullptr;
+    // シェーダー切り替え
+    bindInputLayout(nullptr);
+    bindVertexShader(m_pScreenVS.Get());
+    bindPixelShader(m_pUnifiedLighting_DL_PS.Get());
 
     // ライトバッファの更新
     m_pContext->UpdateSubresource(m_pLightBuffer.Get(), 0, nullptr, &m_lightData, 0, 0);
-    buffer = m_pLightBuffer.Get();
-    m_pContext->PSSetConstantBuffers(3, 1, &buffer);
+    bindConstantBuffer(ShaderStage::Pixel, 3, m_pLightBuffer.Get());
 
-    // VP行列を定数バッファに送る
-    ShadowBufferData shadowData;
-    shadowData.LightViewProj = m_lightVPMatrix;
-    m_pContext->UpdateSubresource(m_pShadowConstantBuffer.Get(), 0, nullptr, &shadowData, 0, 0);
-    buffer = m_pShadowConstantBuffer.Get();
-    m_pContext->PSSetConstantBuffers(4, 1, &buffer);
+    // カスケードのVP行列と分割を定数バッファに送る
+    m_pContext->UpdateSubresource(m_pShadowConstantBuffer.Get(), 0, nullptr, &m_shadowData, 0, 0);
+    bindConstantBuffer(ShaderStage::Pixel, 4, m_pShadowConstantBuffer.Get());
 
-    // ライトバッファの更新
-    m_pContext->UpdateSubresource(m_pFogBuffer.Get(), 0, nullptr, &m_fogData, 0, 0);
-    buffer = m_pFogBuffer.Get();
-    m_pContext->PSSetConstantBuffers(5, 1, &buffer);
+    // フォグバッファの更新
+    reserveConstantRing();
+    bindConstantBuffer(ShaderStage::Pixel, 5, commitConstantBlock(ConstantBlockType::Fog, m_pFogBuffer.Get(), &m_fogData, sizeof(m_fogData)));
 
     // 描画設定
     setLightingPassMode();
@@ -2531,203 +4575,111 @@ void RendererImpl::drawLightingPass()
     
     // G-Buffer
     ID3D11ShaderResourceView* nullSRVs[GBUFFER_COUNT] = { nullptr, nullptr, nullptr,nullptr };
-    m_pContext->PSSetShaderResources(1, GBUFFER_COUNT, nullSRVs);
+    bindPSResources(1, GBUFFER_COUNT, nullSRVs);
 
     // シャドウマップ
     ID3D11ShaderResourceView* nullSRV = nullptr;
-    m_pContext->PSSetShaderResources(5, 1, &nullSRV);
+    bindPSResources(5, 1, &nullSRV);
 }
 
 //---------------------------------
-// ポストプロセスの描画
+// ポストプロセスの描画 (全画面の三角形で読み込みから描画先に描く 描画先のクリアはレンダーグラフが行う)
 //---------------------------------
-void RendererImpl::drawPostProcessPass(PostProcessShaderMask mask, ToneMappingType type)
+void RendererImpl::drawPostProcess(PostProcessShaderType type, FrameTarget target, std::span<ID3D11ShaderResourceView* const> sources, const Vector2& blurDir, float bloomThreshold)
 {
-    ID3D11Buffer* buffer = nullptr;
-
     // 定数バッファ更新
     PostProcessBufferData cb;
     float w = (float)m_screenSize.x;
     float h = (float)m_screenSize.y;
     cb.ScreenSize = Vector4(w, h, 1.0f / w, 1.0f / h); // z,w には逆数を入れる
-    cb.BlurDir = Vector2::Zero();                      // ブラー方向をいったん初期化
-    cb.bloomThreshold = 0.1f;                          // ブルーム閾値
+    cb.BlurDir = blurDir;                              // ブラー方向
+    cb.bloomThreshold = bloomThreshold;                // ブルーム閾値
     cb.bloomIntensity = 5.0f;                          // ブルーム係数
-    cb.toneMappingType = int(type);                    // トーンマッピングの種類
+    cb.toneMappingType = int(m_toneMappingType);       // トーンマッピングの種類
+    cb.UVScale = m_sceneSize / m_screenSize;           // 描いた範囲 (描画先はどれも左上のこの割合だけ描いてある)
     m_pContext->UpdateSubresource(m_pPostProcessBuffer.Get(), 0, nullptr, &cb, 0, 0);
-    buffer = m_pPostProcessBuffer.Get();
-    m_pContext->PSSetConstantBuffers(0, 1, &buffer);
+    bindConstantBuffer(ShaderStage::Pixel, 0, m_pPostProcessBuffer.Get());
 
     // 全画面用 (ScreenVS)
-    m_pContext->VSSetShader(m_pScreenVS.Get(), nullptr, 0);
+    bindInputLayout(nullptr);
+    bindVertexShader(m_pScreenVS.Get());
 
     // ポストプロセス用設定
     setPostProcessMode();
 
-    // 今、絵が入っている場所 (最初SceneTexture)
-    ID3D11ShaderResourceView* currentSRV = m_pSceneSRV.Get();
-
-    // 次に書き込む場所 (最初WorkTexture)
-    ID3D11RenderTargetView* nextRTV = m_pWorkRTV.Get();
-
-    // 次のRTVに対応するSRV (スワップ用)
-    ID3D11ShaderResourceView* nextSRV = m_pWorkSRV.Get();
-
-    // Maskチェック
-    bool isPP = Any(mask), isBloom = HasFlag(mask, PostProcessShaderMask::Bloom), isGray = HasFlag(mask, PostProcessShaderMask::Gray), isFXAA = HasFlag(mask, PostProcessShaderMask::FXAA);
-
-    //---------------
-    // ポストプロセス
-    //---------------
-    if (isPP)
+    // 書き込み (バックバッファ以外はグラフの実体)
+    bool isBackBuffer = target == FrameTarget::BackBuffer;
+    ID3D11RenderTargetView* rtv = isBackBuffer ? m_pRenderTargetView.Get() : getTargetRTV(target);
+    bindRenderTargets(1, &rtv, nullptr);
+    if (isBackBuffer)
     {
-        if (isBloom)
-        {
-            // ビューポートを1/4に変更
-            D3D11_VIEWPORT vp = { 0, 0, w / 4.0f, h / 4.0f, 0.0f, 1.0f };
-            m_pContext->RSSetViewports(1, &vp);
-
-            // 抽出
-            cb.bloomThreshold = 1.0f; // これ以上の彩度光がブラー対象です
-            m_pContext->UpdateSubresource(m_pPostProcessBuffer.Get(), 0, nullptr, &cb, 0, 0);
-
-            // 書き込み
-            ID3D11RenderTargetView* rtv = m_pBloomRTVs[0].Get();
-            m_pContext->OMSetRenderTargets(1, &rtv, nullptr);
-            clearRenderTarget(rtv);
-
-            // 読み込み
-            m_pContext->PSSetShaderResources(0, 1, &currentSRV); // 今のシーン
-
-            // シェーダー
-            m_pContext->PSSetShader(m_pPostProcessShaders[size_t(PostProcessShaderType::BloomExtract)].Get(), nullptr, 0); // 光を抽出するシェーダ
-            m_pContext->Draw(3, 0);
-
-            // SRVの解除
-            ID3D11ShaderResourceView* nullSRV = nullptr;
-            m_pContext->PSSetShaderResources(0, 1, &nullSRV);
-
-            // 横ぼかし
-            cb.BlurDir = Vector2(1.0f, 0.0f); // 横方向
-            m_pContext->UpdateSubresource(m_pPostProcessBuffer.Get(), 0, nullptr, &cb, 0, 0);
-
-            // 書き込み
-            rtv = m_pBloomRTVs[1].Get();
-            m_pContext->OMSetRenderTargets(1, &rtv, nullptr);
-            clearRenderTarget(rtv);
-
-            // 読み込み
-            ID3D11ShaderResourceView* srv = m_pBloomSRVs[0].Get();
-            m_pContext->PSSetShaderResources(0, 1, &srv);
-
-            // シェーダー
-            m_pContext->PSSetShader(m_pPostProcessShaders[size_t(PostProcessShaderType::GaussianBlur)].Get(), nullptr, 0);
-            m_pContext->Draw(3, 0);
-
-            // SRVの解除
-            m_pContext->PSSetShaderResources(0, 1, &nullSRV);
-
-            // 縦ぼかし
-            cb.BlurDir = Vector2(0.0f, 1.0f); // 縦方向
-            m_pContext->UpdateSubresource(m_pPostProcessBuffer.Get(), 0, nullptr, &cb, 0, 0);
-
-            // 書き込み
-            rtv = m_pBloomRTVs[0].Get();
-            m_pContext->OMSetRenderTargets(1, &rtv, nullptr);
-            clearRenderTarget(rtv);
-
-            // 読み込み
-            srv = m_pBloomSRVs[1].Get();
-            m_pContext->PSSetShaderResources(0, 1, &srv);
+        clearRenderTarget(rtv);
+    }
 
-            // シェーダー
-            m_pContext->PSSetShader(m_pPostProcessShaders[size_t(PostProcessShaderType::GaussianBlur)].Get(), nullptr, 0);
-            m_pContext->Draw(3, 0);
+    // バックバッファは全体に引き伸ばし,グラフの描画先は描いた範囲だけに描く
+    UINT sizeShift = isBackBuffer ? 0u : m_renderGraph.getPhysicalTextures()[m_renderGraph.getPhysicalIndex(m_frameTargets[size_t(target)])].sizeShift;
+    Vector2 viewScale = isBackBuffer ? Vector2(1.0f, 1.0f) : cb.UVScale;
+    D3D11_VIEWPORT vp = { 0, 0, float(UINT(w) >> sizeShift) * viewScale.x, float(UINT(h) >> sizeShift) * viewScale.y, 0.0f, 1.0f };
+    m_pContext->RSSetViewports(1, &vp);
 
-            // SRVの解除
-            m_pContext->PSSetShaderResources(0, 1, &nullSRV);
+    // 読み込み
+    bindPSResources(0, UINT(sources.size()), sources.data());
 
-            // ビューポートを戻す
-            D3D11_VIEWPORT fullVP = { 0, 0, w, h, 0.0f, 1.0f };
-            m_pContext->RSSetViewports(1, &fullVP);
-        }
-        if (isGray)
-        {
-            // 書き込み
-            m_pContext->OMSetRenderTargets(1, &nextRTV, nullptr);
-            clearRenderTarget(nextRTV);
+    // シェーダー
+    bindPixelShader(m_pPostProcessShaders[size_t(type)].Get());
+    m_pContext->Draw(3, 0);
 
-            // 読み込み
-            m_pContext->PSSetShaderResources(0, 1, &currentSRV);
+    // SRVの解除
+    ID3D11ShaderResourceView* nullSRVs[PASS_INPUT_SLOTS] = {};
+    bindPSResources(0, UINT(std::min<size_t>(sources.size(), PASS_INPUT_SLOTS)), nullSRVs);
+}
 
-            // シェーダー
-            m_pContext->PSSetShader(m_pPostProcessShaders[size_t(PostProcessShaderType::Gray)].Get(), nullptr, 0);
-            m_pContext->Draw(3, 0);
+//---------------------------------
+// 文字の描画 (Stringキューの中では開いているバッチに積むだけ 外からは1つずつ描く)
+//---------------------------------
+void RendererImpl::drawString(std::string_view string, Vector2 pos, Color color, float angle, Vector2 scale)
+{
+    if (string.empty() || m_spriteBatch == nullptr || m_spriteFont == nullptr) return;
 
-            // SRVの解除
-            ID3D11ShaderResourceView* nullSRV = nullptr;
-            m_pContext->PSSetShaderResources(0, 1, &nullSRV);
+    const TextLayout& layout = findTextLayout(string);
+    if (layout.glyphs.empty()) return;
 
-            // SRVを今描画した結果にする
-            std::swap(currentSRV, nextSRV);
-            nextRTV = (currentSRV == m_pSceneSRV.Get()) ? m_pWorkRTV.Get() : m_pSceneRTV.Get();
-        }
+    bool isSingle = !m_isTextBatchOpen;
+    if (isSingle)
+    {
+        beginString();
     }
 
-    // ブラー合成,色調調整をしてLDRして最終的なシーンテクスチャを完成させる
+    // 配置はキャッシュのまま 位置,回転,拡大はSpriteBatchに任せる (SpriteFont::DrawStringと同じ描き方)
+    DirectX::XMVECTOR position{ pos.x, pos.y };
+    DirectX::XMVECTOR colorVector{ color.r, color.g, color.b, color.a };
+    DirectX::XMVECTOR scaleVector{ scale.x, scale.y };
+    for (const auto& glyph : layout.glyphs)
     {
-        // 書き込み
-        m_pContext->OMSetRenderTargets(1, &nextRTV, nullptr);
-        clearRenderTarget(nextRTV);
+        m_spriteBatch->Draw(
+            m_pFontSheet.Get(),
+            position,
+            &glyph.subrect,
+            colorVector,
+            angle,
+            DirectX::XMLoadFloat2(&glyph.origin),
+            scaleVector
+        );
+    }
 
-        // 読み込み
-        m_pContext->PSSetShaderResources(0, 1, &currentSRV);
-
-        // ブルームが有効な場合ブルームの結果テクスチャをセット 無効な時は黒ダミーテクスチャで加算をさせないようにする
-        ID3D11ShaderResourceView* bloomTex = isBloom ? m_pBloomSRVs[0].Get() : m_pDummyTextureBlack.Get();
-        m_pContext->PSSetShaderResources(1, 1, &bloomTex);
-
-        // シェーダー
-        m_pContext->PSSetShader(m_pPostProcessShaders[size_t(PostProcessShaderType::Compossite)].Get(), nullptr, 0);
-        m_pContext->Draw(3, 0);
-
-        // SRVの解除
-        ID3D11ShaderResourceView* nullSRV = nullptr;
-        m_pContext->PSSetShaderResources(0, 1, &nullSRV);
-
-        // SRVを今描画した結果にする
-        std::swap(currentSRV, nextSRV);
-    }
-
-    // シーンテクスチャをバックバッファに出力(コピー)する(FXAAが有効な場合FXAAを行いつつ出力)
-    {
-        // バックバッファに書き込み
-        ID3D11RenderTargetView* rtv = m_pRenderTargetView.Get();
-        m_pContext->OMSetRenderTargets(1, &rtv, nullptr);
-        clearRenderTarget(rtv);
-
-        // 最終結果
-        m_pContext->PSSetShaderResources(0, 1, &currentSRV);
-
-        // バックバッファにコピー
-        ID3D11PixelShader* pBackBufferPS = isFXAA ? m_pPostProcessShaders[size_t(PostProcessShaderType::FXAA)].Get() : m_pPostProcessShaders[size_t(PostProcessShaderType::None)].Get();
-        m_pContext->PSSetShader(pBackBufferPS, nullptr, 0);
-
-        // 描画
-        m_pContext->Draw(3, 0);
-    }
-
-    // 解除
-    ID3D11ShaderResourceView* nullSRV = nullptr;
-    m_pContext->PSSetShaderResources(0, 1, &nullSRV);
-}
+    if (isSingle)
+    {
+        endString();
+    }
+}
 
 //---------------------------------
-// 文字の描画
+// 文字のバッチを開く (Stringキューの文字列をまとめて1回で描く)
 //---------------------------------
-void RendererImpl::drawString(std::string_view string, Vector2 pos, Color color, float angle, Vector2 scale)
+void RendererImpl::beginString()
 {
-    // 描画開始
+    if (m_spriteBatch == nullptr || m_isTextBatchOpen) return;
+
     m_spriteBatch->Begin(
         DirectX::SpriteSortMode_Deferred,
         nullptr,
@@ -2737,48 +4689,179 @@ void RendererImpl::drawString(std::string_view string, Vector2 pos, Color color,
         nullptr,
         DirectX::XMMatrixIdentity()
     );
+    m_isTextBatchOpen = true;
+    ++m_textBatchCount;
+}
 
-    // テキスト描画
-    m_spriteFont->DrawString(
-        m_spriteBatch.get(),
-        string.data(),
-        DirectX::XMVECTOR{ pos.x, pos.y },
-        DirectX::XMVECTOR{ color.r, color.g,color.b,color.a },
-        angle,
-        DirectX::g_XMZero,
-        DirectX::XMVECTOR{ scale.x, scale.y }
-    );
+//---------------------------------
+// 文字のバッチを閉じて描く (しばらく使われていない配置を捨てる)
+//---------------------------------
+void RendererImpl::endString()
+{
+    if (!m_isTextBatchOpen) return;
 
     // 描画終了
     m_spriteBatch->End();
+    m_isTextBatchOpen = false;
+
+    // SpriteBatchがステートを差し替えるので設定状態を忘れる
+    invalidateStateCache();
+
+    if (m_textLayouts.size() > MAX_TEXT_LAYOUTS)
+    {
+        m_textLayouts.clear();
+        return;
+    }
+    std::erase_if(m_textLayouts, [this](const auto& entry)
+        {
+            return entry.second.lastUsedBatch + TEXT_LAYOUT_KEEP_BATCHES < m_textBatchCount;
+        });
 }
 
 //---------------------------------
-// テクスチャを作成する
+// 文字列の配置を探す (なければSpriteFontと同じ並べ方で作る)
+//---------------------------------
+const TextLayout& RendererImpl::findTextLayout(std::string_view string)
+{
+    auto& layout = m_textLayouts[HashText(string)];
+    layout.lastUsedBatch = m_textBatchCount;
+    if (layout.text == string && !layout.glyphs.empty())
+    {
+        return layout;
+    }
+
+    layout.text.assign(string);
+    layout.glyphs.clear();
+
+    float lineSpacing = m_spriteFont->GetLineSpacing();
+    bool isDefault = m_spriteFont->GetDefaultCharacter() != 0;
+    float x = 0.0f, y = 0.0f;
+    for (size_t index = 0u; index < string.size();)
+    {
+        char32_t code = DecodeUtf8(string, index);
+        if (code == U'\r') continue;
+        if (code == U'\n')
+        {
+            x = 0.0f;
+            y += lineSpacing;
+            continue;
+        }
+
+        // シートにない文字は既定の文字 (なければ飛ばす)
+        wchar_t character = code > 0xFFFFu ? L'?' : static_cast<wchar_t>(code);
+        if (!isDefault && !m_spriteFont->ContainsCharacter(character)) continue;
+        const DirectX::SpriteFont::Glyph* pGlyph = m_spriteFont->FindGlyph(character);
+
+        x = std::max(x + static_cast<float>(pGlyph->XOffset), 0.0f);
+        LONG width = pGlyph->Subrect.right - pGlyph->Subrect.left;
+        LONG height = pGlyph->Subrect.bottom - pGlyph->Subrect.top;
+
+        // 空白は進めるだけ
+        if (!iswspace(character) || width > 1 || height > 1)
+        {
+            TextGlyph glyph{};
+            glyph.subrect = pGlyph->Subrect;
+            glyph.origin = { -x, -(y + pGlyph->YOffset) };
+            layout.glyphs.push_back(glyph);
+        }
+        x += static_cast<float>(width) + pGlyph->XAdvance;
+    }
+    return layout;
+}
+
+//---------------------------------
+// テクスチャを作成する (ストリーミングできるものは低いミップだけ作る)
 //---------------------------------
 void RendererImpl::createTexture(std::shared_ptr<TextureData> spTextureData, uint32_t id)
 {
+    DirectX::ScratchImage scratchImage;
+    if (!decodeTexture(*spTextureData, scratchImage)) return;
+
+    const DirectX::TexMetadata& metadata = scratchImage.GetMetadata();
+    spTextureData->width = static_cast<int>(metadata.width);
+    spTextureData->height = static_cast<int>(metadata.height);
+
+    // 1枚の2Dでミップがあればストリーミングする
+    bool isStreaming = metadata.dimension == DirectX::TEX_DIMENSION_TEXTURE2D && metadata.arraySize == 1u && !metadata.IsCubemap() &&
+        metadata.mipLevels > 1u && metadata.mipLevels <= texture_streaming::MAX_MIP_LEVELS && id < texture_streaming::MAX_TEXTURES;
+    unsigned int firstMip = 0u;
+    if (isStreaming)
+    {
+        std::array<size_t, texture_streaming::MAX_MIP_LEVELS> mipBytes{};
+        for (size_t mip = 0; mip < metadata.mipLevels; ++mip)
+        {
+            mipBytes[mip] = scratchImage.GetImage(mip, 0, 0)->slicePitch;
+        }
+
+        // 圧縮形式は一番細かいミップの縦横が4の倍数でないと作れない
+        unsigned int maxTopMip = static_cast<unsigned int>(metadata.mipLevels) - 1u;
+        if (DirectX::IsCompressed(metadata.format))
+        {
+            maxTopMip = 0u;
+            while (maxTopMip + 1u < metadata.mipLevels && ((metadata.width >> (maxTopMip + 1u)) % 4u) == 0u && ((metadata.height >> (maxTopMip + 1u)) % 4u) == 0u)
+            {
+                ++maxTopMip;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        firstMip = m_textureResidency.registerTexture(id, static_cast<uint32_t>(metadata.width), static_cast<uint32_t>(metadata.height),
+            std::span<const size_t>(mipBytes.data(), metadata.mipLevels), maxTopMip);
+    }
+
+    ComPtr<ID3D11Texture2D> pTexResource = nullptr;
     ComPtr<ID3D11ShaderResourceView> pSRV = nullptr;
+    bool isCreated = createTextureResource(scratchImage, firstMip, spTextureData->isColor, pTexResource, pSRV);
+
+    if (isStreaming)
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        if (isCreated)
+        {
+            StreamingTexture& streaming = m_streamingTextures[id];
+            streaming.spSource = spTextureData;
+            streaming.pTexture = pTexResource;
+            streaming.residentMip = firstMip;
+        }
+        else
+        {
+            m_textureResidency.unregisterTexture(id);
+        }
+    }
+    if (!isCreated) return;
 
+    {// m_texturesに追加
+        std::lock_guard<std::shared_mutex> lock(m_texMutex);
+        m_textures[id] = pSRV;
+    }
+}
+
+//---------------------------------
+// テクスチャをCPUで展開する (ミップが1枚で圧縮形式でなければミップを作る)
+//---------------------------------
+bool RendererImpl::decodeTexture(const TextureData& textureData, DirectX::ScratchImage& outImage) const
+{
     HRESULT hr = S_OK;
     hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-    if (FAILED(hr)) return;
+    if (FAILED(hr)) return false;
     DirectX::TexMetadata metadata = {};
     DirectX::ScratchImage scratchImage;
 
     // 画像データを ScratchImage に読み込む
-    switch (spTextureData->type)
+    switch (textureData.type)
     {
     case TextureType::Raw:
     {
+        if (textureData.rawPixels == nullptr) return false; // CPUリソースを解放済み
+
         // Imageに変換
         DirectX::Image img = {};
-        img.width = spTextureData->width;
-        img.height = spTextureData->height;
+        img.width = textureData.width;
+        img.height = textureData.height;
         img.format = DXGI_FORMAT_R8G8B8A8_UNORM; // 生データはUNORM
-        img.rowPitch = spTextureData->width * 4; // 4バイト(RGBA)
-        img.slicePitch = img.rowPitch * spTextureData->height;
-        img.pixels = spTextureData->rawPixels.get();
+        img.rowPitch = textureData.width * 4; // 4バイト(RGBA)
+        img.slicePitch = img.rowPitch * textureData.height;
+        img.pixels = textureData.rawPixels.get();
 
         // ScratchImageを作成
         hr = scratchImage.InitializeFromImage(img);
@@ -2788,18 +4871,18 @@ void RendererImpl::createTexture(std::shared_ptr<TextureData> spTextureData, uin
         break;
     }
     case TextureType::Wic:
-        hr = DirectX::LoadFromWICMemory(spTextureData->buffer.data(), spTextureData->buffer.size(), DirectX::WIC_FLAGS_NONE, &metadata, scratchImage);
+        hr = DirectX::LoadFromWICMemory(textureData.buffer.data(), textureData.buffer.size(), DirectX::WIC_FLAGS_NONE, &metadata, scratchImage);
         break;
     case TextureType::Dds:
-        hr = DirectX::LoadFromDDSMemory(spTextureData->buffer.data(), spTextureData->buffer.size(), DirectX::DDS_FLAGS_NONE, &metadata, scratchImage);
+        hr = DirectX::LoadFromDDSMemory(textureData.buffer.data(), textureData.buffer.size(), DirectX::DDS_FLAGS_NONE, &metadata, scratchImage);
         break;
     case TextureType::Tga:
-        hr = DirectX::LoadFromTGAMemory(spTextureData->buffer.data(), spTextureData->buffer.size(), DirectX::TGA_FLAGS_NONE, &metadata, scratchImage);
+        hr = DirectX::LoadFromTGAMemory(textureData.buffer.data(), textureData.buffer.size(), DirectX::TGA_FLAGS_NONE, &metadata, scratchImage);
         break;
+    default:
+        return false;
     }
-
-    if (SUCCEEDED(hr)) { spTextureData->width = static_cast<int>(metadata.width); spTextureData->height = static_cast<int>(metadata.height); }
-    else return;
+    if (FAILED(hr)) return false;
 
     // ミップマップ生成 (CPU側処理)
     // ミップマップが1枚しかなく、圧縮フォーマットでない場合は生成する
@@ -2817,45 +4900,34 @@ void RendererImpl::createTexture(std::shared_ptr<TextureData> spTextureData, uin
         {
             // 生成したものに差し替え
             scratchImage = std::move(mipChain);
-            metadata = scratchImage.GetMetadata();
         }
     }
 
-    // フォーマット調整 (UNORM -> TYPELESS & SRGB)
+    outImage = std::move(scratchImage);
+    return true;
+}
+
+//---------------------------------
+// 展開したテクスチャのfirstMipから粗い方をGPUに作る (ストリーミングは一番細かいミップを変えて作り直す)
+//---------------------------------
+bool RendererImpl::createTextureResource(const DirectX::ScratchImage& image, unsigned int firstMip, bool isColor, ComPtr<ID3D11Texture2D>& outTexture, ComPtr<ID3D11ShaderResourceView>& outSRV) const
+{
+    const DirectX::TexMetadata& metadata = image.GetMetadata();
+    firstMip = std::min(firstMip, static_cast<unsigned int>(metadata.mipLevels) - 1u);
+
+    // フォーマット調整 (色だけUNORM -> TYPELESS & SRGB 法線やマスクはクックしたBC5,BC7と同じくそのままの値で読む)
     DXGI_FORMAT resourceFormat = metadata.format;
     DXGI_FORMAT viewFormat = metadata.format;
-
-    if (metadata.format == DXGI_FORMAT_R8G8B8A8_UNORM)
-    {
-        resourceFormat = DXGI_FORMAT_R8G8B8A8_TYPELESS;
-        viewFormat = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-    }
-    else if (metadata.format == DXGI_FORMAT_B8G8R8A8_UNORM)
-    {
-        resourceFormat = DXGI_FORMAT_B8G8R8A8_TYPELESS;
-        viewFormat = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
-    }
-    else if (metadata.format == DXGI_FORMAT_BC1_UNORM)
-    {
-        resourceFormat = DXGI_FORMAT_BC1_TYPELESS;
-        viewFormat = DXGI_FORMAT_BC1_UNORM_SRGB;
-    }
-    else if (metadata.format == DXGI_FORMAT_BC2_UNORM)
-    {
-        resourceFormat = DXGI_FORMAT_BC2_TYPELESS;
-        viewFormat = DXGI_FORMAT_BC2_UNORM_SRGB;
-    }
-    else if (metadata.format == DXGI_FORMAT_BC3_UNORM)
+    if (isColor)
     {
-        resourceFormat = DXGI_FORMAT_BC3_TYPELESS;
-        viewFormat = DXGI_FORMAT_BC3_UNORM_SRGB;
+        SelectSrgbFormats(metadata.format, resourceFormat, viewFormat);
     }
 
     // テクスチャリソース作成 (TYPELESSで作成)
     D3D11_TEXTURE2D_DESC desc = {};
-    desc.Width = (UINT)metadata.width;
-    desc.Height = (UINT)metadata.height;
-    desc.MipLevels = (UINT)metadata.mipLevels;
+    desc.Width = std::max(1u, (UINT)metadata.width >> firstMip);
+    desc.Height = std::max(1u, (UINT)metadata.height >> firstMip);
+    desc.MipLevels = (UINT)metadata.mipLevels - firstMip;
     desc.ArraySize = (UINT)metadata.arraySize;
     desc.Format = resourceFormat; // TYPELESS
     desc.SampleDesc.Count = 1;
@@ -2865,329 +4937,259 @@ void RendererImpl::createTexture(std::shared_ptr<TextureData> spTextureData, uin
     desc.CPUAccessFlags = 0;
     desc.MiscFlags = 0;
 
-    // サブリソースデータの準備
+    // サブリソースデータの準備 (配列の要素ごとにミップを並べる)
     std::vector<D3D11_SUBRESOURCE_DATA> subResources;
-    const DirectX::Image* images = scratchImage.GetImages();
-    size_t nImages = scratchImage.GetImageCount();
-    subResources.resize(nImages);
-    for (size_t i = 0; i < nImages; ++i)
+    subResources.reserve(size_t(desc.ArraySize) * desc.MipLevels);
+    for (size_t item = 0; item < metadata.arraySize; ++item)
     {
-        subResources[i].pSysMem = images[i].pixels;
-        subResources[i].SysMemPitch = (UINT)images[i].rowPitch;
-        subResources[i].SysMemSlicePitch = (UINT)images[i].slicePitch;
+        for (size_t mip = firstMip; mip < metadata.mipLevels; ++mip)
+        {
+            const DirectX::Image* pImage = image.GetImage(mip, item, 0);
+            if (pImage == nullptr) return false;
+
+            D3D11_SUBRESOURCE_DATA subResource{};
+            subResource.pSysMem = pImage->pixels;
+            subResource.SysMemPitch = (UINT)pImage->rowPitch;
+            subResource.SysMemSlicePitch = (UINT)pImage->slicePitch;
+            subResources.push_back(subResource);
+        }
     }
 
     ComPtr<ID3D11Texture2D> pTexResource = nullptr;
-    hr = m_pDevice->CreateTexture2D(&desc, subResources.data(), pTexResource.GetAddressOf());
-    if (FAILED(hr)) return;
+    HRESULT hr = m_pDevice->CreateTexture2D(&desc, subResources.data(), pTexResource.GetAddressOf());
+    if (FAILED(hr)) return false;
 
-    // SRV作成 (SRGBで作成)
+    // SRV作成 (色はSRGBで作成)
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Format = viewFormat; // SRGB
     srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MostDetailedMip = 0;
     srvDesc.Texture2D.MipLevels = desc.MipLevels;
 
+    ComPtr<ID3D11ShaderResourceView> pSRV = nullptr;
     hr = m_pDevice->CreateShaderResourceView(pTexResource.Get(), &srvDesc, pSRV.GetAddressOf());
+    if (FAILED(hr)) return false;
 
-    if (FAILED(hr)) return;
-
-    {// m_texturesに追加
-        std::lock_guard<std::mutex> lock(m_texMutex);
-        m_textures[id] = pSRV;
-    }
-}
-
-//---------------------------------
-// 行列のセット
-//---------------------------------
-void RendererImpl::setVPMatrix(Matrix view, Matrix proj)
-{
-    // プロジェクションマトリックス
-    m_vpMatData.Proj = proj;
-
-    // ビューマトリクス
-    m_vpMatData.View = view;
-
-    // VPバッファの更新とセット
-    m_pContext->UpdateSubresource(m_pVPMatBuffer.Get(), 0, nullptr, &m_vpMatData, 0, 0);
-    ID3D11Buffer* buffer = m_pVPMatBuffer.Get();
-    m_pContext->VSSetConstantBuffers(0, 1, &buffer);
+    outTexture = pTexResource;
+    outSRV = pSRV;
+    return true;
 }
 
 //---------------------------------
-// 正射影行列のセット
+// テクスチャストリーミングの更新 (フレームの先頭で呼ぶ)
+// 終わった読み込みのSRVを差し替え,前のフレームの要求から読み込むミップと捨てるミップを決める
 //---------------------------------
-void RendererImpl::setOrthographic()
+void RendererImpl::updateTextureStreaming()
 {
-    // 正射影行列の計算
-    m_vpMatData.Proj = Matrix::OrthographicOffCenter(0.0f, m_screenSize.x, m_screenSize.y, 0.0f, 0.0f, 1.0f);
-
-    // ビューマトリクスは単位行列
-    m_vpMatData.View.identity();
-
-    // VPバッファの更新とセット
-    m_pContext->UpdateSubresource(m_pVPMatBuffer.Get(), 0, nullptr, &m_vpMatData, 0, 0);
-    ID3D11Buffer* buffer = m_pVPMatBuffer.Get();
-    m_pContext->VSSetConstantBuffers(0, 1, &buffer);
-}
-
-//----------------------------
-// 
-// レンダラー (外部インターフェース)
-//
-// implの同名の関数に渡すだけ
-// 
-//----------------------------
-
-Renderer::Renderer() : m_pImpl{ std::make_unique<RendererImpl>() } {}
-Renderer::~Renderer() = default;
+    std::lock_guard<std::mutex> lock(m_streamMutex);
 
-void Renderer::init(HWND handle, long width, long height)
-{
-    if (m_pImpl != nullptr)
+    // 終わった読み込みを差し替える
+    for (size_t cnt = 0; cnt < m_streamingTasks.size();)
     {
-        m_pImpl->init(handle, width, height);
-    }
-}
+        StreamingTask& task = *m_streamingTasks[cnt];
+        if (task.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++cnt;
+            continue;
+        }
 
-void Renderer::uninit()
-{
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->uninit();
+        bool isSucceeded = task.result.get() && m_streamingTextures.contains(task.id);
+        if (isSucceeded)
+        {
+            replaceStreamingTexture(task.id, task.mip, task.pTexture, task.pSRV);
+            m_textureResidency.onResident(task.id, task.mip, true);
+        }
+        else
+        {// 展開元がもうない (CPUリソースを解放した) ので今のミップのまま止める
+            m_textureResidency.onResident(task.id, task.mip, false);
+            m_textureResidency.unregisterTexture(task.id);
+            m_streamingTextures.erase(task.id);
+        }
+        m_streamingTasks.erase(m_streamingTasks.begin() + cnt);
     }
-}
 
-bool Renderer::render(const Scene& scene, std::function<void()> guiRender)
-{
-    if (m_pImpl != nullptr)
+    // 要求から常駐を決める
+    m_textureResidency.update(m_residencyChanges);
+    for (const auto& change : m_residencyChanges)
     {
-        return m_pImpl->render(scene, guiRender, *this);
-    }
-    return false;
-}
+        auto itr = m_streamingTextures.find(change.id);
+        if (itr == m_streamingTextures.end())
+        {
+            m_textureResidency.onResident(change.id, change.mip, false);
+            continue;
+        }
 
-bool Renderer::uploadTextures(const TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback)
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->uploadTextures(textureManager, maxThread, progressCallback);
-    }
-    return false;
-}
+        if (change.mip > itr->second.residentMip)
+        {// 捨てるのはGPU上のコピーなのですぐ終わる
+            m_textureResidency.onResident(change.id, change.mip, evictTextureMips(change.id, change.mip));
+            continue;
+        }
 
-MeshHandle Renderer::createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount)
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->createMesh(type, vertices, verticesCount, indices, indicesCount);
+        // 読み込みは展開からワーカースレッドで
+        auto upTask = std::make_unique<StreamingTask>();
+        upTask->id = change.id;
+        upTask->mip = change.mip;
+        upTask->result = std::async(std::launch::async, [this, pTask = upTask.get(), spSource = itr->second.spSource]()
+            {
+                DirectX::ScratchImage image;
+                return decodeTexture(*spSource, image) && createTextureResource(image, pTask->mip, spSource->isColor, pTask->pTexture, pTask->pSRV);
+            });
+        m_streamingTasks.push_back(std::move(upTask));
     }
-    return MeshHandle();
 }
 
-bool Renderer::setMesh(const MeshHandle& handle)
+//---------------------------------
+// テクスチャの細かいミップを捨てる (残すミップだけの小さいテクスチャを作ってGPU上でコピーする m_streamMutexを持って呼ぶ)
+//---------------------------------
+bool RendererImpl::evictTextureMips(uint32_t id, unsigned int mip)
 {
-    if (m_pImpl != nullptr)
+    StreamingTexture& streaming = m_streamingTextures[id];
+    if (streaming.pTexture == nullptr || mip <= streaming.residentMip)
     {
-        return m_pImpl->setMesh(handle);
+        return false;
     }
-    return false;
-}
 
-bool Renderer::setTexture(const TextureHandle& handle)
-{
-    if (m_pImpl != nullptr)
+    D3D11_TEXTURE2D_DESC desc{};
+    streaming.pTexture->GetDesc(&desc);
+    UINT dropCount = mip - streaming.residentMip;
+    if (dropCount >= desc.MipLevels)
     {
-        return m_pImpl->setTexture(handle);
+        return false;
     }
-    return false;
-}
 
-bool Renderer::setTransformWorld(const Matrix& matrix)
-{
-    if (m_pImpl != nullptr)
+    D3D11_TEXTURE2D_DESC newDesc = desc;
+    newDesc.Width = std::max(1u, desc.Width >> dropCount);
+    newDesc.Height = std::max(1u, desc.Height >> dropCount);
+    newDesc.MipLevels = desc.MipLevels - dropCount;
+    ComPtr<ID3D11Texture2D> pTexture = nullptr;
+    if (FAILED(m_pDevice->CreateTexture2D(&newDesc, nullptr, pTexture.GetAddressOf())))
     {
-        return m_pImpl->setTransformWorld(matrix);
+        return false;
     }
-    return false;
-}
-
-bool Renderer::setTransformView(const Matrix& matrix)
-{
-    if (m_pImpl != nullptr)
+    for (UINT level = 0; level < newDesc.MipLevels; ++level)
     {
-        return m_pImpl->setTransformView(matrix);
+        m_pContext->CopySubresourceRegion(pTexture.Get(), D3D11CalcSubresource(level, 0, newDesc.MipLevels), 0, 0, 0,
+            streaming.pTexture.Get(), D3D11CalcSubresource(level + dropCount, 0, desc.MipLevels), nullptr);
     }
-    return false;
-}
 
-bool Renderer::setTransformProjection(const Matrix& matrix)
-{
-    if (m_pImpl != nullptr)
+    // 今のSRVと同じ形式で作る
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc{};
     {
-        return m_pImpl->setTransformProjection(matrix);
+        std::shared_lock<std::shared_mutex> lock(m_texMutex);
+        auto itr = m_textures.find(id);
+        if (itr == m_textures.end()) return false;
+        itr->second->GetDesc(&srvDesc);
     }
-    return false;
-}
-
-bool Renderer::setCameraPosition(const Vector3& cameraPos)
-{
-    if (m_pImpl != nullptr)
+    srvDesc.Texture2D.MostDetailedMip = 0;
+    srvDesc.Texture2D.MipLevels = newDesc.MipLevels;
+    ComPtr<ID3D11ShaderResourceView> pSRV = nullptr;
+    if (FAILED(m_pDevice->CreateShaderResourceView(pTexture.Get(), &srvDesc, pSRV.GetAddressOf())))
     {
-        return m_pImpl->setCameraPosition(cameraPos);
-    }
         return false;
-}
-
-bool Renderer::setMaterial(const Material& material)
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->setMaterial(material);
     }
-    return false;
-}
 
-bool Renderer::setLight(std::span<const LightData> lights, const Color& ambient)
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->setLight(lights, ambient);
-    }
-    return false;
+    replaceStreamingTexture(id, mip, pTexture, pSRV);
+    return true;
 }
 
-bool Renderer::setFog(const FogData& fog)
+//---------------------------------
+// ストリーミングしたテクスチャに差し替える (m_streamMutexを持って呼ぶ)
+//---------------------------------
+void RendererImpl::replaceStreamingTexture(uint32_t id, unsigned int mip, const ComPtr<ID3D11Texture2D>& pTexture, const ComPtr<ID3D11ShaderResourceView>& pSRV)
 {
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->setFog(fog);
-    }
-    return false;
-}
+    StreamingTexture& streaming = m_streamingTextures[id];
+    streaming.pTexture = pTexture;
+    streaming.residentMip = mip;
 
-void Renderer::setRasMode(RasMode rasMode)
-{
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->setRasMode(rasMode);
-    }
+    std::lock_guard<std::shared_mutex> lock(m_texMutex);
+    m_textures[id] = pSRV;
 }
 
-bool Renderer::drawMesh(const MeshHandle& handle)
+//---------------------------------
+// 描画に使うテクスチャのミップを要求する (画面上の大きさから 影は測らず,UIは一番細かいミップ)
+//---------------------------------
+void RendererImpl::requestTextureMips(const DrawContext& dc, VertexShaderType type, const Matrix& world)
 {
-    if (m_pImpl != nullptr)
+    if (dc.textureId == ~0u || m_currentPass == RenderPass::Shadow)
     {
-        return m_pImpl->drawMesh(handle);
+        return;
     }
-    return false;
-}
 
-bool Renderer::drawIndexedPrimitive(VertexShaderType vertexShaderType, int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation)
-{
-    if (m_pImpl != nullptr)
+    float screenSize = texture_streaming::FULL_SCREEN_SIZE;
+    if (type != VertexShaderType::Vertex2D && m_currentPass != RenderPass::UI)
     {
-        return m_pImpl->drawIndexedPrimitive(vertexShaderType, indexCount, startIndexLocation, baseVertexLocation);
+        screenSize = texture_streaming::CalcScreenSize(dc.meshBounds, Matrix::Multiply(world, m_streamingViewProj), m_sceneSize); // 動的解像度で縮めた大きさ
     }
-    return false;
+    m_textureResidency.request(dc.textureId, screenSize);
 }
 
-void Renderer::drawDecal(Matrix transform, const MeshHandle& handle, Color color)
+//---------------------------------
+// テクスチャストリーミングの設定 (上限や起動時の大きさ 登録済みのテクスチャの起動時のミップは変わらない)
+//---------------------------------
+void RendererImpl::setTextureStreamingSettings(const TextureStreamingSettings& settings)
 {
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->drawDecal(transform,handle, color);
-    }
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_textureResidency.setSettings(settings);
 }
 
-void Renderer::drawString(std::string_view string, Vector2 pos, Color color, float angle, Vector2 scale)
+//---------------------------------
+// テクスチャストリーミングの統計 (最後の更新)
+//---------------------------------
+void RendererImpl::getTextureStreamingStats(TextureStreamingStats& stats) const
 {
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->drawString(string, pos, color, angle, scale);
-    }
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_textureResidency.getStats(stats);
 }
 
-bool Renderer::setBoneTransforms(std::span<const Matrix> boneTransforms)
+//---------------------------------
+// 動的解像度の統計 (このフレームの大きさ)
+//---------------------------------
+void RendererImpl::getDynamicResolutionStats(DynamicResolutionStats& stats) const
 {
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->setBoneTransforms(boneTransforms);
-    }
-    return false;
+    stats.scale = m_dynamicResolution.getScale();
+    stats.frameMs = m_dynamicResolution.getFrameMs();
+    stats.width = static_cast<unsigned int>(m_sceneSize.x);
+    stats.height = static_cast<unsigned int>(m_sceneSize.y);
 }
 
-void Renderer::setOutlineData(Color color, float width)
+//---------------------------------
+// 行列のセット
+//---------------------------------
+void RendererImpl::setVPMatrix(Matrix view, Matrix proj)
 {
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->setOutlineData(color, width);
-    }
-}
+    // プロジェクションマトリックス
+    m_vpMatData.Proj = proj;
 
-void Renderer::setPostProcessShaderMask(PostProcessShaderMask mask)
-{
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->setPostProcessShaderMask(mask);
-    }
-}
-void Renderer::setToneMappingType(ToneMappingType type)
-{
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->setToneMappingType(type);
-    }
-}
+    // ビューマトリクス
+    m_vpMatData.View = view;
 
-void Renderer::onResize(int width, int height)
-{
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->onResize(width, height);
-    }
+    // VPバッファの更新とセット
+    m_pContext->UpdateSubresource(m_pVPMatBuffer.Get(), 0, nullptr, &m_vpMatData, 0, 0);
+    bindConstantBuffer(ShaderStage::Vertex, 0, m_pVPMatBuffer.Get());
 }
 
-void Renderer::getScreenSizeMagnification(Vector2& magnification) const
+//---------------------------------
+// 正射影行列のセット
+//---------------------------------
+void RendererImpl::setOrthographic()
 {
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->getScreenSizeMagnification(magnification);
-    }
-}
+    // 正射影行列の計算
+    m_vpMatData.Proj = Matrix::OrthographicOffCenter(0.0f, m_screenSize.x, m_screenSize.y, 0.0f, 0.0f, 1.0f);
 
-void Renderer::getViewportSize(Vector2& size) const
-{
-    if (m_pImpl != nullptr)
-    {
-        m_pImpl->getViewportSize(size);
-    }
-}
+    // ビューマトリクスは単位行列
+    m_vpMatData.View.identity();
 
-ID3D11Device* Renderer::getDevice() const
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->getDevice();
-    }
-    return nullptr;
+    // VPバッファの更新とセット
+    m_pContext->UpdateSubresource(m_pVPMatBuffer.Get(), 0, nullptr, &m_vpMatData, 0, 0);
+    bindConstantBuffer(ShaderStage::Vertex, 0, m_pVPMatBuffer.Get());
 }
 
-ID3D11DeviceContext* Renderer::getContext() const
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->getContext();
-    }
-    return nullptr;
-}
+//----------------------------
+// 
+// レンダラー (外部インターフェース)
+//
+// 既定のバックエンドはD3D11 ほかの関数はrenderer_interface.cppで同名の関数に渡すだけ
+// 
+//----------------------------
 
-HWND Renderer::getRegisteredHWND() const
-{
-    if (m_pImpl != nullptr)
-    {
-        return m_pImpl->getRegisteredHWND();
-    }
-    return nullptr;
-}
+Renderer::Renderer() : m_pImpl{ std::make_unique<RendererImpl>() } {}
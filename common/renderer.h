@@ -8,6 +8,8 @@
 #include "graphics_types.h" // Vertex3D
 #include <span>
 #include <functional>
+#include <memory>
+#include <string_view>
 
 class Renderer;
 class Window;
@@ -17,7 +19,7 @@ namespace gui
     void init(const Window& window, const Renderer& renderer);
 }
 
-class RendererImpl;
+class RenderBackend;
 class TextureManager;
 class Scene;
 struct TextureData;
@@ -32,6 +34,7 @@ class Renderer
 {
 public:
     Renderer();
+    explicit Renderer(std::unique_ptr<RenderBackend> pBackend); // D3D11以外のバックエンド (NullRendererなど)
     ~Renderer();
 
     void init(HWND handle, long width, long height);
@@ -41,7 +44,11 @@ public:
     bool uploadTextures(const TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback = {});
 
     MeshHandle createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount);
+    MeshHandle createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount);
+    bool updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount);
+    void releaseMesh(const MeshHandle& handle);
     bool setMesh(const MeshHandle& handle);
+    bool getMeshBounds(const MeshHandle& handle, AABB& outBounds) const;
     bool setTexture(const TextureHandle& handle);
     bool setTransformWorld(const Matrix& matrix);
     bool setTransformView(const Matrix& matrix);
@@ -54,8 +61,13 @@ public:
     void setOutlineData(Color color, float width);
     void setPostProcessShaderMask(PostProcessShaderMask mask);
     void setToneMappingType(ToneMappingType type);
+    void setShadowSettings(const ShadowSettings& settings);
+    void setTextureStreamingSettings(const TextureStreamingSettings& settings);
+    void setOcclusionCullingSettings(const OcclusionCullingSettings& settings);
+    void setDynamicResolutionSettings(const DynamicResolutionSettings& settings);
     void setRasMode(RasMode rasMode);
     bool drawMesh(const MeshHandle& handle);
+    bool drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances);
     bool drawIndexedPrimitive(VertexShaderType vertexShaderType, int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation);
     void drawDecal(Matrix transform, const MeshHandle& handle, Color color);
     void drawString(std::string_view string, Vector2 pos = { 0,0 }, Color color = Color::White(), float angle = 0.0f, Vector2 scale = { 1,1 });
@@ -65,6 +77,10 @@ public:
     HWND getRegisteredHWND() const;
     void getScreenSizeMagnification(Vector2& magnification) const;
     void getViewportSize(Vector2& size) const;
+    void getStateStats(RenderStateStats& stats) const;
+    void getTextureStreamingStats(TextureStreamingStats& stats) const;
+    void getOcclusionCullingStats(OcclusionCullingStats& stats) const;
+    void getDynamicResolutionStats(DynamicResolutionStats& stats) const;
 
 private:
     // ↓ friend Gui
@@ -73,5 +89,5 @@ private:
     ID3D11DeviceContext* getContext() const;
     // ↑
     
-    std::unique_ptr<RendererImpl> m_pImpl;
+    std::unique_ptr<RenderBackend> m_pImpl;
 };
@@ -0,0 +1,366 @@
+//--------------------------------------------
+//
+// レンダラーインターフェース [renderer_interface.cpp]
+// Author: Fuma Sato
+//
+// バックエンドの同名の関数に渡すだけ (D3D11を使わないのでNullRendererと一緒にどこでもビルドできる)
+//
+//--------------------------------------------
+#include "renderer.h"
+#include "render_backend.h"
+
+Renderer::Renderer(std::unique_ptr<RenderBackend> pBackend) : m_pImpl{ std::move(pBackend) } {}
+Renderer::~Renderer() = default;
+
+void Renderer::init(HWND handle, long width, long height)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->init(handle, width, height);
+    }
+}
+
+void Renderer::uninit()
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->uninit();
+    }
+}
+
+bool Renderer::render(const Scene& scene, std::function<void()> guiRender)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->render(scene, guiRender, *this);
+    }
+    return false;
+}
+
+bool Renderer::uploadTextures(const TextureManager& textureManager, unsigned int maxThread, std::function<bool(std::string_view, int, int)> progressCallback)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->uploadTextures(textureManager, maxThread, progressCallback);
+    }
+    return false;
+}
+
+MeshHandle Renderer::createMesh(VertexShaderType type, const void* vertices, size_t verticesCount, const void* indices, size_t indicesCount)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->createMesh(type, vertices, verticesCount, indices, indicesCount);
+    }
+    return MeshHandle();
+}
+
+MeshHandle Renderer::createDynamicMesh(const MeshHandle& source, const void* vertices, size_t verticesCount)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->createDynamicMesh(source, vertices, verticesCount);
+    }
+    return MeshHandle();
+}
+
+bool Renderer::updateMeshVertices(const MeshHandle& handle, const void* vertices, size_t verticesCount)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->updateMeshVertices(handle, vertices, verticesCount);
+    }
+    return false;
+}
+
+void Renderer::releaseMesh(const MeshHandle& handle)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->releaseMesh(handle);
+    }
+}
+
+bool Renderer::setMesh(const MeshHandle& handle)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setMesh(handle);
+    }
+    return false;
+}
+
+bool Renderer::getMeshBounds(const MeshHandle& handle, AABB& outBounds) const
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->getMeshBounds(handle, outBounds);
+    }
+    return false;
+}
+
+bool Renderer::setTexture(const TextureHandle& handle)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setTexture(handle);
+    }
+    return false;
+}
+
+bool Renderer::setTransformWorld(const Matrix& matrix)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setTransformWorld(matrix);
+    }
+    return false;
+}
+
+bool Renderer::setTransformView(const Matrix& matrix)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setTransformView(matrix);
+    }
+    return false;
+}
+
+bool Renderer::setTransformProjection(const Matrix& matrix)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setTransformProjection(matrix);
+    }
+    return false;
+}
+
+bool Renderer::setCameraPosition(const Vector3& cameraPos)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setCameraPosition(cameraPos);
+    }
+        return false;
+}
+
+bool Renderer::setMaterial(const Material& material)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setMaterial(material);
+    }
+    return false;
+}
+
+bool Renderer::setLight(std::span<const LightData> lights, const Color& ambient)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setLight(lights, ambient);
+    }
+    return false;
+}
+
+bool Renderer::setFog(const FogData& fog)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setFog(fog);
+    }
+    return false;
+}
+
+void Renderer::setRasMode(RasMode rasMode)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setRasMode(rasMode);
+    }
+}
+
+bool Renderer::drawMesh(const MeshHandle& handle)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->drawMesh(handle);
+    }
+    return false;
+}
+
+bool Renderer::drawMeshInstanced(const MeshHandle& handle, std::span<const InstanceData> instances)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->drawMeshInstanced(handle, instances);
+    }
+    return false;
+}
+
+bool Renderer::drawIndexedPrimitive(VertexShaderType vertexShaderType, int indexCount, unsigned int startIndexLocation, unsigned int baseVertexLocation)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->drawIndexedPrimitive(vertexShaderType, indexCount, startIndexLocation, baseVertexLocation);
+    }
+    return false;
+}
+
+void Renderer::drawDecal(Matrix transform, const MeshHandle& handle, Color color)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->drawDecal(transform,handle, color);
+    }
+}
+
+void Renderer::drawString(std::string_view string, Vector2 pos, Color color, float angle, Vector2 scale)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->drawString(string, pos, color, angle, scale);
+    }
+}
+
+bool Renderer::setBoneTransforms(std::span<const Matrix> boneTransforms)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setBoneTransforms(boneTransforms);
+    }
+    return false;
+}
+
+void Renderer::setOutlineData(Color color, float width)
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->setOutlineData(color, width);
+    }
+}
+
+void Renderer::setPostProcessShaderMask(PostProcessShaderMask mask)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setPostProcessShaderMask(mask);
+    }
+}
+void Renderer::setToneMappingType(ToneMappingType type)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setToneMappingType(type);
+    }
+}
+void Renderer::setShadowSettings(const ShadowSettings& settings)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setShadowSettings(settings);
+    }
+}
+void Renderer::setTextureStreamingSettings(const TextureStreamingSettings& settings)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setTextureStreamingSettings(settings);
+    }
+}
+void Renderer::setOcclusionCullingSettings(const OcclusionCullingSettings& settings)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setOcclusionCullingSettings(settings);
+    }
+}
+void Renderer::setDynamicResolutionSettings(const DynamicResolutionSettings& settings)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->setDynamicResolutionSettings(settings);
+    }
+}
+
+void Renderer::onResize(int width, int height)
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->onResize(width, height);
+    }
+}
+
+void Renderer::getScreenSizeMagnification(Vector2& magnification) const
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->getScreenSizeMagnification(magnification);
+    }
+}
+
+void Renderer::getViewportSize(Vector2& size) const
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->getViewportSize(size);
+    }
+}
+
+void Renderer::getStateStats(RenderStateStats& stats) const
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->getStateStats(stats);
+    }
+}
+
+void Renderer::getTextureStreamingStats(TextureStreamingStats& stats) const
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->getTextureStreamingStats(stats);
+    }
+}
+
+void Renderer::getOcclusionCullingStats(OcclusionCullingStats& stats) const
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->getOcclusionCullingStats(stats);
+    }
+}
+
+void Renderer::getDynamicResolutionStats(DynamicResolutionStats& stats) const
+{
+    if (m_pImpl != nullptr)
+    {
+        m_pImpl->getDynamicResolutionStats(stats);
+    }
+}
+
+ID3D11Device* Renderer::getDevice() const
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->getDevice();
+    }
+    return nullptr;
+}
+
+ID3D11DeviceContext* Renderer::getContext() const
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->getContext();
+    }
+    return nullptr;
+}
+
+HWND Renderer::getRegisteredHWND() const
+{
+    if (m_pImpl != nullptr)
+    {
+        return m_pImpl->getRegisteredHWND();
+    }
+    return nullptr;
+}
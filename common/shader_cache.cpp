@@ -0,0 +1,328 @@
+//--------------------------------------------
+//
+// シェーダーキャッシュ (コンパイル済みのバイトコードをファイルに残す) [shader_cache.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "shader_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+namespace
+{
+    constexpr uint32_t CACHE_MAGIC = 0x31434853u; // "SHC1"
+
+    // キャッシュファイルの先頭 (キーが違えば読まない 途中で切れていれば読まない)
+    struct CacheHeader
+    {
+        uint32_t magic;   // CACHE_MAGIC
+        uint32_t version; // shader_cache::VERSION
+        uint64_t key;     // キー
+        uint64_t size;    // バイトコードのバイト数
+    };
+
+    // 中身のハッシュ (FNV-1a 64bit)
+    uint64_t HashBytes(const void* data, size_t size, uint64_t h)
+    {
+        const uint8_t* pBytes = static_cast<const uint8_t*>(data);
+        for (size_t cnt = 0; cnt < size; ++cnt)
+        {
+            h ^= pBytes[cnt];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    // 長さ付きで混ぜる ("ab"+"c" と "a"+"bc" を分ける)
+    uint64_t HashString(std::string_view text, uint64_t h)
+    {
+        uint64_t size = text.size();
+        h = HashBytes(&size, sizeof(size), h);
+        return HashBytes(text.data(), text.size(), h);
+    }
+
+    // ファイルを全部読む
+    bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& outBytes)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        outBytes.resize(static_cast<size_t>(size));
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(outBytes.data()), size));
+    }
+
+    // 書き終わってから差し替える (途中で止めても壊れたキャッシュを残さない)
+    bool WriteCacheFile(const std::filesystem::path& path, uint64_t key, std::span<const uint8_t> bytecode)
+    {
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+
+            CacheHeader header{ CACHE_MAGIC, shader_cache::VERSION, key, bytecode.size() };
+            if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header))) return false;
+            if (!file.write(reinterpret_cast<const char*>(bytecode.data()), static_cast<std::streamsize>(bytecode.size()))) return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // キャッシュを読む (キーと大きさが合う時だけ)
+    bool ReadCacheFile(const std::filesystem::path& path, uint64_t key, std::vector<uint8_t>& outBytecode)
+    {
+        std::vector<uint8_t> bytes{};
+        if (!ReadFileBytes(path, bytes) || bytes.size() < sizeof(CacheHeader)) return false;
+
+        CacheHeader header{};
+        std::copy_n(bytes.data(), sizeof(header), reinterpret_cast<uint8_t*>(&header));
+        if (header.magic != CACHE_MAGIC || header.version != shader_cache::VERSION || header.key != key || header.size != bytes.size() - sizeof(header) || header.size == 0u)
+        {
+            return false;
+        }
+        outBytecode.assign(bytes.begin() + sizeof(header), bytes.end());
+        return true;
+    }
+
+    // 1行の #include "file" / <file> のファイル名 (なければ空)
+    std::string_view FindIncludeName(std::string_view line)
+    {
+        auto skipSpace = [&line]()
+            {
+                while (!line.empty() && std::isspace(static_cast<unsigned char>(line.front()))) line.remove_prefix(1);
+            };
+
+        skipSpace();
+        if (line.empty() || line.front() != '#') return {};
+        line.remove_prefix(1);
+        skipSpace();
+        constexpr std::string_view INCLUDE = "include";
+        if (line.substr(0, INCLUDE.size()) != INCLUDE) return {};
+        line.remove_prefix(INCLUDE.size());
+        skipSpace();
+        if (line.empty() || (line.front() != '"' && line.front() != '<')) return {};
+
+        char close = line.front() == '"' ? '"' : '>';
+        line.remove_prefix(1);
+        size_t end = line.find(close);
+        return end == std::string_view::npos ? std::string_view() : line.substr(0, end);
+    }
+
+    // インクルードを深さ優先で集める (D3D_COMPILE_STANDARD_FILE_INCLUDEと同じくインクルードしたファイルのフォルダから探す)
+    bool CollectIncludesRecursive(const std::filesystem::path& source, unsigned int depth, std::vector<std::filesystem::path>& outIncludes)
+    {
+        if (depth > shader_cache::MAX_INCLUDE_DEPTH) return false;
+
+        std::ifstream file(source);
+        if (!file.is_open()) return true; // ないファイルはキーに「ない」として混ぜる
+
+        bool isSucceeded = true;
+        std::string line{};
+        while (std::getline(file, line))
+        {
+            std::string_view name = FindIncludeName(line);
+            if (name.empty()) continue;
+
+            std::filesystem::path include = (source.parent_path() / std::filesystem::path(name)).lexically_normal();
+            if (std::find(outIncludes.begin(), outIncludes.end(), include) != outIncludes.end()) continue; // 2回目以降 (#pragma onceやガードで中身は1回)
+
+            outIncludes.push_back(include);
+            isSucceeded = CollectIncludesRecursive(include, depth + 1u, outIncludes) && isSucceeded;
+        }
+        return isSucceeded;
+    }
+}
+
+//-------------------------------------------
+// レンダラーが使うシェーダーの要求 (オフラインのコンパイルと同じ)
+//-------------------------------------------
+std::vector<ShaderCompileRequest> shader_cache::MakeProgramRequests(const std::filesystem::path& directory)
+{
+    std::vector<ShaderCompileRequest> requests{};
+    requests.reserve(PROGRAMS.size());
+    for (const auto& program : PROGRAMS)
+    {
+        requests.emplace_back(directory / program.fileName, program.entryPoint, program.profile);
+    }
+    return requests;
+}
+
+//-------------------------------------------
+// インクルードを全部集める (インクルードの中のインクルードも 見つけた順)
+//-------------------------------------------
+bool shader_cache::CollectIncludes(const std::filesystem::path& source, std::vector<std::filesystem::path>& outIncludes)
+{
+    outIncludes.clear();
+    return CollectIncludesRecursive(source, 0u, outIncludes);
+}
+
+//-------------------------------------------
+// キャッシュのキー (ソースとインクルードの中身,エントリーポイント,プロファイル,マクロ,フラグ)
+//-------------------------------------------
+uint64_t shader_cache::ComputeKey(const ShaderCompileRequest& request)
+{
+    uint64_t h = HashBytes(&VERSION, sizeof(VERSION), 14695981039346656037ull);
+    h = HashString(request.entryPoint, h);
+    h = HashString(request.profile, h);
+    h = HashBytes(&request.flags, sizeof(request.flags), h);
+    for (const auto& [name, value] : request.defines)
+    {
+        h = HashString(name, h);
+        h = HashString(value, h);
+    }
+
+    // 中身 (名前が違っても同じ中身なら同じバイトコード)
+    std::vector<uint8_t> bytes{};
+    auto hashFile = [&](const std::filesystem::path& path)
+        {
+            if (ReadFileBytes(path, bytes))
+            {
+                h = HashString(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()), h);
+            }
+            else
+            {
+                h = HashString("<missing>", h);
+            }
+        };
+    hashFile(request.path);
+
+    // インクルード (ファイル名も混ぜる 同じ中身でも並びが変われば別)
+    std::vector<std::filesystem::path> includes{};
+    if (!CollectIncludes(request.path, includes))
+    {
+        h = HashString("<recursive>", h);
+    }
+    for (const auto& include : includes)
+    {
+        std::u8string name = include.lexically_relative(request.path.parent_path()).generic_u8string();
+        h = HashString(std::string_view(reinterpret_cast<const char*>(name.data()), name.size()), h);
+        hashFile(include);
+    }
+    return h;
+}
+
+//-------------------------------------------
+// キーのキャッシュファイル
+//-------------------------------------------
+std::filesystem::path shader_cache::CachePath(const std::filesystem::path& cacheDirectory, uint64_t key)
+{
+    std::ostringstream stream;
+    stream << std::hex;
+    stream.width(16);
+    stream.fill('0');
+    stream << key;
+    return cacheDirectory / (stream.str() + std::string(CACHE_EXTENSION));
+}
+
+//-------------------------------------------
+// 読み込み (キーが合えばファイルから,外れたものはスレッドに分けてコンパイルして残す 失敗したものは空)
+//-------------------------------------------
+bool ShaderCache::load(std::span<const ShaderCompileRequest> requests, unsigned int maxThread, std::vector<std::vector<uint8_t>>& outBytecodes, std::function<void(std::string_view)> logCallback)
+{
+    m_stats = ShaderCacheStats();
+    outBytecodes.assign(requests.size(), std::vector<uint8_t>());
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_cacheDirectory, ec); // 書けなくてもコンパイルはする
+
+    std::mutex mutex; // ↓の統計とログのmutex
+    std::atomic<size_t> next{ 0u };
+    auto worker = [&]()
+        {
+            for (size_t index = next++; index < requests.size(); index = next++)
+            {
+                const ShaderCompileRequest& request = requests[index];
+                uint64_t key = shader_cache::ComputeKey(request);
+                std::filesystem::path cachePath = shader_cache::CachePath(m_cacheDirectory, key);
+                std::vector<uint8_t>& bytecode = outBytecodes[index];
+
+                if (ReadCacheFile(cachePath, key, bytecode))
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++m_stats.hits;
+                    continue;
+                }
+
+                std::string error{};
+                bool isCompiled = m_compiler != nullptr && m_compiler(request, bytecode, error) && !bytecode.empty();
+                if (isCompiled)
+                {
+                    WriteCacheFile(cachePath, key, bytecode); // 残せなければ次回もコンパイルするだけ
+                }
+                else
+                {
+                    bytecode.clear();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (isCompiled)
+                {
+                    ++m_stats.compiled;
+                    if (logCallback != nullptr) logCallback("compiled: " + request.path.filename().string());
+                }
+                else
+                {
+                    ++m_stats.failed;
+                    if (logCallback != nullptr) logCallback("failed: " + request.path.filename().string() + " (" + error + ")");
+                }
+            }
+        };
+
+    // シェーダーごとにスレッドで分ける (全部当たれば読むだけなので少ない)
+    unsigned int threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, maxThread), std::max<size_t>(requests.size(), 1u)));
+    std::vector<std::thread> threads{};
+    threads.reserve(threadCount - 1u);
+    for (unsigned int cnt = 1; cnt < threadCount; ++cnt)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return m_stats.failed == 0u;
+}
+
+//-------------------------------------------
+// 要求のどれのキーでもないキャッシュを消す (ソースを変えるたびに古いものが残るので)
+//-------------------------------------------
+size_t ShaderCache::prune(std::span<const ShaderCompileRequest> requests) const
+{
+    std::unordered_set<std::filesystem::path::string_type> keep{};
+    for (const auto& request : requests)
+    {
+        keep.insert(shader_cache::CachePath(m_cacheDirectory, shader_cache::ComputeKey(request)).filename().native());
+    }
+
+    size_t removed = 0u;
+    std::error_code ec;
+    for (auto itr = std::filesystem::directory_iterator(m_cacheDirectory, ec); !ec && itr != std::filesystem::directory_iterator(); itr.increment(ec))
+    {
+        const std::filesystem::path& path = itr->path();
+        if (!itr->is_regular_file(ec) || path.extension() != std::filesystem::path(shader_cache::CACHE_EXTENSION) || keep.contains(path.filename().native()))
+        {
+            continue;
+        }
+        if (std::filesystem::remove(path, ec))
+        {
+            ++removed;
+        }
+    }
+    return removed;
+}
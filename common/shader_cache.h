@@ -0,0 +1,142 @@
+//--------------------------------------------
+//
+// シェーダーキャッシュ (コンパイル済みのバイトコードをファイルに残す) [shader_cache.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// コンパイルするシェーダー
+struct ShaderCompileRequest
+{
+    std::filesystem::path path;                               // ソース (.hlsl)
+    std::string entryPoint;                                   // エントリーポイント
+    std::string profile;                                      // プロファイル (vs_5_0, ps_5_0)
+    std::vector<std::pair<std::string, std::string>> defines; // マクロ (名前と値)
+    uint32_t flags;                                           // コンパイルフラグ (D3DCOMPILE_*)
+
+    ShaderCompileRequest() : path{}, entryPoint{}, profile{}, defines{}, flags{} {}
+    ShaderCompileRequest(std::filesystem::path sourcePath, std::string_view entry, std::string_view target) : path{ std::move(sourcePath) }, entryPoint{ entry }, profile{ target }, defines{}, flags{} {}
+    ~ShaderCompileRequest() = default;
+};
+
+// コンパイラ (成功したらバイトコードを返す キャッシュから呼ぶのは外れた時だけ 複数のスレッドから同時に呼ぶ)
+using ShaderCompileFunction = std::function<bool(const ShaderCompileRequest& request, std::vector<uint8_t>& outBytecode, std::string& outError)>;
+
+// シェーダーキャッシュの統計
+struct ShaderCacheStats
+{
+    size_t hits;     // ファイルから読んだ数
+    size_t compiled; // コンパイルした数
+    size_t failed;   // コンパイルに失敗した数
+
+    ShaderCacheStats() : hits{}, compiled{}, failed{} {}
+    ~ShaderCacheStats() = default;
+};
+
+//------------------------
+// レンダラーが使うシェーダー (オフラインのコンパイルと同じ一覧を使う)
+//------------------------
+enum class ShaderProgram : unsigned char
+{
+    Polygon2DVS,             // 2D頂点シェーダー
+    Polygon3DVS,             // 3D頂点シェーダー
+    Polygon3DInstancedVS,    // 3D頂点シェーダー (インスタンシング)
+    ModelVS,                 // Model頂点シェーダー
+    ShadowPS,                // シャドウ用ピクセルシェーダー
+    GeometryPS,              // ジオメトリピクセルシェーダー
+    DecalVS,                 // デカール頂点シェーダー
+    DecalPS,                 // デカールピクセルシェーダー
+    ScreenVS,                // 全画面頂点シェーダー
+    UnifiedLightingPS,       // ライティングピクセルシェーダー
+    Outline3DVS,             // アウトライン用3D頂点シェーダ
+    OutlineModelVS,          // アウトライン用Model頂点シェーダ
+    SkyPS,                   // 空ピクセルシェーダ
+    OutlinePS,               // アウトライン用ピクセルシェーダ
+    TransparentPS,           // 半透明シェーダ
+    PostProcessNone,         // ポストプロセス (PostProcessShaderTypeの順)
+    PostProcessFxaa,         //
+    PostProcessGray,         //
+    PostProcessBloomExtract, //
+    PostProcessGaussianBlur, //
+    PostProcessComposite,    //
+    UIPS,                    // UIシェーダ
+    Max
+};
+
+// シェーダーのファイルとエントリーポイントとプロファイル
+struct ShaderProgramDesc
+{
+    const wchar_t* fileName; // SHADERフォルダからのファイル名
+    const char* entryPoint;  // エントリーポイント
+    const char* profile;     // プロファイル
+};
+
+namespace shader_cache
+{
+    constexpr uint32_t VERSION = 1u;                        // キャッシュの形式やコンパイラを変えたら上げる (全部コンパイルし直しになる)
+    constexpr std::string_view CACHE_DIRECTORY_NAME = "cache"; // SHADERフォルダの中に置くバイトコードのフォルダ
+    constexpr std::string_view CACHE_EXTENSION = ".cso";       // バイトコードのファイル (キーの16進が名前)
+    constexpr unsigned int MAX_INCLUDE_DEPTH = 32u;            // これより深いインクルードは循環とみなす
+
+    constexpr std::array<ShaderProgramDesc, size_t(ShaderProgram::Max)> PROGRAMS =
+    { {
+        { L"2DPolygonVS.hlsl",          "VS", "vs_5_0" },
+        { L"3DPolygonVS.hlsl",          "VS", "vs_5_0" },
+        { L"3DPolygonInstancedVS.hlsl", "VS", "vs_5_0" },
+        { L"ModelVS.hlsl",              "VS", "vs_5_0" },
+        { L"ShadowPS.hlsl",             "PS", "ps_5_0" },
+        { L"GeometryPS.hlsl",           "PS", "ps_5_0" },
+        { L"DecalVS.hlsl",              "VS", "vs_5_0" },
+        { L"DecalPS.hlsl",              "PS", "ps_5_0" },
+        { L"ScreenVS.hlsl",             "VS", "vs_5_0" },
+        { L"UnifiedLighting_DL.hlsl",   "PS", "ps_5_0" },
+        { L"Outline3DVS.hlsl",          "VS", "vs_5_0" },
+        { L"OutlineModelVS.hlsl",       "VS", "vs_5_0" },
+        { L"SkyPS.hlsl",                "PS", "ps_5_0" },
+        { L"OutlinePS.hlsl",            "PS", "ps_5_0" },
+        { L"TransparentPS.hlsl",        "PS", "ps_5_0" },
+        { L"PP_None.hlsl",              "PS", "ps_5_0" },
+        { L"PP_Fxaa.hlsl",              "PS", "ps_5_0" },
+        { L"PP_Gray.hlsl",              "PS", "ps_5_0" },
+        { L"PP_BloomExtract.hlsl",      "PS", "ps_5_0" },
+        { L"PP_GaussianBlur.hlsl",      "PS", "ps_5_0" },
+        { L"PP_Composite.hlsl",         "PS", "ps_5_0" },
+        { L"UIPS.hlsl",                 "PS", "ps_5_0" },
+    } };
+
+    std::vector<ShaderCompileRequest> MakeProgramRequests(const std::filesystem::path& directory);
+    bool CollectIncludes(const std::filesystem::path& source, std::vector<std::filesystem::path>& outIncludes);
+    uint64_t ComputeKey(const ShaderCompileRequest& request);
+    std::filesystem::path CachePath(const std::filesystem::path& cacheDirectory, uint64_t key);
+}
+
+//----------------------------
+// シェーダーキャッシュ (ソースとインクルードとコンパイル設定のハッシュをキーにバイトコードを残し,外れたものだけ並列にコンパイルする GPUには触らない)
+//----------------------------
+class ShaderCache
+{
+public:
+    ShaderCache(std::filesystem::path cacheDirectory, ShaderCompileFunction compiler) : m_cacheDirectory{ std::move(cacheDirectory) }, m_compiler{ std::move(compiler) }, m_stats{} {}
+    ~ShaderCache() = default;
+
+    bool load(std::span<const ShaderCompileRequest> requests, unsigned int maxThread, std::vector<std::vector<uint8_t>>& outBytecodes, std::function<void(std::string_view)> logCallback = {});
+    size_t prune(std::span<const ShaderCompileRequest> requests) const;
+
+    const std::filesystem::path& getCacheDirectory() const { return m_cacheDirectory; }
+    void getStats(ShaderCacheStats& stats) const { stats = m_stats; }
+
+private:
+    std::filesystem::path m_cacheDirectory; // バイトコードのフォルダ
+    ShaderCompileFunction m_compiler;       // 外れた時のコンパイラ
+    ShaderCacheStats m_stats;               // 最後のloadの統計
+};
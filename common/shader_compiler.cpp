@@ -0,0 +1,38 @@
+//--------------------------------------------
+//
+// シェーダーのコンパイル (D3DCompileFromFile) [shader_compiler.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "shader_compiler.h"
+#include <d3dcompiler.h>
+#include <wrl/client.h>
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+//-------------------------------------------
+// 1つコンパイルする (D3DCompileFromFileは複数のスレッドから呼べる)
+//-------------------------------------------
+bool shader_compiler::CompileFromFile(const ShaderCompileRequest& request, std::vector<uint8_t>& outBytecode, std::string& outError)
+{
+    // マクロ (最後は空で終わる)
+    std::vector<D3D_SHADER_MACRO> macros{};
+    macros.reserve(request.defines.size() + 1u);
+    for (const auto& [name, value] : request.defines)
+    {
+        macros.push_back({ name.c_str(), value.c_str() });
+    }
+    macros.push_back({ nullptr, nullptr });
+
+    Microsoft::WRL::ComPtr<ID3DBlob> pBlob{}, pErrorBlob{};
+    HRESULT hr = D3DCompileFromFile(request.path.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, request.entryPoint.c_str(), request.profile.c_str(), request.flags, 0, pBlob.GetAddressOf(), pErrorBlob.GetAddressOf());
+    if (FAILED(hr) || pBlob == nullptr)
+    {
+        outError = pErrorBlob != nullptr ? std::string(static_cast<const char*>(pErrorBlob->GetBufferPointer()), pErrorBlob->GetBufferSize()) : "compile failed";
+        return false;
+    }
+
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pBlob->GetBufferPointer());
+    outBytecode.assign(pBytes, pBytes + pBlob->GetBufferSize());
+    return true;
+}
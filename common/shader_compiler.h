@@ -0,0 +1,13 @@
+//--------------------------------------------
+//
+// シェーダーのコンパイル (D3DCompileFromFile) [shader_compiler.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "shader_cache.h" // ShaderCompileRequest
+
+namespace shader_compiler
+{
+    bool CompileFromFile(const ShaderCompileRequest& request, std::vector<uint8_t>& outBytecode, std::string& outError);
+}
@@ -0,0 +1,177 @@
+//--------------------------------------------
+//
+// カスケードシャドウ [shadow_cascade.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "shadow_cascade.h"
+
+namespace
+{
+    constexpr float RADIUS_ROUNDING = 16.0f;      // 半径を1/16単位に丸める (回転で大きさが揺れないように)
+    constexpr float STATIC_REGION_PADDING = 1.25f; // 動かない影のキャッシュの範囲の広さ (カスケードの半径に対する倍率)
+
+    //--------------
+    // 正射影を作る (中心から左右上下に半径,奥行きは手前に影を落とすものの距離を足す)
+    //--------------
+    Matrix MakeCascadeProj(const Vector3& center, float radius, float casterDistance)
+    {
+        return Matrix::OrthographicOffCenter(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+            center.z - radius - casterDistance, center.z + radius);
+    }
+}
+
+//-------------------------------------------
+// カメラの視錐台を分割し,区間ごとにライトの正射影を合わせる
+// 区間は包む球で囲み (向きに依存しない大きさ),中心をテクセル単位に揃える (移動でちらつかない)
+//-------------------------------------------
+bool BuildShadowCascades(const Matrix& cameraView, const Matrix& cameraProj, const Vector3& lightDirection, const Vector3& lightUp, const ShadowSettings& settings, ShadowCascadeSet& outSet)
+{
+    outSet.count = 0u;
+
+    Matrix invViewProj{};
+    if (settings.resolution == 0u || !Matrix::Inverse(Matrix::Multiply(cameraView, cameraProj), invViewProj))
+    {
+        return false;
+    }
+
+    // プロジェクションからカメラの手前と奥を取り出す (透視: m23=1, 正射影: m33=1)
+    float m22 = cameraProj.m[2][2], m32 = cameraProj.m[3][2], m23 = cameraProj.m[2][3], m33 = cameraProj.m[3][3];
+    if (m22 == 0.0f || m22 == 1.0f)
+    {
+        return false;
+    }
+    bool isPerspective = m23 != 0.0f;
+    float nearZ = -m32 / m22;
+    float farZ = isPerspective ? m32 / (1.0f - m22) : nearZ + 1.0f / m22;
+    farZ = std::min(farZ, settings.maxDistance);
+    if (farZ <= nearZ)
+    {
+        return false;
+    }
+    auto depthToNdc = [=](float depth) { return (depth * m22 + m32) / (depth * m23 + m33); };
+
+    // ライトの向き (原点から光の方向を見る 平行光源なので位置は射影側で決める)
+    if (lightDirection.length() <= 0.0f)
+    {
+        return false;
+    }
+    Vector3 direction = lightDirection;
+    direction.normalize();
+    Vector3 up = lightUp;
+    if (std::fabs(Vector3::Dot(direction, up)) > 0.99f * up.length())
+    {
+        up = (std::fabs(direction.y) < 0.99f) ? Vector3(0.0f, 1.0f, 0.0f) : Vector3(0.0f, 0.0f, 1.0f); // 平行だと向きが決まらない
+    }
+    Matrix lightView = Matrix::LookAtLH(Vector3(), direction, up);
+
+    unsigned int count = std::clamp(settings.cascadeCount, 1u, static_cast<unsigned int>(MAX_SHADOW_CASCADES));
+    float lambda = std::clamp(settings.splitLambda, 0.0f, 1.0f);
+    float splitNear = nearZ;
+    for (unsigned int cnt = 0; cnt < count; ++cnt)
+    {
+        // 均等分割と対数分割を混ぜる (対数は手前ほど細かい)
+        float ratio = static_cast<float>(cnt + 1u) / static_cast<float>(count);
+        float uniform = nearZ + (farZ - nearZ) * ratio;
+        float logarithmic = (nearZ > 0.0f) ? nearZ * std::pow(farZ / nearZ, ratio) : uniform;
+        float splitFar = (cnt + 1u == count) ? farZ : uniform + (logarithmic - uniform) * lambda;
+
+        // 区間の8頂点 (NDCからワールドへ戻す)
+        std::array<Vector3, 8> corners{};
+        Vector3 center{};
+        size_t index = 0u;
+        for (float depth : { splitNear, splitFar })
+        {
+            float ndcZ = depthToNdc(depth);
+            for (float y : { -1.0f, 1.0f })
+            {
+                for (float x : { -1.0f, 1.0f })
+                {
+                    Vector3 corner(x, y, ndcZ);
+                    corner.transformCoord(invViewProj);
+                    corners[index++] = corner;
+                    center = center + corner;
+                }
+            }
+        }
+        center = center / static_cast<float>(corners.size());
+
+        float radius = 0.0f;
+        for (const auto& corner : corners)
+        {
+            radius = std::max(radius, (corner - center).length());
+        }
+        radius = std::ceil(radius * RADIUS_ROUNDING) / RADIUS_ROUNDING;
+
+        // ライト空間で中心をテクセル単位に揃える
+        Vector3 lightCenter = center;
+        lightCenter.transformCoord(lightView);
+        float texelSize = radius * 2.0f / static_cast<float>(settings.resolution);
+        lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+        lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+        ShadowCascade& cascade = outSet.cascades[cnt];
+        cascade.view = lightView;
+        cascade.proj = MakeCascadeProj(lightCenter, radius, settings.casterDistance);
+        cascade.center = lightCenter;
+        cascade.radius = radius;
+        cascade.splitNear = splitNear;
+        cascade.splitFar = splitFar;
+
+        splitNear = splitFar;
+    }
+    outSet.count = count;
+    return true;
+}
+
+//-------------------------------------------
+// 動かない影のキャッシュを描く範囲を作る
+// カスケードを広げた範囲の中心を粗い格子に揃える (格子の幅は広げた分より狭いので,作った時のカスケードは必ず中に入る)
+// カメラが少し動いてもカスケードがこの範囲にある間はキャッシュを使い回せる
+//-------------------------------------------
+ShadowCascade BuildStaticShadowRegion(const ShadowCascade& cascade, const ShadowSettings& settings)
+{
+    ShadowCascade region = cascade;
+    if (settings.resolution == 0u || cascade.radius <= 0.0f)
+    {
+        return region;
+    }
+
+    float radius = std::ceil(cascade.radius * STATIC_REGION_PADDING * RADIUS_ROUNDING) / RADIUS_ROUNDING;
+    float texelSize = radius * 2.0f / static_cast<float>(settings.resolution);
+
+    // 格子はテクセル単位 (描き直しても影の縁が揃う),丸めの誤差で外れないように1テクセル余らせる
+    float step = std::max(std::floor((radius - cascade.radius) / texelSize) - 1.0f, 1.0f) * texelSize;
+    Vector3 center = cascade.center;
+    center.x = std::floor(center.x / step) * step;
+    center.y = std::floor(center.y / step) * step;
+    center.z = std::floor(center.z / step) * step;
+
+    region.proj = MakeCascadeProj(center, radius, settings.casterDistance);
+    region.center = center;
+    region.radius = radius;
+    return region;
+}
+
+//-------------------------------------------
+// キャッシュを使い回せるか (ライトの向きが同じで,カスケードの正射影がキャッシュを描いた範囲に収まる)
+//-------------------------------------------
+bool StaticShadowCache::isReusable(unsigned int index, const ShadowCascade& cascade) const
+{
+    if (index >= MAX_SHADOW_CASCADES || !isValid[index])
+    {
+        return false;
+    }
+
+    const ShadowCascade& region = regions[index];
+    if (std::memcmp(&region.view, &cascade.view, sizeof(Matrix)) != 0)
+    {
+        return false;
+    }
+
+    // 奥行きは手前に影を落とすものの距離が同じなので,中心のずれだけ見ればよい
+    float margin = region.radius - cascade.radius;
+    return std::fabs(cascade.center.x - region.center.x) <= margin &&
+        std::fabs(cascade.center.y - region.center.y) <= margin &&
+        std::fabs(cascade.center.z - region.center.z) <= margin;
+}
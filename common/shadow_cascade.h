@@ -0,0 +1,63 @@
+//--------------------------------------------
+//
+// カスケードシャドウ [shadow_cascade.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // ShadowSettings, MAX_SHADOW_CASCADES
+#include <cstring>
+
+// 1つのカスケード (カメラの視錐台の一区間を包むライトの正射影)
+struct ShadowCascade
+{
+    Matrix view;     // ライトのビュー行列
+    Matrix proj;     // ライトの正射影行列
+    Vector3 center;  // 正射影の中心 (ライト空間)
+    float radius;    // 正射影の半分の幅 (奥行きは手前に影を落とすものの距離を足す)
+    float splitNear; // 区間の手前 (カメラのビュー空間の奥行き)
+    float splitFar;  // 区間の奥
+
+    ShadowCascade() : view{}, proj{}, center{}, radius{}, splitNear{}, splitFar{} {}
+    ~ShadowCascade() = default;
+};
+
+// カメラ1つ分のカスケード
+struct ShadowCascadeSet
+{
+    std::array<ShadowCascade, MAX_SHADOW_CASCADES> cascades; // カスケード (手前から)
+    unsigned int count;                                      // 有効な数
+
+    ShadowCascadeSet() : cascades{}, count{} {}
+    ~ShadowCascadeSet() = default;
+};
+
+// 動かない影のキャッシュの状態 (カスケードごとにカスケードより広い範囲へ描き,カスケードがその中にあり顔ぶれが変わらなければ使い回す)
+struct StaticShadowCache
+{
+    std::array<ShadowCascade, MAX_SHADOW_CASCADES> regions; // キャッシュを描いた範囲 (BuildStaticShadowRegionで作った正射影)
+    std::array<bool, MAX_SHADOW_CASCADES> isValid;          // キャッシュが使えるか
+    uint64_t casterKey;                                     // キャッシュを描いたときの動かない影の顔ぶれ
+
+    StaticShadowCache() : regions{}, isValid{}, casterKey{} {}
+    ~StaticShadowCache() = default;
+
+    void invalidate() { isValid.fill(false); }
+    void beginFrame(uint64_t key)
+    {
+        if (key != casterKey)
+        {
+            invalidate();
+            casterKey = key;
+        }
+    }
+    bool isReusable(unsigned int index, const ShadowCascade& cascade) const;
+    void store(unsigned int index, const ShadowCascade& region)
+    {
+        regions[index] = region;
+        isValid[index] = true;
+    }
+};
+
+bool BuildShadowCascades(const Matrix& cameraView, const Matrix& cameraProj, const Vector3& lightDirection, const Vector3& lightUp, const ShadowSettings& settings, ShadowCascadeSet& outSet);
+ShadowCascade BuildStaticShadowRegion(const ShadowCascade& cascade, const ShadowSettings& settings);
@@ -0,0 +1,44 @@
+//--------------------------------------------
+//
+// スキンメッシュの境界ボックス (ボーン空間のボックスとワールドへの変換) [skinned_bounds.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "skinned_bounds.h"
+
+namespace skinning
+{
+    //--------------
+    // ボックスを軸ごとに広げる
+    //--------------
+    AABB Inflated(const AABB& box, const Vector3& margin)
+    {
+        if (!box.isValid()) return box;
+        return AABB(box.min - margin, box.max + margin);
+    }
+
+    //--------------
+    // ボーン空間の境界ボックスを頂点で広げる (モデル空間の頂点をオフセット行列でボーン空間へ移す)
+    //--------------
+    void ExpandBoneBounds(AABB& boneBounds, const Vector3& position, const Matrix& offsetMatrix)
+    {
+        Vector3 bonePosition = position;
+        bonePosition.transformCoord(offsetMatrix);
+        boneBounds.expand(bonePosition);
+    }
+
+    //--------------
+    // ボーン空間の境界ボックスをワールドへ変換する
+    // ボックスはオフセット行列を掛けた後なので,ボーンのノードのグローバル行列だけを掛ける (パレット行列はオフセット込み)
+    // モーフの差分はモデル空間なのでオフセット行列でボーン空間の大きさにして広げる
+    //--------------
+    AABB TransformBoneBounds(const AABB& boneBounds, const Matrix& offsetMatrix, const Matrix& boneGlobal, const Vector3& morphMargin)
+    {
+        AABB bounds = boneBounds;
+        if (morphMargin.x > 0.0f || morphMargin.y > 0.0f || morphMargin.z > 0.0f)
+        {
+            bounds = Inflated(bounds, AABB::Transformed(AABB(morphMargin * -1.0f, morphMargin), offsetMatrix).getExtent());
+        }
+        return AABB::Transformed(bounds, boneGlobal);
+    }
+}
@@ -0,0 +1,15 @@
+//--------------------------------------------
+//
+// スキンメッシュの境界ボックス (ボーン空間のボックスとワールドへの変換) [skinned_bounds.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "math_types.h"
+
+namespace skinning
+{
+    AABB Inflated(const AABB& box, const Vector3& margin);
+    void ExpandBoneBounds(AABB& boneBounds, const Vector3& position, const Matrix& offsetMatrix);
+    AABB TransformBoneBounds(const AABB& boneBounds, const Matrix& offsetMatrix, const Matrix& boneGlobal, const Vector3& morphMargin);
+}
@@ -5,6 +5,7 @@
 //
 //--------------------------------------------
 #include "texture.h"
+#include "texture_cooker.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -56,6 +57,25 @@ namespace
             return TextureType::None;
         }
     }
+
+    // クック済みのDDSを探す (元の画像より古いものは使わない 元がなければ使う)
+    bool FindCookedPath(const std::filesystem::path& path, std::filesystem::path& outPath)
+    {
+        std::error_code ec;
+        std::filesystem::path cookedPath = texture_cooker::CookedPath(path);
+        if (!std::filesystem::is_regular_file(cookedPath, ec))
+        {
+            return false;
+        }
+
+        auto sourceTime = std::filesystem::last_write_time(path, ec);
+        if (!ec && std::filesystem::last_write_time(cookedPath, ec) < sourceTime)
+        {
+            return false;
+        }
+        outPath = cookedPath;
+        return true;
+    }
 }
 
 // stbカスタムデリータ
@@ -188,6 +208,15 @@ bool TextureManager::registerPath(uint64_t id, const std::filesystem::path& path
     slot.path = path;
     slot.type = findTextureType(path, typeName);
     if (slot.type == TextureType::None) { return false; }
+    slot.isColor = texture_cooker::FindRole(path) == TextureCookRole::Albedo; // クック済みの名前 (.png.dds) では分からないので元の名前で
+
+    // texcookでBC圧縮したものがあればそちらを読む
+    std::filesystem::path cookedPath{};
+    if ((slot.type == TextureType::Wic || slot.type == TextureType::Tga) && FindCookedPath(path, cookedPath))
+    {
+        slot.path = cookedPath;
+        slot.type = TextureType::Dds;
+    }
 
     // キャッシュ登録
     TextureHandle handle(uint32_t(m_slots.size()));
@@ -223,6 +252,8 @@ bool TextureManager::registerByteData(uint64_t id, const std::filesystem::path&
     if (textureData->type == TextureType::None || textureData->type == TextureType::Raw) { return false; }
     textureData->buffer.assign(data.begin(), data.end());
     textureData->isValid = true;
+    slot.isColor = texture_cooker::FindRole(path) == TextureCookRole::Albedo;
+    textureData->isColor = slot.isColor;
 
     // キャッシュ登録
     slot.data = textureData;
@@ -285,30 +316,6 @@ TextureHandle TextureManager::getTextureHandle(uint64_t id)
     return TextureHandle();
 }
 
-//----------------------------
-// テクスチャデータを取得する
-//----------------------------
-std::weak_ptr<TextureData> TextureManager::getTextureData(const TextureHandle& handle) const
-{
-    if (!handle.isValid() || handle.id >= m_slots.size())
-    {
-        return std::weak_ptr<TextureData>{};
-    }
-    return m_slots[handle.id].data;
-}
-
-//----------------------------
-// テクスチャデータを取得する
-//----------------------------
-std::weak_ptr<TextureData> TextureManager::getTextureData(size_t index) const
-{
-    if (index >= m_slots.size())
-    {
-        return std::weak_ptr<TextureData>{};
-    }
-    return m_slots[index].data;
-}
-
 //----------------------------
 // テクスチャのサイズを取得する
 //----------------------------
@@ -384,6 +391,7 @@ void TextureManager::setData(size_t index)
     {// m_slotsは同時に触らない
         std::lock_guard<std::mutex> lock(m_slotsMutex);
         data->type = m_slots[index].type;
+        data->isColor = m_slots[index].isColor;
         filePath = m_slots[index].path;
     }
 
@@ -8,8 +8,12 @@
 #include <filesystem>
 #include <mutex>
 #include <functional>
+#include <memory>
 #include <span>
-#include "pch.h"
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "hash.h"
 #include "graphics_types.h"
 
 // stbカスタムデリータ
@@ -27,8 +31,9 @@ struct TextureData
     int height;                                            // 高さ
     std::unique_ptr<unsigned char, StbDeleter> rawPixels;  // RGBAポインタ (type==Raw時のみ)
     bool isValid;                                          // データが有効かどうか
+    bool isColor;                                          // 色のテクスチャ (SRGBで読む 法線やマスクはそのままの値で読む)
 
-    TextureData() : type{}, buffer{}, isValid(false), rawPixels{}, width{}, height{} {}
+    TextureData() : type{}, buffer{}, isValid(false), isColor(true), rawPixels{}, width{}, height{} {}
     ~TextureData();
 };
 
@@ -38,8 +43,9 @@ struct TextureSlot
     std::filesystem::path path;        // パス
     TextureType type;                  // 種類
     std::shared_ptr<TextureData> data; // データ
+    bool isColor;                      // 色のテクスチャ (元のファイル名で決める)
 
-    TextureSlot() : type{}, data{}, path{} {}
+    TextureSlot() : type{}, data{}, path{}, isColor{ true } {}
     ~TextureSlot() = default;
 };
 
@@ -60,11 +66,11 @@ public:
 
     TextureHandle getTextureHandle(uint64_t id);
 
-    std::weak_ptr<TextureData> getTextureData(const TextureHandle& handle) const;
+    std::weak_ptr<TextureData> getTextureData(const TextureHandle& handle) const { return handle.isValid() ? getTextureData(size_t(handle.id)) : std::weak_ptr<TextureData>{}; }
     void getTextureSize(const TextureHandle& handle, int& width, int& height) const;
     size_t getTextureCount() const { return m_slots.size(); }
 
-    std::weak_ptr<TextureData> getTextureData(size_t index) const;
+    std::weak_ptr<TextureData> getTextureData(size_t index) const { return index < m_slots.size() ? m_slots[index].data : std::weak_ptr<TextureData>{}; } // バックエンドはローダーなしで読む
 
     void releaseCpuResources();
     void releaseCpuResource(uint64_t id);
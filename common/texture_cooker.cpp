@@ -0,0 +1,376 @@
+//--------------------------------------------
+//
+// テクスチャのクック (画像をBC圧縮とミップ付きのDDSにする) [texture_cooker.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "texture_cooker.h"
+#include <DirectXTex.h> // 圧縮とミップ生成はCPUで (WICは使わない)
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "stb_image.h" // 実装はtexture.cpp
+
+namespace
+{
+    // stbの画素を解放する
+    struct StbPixelsDeleter
+    {
+        void operator()(unsigned char* p) const { stbi_image_free(p); }
+    };
+
+    // 小文字にする
+    std::string ToLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    // ファイルを全部読む
+    bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& outBytes)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        outBytes.resize(static_cast<size_t>(size));
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(outBytes.data()), size));
+    }
+
+    // 書き終わってから差し替える (途中で止めても壊れたDDSを残さない)
+    bool WriteFileBytes(const std::filesystem::path& path, const void* data, size_t size)
+    {
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+            if (!file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size))) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // 使い方ごとの圧縮形式 (色だけSRGBで書く ランタイムはSRGBの形式をそのまま読む)
+    DXGI_FORMAT SelectCookFormat(TextureCookRole role, const DirectX::Image& image)
+    {
+        switch (role)
+        {
+        case TextureCookRole::Normal: return DXGI_FORMAT_BC5_UNORM;
+        case TextureCookRole::Mask:   return DXGI_FORMAT_BC7_UNORM;
+        case TextureCookRole::Gray:   return DXGI_FORMAT_BC4_UNORM;
+        default: break;
+        }
+
+        // 透明がなければ半分の大きさのBC1にする
+        for (size_t y = 0; y < image.height; ++y)
+        {
+            const uint8_t* pRow = image.pixels + image.rowPitch * y;
+            for (size_t x = 0; x < image.width; ++x)
+            {
+                if (pRow[x * 4u + 3u] != 0xFFu) return DXGI_FORMAT_BC7_UNORM_SRGB;
+            }
+        }
+        return DXGI_FORMAT_BC1_UNORM_SRGB;
+    }
+
+    // 前回のハッシュを読む (1行に ハッシュ 相対パス)
+    void LoadCache(const std::filesystem::path& path, std::unordered_map<std::string, uint64_t>& outCache)
+    {
+        std::ifstream file(path);
+        std::string line{};
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            uint64_t hash{};
+            std::string key{};
+            if (stream >> std::hex >> hash && stream.get() == ' ' && std::getline(stream, key) && !key.empty())
+            {
+                outCache[key] = hash;
+            }
+        }
+    }
+
+    // ハッシュを書く (差分が見やすいように並べる)
+    bool SaveCache(const std::filesystem::path& path, const std::unordered_map<std::string, uint64_t>& cache)
+    {
+        std::vector<std::pair<std::string, uint64_t>> entries(cache.begin(), cache.end());
+        std::sort(entries.begin(), entries.end());
+
+        std::ostringstream stream;
+        for (const auto& [key, hash] : entries)
+        {
+            stream << std::hex << hash << ' ' << key << '\n';
+        }
+        std::string text = stream.str();
+        return WriteFileBytes(path, text.data(), text.size());
+    }
+}
+
+//-------------------------------------------
+// クックする画像か (DDSとRawはしない)
+//-------------------------------------------
+bool texture_cooker::IsCookable(const std::filesystem::path& path)
+{
+    std::string ext = ToLower(path.extension().string());
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tga";
+}
+
+//-------------------------------------------
+// クックしたDDSのパス (元の名前に.ddsを足す 同じ名前の手作りのDDSとぶつけない)
+//-------------------------------------------
+std::filesystem::path texture_cooker::CookedPath(const std::filesystem::path& source)
+{
+    std::filesystem::path cooked = source;
+    cooked += ".dds";
+    return cooked;
+}
+
+//-------------------------------------------
+// ファイル名の末尾から使い方を決める
+//-------------------------------------------
+TextureCookRole texture_cooker::FindRole(const std::filesystem::path& path)
+{
+    std::string stem = ToLower(path.stem().string());
+    size_t separator = stem.find_last_of('_');
+    if (separator == std::string::npos)
+    {
+        return TextureCookRole::Albedo;
+    }
+
+    std::string_view suffix = std::string_view(stem).substr(separator + 1u);
+    if (suffix == "n" || suffix == "nrm" || suffix == "normal")
+    {
+        return TextureCookRole::Normal;
+    }
+    if (suffix == "m" || suffix == "mask" || suffix == "orm" || suffix == "arm")
+    {
+        return TextureCookRole::Mask;
+    }
+    if (suffix == "ao" || suffix == "r" || suffix == "rough" || suffix == "roughness" || suffix == "metal" || suffix == "metallic" || suffix == "h" || suffix == "height")
+    {
+        return TextureCookRole::Gray;
+    }
+    return TextureCookRole::Albedo;
+}
+
+//-------------------------------------------
+// 中身のハッシュ (FNV-1a 64bit)
+//-------------------------------------------
+uint64_t texture_cooker::HashBytes(std::span<const uint8_t> bytes, uint64_t seed)
+{
+    uint64_t h = seed;
+    for (uint8_t byte : bytes)
+    {
+        h ^= byte;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+//-------------------------------------------
+// 1枚クックする (縦横を4の倍数に広げ,ミップを作ってBC圧縮する)
+//-------------------------------------------
+bool texture_cooker::CookTexture(std::span<const uint8_t> source, TextureCookRole role, const TextureCookSettings& settings, const std::filesystem::path& outPath, std::string& outError)
+{
+    // 展開 (RGBA8)
+    int width{}, height{};
+    std::unique_ptr<unsigned char, StbPixelsDeleter> upPixels(stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, nullptr, 4));
+    if (upPixels == nullptr)
+    {
+        outError = stbi_failure_reason() != nullptr ? stbi_failure_reason() : "decode failed";
+        return false;
+    }
+
+    // 色はSRGBのままミップを作る (DirectXTexが線形で平均する)
+    DirectX::Image image{};
+    image.width = static_cast<size_t>(width);
+    image.height = static_cast<size_t>(height);
+    image.format = role == TextureCookRole::Albedo ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+    image.rowPitch = image.width * 4u;
+    image.slicePitch = image.rowPitch * image.height;
+    image.pixels = upPixels.get();
+
+    // BCの一番細かいミップは縦横が4の倍数でないとD3D11で作れない
+    DirectX::ScratchImage resized;
+    size_t alignedWidth = (image.width + 3u) & ~size_t(3u), alignedHeight = (image.height + 3u) & ~size_t(3u);
+    if (alignedWidth != image.width || alignedHeight != image.height)
+    {
+        if (FAILED(DirectX::Resize(image, alignedWidth, alignedHeight, DirectX::TEX_FILTER_DEFAULT, resized)))
+        {
+            outError = "resize failed";
+            return false;
+        }
+        image = *resized.GetImage(0, 0, 0);
+    }
+
+    DirectX::ScratchImage mipChain;
+    if (FAILED(DirectX::GenerateMipMaps(image, DirectX::TEX_FILTER_DEFAULT, 0, mipChain)))
+    {
+        outError = "mip generation failed";
+        return false;
+    }
+
+    // 圧縮 (ファイルごとにスレッドを分けるので1枚の中は並列にしない)
+    DXGI_FORMAT format = SelectCookFormat(role, image);
+    DirectX::TEX_COMPRESS_FLAGS compressFlags = DirectX::TEX_COMPRESS_DEFAULT;
+    if (settings.isQuick)
+    {
+        compressFlags |= DirectX::TEX_COMPRESS_BC7_QUICK;
+    }
+    DirectX::ScratchImage compressed;
+    if (FAILED(DirectX::Compress(mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(), format, compressFlags, DirectX::TEX_THRESHOLD_DEFAULT, compressed)))
+    {
+        outError = "compression failed";
+        return false;
+    }
+
+    DirectX::Blob blob;
+    if (FAILED(DirectX::SaveToDDSMemory(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(), DirectX::DDS_FLAGS_NONE, blob)))
+    {
+        outError = "dds encode failed";
+        return false;
+    }
+    if (!WriteFileBytes(outPath, blob.GetBufferPointer(), blob.GetBufferSize()))
+    {
+        outError = "write failed";
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------
+// フォルダの画像を全部クックする (中身と設定のハッシュが前回と同じで出力があれば飛ばす)
+//-------------------------------------------
+TextureCookResult texture_cooker::CookDirectory(const std::filesystem::path& root, unsigned int maxThread, const TextureCookSettings& settings, std::function<void(std::string_view)> logCallback)
+{
+    TextureCookResult result{};
+    std::mutex mutex; // ↓のキャッシュと結果とログのmutex
+    auto log = [&](const std::string& message)
+        {
+            if (logCallback != nullptr) logCallback(message);
+        };
+
+    std::error_code ec;
+    if (!std::filesystem::is_directory(root, ec))
+    {
+        log("not a directory: " + root.string());
+        ++result.failed;
+        return result;
+    }
+
+    // 対象を集める
+    std::vector<std::filesystem::path> sources{};
+    for (auto itr = std::filesystem::recursive_directory_iterator(root, ec); !ec && itr != std::filesystem::recursive_directory_iterator(); itr.increment(ec))
+    {
+        if (itr->is_regular_file(ec) && IsCookable(itr->path()))
+        {
+            sources.push_back(itr->path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+
+    std::filesystem::path cachePath = root / CACHE_FILE_NAME;
+    std::unordered_map<std::string, uint64_t> cache{};
+    LoadCache(cachePath, cache);
+
+    std::atomic<size_t> next{ 0u };
+    auto worker = [&]()
+        {
+            std::vector<uint8_t> bytes{};
+            for (size_t index = next++; index < sources.size(); index = next++)
+            {
+                const std::filesystem::path& source = sources[index];
+                std::filesystem::path outPath = CookedPath(source);
+                std::u8string relative = source.lexically_relative(root).generic_u8string();
+                std::string key(relative.begin(), relative.end());
+
+                if (!ReadFileBytes(source, bytes))
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++result.failed;
+                    log("read failed: " + key);
+                    continue;
+                }
+
+                // 設定が変わっても作り直すようにハッシュに混ぜる
+                TextureCookRole role = FindRole(source);
+                std::array<uint8_t, 6> salt{ uint8_t(VERSION), uint8_t(VERSION >> 8), uint8_t(VERSION >> 16), uint8_t(VERSION >> 24), uint8_t(role), uint8_t(settings.isQuick) };
+                uint64_t hash = HashBytes(bytes, HashBytes(salt));
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto itr = cache.find(key);
+                    if (!settings.isForce && itr != cache.end() && itr->second == hash && std::filesystem::exists(outPath, ec))
+                    {
+                        ++result.skipped;
+                        continue;
+                    }
+                }
+
+                std::string error{};
+                bool isCooked = CookTexture(bytes, role, settings, outPath, error);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (isCooked)
+                {
+                    cache[key] = hash;
+                    ++result.cooked;
+                    log("cooked: " + key);
+                }
+                else
+                {
+                    cache.erase(key);
+                    ++result.failed;
+                    log("failed: " + key + " (" + error + ")");
+                }
+            }
+        };
+
+    // ファイルごとにスレッドで分ける
+    unsigned int threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, maxThread), std::max<size_t>(sources.size(), 1u)));
+    std::vector<std::thread> threads{};
+    threads.reserve(threadCount);
+    for (unsigned int cnt = 0; cnt < threadCount; ++cnt)
+    {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // 消えた画像のハッシュは残さない
+    for (auto itr = cache.begin(); itr != cache.end();)
+    {
+        if (!std::filesystem::exists(root / std::filesystem::path(std::u8string(itr->first.begin(), itr->first.end())), ec))
+        {
+            itr = cache.erase(itr);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+    if (!SaveCache(cachePath, cache))
+    {
+        log("cache write failed: " + cachePath.string());
+    }
+    return result;
+}
@@ -0,0 +1,58 @@
+//--------------------------------------------
+//
+// テクスチャのクック (画像をBC圧縮とミップ付きのDDSにする) [texture_cooker.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// テクスチャの使い方 (圧縮形式を決める ファイル名の末尾で分ける)
+enum class TextureCookRole : unsigned char
+{
+    Albedo, // 色 (SRGB 不透明ならBC1,透明があればBC7)
+    Normal, // 法線 _n _nrm _normal (BC5 XYだけ残すのでZはシェーダーで戻す)
+    Mask,   // 複数のチャンネルのマスク _m _mask _orm _arm (BC7)
+    Gray,   // 1チャンネル _ao _r _rough _roughness _metal _metallic _h _height (BC4)
+    Max
+};
+
+// クックの設定
+struct TextureCookSettings
+{
+    bool isQuick; // BC7を速い設定で圧縮する (確認用 品質は落ちる)
+    bool isForce; // 変わっていなくても作り直す
+
+    TextureCookSettings() : isQuick{}, isForce{} {}
+    ~TextureCookSettings() = default;
+};
+
+// クックの結果
+struct TextureCookResult
+{
+    size_t cooked;  // 作ったDDS数
+    size_t skipped; // 変わっていないので飛ばした数
+    size_t failed;  // 失敗した数
+
+    TextureCookResult() : cooked{}, skipped{}, failed{} {}
+    ~TextureCookResult() = default;
+};
+
+namespace texture_cooker
+{
+    constexpr uint32_t VERSION = 1u;                       // 出力が変わったら上げる (キャッシュが全部作り直しになる)
+    constexpr std::string_view CACHE_FILE_NAME = "texcook.cache"; // クックしたフォルダに置くハッシュのキャッシュ
+
+    bool IsCookable(const std::filesystem::path& path);
+    std::filesystem::path CookedPath(const std::filesystem::path& source);
+    TextureCookRole FindRole(const std::filesystem::path& path);
+    uint64_t HashBytes(std::span<const uint8_t> bytes, uint64_t seed = 14695981039346656037ull);
+
+    bool CookTexture(std::span<const uint8_t> source, TextureCookRole role, const TextureCookSettings& settings, const std::filesystem::path& outPath, std::string& outError);
+    TextureCookResult CookDirectory(const std::filesystem::path& root, unsigned int maxThread, const TextureCookSettings& settings, std::function<void(std::string_view)> logCallback = {});
+}
@@ -0,0 +1,380 @@
+//--------------------------------------------
+//
+// テクスチャストリーミング (ミップの常駐管理) [texture_streaming.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "texture_streaming.h"
+
+namespace
+{
+    constexpr float MIN_CLIP_W = 1.0e-4f; // これより手前にかかる箱は画面上の大きさを決められない
+}
+
+//--------------
+// ミップの数 (1x1まで)
+//--------------
+unsigned int texture_streaming::CountMips(uint32_t width, uint32_t height)
+{
+    uint32_t size = std::max(width, height);
+    unsigned int count = 1u;
+    while (size > 1u && count < MAX_MIP_LEVELS)
+    {
+        size >>= 1u;
+        ++count;
+    }
+    return count;
+}
+
+//--------------
+// 画面上の大きさ (画素) から必要な一番細かいミップを求める
+// UVがテクスチャ1枚を描画の大きさに貼る前提 (テクセルと画素が1:1になるミップ)
+//--------------
+unsigned int texture_streaming::CalcRequiredMip(uint32_t width, uint32_t height, unsigned int mipCount, float screenSize)
+{
+    if (mipCount == 0u || screenSize >= FULL_SCREEN_SIZE)
+    {
+        return 0u;
+    }
+    float texels = static_cast<float>(std::max(width, height));
+    if (screenSize <= 1.0f)
+    {
+        return mipCount - 1u;
+    }
+    float ratio = texels / screenSize;
+    if (ratio <= 1.0f)
+    {
+        return 0u;
+    }
+    unsigned int mip = static_cast<unsigned int>(std::floor(std::log2(ratio)));
+    return std::min(mip, mipCount - 1u);
+}
+
+//--------------
+// ローカルの境界ボックスが画面に映る大きさ (画素 縦横の大きい方)
+// カメラの手前にかかるものは分からないので一番大きい値にする
+//--------------
+float texture_streaming::CalcScreenSize(const AABB& localBounds, const Matrix& worldViewProj, const Vector2& viewportSize)
+{
+    if (!localBounds.isValid())
+    {
+        return FULL_SCREEN_SIZE;
+    }
+
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (unsigned int corner = 0; corner < 8u; ++corner)
+    {
+        float x = (corner & 1u) ? localBounds.max.x : localBounds.min.x;
+        float y = (corner & 2u) ? localBounds.max.y : localBounds.min.y;
+        float z = (corner & 4u) ? localBounds.max.z : localBounds.min.z;
+        const Matrix& m = worldViewProj;
+        float clipW = x * m.m[0][3] + y * m.m[1][3] + z * m.m[2][3] + m.m[3][3];
+        if (clipW <= MIN_CLIP_W)
+        {
+            return FULL_SCREEN_SIZE;
+        }
+        float ndcX = (x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + m.m[3][0]) / clipW;
+        float ndcY = (x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + m.m[3][1]) / clipW;
+        minX = std::min(minX, ndcX); maxX = std::max(maxX, ndcX);
+        minY = std::min(minY, ndcY); maxY = std::max(maxY, ndcY);
+    }
+
+    // NDCは-1~1なので半分にして画素へ
+    return std::max((maxX - minX) * 0.5f * viewportSize.x, (maxY - minY) * 0.5f * viewportSize.y);
+}
+
+//--------------
+// 一番大きく映りそうなインスタンスの番号 (原点の奥行きと行列の拡大率で比べる インスタンシングのミップ要求を1回にする)
+// 原点がカメラの手前にかかるものは一番大きいとみなす
+//--------------
+size_t texture_streaming::FindLargestInstance(std::span<const InstanceData> instances, const Matrix& viewProj)
+{
+    size_t largest = 0u;
+    float largestRatio = -1.0f;
+    for (size_t cnt = 0; cnt < instances.size(); ++cnt)
+    {
+        const Matrix& world = instances[cnt].world;
+        const Matrix& m = viewProj;
+        float clipW = world.m[3][0] * m.m[0][3] + world.m[3][1] * m.m[1][3] + world.m[3][2] * m.m[2][3] + m.m[3][3];
+        if (clipW <= MIN_CLIP_W)
+        {
+            return cnt;
+        }
+
+        // 一番大きい軸の拡大率の2乗 / 奥行きの2乗 (画面上の大きさの2乗に比例する)
+        float scaleSq = 0.0f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            scaleSq = std::max(scaleSq, world.m[axis][0] * world.m[axis][0] + world.m[axis][1] * world.m[axis][1] + world.m[axis][2] * world.m[axis][2]);
+        }
+        float ratio = scaleSq / (clipW * clipW);
+        if (ratio > largestRatio)
+        {
+            largestRatio = ratio;
+            largest = cnt;
+        }
+    }
+    return largest;
+}
+
+//-------------------------------------------
+// テクスチャを登録する (起動時に常駐させる一番細かいミップを返す)
+// mipBytesは一番細かいミップから順のバイト数,maxTopMipは一番細かいミップにできる最大の番号 (圧縮形式の4の倍数の制限など)
+//-------------------------------------------
+unsigned int TextureResidency::registerTexture(uint32_t id, uint32_t width, uint32_t height, std::span<const size_t> mipBytes, unsigned int maxTopMip)
+{
+    if (id >= texture_streaming::MAX_TEXTURES || mipBytes.empty())
+    {
+        return 0u; // 管理しない (全ミップ常駐)
+    }
+    if (m_textures.size() <= id)
+    {
+        m_textures.resize(size_t(id) + 1u);
+    }
+
+    ResidencyState& state = m_textures[id];
+    if (state.mipCount > 0u)
+    {// 登録し直し
+        m_residentBytes -= state.bytesAt(state.residentMip);
+    }
+
+    state = ResidencyState();
+    state.width = width;
+    state.height = height;
+    state.mipCount = static_cast<unsigned int>(std::min<size_t>(mipBytes.size(), texture_streaming::MAX_MIP_LEVELS));
+    state.tailBytes[state.mipCount] = 0u;
+    for (unsigned int mip = state.mipCount; mip > 0u; --mip)
+    {
+        state.tailBytes[mip - 1u] = state.tailBytes[mip] + mipBytes[mip - 1u];
+    }
+
+    // 設定の大きさ以下になる最初のミップ
+    unsigned int startupMip = 0u;
+    while (startupMip + 1u < state.mipCount && std::max(width >> startupMip, height >> startupMip) > m_settings.startupMaxSize)
+    {
+        ++startupMip;
+    }
+    state.startupMip = std::min({ startupMip, maxTopMip, state.mipCount - 1u });
+    state.residentMip = state.startupMip;
+    state.wantedMip = state.startupMip;
+    state.lastUsedFrame = m_frame;
+
+    m_residentBytes += state.bytesAt(state.residentMip);
+    m_requests[id].store(0.0f, std::memory_order_relaxed);
+    return state.startupMip;
+}
+
+//-------------------------------------------
+// 1つ忘れる (以後は要求されても何もしない)
+//-------------------------------------------
+void TextureResidency::unregisterTexture(uint32_t id)
+{
+    if (!isRegistered(id))
+    {
+        return;
+    }
+    ResidencyState& state = m_textures[id];
+    if (state.pendingMip != texture_streaming::NO_MIP)
+    {
+        onResident(id, state.pendingMip, false);
+    }
+    m_residentBytes -= state.bytesAt(state.residentMip);
+    state = ResidencyState();
+    m_requests[id].store(0.0f, std::memory_order_relaxed);
+}
+
+//-------------------------------------------
+// 全部忘れる
+//-------------------------------------------
+void TextureResidency::unregisterAll()
+{
+    for (uint32_t id = 0; id < m_textures.size(); ++id)
+    {
+        m_requests[id].store(0.0f, std::memory_order_relaxed);
+    }
+    m_textures.clear();
+    m_residentBytes = 0u;
+    m_streamedIn = 0u;
+    m_evicted = 0u;
+}
+
+//-------------------------------------------
+// 描画で使われたことを伝える (画面上の大きさの最大を残す 描画スレッドから同時に呼べる)
+//-------------------------------------------
+void TextureResidency::request(uint32_t id, float screenSize)
+{
+    if (id >= texture_streaming::MAX_TEXTURES || !(screenSize > 0.0f))
+    {
+        return;
+    }
+    std::atomic<float>& slot = m_requests[id];
+    float current = slot.load(std::memory_order_relaxed);
+    while (current < screenSize && !slot.compare_exchange_weak(current, screenSize, std::memory_order_relaxed))
+    {
+    }
+}
+
+//-------------------------------------------
+// フレームの要求から常駐を決める (読み込みは足りないミップの多い順,上限を超えるなら今使っていないミップを古い順に捨てる)
+//-------------------------------------------
+void TextureResidency::update(std::vector<TextureResidencyChange>& outChanges)
+{
+    outChanges.clear();
+    ++m_frame;
+    m_streamedIn = 0u;
+    m_evicted = 0u;
+
+    // 要求をミップにする
+    std::vector<uint32_t> loads{};
+    for (uint32_t id = 0; id < m_textures.size(); ++id)
+    {
+        ResidencyState& state = m_textures[id];
+        if (state.mipCount == 0u) continue;
+
+        float screenSize = m_requests[id].exchange(0.0f, std::memory_order_relaxed);
+        if (screenSize > 0.0f)
+        {
+            state.wantedMip = std::min(texture_streaming::CalcRequiredMip(state.width, state.height, state.mipCount, screenSize), state.startupMip);
+            state.lastUsedFrame = m_frame;
+        }
+        else if (m_frame - state.lastUsedFrame >= m_settings.evictFrames)
+        {// しばらく使われていないので起動時のミップだけでよい
+            state.wantedMip = state.startupMip;
+        }
+
+        if (state.lastUsedFrame == m_frame && state.pendingMip == texture_streaming::NO_MIP && state.wantedMip < state.residentMip)
+        {// 読み込むのはこのフレームで使われたものだけ
+            loads.push_back(id);
+        }
+    }
+
+    // しばらく使われていないテクスチャの高いミップは上限に関係なく捨てる
+    evictFor(~size_t(0), texture_streaming::MAX_TEXTURES, false, outChanges);
+
+    // 足りないミップの多い順に読み込む (同じなら小さいIDから)
+    std::sort(loads.begin(), loads.end(), [this](uint32_t a, uint32_t b)
+        {
+            unsigned int lackA = m_textures[a].residentMip - m_textures[a].wantedMip;
+            unsigned int lackB = m_textures[b].residentMip - m_textures[b].wantedMip;
+            if (lackA != lackB) return lackA > lackB;
+            return a < b;
+        });
+    for (uint32_t id : loads)
+    {
+        if (m_streamedIn >= m_settings.maxStreamsPerFrame) break;
+
+        ResidencyState& state = m_textures[id];
+        size_t residentBytes = state.bytesAt(state.residentMip);
+        if (m_residentBytes + state.bytesAt(state.wantedMip) - residentBytes > m_settings.budgetBytes)
+        {// 今使っていない高いミップを捨てて空ける
+            evictFor(m_residentBytes + state.bytesAt(state.wantedMip) - residentBytes - m_settings.budgetBytes, id, true, outChanges);
+        }
+
+        // 入る一番細かいミップまで
+        unsigned int mip = state.wantedMip;
+        while (mip < state.residentMip && m_residentBytes + state.bytesAt(mip) - residentBytes > m_settings.budgetBytes)
+        {
+            ++mip;
+        }
+        if (mip >= state.residentMip) continue;
+
+        outChanges.emplace_back(id, mip);
+        state.pendingMip = mip;
+        m_residentBytes += state.bytesAt(mip) - residentBytes; // 読み込み中から数える
+        ++m_streamedIn;
+    }
+
+    // 上限を下げたときなどに超えている分
+    if (m_residentBytes > m_settings.budgetBytes)
+    {
+        evictFor(m_residentBytes - m_settings.budgetBytes, texture_streaming::MAX_TEXTURES, true, outChanges);
+    }
+}
+
+//-------------------------------------------
+// ミップを捨てる (古く使われたものから)
+// isPressureがfalseならしばらく使われていないものだけ,trueならこのフレームで使われていないものと要求より細かく持っているものも捨てる
+//-------------------------------------------
+bool TextureResidency::evictFor(size_t needBytes, uint32_t keepId, bool isPressure, std::vector<TextureResidencyChange>& outChanges)
+{
+    // 捨てた後の一番細かいミップ (このフレームで使われていなければ起動時のミップまで)
+    auto evictMip = [this](const ResidencyState& state) { return (state.lastUsedFrame < m_frame) ? state.startupMip : state.wantedMip; };
+
+    std::vector<uint32_t> candidates{};
+    for (uint32_t id = 0; id < m_textures.size(); ++id)
+    {
+        const ResidencyState& state = m_textures[id];
+        if (state.mipCount == 0u || id == keepId || state.pendingMip != texture_streaming::NO_MIP) continue;
+        if (!isPressure && (m_frame - state.lastUsedFrame < m_settings.evictFrames || state.residentMip >= state.wantedMip)) continue;
+        if (isPressure && state.residentMip >= evictMip(state)) continue;
+        candidates.push_back(id);
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+        {
+            if (m_textures[a].lastUsedFrame != m_textures[b].lastUsedFrame) return m_textures[a].lastUsedFrame < m_textures[b].lastUsedFrame;
+            return a < b;
+        });
+
+    size_t freedBytes = 0u;
+    for (uint32_t id : candidates)
+    {
+        if (freedBytes >= needBytes) break;
+
+        ResidencyState& state = m_textures[id];
+        unsigned int mip = isPressure ? evictMip(state) : state.wantedMip;
+        size_t freed = state.bytesAt(state.residentMip) - state.bytesAt(mip);
+        outChanges.emplace_back(id, mip);
+        state.pendingMip = mip;
+        m_residentBytes -= freed; // 捨てるのはすぐ終わるので先に減らす
+        freedBytes += freed;
+        ++m_evicted;
+    }
+    return freedBytes >= needBytes;
+}
+
+//-------------------------------------------
+// 常駐の変更が終わった (失敗したら数え直して元に戻す)
+//-------------------------------------------
+void TextureResidency::onResident(uint32_t id, unsigned int mip, bool isSucceeded)
+{
+    if (!isRegistered(id))
+    {
+        return;
+    }
+    ResidencyState& state = m_textures[id];
+    if (state.pendingMip != mip)
+    {
+        return;
+    }
+    state.pendingMip = texture_streaming::NO_MIP;
+
+    if (isSucceeded)
+    {
+        state.residentMip = mip;
+    }
+    else
+    {
+        m_residentBytes = m_residentBytes + state.bytesAt(state.residentMip) - state.bytesAt(mip);
+    }
+}
+
+//-------------------------------------------
+// 統計
+//-------------------------------------------
+void TextureResidency::getStats(TextureStreamingStats& outStats) const
+{
+    outStats = TextureStreamingStats();
+    outStats.residentBytes = m_residentBytes;
+    outStats.budgetBytes = m_settings.budgetBytes;
+    outStats.streamedIn = m_streamedIn;
+    outStats.evicted = m_evicted;
+    for (const auto& state : m_textures)
+    {
+        if (state.mipCount == 0u) continue;
+        ++outStats.textures;
+        if (state.pendingMip != texture_streaming::NO_MIP)
+        {
+            ++outStats.pending;
+        }
+    }
+}
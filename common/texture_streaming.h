@@ -0,0 +1,94 @@
+//--------------------------------------------
+//
+// テクスチャストリーミング (ミップの常駐管理) [texture_streaming.h]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#pragma once
+#include "graphics_types.h" // TextureStreamingSettings, TextureStreamingStats
+#include <atomic>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace texture_streaming
+{
+    constexpr unsigned int MAX_MIP_LEVELS = 16u;        // 扱うミップの最大数 (32768px)
+    constexpr uint32_t MAX_TEXTURES = 16384u;           // 管理するテクスチャIDの上限 (これ以上のIDは全ミップ常駐)
+    constexpr unsigned int NO_MIP = ~0u;                // 読み込み中でない
+    constexpr float FULL_SCREEN_SIZE = 1.0e30f;         // 画面上の大きさが分からない描画 (UIやカメラをまたぐもの 一番細かいミップを要求する)
+
+    unsigned int CountMips(uint32_t width, uint32_t height);
+    unsigned int CalcRequiredMip(uint32_t width, uint32_t height, unsigned int mipCount, float screenSize);
+    float CalcScreenSize(const AABB& localBounds, const Matrix& worldViewProj, const Vector2& viewportSize);
+    size_t FindLargestInstance(std::span<const InstanceData> instances, const Matrix& viewProj);
+}
+
+// 常駐の変更 (レンダラーがテクスチャを作り直す)
+struct TextureResidencyChange
+{
+    uint32_t id;        // テクスチャID
+    unsigned int mip;   // 新しく一番細かいミップにする番号 (今より小さければ読み込み,大きければ捨てる)
+
+    TextureResidencyChange() : id{}, mip{} {}
+    TextureResidencyChange(uint32_t textureId, unsigned int topMip) : id{ textureId }, mip{ topMip } {}
+    ~TextureResidencyChange() = default;
+};
+
+//----------------------------
+// テクスチャの常駐管理 (描画からの要求を集め,上限の中で読み込むミップと捨てるミップを決める GPUには触らない)
+// requestは描画スレッドから同時に呼べる それ以外は呼び出し側で1つのスレッドにまとめる
+//----------------------------
+class TextureResidency
+{
+public:
+    TextureResidency() : m_settings{}, m_textures{}, m_requests{ std::make_unique<std::atomic<float>[]>(texture_streaming::MAX_TEXTURES) }, m_frame{}, m_residentBytes{}, m_streamedIn{}, m_evicted{} {}
+    ~TextureResidency() = default;
+
+    void setSettings(const TextureStreamingSettings& settings) { m_settings = settings; }
+    const TextureStreamingSettings& getSettings() const { return m_settings; }
+
+    unsigned int registerTexture(uint32_t id, uint32_t width, uint32_t height, std::span<const size_t> mipBytes, unsigned int maxTopMip);
+    void unregisterTexture(uint32_t id);
+    void unregisterAll();
+    bool isRegistered(uint32_t id) const { return id < m_textures.size() && m_textures[id].mipCount > 0u; }
+
+    void request(uint32_t id, float screenSize);
+    void update(std::vector<TextureResidencyChange>& outChanges);
+    void onResident(uint32_t id, unsigned int mip, bool isSucceeded);
+
+    unsigned int getResidentMip(uint32_t id) const { return isRegistered(id) ? m_textures[id].residentMip : texture_streaming::NO_MIP; }
+    unsigned int getWantedMip(uint32_t id) const { return isRegistered(id) ? m_textures[id].wantedMip : texture_streaming::NO_MIP; }
+    size_t getResidentBytes() const { return m_residentBytes; }
+    void getStats(TextureStreamingStats& outStats) const;
+
+private:
+    // 管理しているテクスチャ
+    struct ResidencyState
+    {
+        uint32_t width;                                                   // 一番細かいミップの幅
+        uint32_t height;                                                  // 高さ
+        unsigned int mipCount;                                            // ミップ数 (0なら未登録)
+        std::array<size_t, texture_streaming::MAX_MIP_LEVELS + 1u> tailBytes; // そのミップから一番粗いミップまでのバイト数
+        unsigned int startupMip;                                          // 常に常駐する一番細かいミップ
+        unsigned int residentMip;                                         // 常駐している一番細かいミップ
+        unsigned int pendingMip;                                          // 読み込み中のミップ (NO_MIPならなし)
+        unsigned int wantedMip;                                           // 最後に要求されたミップ
+        uint64_t lastUsedFrame;                                           // 最後に描画で使われたフレーム
+
+        ResidencyState() : width{}, height{}, mipCount{}, tailBytes{}, startupMip{}, residentMip{}, pendingMip{ texture_streaming::NO_MIP }, wantedMip{}, lastUsedFrame{} {}
+        ~ResidencyState() = default;
+
+        size_t bytesAt(unsigned int mip) const { return tailBytes[std::min(mip, mipCount)]; }
+    };
+
+    bool evictFor(size_t needBytes, uint32_t keepId, bool isPressure, std::vector<TextureResidencyChange>& outChanges);
+
+    TextureStreamingSettings m_settings;                       // 設定
+    std::vector<ResidencyState> m_textures;                    // テクスチャIDごとの状態
+    std::unique_ptr<std::atomic<float>[]> m_requests;          // このフレームに描画された画面上の最大の大きさ (描画スレッドから書き込む 0なら未使用)
+    uint64_t m_frame;                                          // updateの回数
+    size_t m_residentBytes;                                    // 常駐しているバイト数 (読み込み中は大きい方)
+    unsigned int m_streamedIn;                                 // 最後のupdateで始めた読み込み数
+    unsigned int m_evicted;                                    // 最後のupdateで捨てた数
+};
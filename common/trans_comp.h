@@ -14,12 +14,14 @@
 class TransformComponent : public Component
 {
 public:
-    TransformComponent(const Transform& transform) : m_transform(transform) {}
+    TransformComponent(const Transform& transform) : m_transform(transform), m_version{} {}
     virtual ~TransformComponent() = default;
 
-    void set(const Transform& transform) { m_transform = transform; }
+    void set(const Transform& transform) { m_transform = transform; ++m_version; }
     Transform get() const { return m_transform; }
+    uint32_t getVersion() const { return m_version; } // 変更回数 (前のフレームと比べて変わったかを調べる)
 
 private:
     Transform m_transform; // オブジェクトの位置、回転、スケールを表すTransform
+    uint32_t m_version;    // setされた回数
 };
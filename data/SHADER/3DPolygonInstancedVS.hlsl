@@ -0,0 +1,49 @@
+// 3DPolygonInstancedVS.hlsl
+#include "Common.hlsli"
+
+// 入力頂点データ: C++の Vertex3D 構造体 (スロット0) と InstanceData 構造体 (スロット1) と対応させる
+struct VS_INPUT
+{
+    float3 Pos : POSITION;
+    float3 Normal : NORMAL;
+    float4 Color : COLOR;
+    float2 UV : TEXCOORD0;
+
+    // インスタンスごとのデータ
+    float4 World0 : INSTANCE_WORLD0;
+    float4 World1 : INSTANCE_WORLD1;
+    float4 World2 : INSTANCE_WORLD2;
+    float4 World3 : INSTANCE_WORLD3;
+    float4 InstanceColor : INSTANCE_COLOR;
+};
+
+//--------------------------------------------------------------------------------------
+// 頂点シェーダー (Vertex Shader)
+// 座標変換を担当 (ワールド行列は定数バッファではなくインスタンスバッファから取る)
+//--------------------------------------------------------------------------------------
+PS_INPUT VS(VS_INPUT input)
+{
+    PS_INPUT output = (PS_INPUT) 0;
+
+    // 行ごとに組み立てる (row_majorのWorldと同じ並び)
+    float4x4 world = float4x4(input.World0, input.World1, input.World2, input.World3);
+
+    // ワールド変換
+    float4 wPos = mul(float4(input.Pos, 1.0f), world);
+
+    // ワールド座標を渡す
+    output.WorldPos = wPos.xyz;
+
+    // ビュー・プロジェクション変換
+    output.Pos = mul(mul(wPos, View), Proj);
+    
+    // 法線の回転 (平行移動は無視するため w=0 にする)
+    float4 normal = float4(input.Normal, 0.0f);
+    output.Normal = normalize(mul(normal, world).xyz);
+
+    // 色はインスタンスの色をかける
+    output.Color = input.Color * input.InstanceColor;
+    output.UV = input.UV;
+
+    return output;
+}
@@ -20,14 +20,9 @@ struct VS_OUT
 // RT0 (Albedo/Diffuse) だけに書き込むので float4 を返す
 float4 PS(VS_OUT input) : SV_Target0
 {
-    // スクリーンUVを計算 (0.0 ~ 1.0)
-    // ClipSpace(-1~1) を UV(0~1) に変換
-    float2 screenUV = input.ScreenPos.xy / input.ScreenPos.w;
-    screenUV.x = screenUV.x * 0.5f + 0.5f;
-    screenUV.y = screenUV.y * -0.5f + 0.5f;
-
     // そのピクセルのワールド座標を取得
-    float4 worldPosData = gPositionTex.Sample(mySampler, screenUV);
+    // 描画先の画素で読む (動的解像度でビューポートを縮めてもGバッファの同じ画素になる)
+    float4 worldPosData = gPositionTex.Load(int3(input.Pos.xy, 0));
     float3 worldPos = worldPosData.xyz;
 
     // 座標がない場所は描画しない
@@ -1,7 +1,8 @@
 #ifndef __LIGHTING_HLSLI__
 #define __LIGHTING_HLSLI__
 
-#define MAX_LIGHTS 8 // ライト数
+#define MAX_LIGHTS 8 // ライト数 (平行光源)
+#define LIGHT_DEFAULT_RANGE 1000.0f // 点光源の半径を指定しないときの影響半径
 
 // --------------------------------------------------------
 // ライティングモデル定義
@@ -33,15 +34,34 @@ cbuffer LightBuffer : register(b3)
 {
     float4 GlobalAmbient;
     float4 CameraPos;
-    int LightCount;
-    float3 _padding;
+    int LightCount;                 // 平行光源の数
+    int PointLightCount;            // 点光源の数 (クラスターに振り分け済み)
+    float2 _padding;
+    float4 ClusterViewDepthRow;     // ワールド座標からカメラの奥行きを出す (View行列の3列目)
+    float4 ClusterScale;            // xy: 画素→タイル, zw: 奥行き→スライス (対数か線形)
+    int4 ClusterDims;               // xyz: 分割数, w: 1なら奥行きは対数
     LightData Lights[MAX_LIGHTS];
 }
 
-// b4: シャドウ用ライト行列
+// 点光源 (クラスターライト)
+struct PointLightData
+{
+    float4 PositionRange; // xyz:位置, w:影響半径
+    float4 Color;
+};
+StructuredBuffer<PointLightData> gPointLights : register(t6); // 点光源
+StructuredBuffer<uint2> gLightClusters : register(t7);        // クラスターごとのライト番号の範囲 (先頭,数)
+StructuredBuffer<uint> gLightIndices : register(t8);          // ライト番号リスト
+
+// b4: シャドウ用 (カスケードシャドウ)
+#define MAX_SHADOW_CASCADES 4 // 最大カスケード数
 cbuffer ShadowBuffer : register(b4)
 {
-    row_major matrix LightViewProj; // ライト視点の View * Proj
+    row_major matrix CascadeViewProj[MAX_SHADOW_CASCADES]; // カスケードごとのライト視点の View * Proj
+    float4 CascadeSplits;                                  // カスケードの奥 (カメラのビュー空間の奥行き)
+    float4 ViewDepthRow;                                   // ワールド座標からカメラの奥行きを出す (View行列の3列目)
+    int CascadeCount;                                      // カスケード数 (0なら影なし)
+    float3 _shadowPadding;
 }
 
 // b5: Fog
@@ -68,7 +88,69 @@ Texture2D gEmissive : register(t4); // Emissive
 // --------------------------------------------------------
 // ShadowMap テクスチャ (SRV)
 // --------------------------------------------------------
-Texture2D gShadowMap : register(t5); // ShadowMap
+Texture2DArray gShadowMap : register(t5); // ShadowMap (カスケードごとのスライス)
+
+// --------------------------------------------------------
+// 影の計算関数 (カスケードシャドウ)
+// --------------------------------------------------------
+// worldPos: ワールド座標
+// N: 法線 (正規化済み)
+// samp: シャドウマップのサンプラー
+// 戻り値: 影なら0.5, 光が当たっていれば1.0
+// --------------------------------------------------------
+float CalculateShadowFactor(
+    float3 worldPos,
+    float3 N,
+    SamplerState samp
+)
+{
+    // カメラからの奥行きでカスケードを選ぶ (最後のカスケードより奥は影なし)
+    float viewDepth = dot(float4(worldPos, 1.0f), ViewDepthRow);
+    if (CascadeCount <= 0 || viewDepth > CascadeSplits[CascadeCount - 1])
+    {
+        return 1.0f;
+    }
+    int cascade = 0;
+    [unroll]
+    for (int i = 0; i < MAX_SHADOW_CASCADES - 1; ++i)
+    {
+        if (i < CascadeCount - 1 && viewDepth > CascadeSplits[i])
+        {
+            cascade = i + 1;
+        }
+    }
+
+    // ワールド座標をライトのプロジェクション空間へ変換
+    float4 lightSpacePos = mul(float4(worldPos, 1.0f), CascadeViewProj[cascade]);
+    
+    // w除算 (正規化デバイス座標へ: -1.0 ~ 1.0)
+    lightSpacePos.xyz /= lightSpacePos.w;
+
+    // UV座標へ変換 (-1~1 -> 0~1)
+    // X: (-1 -> 0, 1 -> 1)  => *0.5 + 0.5
+    // Y: ( 1 -> 0, -1 -> 1) => *-0.5 + 0.5 (Yは上下反転)
+    float2 shadowUV = lightSpacePos.xy * float2(0.5f, -0.5f) + 0.5f;
+
+    // シャドウマップ範囲内かチェック
+    if (shadowUV.x < 0.0f || shadowUV.x > 1.0f ||
+        shadowUV.y < 0.0f || shadowUV.y > 1.0f)
+    {
+        return 1.0f;
+    }
+
+    // シャドウマップから深度値を取得 (ライトから一番近い距離)
+    float closestDepth = gShadowMap.Sample(samp, float3(shadowUV, cascade)).r;
+
+    // 今のピクセルの深度 (ライトからの距離)
+    float currentDepth = lightSpacePos.z;
+
+    // 今の場所が、一番近い場所より奥にあれば「影」
+    float3 L = normalize(Lights[0].Position.xyz - worldPos);
+    float cosTheta = clamp(dot(N, L), 0.0, 1.0);
+    float bias = 0.005 * tan(acos(cosTheta)); // 角度がきついほどバイアスを増やす
+    bias = clamp(bias, 0.0, 0.01);
+    return (currentDepth - bias > closestDepth) ? 0.5f : 1.0f;
+}
 
 // --------------------------------------------------------
 // Lambert (拡散反射) 計算関数
@@ -179,6 +261,82 @@ void CalculateToon(
     }
 }
 
+// --------------------------------------------------------
+// ライト1つ分を足す (シェーディングモデルごとに計算関数を呼ぶ)
+// --------------------------------------------------------
+void AccumulateLight(
+    int shadingModel,
+    float3 N,
+    float3 L,
+    float3 V,
+    float3 lightColor,
+    float specPower,
+    float specIntensity,
+    float shadowFactor,
+    inout float3 diffuseColor,
+    inout float3 specularColor
+)
+{
+    if (shadingModel == SHADING_MODEL_PHONG)
+    {
+        CalculateBlinnPhong(N, L, V, lightColor, specPower, specIntensity, diffuseColor, specularColor);
+    }
+    else if (shadingModel == SHADING_MODEL_TOON)
+    {
+        // Toonは影の影響を内部で処理するためshadowFactorを渡す
+        CalculateToon(N, L, V, lightColor, specPower, specIntensity, shadowFactor, diffuseColor, specularColor);
+    }
+}
+
+// --------------------------------------------------------
+// ライトを全部足す (平行光源は全部,点光源は画素のクラスターに入っているものだけ)
+// --------------------------------------------------------
+// screenPos: 画素の位置 (SV_Position.xy)
+// --------------------------------------------------------
+void AccumulateLights(
+    int shadingModel,
+    float2 screenPos,
+    float3 worldPos,
+    float3 N,
+    float3 V,
+    float specPower,
+    float specIntensity,
+    float shadowFactor,
+    inout float3 diffuseColor,
+    inout float3 specularColor
+)
+{
+    // 平行光源
+    for (int i = 0; i < LightCount; ++i)
+    {
+        float3 L = normalize(-Lights[i].Direction.xyz);
+        AccumulateLight(shadingModel, N, L, V, Lights[i].Color.rgb, specPower, specIntensity, shadowFactor, diffuseColor, specularColor);
+    }
+
+    if (PointLightCount <= 0)
+    {
+        return;
+    }
+
+    // 画素のクラスター
+    float viewDepth = dot(float4(worldPos, 1.0f), ClusterViewDepthRow);
+    float depthKey = (ClusterDims.w != 0) ? log(max(viewDepth, 1.0e-4f)) : viewDepth;
+    int3 clusterCoord = int3(screenPos * ClusterScale.xy, depthKey * ClusterScale.z + ClusterScale.w);
+    clusterCoord = clamp(clusterCoord, int3(0, 0, 0), ClusterDims.xyz - 1);
+    uint2 range = gLightClusters[(clusterCoord.z * ClusterDims.y + clusterCoord.y) * ClusterDims.x + clusterCoord.x];
+
+    // 点光源
+    for (uint j = 0; j < range.y; ++j)
+    {
+        PointLightData light = gPointLights[gLightIndices[range.x + j]];
+        float3 lightDir = light.PositionRange.xyz - worldPos;
+        float dist = length(lightDir);
+        float3 L = lightDir / max(dist, 1.0e-4f);
+        float attenuation = saturate(1.0f - dist / light.PositionRange.w); // 簡易減衰
+        AccumulateLight(shadingModel, N, L, V, light.Color.rgb * attenuation, specPower, specIntensity, shadowFactor, diffuseColor, specularColor);
+    }
+}
+
 float3 CalculateFog(float3 color,float3 WorldPos)
 {
     // カメラからの距離を計算
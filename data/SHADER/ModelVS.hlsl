@@ -1,9 +1,9 @@
 // ModelVS.hlsl
 #include "Common.hlsli"
 
-#define MAX_BONES 256 // ボーンの最大数
+#define MAX_BONES 256 // 1回の描画で使えるボーンの最大数
 
-// ボーン行列配列
+// ボーン行列配列 (描画単位のパレット 頂点のボーン番号はパレット内の番号 使う分だけ送られる)
 cbuffer BoneBuffer : register(b3)
 {
     row_major matrix BoneTransforms[MAX_BONES];
@@ -2,7 +2,7 @@
 
 float4 PS(VS_OUTPUT input) : SV_Target
 {
-    float4 color = gSceneTexture.Sample(gSampler, input.UV);
+    float4 color = gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, input.UV * UVScale));
     
     // 輝度(明るさ)を計算
     float brightness = dot(color.rgb, float3(0.2126, 0.7152, 0.0722));
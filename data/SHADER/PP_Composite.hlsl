@@ -49,11 +49,14 @@ float3 ACESToneMapping_AnimeStyle(float3 x)
 
 float4 PS(VS_OUTPUT input) : SV_Target
 {
+    // 描いた範囲のUV (シーンもブルームも同じ割合で描いてある)
+    float2 uv = input.UV * UVScale;
+
     // メインシーン (HDR)
-    float3 sceneColor = gSceneTexture.Sample(gSampler, input.UV).rgb;
+    float3 sceneColor = gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, uv)).rgb;
     
     // ブルーム (HDR)
-    float3 bloomColor = gBloomTexture.Sample(gSampler, input.UV).rgb;
+    float3 bloomColor = gBloomTexture.Sample(gSampler, ClampSceneUV(gBloomTexture, uv)).rgb;
     
     // ブルーム強度調整
     sceneColor += bloomColor * bloomIntensity; // 加算合成
@@ -6,20 +6,27 @@ float GetLuma(float3 color)
     return dot(color, float3(0.299, 0.587, 0.114));
 }
 
+// 描いた範囲の中の色 (動的解像度で縮めていれば画面に引き伸ばしながら読む)
+float3 SampleScene(float2 uv)
+{
+    return gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, uv)).rgb;
+}
+
 // ----------------------------------------------------
 // FXAA (Fast Approximate Anti-Aliasing)
 // ----------------------------------------------------
 float4 PS(VS_OUTPUT input) : SV_Target
 {
-    // 1ピクセルのUVサイズ
+    // 1ピクセルのUVサイズ (縮めて描いていても描画先の1画素ずつ見る)
     float2 rcpFrame = ScreenSize.zw;
+    float2 uv = input.UV * UVScale;
 
     // 周囲の輝度を取得 (N=上, S=下, W=左, E=右, M=中心)
-    float3 rgbM = gSceneTexture.Sample(gSampler, input.UV).rgb;
-    float3 rgbN = gSceneTexture.Sample(gSampler, input.UV + float2(0, -1) * rcpFrame).rgb;
-    float3 rgbS = gSceneTexture.Sample(gSampler, input.UV + float2(0, +1) * rcpFrame).rgb;
-    float3 rgbE = gSceneTexture.Sample(gSampler, input.UV + float2(+1, 0) * rcpFrame).rgb;
-    float3 rgbW = gSceneTexture.Sample(gSampler, input.UV + float2(-1, 0) * rcpFrame).rgb;
+    float3 rgbM = SampleScene(uv);
+    float3 rgbN = SampleScene(uv + float2(0, -1) * rcpFrame);
+    float3 rgbS = SampleScene(uv + float2(0, +1) * rcpFrame);
+    float3 rgbE = SampleScene(uv + float2(+1, 0) * rcpFrame);
+    float3 rgbW = SampleScene(uv + float2(-1, 0) * rcpFrame);
 
     float lumaM = GetLuma(rgbM);
     float lumaN = GetLuma(rgbN);
@@ -39,10 +46,10 @@ float4 PS(VS_OUTPUT input) : SV_Target
     }
 
     // さらに広範囲(コーナー)の輝度を取得
-    float3 rgbNW = gSceneTexture.Sample(gSampler, input.UV + float2(-1, -1) * rcpFrame).rgb;
-    float3 rgbNE = gSceneTexture.Sample(gSampler, input.UV + float2(+1, -1) * rcpFrame).rgb;
-    float3 rgbSW = gSceneTexture.Sample(gSampler, input.UV + float2(-1, +1) * rcpFrame).rgb;
-    float3 rgbSE = gSceneTexture.Sample(gSampler, input.UV + float2(+1, +1) * rcpFrame).rgb;
+    float3 rgbNW = SampleScene(uv + float2(-1, -1) * rcpFrame);
+    float3 rgbNE = SampleScene(uv + float2(+1, -1) * rcpFrame);
+    float3 rgbSW = SampleScene(uv + float2(-1, +1) * rcpFrame);
+    float3 rgbSE = SampleScene(uv + float2(+1, +1) * rcpFrame);
 
     float lumaNW = GetLuma(rgbNW);
     float lumaNE = GetLuma(rgbNE);
@@ -86,12 +93,12 @@ float4 PS(VS_OUTPUT input) : SV_Target
     
     // 2回サンプリングしてブレンド
     float3 rgbA = 0.5 * (
-        gSceneTexture.Sample(gSampler, input.UV + dir * (1.0 / 3.0 - 0.5)).rgb +
-        gSceneTexture.Sample(gSampler, input.UV + dir * (2.0 / 3.0 - 0.5)).rgb);
+        SampleScene(uv + dir * (1.0 / 3.0 - 0.5)) +
+        SampleScene(uv + dir * (2.0 / 3.0 - 0.5)));
         
     float3 rgbB = rgbA * 0.5 + 0.25 * (
-        gSceneTexture.Sample(gSampler, input.UV + dir * -0.5).rgb +
-        gSceneTexture.Sample(gSampler, input.UV + dir * 0.5).rgb);
+        SampleScene(uv + dir * -0.5) +
+        SampleScene(uv + dir * 0.5));
         
     float lumaB = GetLuma(rgbB);
     
@@ -5,15 +5,16 @@ static const float Weights[5] = { 0.227027, 0.1945946, 0.1216216, 0.054054, 0.01
 
 float4 PS(VS_OUTPUT input) : SV_Target
 {
-    // 方向 * 1ピクセル幅 = UVのずらす量 (ブルームは1/4サイズ *4.0倍する)
-    float2 offset = BlurDir * ScreenSize.zw * 4.0f;
+    // 方向 * 1ピクセル幅 = UVのずらす量 (ブルームは1/4サイズ *4.0倍する 縮めて描いた時も画面上の幅が変わらないよう割合をかける)
+    float2 offset = BlurDir * ScreenSize.zw * 4.0f * UVScale;
+    float2 uv = input.UV * UVScale;
 
-    float3 result = gSceneTexture.Sample(gSampler, input.UV).rgb * Weights[0];
+    float3 result = gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, uv)).rgb * Weights[0];
 
     for (int i = 1; i < 5; ++i)
     {
-        result += gSceneTexture.Sample(gSampler, input.UV + offset * i).rgb * Weights[i];
-        result += gSceneTexture.Sample(gSampler, input.UV - offset * i).rgb * Weights[i];
+        result += gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, uv + offset * i)).rgb * Weights[i];
+        result += gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, uv - offset * i)).rgb * Weights[i];
     }
 
     return float4(result, 1.0f);
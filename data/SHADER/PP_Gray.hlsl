@@ -2,7 +2,7 @@
 
 float4 PS(VS_OUTPUT input) : SV_Target
 {
-    float3 col = gSceneTexture.Sample(gSampler, input.UV);
+    float3 col = gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, input.UV * UVScale));
 
     float gray = dot(col, float3(0.2126, 0.7152, 0.0722));
 
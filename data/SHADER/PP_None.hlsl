@@ -2,5 +2,5 @@
 
 float4 PS(VS_OUTPUT input) : SV_Target
 {
-    return gSceneTexture.Sample(gSampler, input.UV);
+    return gSceneTexture.Sample(gSampler, ClampSceneUV(gSceneTexture, input.UV * UVScale));
 }
@@ -18,5 +18,14 @@ cbuffer PostProcessBuffer : register(b0)
     float bloomThreshold; // ブルームで抽出する明るさの閾値
     float bloomIntensity; // ブルーム強度
     int toneMappingType;  // トーンマッピングの種類
-    float padding[3];
+    float padding;
+    float2 UVScale;       // 3Dを描いた範囲 (動的解像度で縮めた割合 描画先はどれも左上のこの範囲だけ描いてある)
+}
+
+// 描いた範囲の外を読まないUV (バイリニアで外の画素が混ざらないよう半テクセル内側で止める)
+float2 ClampSceneUV(Texture2D tex, float2 uv)
+{
+    float2 size;
+    tex.GetDimensions(size.x, size.y);
+    return min(uv, UVScale - 0.5f / size);
 }
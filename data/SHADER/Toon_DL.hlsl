@@ -30,45 +30,8 @@ float4 PS(VS_OUTPUT input) : SV_Target
     // ライティング計算
     if (LightFlag > 0.5f)
     {
-        //--------------------
-        // 影の計算
-        //--------------------
-        float shadowFactor = 1.0f;
-        
-        // ワールド座標をライトのプロジェクション空間へ変換
-        float4 lightSpacePos = mul(float4(WorldPos, 1.0f), LightViewProj);
-        
-        // w除算 (正規化デバイス座標へ: -1.0 ~ 1.0)
-        lightSpacePos.xyz /= lightSpacePos.w;
-
-        // UV座標へ変換 (-1~1 -> 0~1)
-        // X: (-1 -> 0, 1 -> 1)  => *0.5 + 0.5
-        // Y: ( 1 -> 0, -1 -> 1) => *-0.5 + 0.5 (Yは上下反転)
-        float2 shadowUV = lightSpacePos.xy * float2(0.5f, -0.5f) + 0.5f;
-
-        // シャドウマップ範囲内かチェック
-        if (shadowUV.x >= 0.0f && shadowUV.x <= 1.0f &&
-            shadowUV.y >= 0.0f && shadowUV.y <= 1.0f)
-        {
-            // シャドウマップから深度値を取得 (ライトから一番近い距離)
-            float closestDepth = gShadowMap.Sample(gSampler, shadowUV).r;
-
-            // 今のピクセルの深度 (ライトからの距離)
-            float currentDepth = lightSpacePos.z;
-
-            // 今の場所が、一番近い場所より奥にあれば「影」
-            float3 L = normalize(Lights[0].Position.xyz - WorldPos);
-            float cosTheta = clamp(dot(Normal, L), 0.0, 1.0);
-            float bias = 0.005 * tan(acos(cosTheta)); // 角度がきついほどバイアスを増やす
-            bias = clamp(bias, 0.0, 0.01);
-            if (currentDepth - bias > closestDepth)
-            {
-                shadowFactor = 0.5f;
-            }
-        }
-        //--------------------
-        // 影の計算 End
-        //--------------------
+        // 影の計算 (カスケードシャドウ)
+        float shadowFactor = CalculateShadowFactor(WorldPos, Normal, gSampler);
         
         float3 totalDiffuse = float3(0, 0, 0);
         float3 totalSpecular = float3(0, 0, 0);
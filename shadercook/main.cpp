@@ -0,0 +1,66 @@
+//--------------------------------------------
+//
+// シェーダークッカー (data/SHADER以下のシェーダーを前もってコンパイルしてキャッシュに残す) [main.cpp]
+// Author: Fuma Sato
+//
+// shadercook [フォルダ=data/SHADER] [--threads N] [--prune]
+//
+//--------------------------------------------
+#include "shader_cache.h"
+#include "shader_compiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+//----------------------------
+// エントリーポイント
+//----------------------------
+int main(int argc, char* argv[])
+{
+    std::filesystem::path directory = u8"data/SHADER";
+    bool isPrune = false;
+    unsigned int maxThread = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int cnt = 1; cnt < argc; ++cnt)
+    {
+        std::string arg = argv[cnt];
+        if (arg == "--prune")
+        {
+            isPrune = true;
+        }
+        else if (arg == "--threads" && cnt + 1 < argc)
+        {
+            maxThread = static_cast<unsigned int>(std::max(1, std::atoi(argv[++cnt])));
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            std::cout << "shadercook [dir=data/SHADER] [--threads N] [--prune]\n";
+            return 0;
+        }
+        else
+        {
+            directory = arg;
+        }
+    }
+
+    // レンダラーと同じ一覧,同じキーで残す (起動時はキャッシュから読むだけになる)
+    std::vector<ShaderCompileRequest> requests = shader_cache::MakeProgramRequests(directory);
+    ShaderCache cache(directory / shader_cache::CACHE_DIRECTORY_NAME, shader_compiler::CompileFromFile);
+    std::vector<std::vector<uint8_t>> bytecodes{};
+    cache.load(requests, maxThread, bytecodes, [](std::string_view message)
+        {
+            std::cout << message << '\n';
+        });
+
+    ShaderCacheStats stats{};
+    cache.getStats(stats);
+    std::cout << "compiled " << stats.compiled << ", hits " << stats.hits << ", failed " << stats.failed << '\n';
+
+    if (isPrune)
+    {
+        std::cout << "pruned " << cache.prune(requests) << '\n';
+    }
+    return stats.failed > 0u ? 1 : 0;
+}
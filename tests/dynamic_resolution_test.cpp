@@ -0,0 +1,220 @@
+//--------------------------------------------
+//
+// 動的解像度のテスト (記録したフレーム時間での割合の動き) [dynamic_resolution_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "dynamic_resolution.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    constexpr float TARGET_MS = 15.0f; // 目標のフレーム時間
+
+    //--------------
+    // 使う設定 (既定は使わないので有効にする)
+    //--------------
+    DynamicResolutionSettings MakeSettings()
+    {
+        DynamicResolutionSettings settings{};
+        settings.isEnabled = true;
+        settings.targetFrameMs = TARGET_MS;
+        return settings;
+    }
+
+    //--------------
+    // 割合が変わった回数
+    //--------------
+    size_t CountChanges(const std::vector<float>& scales, size_t first)
+    {
+        size_t changes = 0u;
+        for (size_t cnt = std::max<size_t>(first, 1u); cnt < scales.size(); ++cnt)
+        {
+            if (scales[cnt] != scales[cnt - 1u]) ++changes;
+        }
+        return changes;
+    }
+}
+
+//--------------
+// 既定では使わず,いつも等倍
+//--------------
+TEST(DynamicResolutionTest, DisabledByDefault)
+{
+    EXPECT_FALSE(DynamicResolutionSettings().isEnabled);
+
+    const std::vector<float> frameTimes(60u, 40.0f);
+    std::vector<float> scales{};
+    dynamic_resolution::Replay(DynamicResolutionSettings(), frameTimes, scales);
+    ASSERT_EQ(scales.size(), frameTimes.size());
+    for (float scale : scales)
+    {
+        EXPECT_EQ(scale, 1.0f);
+    }
+}
+
+//--------------
+// 重いフレームが続くと下がり続けて下限で止まる,軽ければ上限のまま
+//--------------
+TEST(DynamicResolutionTest, ReplayMovesTowardTarget)
+{
+    DynamicResolutionSettings settings = MakeSettings();
+    std::vector<float> scales{};
+
+    dynamic_resolution::Replay(settings, std::vector<float>(300u, TARGET_MS * 2.0f), scales);
+    for (size_t cnt = 1; cnt < scales.size(); ++cnt)
+    {
+        EXPECT_LE(scales[cnt], scales[cnt - 1u]);
+    }
+    EXPECT_LT(scales[10], settings.maxScale);
+    EXPECT_EQ(scales.back(), settings.minScale);
+
+    dynamic_resolution::Replay(settings, std::vector<float>(300u, TARGET_MS * 0.5f), scales);
+    for (float scale : scales)
+    {
+        EXPECT_EQ(scale, settings.maxScale);
+    }
+}
+
+//--------------
+// 画素数に比例する重さなら目標のフレーム時間に落ち着く (前のフレームの割合で次の時間が決まる)
+//--------------
+TEST(DynamicResolutionTest, ClosedLoopConverges)
+{
+    constexpr float FULL_FRAME_MS = 24.0f; // 等倍で描いた時のフレーム時間
+    DynamicResolution controller{};
+    controller.setSettings(MakeSettings());
+
+    float scale = controller.getScale();
+    std::vector<float> scales{};
+    for (int frame = 0; frame < 600; ++frame)
+    {
+        scale = controller.update(FULL_FRAME_MS * scale * scale);
+        scales.push_back(scale);
+    }
+
+    // sqrt(15/24)を挟む2つの刻みの間でゆっくり行き来する (刻みの間に目標があるので積分が少しずつ超える)
+    const float settled = std::sqrt(TARGET_MS / FULL_FRAME_MS);
+    const float step = controller.getSettings().scaleStep;
+    size_t run = 0u, shortestRun = scales.size();
+    bool isFirstRun = true; // 400フレーム目から始まる最初の続きは途中からなので数えない
+    for (size_t cnt = 400u; cnt < scales.size(); ++cnt)
+    {
+        EXPECT_NEAR(scales[cnt], settled, step);
+        EXPECT_NEAR(FULL_FRAME_MS * scales[cnt] * scales[cnt], TARGET_MS, TARGET_MS * 0.05f);
+        if (scales[cnt] != scales[cnt - 1u])
+        {
+            if (!isFirstRun) shortestRun = std::min(shortestRun, run);
+            isFirstRun = false;
+            run = 0u;
+        }
+        ++run;
+    }
+    EXPECT_GE(shortestRun, 10u); // 毎フレーム行き来しない
+}
+
+//--------------
+// 目標のまわりで揺れるフレーム時間では刻みの間を行き来しない
+//--------------
+TEST(DynamicResolutionTest, HysteresisHoldsScaleAroundTarget)
+{
+    DynamicResolutionSettings settings = MakeSettings();
+
+    // 落ち着くまでは重く,その後は目標の±3%で揺らす
+    std::vector<float> frameTimes(120u, TARGET_MS * 1.3f);
+    for (int frame = 0; frame < 400; ++frame)
+    {
+        frameTimes.push_back(TARGET_MS * ((frame % 2 == 0) ? 1.03f : 0.97f));
+    }
+
+    std::vector<float> scales{};
+    dynamic_resolution::Replay(settings, frameTimes, scales);
+    EXPECT_LE(CountChanges(scales, 200u), 1u);
+
+    // 割合はいつも刻みの上
+    for (float scale : scales)
+    {
+        float steps = scale / settings.scaleStep;
+        EXPECT_NEAR(steps, std::round(steps), 1.0e-3f);
+    }
+}
+
+//--------------
+// 割合は設定の範囲に収まり,範囲の外の設定は直す
+//--------------
+TEST(DynamicResolutionTest, ScaleIsClampedToSettings)
+{
+    DynamicResolutionSettings settings = MakeSettings();
+    settings.minScale = 0.6f;
+    settings.maxScale = 0.9f;
+
+    std::vector<float> frameTimes(200u, TARGET_MS * 4.0f);
+    frameTimes.resize(600u, TARGET_MS * 0.25f);
+    std::vector<float> scales{};
+    dynamic_resolution::Replay(settings, frameTimes, scales);
+    for (float scale : scales)
+    {
+        EXPECT_GE(scale, settings.minScale);
+        EXPECT_LE(scale, settings.maxScale);
+    }
+    EXPECT_EQ(scales[199], settings.minScale);
+    EXPECT_EQ(scales.back(), settings.maxScale);
+
+    // 上限は1,下限はMIN_SCALE_LIMITまで
+    settings.minScale = 0.0f;
+    settings.maxScale = 2.0f;
+    DynamicResolution controller{};
+    controller.setSettings(settings);
+    EXPECT_EQ(controller.getSettings().maxScale, 1.0f);
+    EXPECT_EQ(controller.getSettings().minScale, dynamic_resolution::MIN_SCALE_LIMIT);
+    for (int frame = 0; frame < 600; ++frame)
+    {
+        controller.update(TARGET_MS * 10.0f);
+    }
+    EXPECT_EQ(controller.getScale(), dynamic_resolution::MIN_SCALE_LIMIT);
+}
+
+//--------------
+// 測れなかったフレーム (0以下,NaN,無限) は今の割合のまま,その後も測れたフレームだけで決まる
+//--------------
+TEST(DynamicResolutionTest, UnmeasuredFramesAreIgnored)
+{
+    DynamicResolutionSettings settings = MakeSettings();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+
+    std::vector<float> measured{};
+    for (int frame = 0; frame < 120; ++frame)
+    {
+        measured.push_back(TARGET_MS * (1.5f + 0.1f * float(frame % 3)));
+    }
+
+    // 測れたフレームの間に測れなかったフレームを挟む
+    std::vector<float> withGaps{ 0.0f };
+    for (size_t cnt = 0; cnt < measured.size(); ++cnt)
+    {
+        withGaps.push_back(measured[cnt]);
+        switch (cnt % 4u)
+        {
+        case 0u: withGaps.push_back(0.0f); break;
+        case 1u: withGaps.push_back(-1.0f); break;
+        case 2u: withGaps.push_back(nan); break;
+        default: withGaps.push_back(inf); break;
+        }
+    }
+
+    std::vector<float> expected{}, scales{};
+    dynamic_resolution::Replay(settings, measured, expected);
+    dynamic_resolution::Replay(settings, withGaps, scales);
+    ASSERT_EQ(scales.size(), measured.size() * 2u + 1u);
+
+    // 最初のフレームが測れなくても上限から
+    EXPECT_EQ(scales[0], settings.maxScale);
+    for (size_t cnt = 0; cnt < measured.size(); ++cnt)
+    {
+        EXPECT_EQ(scales[cnt * 2u + 1u], expected[cnt]);
+        EXPECT_EQ(scales[cnt * 2u + 2u], expected[cnt]);
+    }
+}
@@ -0,0 +1,298 @@
+//--------------------------------------------
+//
+// クラスターライトのテスト (境界をまたぐ点光源,奥行きの外,一杯のクラスター,スレッド分け) [light_cluster_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "light_cluster.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <random>
+
+namespace
+{
+    constexpr float NEAR_Z = 0.1f;   // 射影の手前
+    constexpr float FAR_Z = 100.0f;  // 射影の奥
+    constexpr float ASPECT = 16.0f / 9.0f;
+    constexpr float TAN_HALF_FOV = 1.0f; // 縦の画角は90度
+
+    //--------------
+    // 原点から+zを見る透視射影
+    //--------------
+    Matrix MakePerspective()
+    {
+        return Matrix::PerspectiveFovLH(std::numbers::pi_v<float> * 0.5f, ASPECT, NEAR_Z, FAR_Z);
+    }
+
+    //--------------
+    // 点光源
+    //--------------
+    LightData MakeLight(const Vector3& position, float range)
+    {
+        return LightData(Vector4(position, 1.0f), Vector4(0.0f, -1.0f, 0.0f, range), Color(1.0f, 1.0f, 1.0f, 1.0f));
+    }
+
+    //--------------
+    // 透視射影のタイルの境界 (NDC) と奥行きからビュー空間の位置
+    //--------------
+    Vector3 PerspectivePosition(float ndcX, float ndcY, float depth)
+    {
+        return Vector3(ndcX * TAN_HALF_FOV * ASPECT * depth, ndcY * TAN_HALF_FOV * depth, depth);
+    }
+
+    //--------------
+    // タイルの中心のNDC
+    //--------------
+    float TileCenterX(unsigned int x) { return -1.0f + (2.0f * float(x) + 1.0f) / float(cluster::COUNT_X); }
+    float TileCenterY(unsigned int y) { return 1.0f - (2.0f * float(y) + 1.0f) / float(cluster::COUNT_Y); }
+
+    //--------------
+    // 透視射影のスライスの手前の奥行き (対数で分ける)
+    //--------------
+    float SliceDepth(unsigned int slice)
+    {
+        return NEAR_Z * std::pow(FAR_Z / NEAR_Z, float(slice) / float(cluster::COUNT_Z));
+    }
+
+    //--------------
+    // 透視射影の奥行きのスライス
+    //--------------
+    unsigned int SliceOf(float depth)
+    {
+        return static_cast<unsigned int>(std::log(depth / NEAR_Z) / std::log(FAR_Z / NEAR_Z) * float(cluster::COUNT_Z));
+    }
+
+    //--------------
+    // クラスターに点光源が入っているか
+    //--------------
+    bool HasLight(const LightClusterGrid& grid, unsigned int x, unsigned int y, unsigned int z, uint32_t light)
+    {
+        std::span<const uint32_t> indices{};
+        grid.getClusterLights(x, y, z, indices);
+        return std::find(indices.begin(), indices.end(), light) != indices.end();
+    }
+
+    //--------------
+    // 点光源が入っているクラスターの数
+    //--------------
+    size_t CountClusters(const LightClusterGrid& grid, uint32_t light)
+    {
+        return size_t(std::count(grid.getLightIndices().begin(), grid.getLightIndices().end(), light));
+    }
+}
+
+//--------------
+// 球と箱は表面で触れても触れていることにし,角は3軸の距離で判定する
+//--------------
+TEST(LightClusterTest, SphereInBoxUsesDistanceToBox)
+{
+    const Vector3 boxCenter(0.0f, 0.0f, 0.0f), boxExtent(1.0f, 2.0f, 3.0f);
+    EXPECT_TRUE(cluster::IsSphereInBox(Vector3(0.5f, 0.5f, 0.5f), 0.1f, boxCenter, boxExtent));
+    EXPECT_TRUE(cluster::IsSphereInBox(Vector3(2.0f, 0.0f, 0.0f), 1.0f, boxCenter, boxExtent));
+    EXPECT_FALSE(cluster::IsSphereInBox(Vector3(2.0f, 0.0f, 0.0f), 0.99f, boxCenter, boxExtent));
+    EXPECT_TRUE(cluster::IsSphereInBox(Vector3(0.0f, -4.0f, 0.0f), 2.0f, boxCenter, boxExtent));
+    EXPECT_FALSE(cluster::IsSphereInBox(Vector3(0.0f, 0.0f, -5.0f), 1.9f, boxCenter, boxExtent));
+
+    // 角の外 (各軸1ずつ離れている) は半径sqrt(3)で届く
+    const Vector3 corner(2.0f, 3.0f, 4.0f);
+    EXPECT_FALSE(cluster::IsSphereInBox(corner, 1.7f, boxCenter, boxExtent));
+    EXPECT_TRUE(cluster::IsSphereInBox(corner, 1.74f, boxCenter, boxExtent));
+}
+
+//--------------
+// タイルの境界にある点光源は両側のタイルに入る
+//--------------
+TEST(LightClusterTest, LightOnTileBorderIsInBothTiles)
+{
+    const float depth = 12.0f;
+    const unsigned int slice = SliceOf(depth);
+    const std::vector<LightData> lights{
+        MakeLight(PerspectivePosition(0.0f, TileCenterY(4u), depth), 0.05f),                               // 縦の境界 (x 7と8)
+        MakeLight(PerspectivePosition(TileCenterX(3u), 1.0f - 2.0f / float(cluster::COUNT_Y), depth), 0.05f) // 横の境界 (y 0と1)
+    };
+
+    LightClusterGrid grid{};
+    ASSERT_TRUE(grid.build(Matrix(), MakePerspective(), lights, 1u));
+    EXPECT_TRUE(grid.validate());
+
+    EXPECT_TRUE(HasLight(grid, 7u, 4u, slice, 0u));
+    EXPECT_TRUE(HasLight(grid, 8u, 4u, slice, 0u));
+    EXPECT_FALSE(HasLight(grid, 6u, 4u, slice, 0u));
+    EXPECT_FALSE(HasLight(grid, 9u, 4u, slice, 0u));
+
+    EXPECT_TRUE(HasLight(grid, 3u, 0u, slice, 1u));
+    EXPECT_TRUE(HasLight(grid, 3u, 1u, slice, 1u));
+    EXPECT_FALSE(HasLight(grid, 3u, 2u, slice, 1u));
+
+    // 透視のクラスターの箱は視錐台の区間を包むので隣の列にはみ出すが,2つ先には届かない
+    EXPECT_FALSE(HasLight(grid, 1u, 0u, slice, 1u));
+}
+
+//--------------
+// スライスの境界にある点光源は両側のスライスに入る
+//--------------
+TEST(LightClusterTest, LightOnSliceBorderIsInBothSlices)
+{
+    constexpr unsigned int SLICE = 12u;
+    const std::vector<LightData> lights{ MakeLight(PerspectivePosition(TileCenterX(5u), TileCenterY(5u), SliceDepth(SLICE)), 0.01f) };
+
+    LightClusterGrid grid{};
+    ASSERT_TRUE(grid.build(Matrix(), MakePerspective(), lights, 1u));
+    EXPECT_TRUE(grid.validate());
+
+    EXPECT_TRUE(HasLight(grid, 5u, 5u, SLICE - 1u, 0u));
+    EXPECT_TRUE(HasLight(grid, 5u, 5u, SLICE, 0u));
+    EXPECT_FALSE(HasLight(grid, 5u, 5u, SLICE - 2u, 0u));
+    EXPECT_FALSE(HasLight(grid, 5u, 5u, SLICE + 1u, 0u));
+    EXPECT_EQ(CountClusters(grid, 0u), 4u); // 箱が視錐台の区間を包む分だけ左右の列にもはみ出す
+}
+
+//--------------
+// 手前より前,奥より先の点光源はどこにも入らず,またぐものは端のスライスに入る
+//--------------
+TEST(LightClusterTest, LightsOutsideDepthRangeAreSkipped)
+{
+    const std::vector<LightData> lights{
+        MakeLight(Vector3(0.0f, 0.0f, -1.0f), 0.5f),                                       // カメラの後ろ
+        MakeLight(Vector3(0.0f, 0.0f, FAR_Z + 10.0f), 5.0f),                               // 奥より先
+        MakeLight(PerspectivePosition(TileCenterX(2u), TileCenterY(2u), NEAR_Z), 0.05f),   // 手前の面をまたぐ
+        MakeLight(PerspectivePosition(TileCenterX(2u), TileCenterY(2u), FAR_Z + 1.0f), 2.0f) // 奥の面をまたぐ
+    };
+
+    LightClusterGrid grid{};
+    ASSERT_TRUE(grid.build(Matrix(), MakePerspective(), lights, 1u));
+    EXPECT_TRUE(grid.validate());
+    EXPECT_EQ(grid.getPointLights().size(), lights.size());
+
+    EXPECT_EQ(CountClusters(grid, 0u), 0u);
+    EXPECT_EQ(CountClusters(grid, 1u), 0u);
+    EXPECT_TRUE(HasLight(grid, 2u, 2u, 0u, 2u));
+    EXPECT_TRUE(HasLight(grid, 2u, 2u, cluster::COUNT_Z - 1u, 3u));
+    EXPECT_FALSE(HasLight(grid, 2u, 2u, cluster::COUNT_Z - 2u, 3u));
+}
+
+//--------------
+// 1つのクラスターに入る数は上限までで,先に並んでいる点光源を残す
+//--------------
+TEST(LightClusterTest, FullClusterKeepsFirstLights)
+{
+    const Vector3 position = PerspectivePosition(TileCenterX(10u), TileCenterY(6u), 20.0f);
+    const std::vector<LightData> lights(cluster::MAX_LIGHTS_PER_CLUSTER + 40u, MakeLight(position, 0.01f));
+
+    LightClusterGrid grid{};
+    ASSERT_TRUE(grid.build(Matrix(), MakePerspective(), lights, 4u));
+    EXPECT_TRUE(grid.validate());
+
+    const unsigned int slice = SliceOf(20.0f);
+    std::span<const uint32_t> indices{};
+    grid.getClusterLights(10u, 6u, slice, indices);
+    ASSERT_EQ(indices.size(), cluster::MAX_LIGHTS_PER_CLUSTER);
+    for (uint32_t cnt = 0; cnt < indices.size(); ++cnt)
+    {
+        EXPECT_EQ(indices[cnt], cnt);
+    }
+    EXPECT_FALSE(HasLight(grid, 10u, 6u, slice, cluster::MAX_LIGHTS_PER_CLUSTER));
+
+    // 範囲の外のクラスターは空
+    grid.getClusterLights(cluster::COUNT_X, 0u, 0u, indices);
+    EXPECT_TRUE(indices.empty());
+    grid.getClusterLights(0u, 0u, cluster::COUNT_Z, indices);
+    EXPECT_TRUE(indices.empty());
+}
+
+//--------------
+// スレッドに分けた振り分けは1スレッドと全探索に一致し,中心のクラスターには必ず入る
+//--------------
+TEST(LightClusterTest, ParallelBuildMatchesBruteForce)
+{
+    const Matrix view = Matrix::LookAtLH(Vector3(3.0f, 5.0f, -20.0f), Vector3(0.0f, 0.0f, 10.0f), Vector3(0.0f, 1.0f, 0.0f));
+    std::mt19937 random(7u);
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f), range(0.2f, 6.0f);
+    std::vector<LightData> lights{};
+    for (size_t cnt = 0; cnt < cluster::MIN_PARALLEL_LIGHTS * 8u; ++cnt)
+    {
+        lights.push_back(MakeLight(Vector3(position(random), position(random) * 0.3f, position(random) + 40.0f), range(random)));
+    }
+
+    LightClusterGrid parallel{}, single{};
+    ASSERT_TRUE(parallel.build(view, MakePerspective(), lights, 8u));
+    ASSERT_TRUE(single.build(view, MakePerspective(), lights, 1u));
+    EXPECT_TRUE(parallel.validate());
+    EXPECT_TRUE(single.validate());
+    EXPECT_TRUE(std::equal(parallel.getLightIndices().begin(), parallel.getLightIndices().end(), single.getLightIndices().begin(), single.getLightIndices().end()));
+    ASSERT_EQ(parallel.getClusters().size(), single.getClusters().size());
+    for (size_t cnt = 0; cnt < parallel.getClusters().size(); ++cnt)
+    {
+        EXPECT_EQ(parallel.getClusters()[cnt].offset, single.getClusters()[cnt].offset);
+        EXPECT_EQ(parallel.getClusters()[cnt].count, single.getClusters()[cnt].count);
+    }
+
+    // 画面に中心が映る点光源は中心の画素のクラスターに入る (射影とスライスの式から直接求める)
+    const Matrix viewProj = view * MakePerspective();
+    size_t checked = 0u;
+    for (uint32_t cnt = 0; cnt < lights.size(); ++cnt)
+    {
+        Vector3 viewPos(lights[cnt].position.x, lights[cnt].position.y, lights[cnt].position.z), ndc = viewPos;
+        viewPos.transformCoord(view);
+        ndc.transformCoord(viewProj);
+        if (viewPos.z <= NEAR_Z || viewPos.z >= FAR_Z || std::fabs(ndc.x) >= 1.0f || std::fabs(ndc.y) >= 1.0f)
+        {
+            continue;
+        }
+        unsigned int x = static_cast<unsigned int>((ndc.x + 1.0f) * 0.5f * float(cluster::COUNT_X));
+        unsigned int y = static_cast<unsigned int>((1.0f - ndc.y) * 0.5f * float(cluster::COUNT_Y));
+        unsigned int z = SliceOf(viewPos.z);
+        EXPECT_TRUE(HasLight(parallel, x, y, z, cnt)) << "light " << cnt;
+        ++checked;
+    }
+    EXPECT_GT(checked, lights.size() / 4u);
+}
+
+//--------------
+// 手前が0の正射影は奥行きを線形に分け,境界の点光源は両側に入る
+//--------------
+TEST(LightClusterTest, OrthographicUsesLinearSlices)
+{
+    constexpr float WIDTH = 32.0f, HEIGHT = 18.0f, ORTHO_FAR = 96.0f;
+    const Matrix proj = Matrix::Orthographic(WIDTH, HEIGHT, 0.0f, ORTHO_FAR);
+    const float sliceDepth = ORTHO_FAR / float(cluster::COUNT_Z);
+    const std::vector<LightData> lights{
+        MakeLight(Vector3(0.0f, 1.0f, sliceDepth * 6.0f), 0.05f),                     // スライス5と6,タイル7と8
+        MakeLight(Vector3(-WIDTH * 0.5f + 1.0f, 1.0f, sliceDepth * 6.5f), 0.05f)      // スライス6の中,タイル0
+    };
+
+    LightClusterGrid grid{};
+    ASSERT_TRUE(grid.build(Matrix(), proj, lights, 1u));
+    EXPECT_TRUE(grid.validate());
+
+    Vector4 viewDepthRow{}, scale{};
+    bool isLogarithmic = true;
+    grid.getShaderParams(Vector2(1600.0f, 900.0f), viewDepthRow, scale, isLogarithmic);
+    EXPECT_FALSE(isLogarithmic);
+    EXPECT_NEAR(scale.z, float(cluster::COUNT_Z) / ORTHO_FAR, 1.0e-6f);
+    EXPECT_NEAR(scale.w, 0.0f, 1.0e-6f);
+    EXPECT_FLOAT_EQ(scale.x, float(cluster::COUNT_X) / 1600.0f);
+
+    // y = 1はタイル3と4の境界 (高さ18を9つに分けるので境界は奇数)
+    for (unsigned int x : { 7u, 8u })
+    {
+        for (unsigned int z : { 5u, 6u })
+        {
+            EXPECT_TRUE(HasLight(grid, x, 3u, z, 0u) && HasLight(grid, x, 4u, z, 0u));
+        }
+    }
+    EXPECT_FALSE(HasLight(grid, 7u, 3u, 4u, 0u));
+    EXPECT_FALSE(HasLight(grid, 7u, 3u, 7u, 0u));
+    EXPECT_EQ(CountClusters(grid, 0u), 8u);
+
+    EXPECT_TRUE(HasLight(grid, 0u, 3u, 6u, 1u));
+    EXPECT_TRUE(HasLight(grid, 0u, 4u, 6u, 1u));
+    EXPECT_EQ(CountClusters(grid, 1u), 2u);
+
+    // 透視射影は対数
+    ASSERT_TRUE(grid.build(Matrix(), MakePerspective(), lights, 1u));
+    grid.getShaderParams(Vector2(1600.0f, 900.0f), viewDepthRow, scale, isLogarithmic);
+    EXPECT_TRUE(isLogarithmic);
+}
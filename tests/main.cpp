@@ -0,0 +1,18 @@
+//--------------------------------------------
+//
+// テスト (commonのうちデバイスを使わない部分) [main.cpp]
+// Author: Fuma Sato
+//
+// Windowsはtests.vcxproj,LinuxはこのフォルダのCMakeLists.txtでビルドする
+//
+//--------------------------------------------
+#include <gtest/gtest.h>
+
+//----------------------------
+// エントリーポイント
+//----------------------------
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,278 @@
+//--------------------------------------------
+//
+// モーションデータベースのテスト (枝刈り検索と全探索の一致,端数の埋め,短いクリップ,検索時間) [motion_matching_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "motion_database.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <random>
+
+namespace
+{
+    using Feature = std::array<float, motion::FEATURE_COUNT>;
+
+    //--------------
+    // 作ったクリップの特徴量 (クリップごとに並べる)
+    //--------------
+    struct ClipSet
+    {
+        std::vector<Feature> features;  // フレームごとの特徴量
+        std::vector<size_t> animations; // フレームごとのアニメーション番号
+        std::vector<float> times;       // フレームごとの時間 (秒)
+    };
+
+    //--------------
+    // 滑らかに動く特徴量のクリップを作る (クリップごとに中心と位相が違う 実際のモーションのように近いフレームは近い値)
+    //--------------
+    ClipSet MakeClips(std::span<const size_t> frameCounts, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> center(-2.0f, 2.0f), phase(0.0f, 6.28f), speed(0.05f, 0.3f);
+        const float frameDelta = 1.0f / MotionFeatureConfig().sampleRate;
+
+        ClipSet clips{};
+        for (size_t cntClip = 0; cntClip < frameCounts.size(); ++cntClip)
+        {
+            Feature centers{}, phases{}, speeds{};
+            for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+            {
+                centers[cntDim] = center(random);
+                phases[cntDim] = phase(random);
+                speeds[cntDim] = speed(random);
+            }
+            for (size_t cntFrame = 0; cntFrame < frameCounts[cntClip]; ++cntFrame)
+            {
+                Feature& feature = clips.features.emplace_back();
+                for (size_t cntDim = 0; cntDim < motion::FEATURE_COUNT; ++cntDim)
+                {
+                    feature[cntDim] = centers[cntDim] + std::sin(phases[cntDim] + speeds[cntDim] * float(cntFrame));
+                }
+                clips.animations.push_back(cntClip);
+                clips.times.push_back(frameDelta * float(cntFrame));
+            }
+        }
+        return clips;
+    }
+
+    //--------------
+    // データベースを作る
+    //--------------
+    bool BuildDatabase(MotionDatabase& database, const ClipSet& clips, bool isLoop = false)
+    {
+        MotionFeatureConfig config{};
+        config.isLoop = isLoop;
+        return database.buildFromFeatures(clips.features, clips.animations, clips.times, config);
+    }
+
+    //--------------
+    // 1フレームずつ距離を比べる検索 (SIMDも枝刈りも使わない)
+    //--------------
+    MotionMatchResult SearchScalar(const MotionDatabase& database, std::span<const float, motion::FEATURE_COUNT> query)
+    {
+        MotionMatchResult best{};
+        for (size_t cntFrame = 0; cntFrame < database.getNumFrames(); ++cntFrame)
+        {
+            float cost = database.computeCost(cntFrame, query);
+            if (cost < best.cost)
+            {
+                best.cost = cost;
+                best.frame = cntFrame;
+            }
+        }
+        return best;
+    }
+
+    //--------------
+    // 検索結果が1フレームずつの検索と同じか (同じ距離のフレームはどちらでもよい)
+    //--------------
+    void ExpectSameResult(const MotionDatabase& database, const MotionMatchResult& result, std::span<const float, motion::FEATURE_COUNT> query)
+    {
+        MotionMatchResult expected = SearchScalar(database, query);
+        ASSERT_TRUE(result.isValid());
+        ASSERT_LT(result.frame, database.getNumFrames());
+        EXPECT_NEAR(result.cost, expected.cost, std::max(expected.cost, 1.0f) * 1.0e-4f);
+        EXPECT_NEAR(database.computeCost(result.frame, query), expected.cost, std::max(expected.cost, 1.0f) * 1.0e-4f);
+        EXPECT_EQ(result.animationIndex, database.getAnimationIndex(result.frame));
+        EXPECT_EQ(result.time, database.getTime(result.frame));
+    }
+
+    //--------------
+    // フレームの特徴量にずれを足した検索クエリ
+    //--------------
+    Feature MakeQuery(const MotionDatabase& database, size_t frame, float noise, std::mt19937& random)
+    {
+        std::normal_distribution<float> offset(0.0f, noise);
+        Feature query{};
+        database.getFeatures(frame, query);
+        for (float& value : query)
+        {
+            value += offset(random);
+        }
+        return query;
+    }
+}
+
+//--------------
+// 枝刈り検索と全探索は1フレームずつの検索と同じフレームを選ぶ (短いクリップと端数の埋めを含む)
+//--------------
+TEST(MotionMatchingTest, SearchMatchesBruteForce)
+{
+    const std::vector<size_t> frameCounts{ 3u, 250u, 5u, 17u, 64u, 1u, 130u, 9u };
+    const ClipSet clips = MakeClips(frameCounts, 3u);
+    MotionDatabase database{};
+    ASSERT_TRUE(BuildDatabase(database, clips));
+    ASSERT_EQ(database.getNumFrames(), clips.features.size());
+    ASSERT_NE(database.getNumFrames() % motion::LARGE_BOX_SIZE, 0u);
+
+    std::mt19937 random(11u);
+    std::uniform_int_distribution<size_t> frame(0u, database.getNumFrames() - 1u);
+    std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+    for (int cnt = 0; cnt < 300; ++cnt)
+    {
+        // データの近く,遠く,どこでもない場所
+        Feature query{};
+        if (cnt % 3 == 2)
+        {
+            for (float& element : query) element = value(random);
+        }
+        else
+        {
+            query = MakeQuery(database, frame(random), (cnt % 3 == 0) ? 0.05f : 1.0f, random);
+        }
+        ExpectSameResult(database, database.search(query), query);
+        ExpectSameResult(database, database.searchBruteForce(query), query);
+    }
+
+    // データのフレームそのものならそのフレーム
+    for (size_t cntFrame = 0; cntFrame < database.getNumFrames(); cntFrame += 7u)
+    {
+        Feature query{};
+        database.getFeatures(cntFrame, query);
+        MotionMatchResult result = database.search(query);
+        EXPECT_EQ(result.frame, cntFrame);
+        EXPECT_NEAR(result.cost, 0.0f, 1.0e-6f);
+    }
+}
+
+//--------------
+// 端数を埋めたフレームは遠いクエリでも選ばれない
+//--------------
+TEST(MotionMatchingTest, PaddedTailIsNeverSelected)
+{
+    const std::vector<size_t> frameCounts{ 5u };
+    const ClipSet clips = MakeClips(frameCounts, 5u);
+    MotionDatabase database{};
+    ASSERT_TRUE(BuildDatabase(database, clips));
+    ASSERT_EQ(database.getNumFrames(), 5u);
+
+    for (float value : { 1.0e6f, -1.0e6f, 1.0e9f, 0.0f })
+    {
+        Feature query{};
+        query.fill(value);
+        MotionMatchResult result = database.search(query);
+        ExpectSameResult(database, result, query);
+        ExpectSameResult(database, database.searchBruteForce(query), query);
+    }
+
+    // 1フレームだけ (次元ごとの広がりがない) でもそのフレーム
+    MotionDatabase single{};
+    ASSERT_TRUE(BuildDatabase(single, MakeClips(std::vector<size_t>{ 1u }, 6u)));
+    Feature query{};
+    query.fill(3.0f);
+    EXPECT_EQ(single.search(query).frame, 0u);
+    EXPECT_EQ(single.searchBruteForce(query).frame, 0u);
+}
+
+//--------------
+// 上限より遠いフレームしかなければ見つからない
+//--------------
+TEST(MotionMatchingTest, SearchRespectsMaxCost)
+{
+    const std::vector<size_t> frameCounts{ 40u, 40u };
+    MotionDatabase database{};
+    ASSERT_TRUE(BuildDatabase(database, MakeClips(frameCounts, 7u)));
+
+    std::mt19937 random(13u);
+    Feature query = MakeQuery(database, 20u, 0.5f, random);
+    MotionMatchResult best = database.search(query);
+    ASSERT_TRUE(best.isValid());
+    EXPECT_FALSE(database.search(query, best.cost).isValid());
+    EXPECT_FALSE(database.search(query, best.cost * 0.5f).isValid());
+    EXPECT_EQ(database.search(query, best.cost * 1.01f).frame, best.frame);
+}
+
+//--------------
+// 次のフレームはクリップの中だけ (短いクリップ,同じアニメーションが続くクリップ,ループ)
+//--------------
+TEST(MotionMatchingTest, NextFrameStaysInClip)
+{
+    ClipSet clips = MakeClips(std::vector<size_t>{ 3u, 2u, 4u }, 9u);
+    clips.animations.assign({ 0u, 0u, 0u, 1u, 1u, 1u, 1u, 1u, 1u }); // 2つ目と3つ目は同じアニメーション (時間が戻ったら別のクリップ)
+
+    MotionDatabase database{};
+    ASSERT_TRUE(BuildDatabase(database, clips));
+    const std::vector<size_t> next{ 1u, 2u, motion::INVALID_FRAME, 4u, motion::INVALID_FRAME, 6u, 7u, 8u, motion::INVALID_FRAME };
+    for (size_t cntFrame = 0; cntFrame < next.size(); ++cntFrame)
+    {
+        EXPECT_EQ(database.getNextFrame(cntFrame), next[cntFrame]) << "frame " << cntFrame;
+    }
+    EXPECT_EQ(database.getNextFrame(next.size()), motion::INVALID_FRAME);
+
+    MotionDatabase loop{};
+    ASSERT_TRUE(BuildDatabase(loop, clips, true));
+    EXPECT_EQ(loop.getNextFrame(2u), 0u);
+    EXPECT_EQ(loop.getNextFrame(4u), 3u);
+    EXPECT_EQ(loop.getNextFrame(8u), 5u);
+
+    // 数の合わない入力は作らない
+    clips.times.pop_back();
+    EXPECT_FALSE(BuildDatabase(database, clips));
+    EXPECT_EQ(database.getNumFrames(), 0u);
+    EXPECT_FALSE(database.search(Feature{}).isValid());
+}
+
+//--------------
+// 10万フレームの検索は1msより十分短い (枝刈りで読むフレームが減る)
+//--------------
+TEST(MotionMatchingTest, SearchIsFastAtHundredThousandFrames)
+{
+    constexpr size_t FRAME_COUNT = 100000u;
+    constexpr int QUERY_COUNT = 200;
+    std::vector<size_t> frameCounts(FRAME_COUNT / 250u, 250u);
+    MotionDatabase database{};
+    ASSERT_TRUE(BuildDatabase(database, MakeClips(frameCounts, 17u)));
+    ASSERT_EQ(database.getNumFrames(), FRAME_COUNT);
+
+    std::mt19937 random(19u);
+    std::uniform_int_distribution<size_t> frame(0u, FRAME_COUNT - 1u);
+    std::vector<Feature> queries{};
+    for (int cnt = 0; cnt < QUERY_COUNT; ++cnt)
+    {
+        queries.push_back(MakeQuery(database, frame(random), 0.05f, random));
+    }
+
+    // 枝刈り検索と全探索の1回の平均 (ms)
+    std::vector<MotionMatchResult> results(queries.size());
+    auto measure = [&](bool isBruteForce)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t cnt = 0; cnt < queries.size(); ++cnt)
+            {
+                results[cnt] = isBruteForce ? database.searchBruteForce(queries[cnt]) : database.search(queries[cnt]);
+            }
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(QUERY_COUNT);
+        };
+    const double bruteForceMs = measure(true);
+    const double averageMs = measure(false);
+    EXPECT_LT(averageMs, bruteForceMs * 0.5) << "search " << averageMs << "ms, brute force " << bruteForceMs << "ms";
+#ifdef NDEBUG
+    EXPECT_LT(averageMs, 0.5) << "search " << averageMs << "ms"; // 時間そのものは最適化したビルドだけで見る
+#endif
+
+    for (size_t cnt = 0; cnt < queries.size(); cnt += 20u)
+    {
+        ExpectSameResult(database, results[cnt], queries[cnt]);
+    }
+}
@@ -0,0 +1,260 @@
+//--------------------------------------------
+//
+// 記録だけするレンダラーのテスト (描画の流れが決まった通りになるか) [null_renderer_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "null_renderer.h"
+#include "renderer.h"
+#include "scene.h"
+#include "camera.h"
+#include "camera_comp.h"
+#include "light_comp.h"
+#include "render_mesh.h"
+#include "trans_comp.h"
+#include <gtest/gtest.h>
+#include <array>
+
+namespace
+{
+    constexpr long SCREEN_WIDTH = 1280; // 画面の大きさ
+    constexpr long SCREEN_HEIGHT = 720; //
+
+    //--------------
+    // 1辺1の立方体を登録する
+    //--------------
+    MeshHandle CreateCube(Renderer& renderer)
+    {
+        std::array<Vertex3D, 8> vertices{};
+        for (size_t cnt = 0; cnt < vertices.size(); ++cnt)
+        {
+            vertices[cnt].pos = Vector3((cnt & 1u) ? 0.5f : -0.5f, (cnt & 2u) ? 0.5f : -0.5f, (cnt & 4u) ? 0.5f : -0.5f);
+        }
+        const std::array<uint32_t, 36> indices = { 0,1,2, 2,1,3, 4,6,5, 5,6,7, 0,2,4, 4,2,6, 1,5,3, 3,5,7, 0,4,1, 1,4,5, 2,3,6, 6,3,7 };
+        return renderer.createMesh(VertexShaderType::Vertex3D, vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    //--------------
+    // メッシュを描くオブジェクトを作る
+    //--------------
+    std::unique_ptr<GameObject> MakeMeshObject(const Vector3& position, MeshHandle mesh, RenderQueue queue = RenderQueue::Geometry, const Material& material = Material())
+    {
+        auto gameObject = std::make_unique<GameObject>();
+        gameObject->Add<TransformComponent>(Transform(position, Quaternion(), Vector3(1.0f, 1.0f, 1.0f)));
+        gameObject->Add<MeshRenderComponent>(queue, RasMode::Back, mesh, material, TextureHandle());
+        return gameObject;
+    }
+
+    //--------------
+    // 既定のカメラ (z=-5から+zを見る)
+    //--------------
+    std::unique_ptr<GameObject> MakeCameraObject()
+    {
+        Camera camera{};
+        camera.SetAspectRatio(float(SCREEN_WIDTH) / float(SCREEN_HEIGHT));
+        camera.Set();
+
+        auto gameObject = std::make_unique<GameObject>();
+        gameObject->Add<CameraComponent>(camera);
+        return gameObject;
+    }
+
+    //--------------
+    // テスト用のレンダラーとシーン
+    //--------------
+    class NullRendererTest : public testing::Test
+    {
+    protected:
+        NullRendererTest() : m_pBackend{}, m_renderer{ MakeBackend(m_pBackend) }, m_scene{ nullptr }, m_cube{} {}
+
+        void SetUp() override
+        {
+            m_renderer.init(nullptr, SCREEN_WIDTH, SCREEN_HEIGHT);
+            m_cube = CreateCube(m_renderer);
+            m_scene.addGameObject(MakeCameraObject());
+        }
+        void TearDown() override { m_renderer.uninit(); }
+
+        // 指定した種類のコマンドの数
+        size_t countCommands(RenderCommandType type) const
+        {
+            size_t count = 0u;
+            for (const auto& command : m_pBackend->getCommands())
+            {
+                count += command.type == type ? 1u : 0u;
+            }
+            return count;
+        }
+
+        NullRenderStats getStats() const
+        {
+            NullRenderStats stats{};
+            m_pBackend->getStats(stats);
+            return stats;
+        }
+
+        NullRenderer* m_pBackend; // 記録を見るため (所有はRenderer)
+        Renderer m_renderer;      // テスト対象
+        Scene m_scene;            // 描くシーン
+        MeshHandle m_cube;        // 立方体
+
+    private:
+        static std::unique_ptr<RenderBackend> MakeBackend(NullRenderer*& pOut)
+        {
+            auto pBackend = std::make_unique<NullRenderer>();
+            pOut = pBackend.get();
+            return pBackend;
+        }
+    };
+
+    //--------------
+    // 記録を比べられる形にする
+    //--------------
+    std::vector<std::array<uint32_t, 3>> ToTuples(std::span<const RenderCommand> commands)
+    {
+        std::vector<std::array<uint32_t, 3>> result{};
+        for (const auto& command : commands)
+        {
+            result.push_back({ static_cast<uint32_t>(command.type), command.arg0, command.arg1 });
+        }
+        return result;
+    }
+}
+
+//--------------
+// キューはD3D11と同じ順番で回る
+//--------------
+TEST_F(NullRendererTest, QueuesAreVisitedInBackendOrder)
+{
+    ASSERT_TRUE(m_renderer.render(m_scene));
+
+    std::vector<uint32_t> queues{};
+    for (const auto& command : m_pBackend->getCommands())
+    {
+        if (command.type == RenderCommandType::BeginQueue)
+        {
+            queues.push_back(command.arg0);
+        }
+    }
+
+    const std::vector<uint32_t> expected = {
+        uint32_t(RenderQueue::Geometry), uint32_t(RenderQueue::Decal), uint32_t(RenderQueue::Sky), uint32_t(RenderQueue::Outline),
+        uint32_t(RenderQueue::Transparent), uint32_t(RenderQueue::UI), uint32_t(RenderQueue::String) };
+    EXPECT_EQ(queues, expected);
+}
+
+//--------------
+// 同じシーンは何度描いても,別のレンダラーで描いても同じ記録になる
+//--------------
+TEST_F(NullRendererTest, SameSceneRecordsSameCommands)
+{
+    Material red{};
+    red.Diffuse = Color(1.0f, 0.0f, 0.0f, 1.0f);
+    for (int cnt = 0; cnt < 6; ++cnt)
+    {
+        m_scene.addGameObject(MakeMeshObject(Vector3(float(cnt % 3) - 1.0f, 0.0f, float(cnt)), m_cube, (cnt % 2) ? RenderQueue::Transparent : RenderQueue::Geometry, (cnt % 3) ? red : Material()));
+    }
+
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    auto first = ToTuples(m_pBackend->getCommands());
+    ASSERT_FALSE(first.empty());
+    NullRenderStats firstStats = getStats();
+
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    EXPECT_EQ(ToTuples(m_pBackend->getCommands()), first);
+    EXPECT_EQ(getStats().draws, firstStats.draws);
+    EXPECT_EQ(getStats().constantBytes, firstStats.constantBytes);
+
+    // 別のレンダラー (メッシュを同じ順で登録すればIDも同じ)
+    auto pOther = std::make_unique<NullRenderer>();
+    NullRenderer* pOtherBackend = pOther.get();
+    Renderer other(std::move(pOther));
+    other.init(nullptr, SCREEN_WIDTH, SCREEN_HEIGHT);
+    ASSERT_EQ(CreateCube(other).id, m_cube.id);
+    ASSERT_TRUE(other.render(m_scene));
+    EXPECT_EQ(ToTuples(pOtherBackend->getCommands()), first);
+    other.uninit();
+}
+
+//--------------
+// 画面の外のものは描かない
+//--------------
+TEST_F(NullRendererTest, OffscreenMeshIsCulled)
+{
+    m_scene.addGameObject(MakeMeshObject(Vector3(0.0f, 0.0f, 2.0f), m_cube));
+    m_scene.addGameObject(MakeMeshObject(Vector3(500.0f, 0.0f, 2.0f), m_cube));  // 右の外
+    m_scene.addGameObject(MakeMeshObject(Vector3(0.0f, 0.0f, -50.0f), m_cube)); // カメラの後ろ
+
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    EXPECT_EQ(countCommands(RenderCommandType::DrawIndexed), 1u);
+    EXPECT_EQ(countCommands(RenderCommandType::DrawInstanced), 0u);
+    EXPECT_EQ(getStats().triangles, 12u);
+}
+
+//--------------
+// 同じ状態が並ぶジオメトリは1回のインスタンシングにまとまる
+//--------------
+TEST_F(NullRendererTest, SameStateMeshesAreInstanced)
+{
+    constexpr uint32_t COUNT = 5u;
+    for (uint32_t cnt = 0; cnt < COUNT; ++cnt)
+    {
+        m_scene.addGameObject(MakeMeshObject(Vector3(float(cnt) - 2.0f, 0.0f, 3.0f), m_cube));
+    }
+
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    ASSERT_EQ(countCommands(RenderCommandType::DrawInstanced), 1u);
+    EXPECT_EQ(countCommands(RenderCommandType::DrawIndexed), 0u);
+    for (const auto& command : m_pBackend->getCommands())
+    {
+        if (command.type == RenderCommandType::DrawInstanced)
+        {
+            EXPECT_EQ(command.arg0, m_cube.id);
+            EXPECT_EQ(command.arg1, COUNT);
+        }
+    }
+
+    NullRenderStats stats = getStats();
+    EXPECT_EQ(stats.draws, 1u);
+    EXPECT_EQ(stats.instances, COUNT);
+    EXPECT_EQ(stats.triangles, 12u * COUNT);
+}
+
+//--------------
+// 同じマテリアルを続けて設定しても送らない
+//--------------
+TEST_F(NullRendererTest, RedundantMaterialIsFiltered)
+{
+    // アウトラインはまとめないので1つずつrenderで設定される
+    m_scene.addGameObject(MakeMeshObject(Vector3(-1.0f, 0.0f, 2.0f), m_cube, RenderQueue::Outline));
+    m_scene.addGameObject(MakeMeshObject(Vector3(1.0f, 0.0f, 2.0f), m_cube, RenderQueue::Outline));
+
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    EXPECT_EQ(countCommands(RenderCommandType::DrawIndexed), 2u);
+    EXPECT_EQ(countCommands(RenderCommandType::SetMaterial), 1u);
+    EXPECT_EQ(countCommands(RenderCommandType::SetMesh), 1u);
+
+    RenderStateStats stateStats{};
+    m_renderer.getStateStats(stateStats);
+    EXPECT_GT(stateStats.redundantCalls, 0u);
+}
+
+//--------------
+// 記録しなくても統計は同じ
+//--------------
+TEST_F(NullRendererTest, StatsWithoutRecordingMatch)
+{
+    for (int cnt = 0; cnt < 3; ++cnt)
+    {
+        m_scene.addGameObject(MakeMeshObject(Vector3(float(cnt), 0.0f, 4.0f), m_cube));
+    }
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    NullRenderStats recorded = getStats();
+
+    m_pBackend->setRecording(false);
+    ASSERT_TRUE(m_renderer.render(m_scene));
+    EXPECT_TRUE(m_pBackend->getCommands().empty());
+    EXPECT_EQ(getStats().draws, recorded.draws);
+    EXPECT_EQ(getStats().triangles, recorded.triangles);
+    EXPECT_EQ(getStats().constantBytes, recorded.constantBytes);
+}
@@ -0,0 +1,153 @@
+//--------------------------------------------
+//
+// オクルージョンカリングのテスト (遮蔽物の深度と隠れているかの判定) [occlusion_culling_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "occlusion_culling.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <numbers>
+
+namespace
+{
+    constexpr float NEAR_Z = 0.1f;    // 射影の手前
+    constexpr float FAR_Z = 100.0f;   // 射影の奥
+    constexpr float WALL_Z = 10.0f;   // 壁の中心の奥行き (厚さ1なので手前の面は9.5)
+
+    //--------------
+    // 原点から+zを見る射影 (ビューは単位行列 深度バッファと同じ縦横比)
+    //--------------
+    Matrix MakeViewProj()
+    {
+        return Matrix::PerspectiveFovLH(std::numbers::pi_v<float> * 0.5f, float(occlusion::DEPTH_WIDTH) / float(occlusion::DEPTH_HEIGHT), NEAR_Z, FAR_Z);
+    }
+
+    //--------------
+    // 正面の壁 (8x8x1) を遮蔽物にして描く
+    //--------------
+    bool BuildWall(OcclusionCuller& culler)
+    {
+        OccluderBox wall{};
+        wall.world.m[3][2] = WALL_Z;
+        wall.local = AABB(Vector3(-4.0f, -4.0f, -0.5f), Vector3(4.0f, 4.0f, 0.5f));
+        wall.index = 0u;
+
+        const std::array<OccluderBox, 1> occluders{ wall };
+        const std::array<uint8_t, 1> visible{ 1u };
+        return culler.build(MakeViewProj(), occluders, visible, 1u);
+    }
+}
+
+//--------------
+// 壁の手前の面の深度が描かれ,粗い段は下の段の一番奥になる
+//--------------
+TEST(OcclusionCullingTest, BuildRasterizesOccluderDepth)
+{
+    OcclusionCuller culler{};
+    ASSERT_TRUE(BuildWall(culler));
+
+    OcclusionCullingStats stats{};
+    culler.getStats(stats);
+    EXPECT_EQ(stats.occluders, 1u);
+    EXPECT_GT(stats.triangles, 0u);
+
+    // 画面の中心は手前の面 (z = 9.5) のz/w
+    float expected = FAR_Z / (FAR_Z - NEAR_Z) * (1.0f - NEAR_Z / (WALL_Z - 0.5f));
+    EXPECT_NEAR(culler.getDepth(0u, occlusion::DEPTH_WIDTH / 2u, occlusion::DEPTH_HEIGHT / 2u), expected, 1.0e-4f);
+
+    // 壁の外は何もない
+    EXPECT_EQ(culler.getDepth(0u, 0u, 0u), 1.0f);
+
+    // 一番粗い段は画面の外まで含むので一番奥
+    EXPECT_EQ(culler.getDepth(occlusion::HIZ_LEVELS - 1u, 0u, 0u), 1.0f);
+    EXPECT_EQ(culler.getDepth(occlusion::HIZ_LEVELS - 1u, 1u, 0u), 1.0f);
+
+    // 壁の内側に収まる段の値は壁の深度
+    EXPECT_NEAR(culler.getDepth(3u, (occlusion::DEPTH_WIDTH >> 3u) / 2u, (occlusion::DEPTH_HEIGHT >> 3u) / 2u), expected, 1.0e-4f);
+}
+
+//--------------
+// 壁の奥に全部隠れている箱は除く (大きな箱は粗い段で判定する)
+//--------------
+TEST(OcclusionCullingTest, FullyHiddenBoxIsOccluded)
+{
+    OcclusionCuller culler{};
+    ASSERT_TRUE(BuildWall(culler));
+
+    EXPECT_TRUE(culler.isOccluded(Vector3(0.0f, 0.0f, 20.0f), Vector3(1.0f, 1.0f, 1.0f)));
+    EXPECT_TRUE(culler.isOccluded(Vector3(0.0f, 0.0f, 50.0f), Vector3(10.0f, 10.0f, 1.0f)));
+}
+
+//--------------
+// 一部でも壁の外か手前にある箱は見える
+//--------------
+TEST(OcclusionCullingTest, PartiallyVisibleBoxIsKept)
+{
+    OcclusionCuller culler{};
+    ASSERT_TRUE(BuildWall(culler));
+
+    // 壁の端 (z=20ではx=8.4あたり) からはみ出す
+    EXPECT_FALSE(culler.isOccluded(Vector3(8.4f, 0.0f, 20.0f), Vector3(1.0f, 1.0f, 1.0f)));
+
+    // 壁の手前,壁を貫くもの
+    EXPECT_FALSE(culler.isOccluded(Vector3(0.0f, 0.0f, 5.0f), Vector3(1.0f, 1.0f, 1.0f)));
+    EXPECT_FALSE(culler.isOccluded(Vector3(0.0f, 0.0f, WALL_Z), Vector3(1.0f, 1.0f, 2.0f)));
+
+    // 画面の外
+    EXPECT_FALSE(culler.isOccluded(Vector3(0.0f, 0.0f, -20.0f), Vector3(1.0f, 1.0f, 1.0f)));
+}
+
+//--------------
+// 手前の面をまたぐ箱は奥が隠れていても見えることにする
+//--------------
+TEST(OcclusionCullingTest, BoxCrossingNearPlaneStaysVisible)
+{
+    OcclusionCuller culler{};
+    ASSERT_TRUE(BuildWall(culler));
+
+    EXPECT_FALSE(culler.isOccluded(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 1.0f, 1.0f)));
+    EXPECT_FALSE(culler.isOccluded(Vector3(0.0f, 0.0f, 15.0f), Vector3(1.0f, 1.0f, 15.0f)));
+}
+
+//--------------
+// 見えているものだけ判定し,境界ボックスのないものは残す
+//--------------
+TEST(OcclusionCullingTest, CullClearsHiddenEntries)
+{
+    OcclusionCuller culler{};
+    ASSERT_TRUE(BuildWall(culler));
+
+    CullBounds bounds{};
+    bounds.resize(4u);
+    const std::array<Vector3, 4> centers{ Vector3(0.0f, 0.0f, 20.0f), Vector3(0.0f, 0.0f, 5.0f), Vector3(0.0f, 0.0f, 30.0f), Vector3(0.0f, 0.0f, 40.0f) };
+    for (size_t cnt = 0; cnt < centers.size(); ++cnt)
+    {
+        bounds.centerX[cnt] = centers[cnt].x; bounds.centerY[cnt] = centers[cnt].y; bounds.centerZ[cnt] = centers[cnt].z;
+        bounds.extentX[cnt] = bounds.extentY[cnt] = bounds.extentZ[cnt] = 1.0f;
+    }
+    bounds.extentX[3] = bounds.extentY[3] = bounds.extentZ[3] = draw::UNBOUNDED_EXTENT;
+
+    std::vector<uint8_t> visible{ 1u, 1u, 0u, 1u };
+    EXPECT_EQ(culler.cull(bounds, visible), 1u);
+    EXPECT_EQ(visible, (std::vector<uint8_t>{ 0u, 1u, 0u, 1u }));
+
+    OcclusionCullingStats stats{};
+    culler.getStats(stats);
+    EXPECT_EQ(stats.tested, 2u);
+    EXPECT_EQ(stats.culled, 1u);
+}
+
+//--------------
+// 使わない設定なら描かず,何も除かない
+//--------------
+TEST(OcclusionCullingTest, DisabledCullerKeepsEverything)
+{
+    OcclusionCullingSettings settings{};
+    settings.isEnabled = false;
+    OcclusionCuller culler{};
+    culler.setSettings(settings);
+    EXPECT_FALSE(BuildWall(culler));
+    EXPECT_FALSE(culler.isOccluded(Vector3(0.0f, 0.0f, 20.0f), Vector3(1.0f, 1.0f, 1.0f)));
+    EXPECT_EQ(culler.getDepth(0u, occlusion::DEPTH_WIDTH / 2u, occlusion::DEPTH_HEIGHT / 2u), 1.0f);
+}
@@ -0,0 +1,156 @@
+//--------------------------------------------
+//
+// 範囲の割り当てのテスト (結合,一番ぴったりの空き,詰め直し) [offset_allocator_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "offset_allocator.h"
+#include <gtest/gtest.h>
+
+//--------------
+// 前から順に貸し出し,返すと空きに戻る
+//--------------
+TEST(OffsetAllocatorTest, AllocateAndRelease)
+{
+    OffsetAllocator allocator(100u);
+    EXPECT_EQ(allocator.allocate(10u), 0u);
+    EXPECT_EQ(allocator.allocate(20u), 10u);
+    EXPECT_EQ(allocator.getUsedSize(), 30u);
+    EXPECT_EQ(allocator.getAllocationCount(), 2u);
+
+    EXPECT_TRUE(allocator.release(0u));
+    EXPECT_EQ(allocator.getUsedSize(), 20u);
+    EXPECT_EQ(allocator.getFreeSize(), 80u);
+
+    // 知らない位置と2回目は返せない
+    EXPECT_FALSE(allocator.release(0u));
+    EXPECT_FALSE(allocator.release(5u));
+
+    // 0個は貸さない
+    EXPECT_EQ(allocator.allocate(0u), OffsetAllocator::NO_OFFSET);
+
+    EXPECT_TRUE(allocator.release(10u));
+    EXPECT_EQ(allocator.getUsedSize(), 0u);
+    EXPECT_EQ(allocator.getAllocationCount(), 0u);
+}
+
+//--------------
+// 返した範囲は前後の空きとつながる
+//--------------
+TEST(OffsetAllocatorTest, ReleaseCoalescesNeighbours)
+{
+    OffsetAllocator allocator(40u);
+    uint32_t a = allocator.allocate(10u);
+    uint32_t b = allocator.allocate(10u);
+    uint32_t c = allocator.allocate(10u);
+    uint32_t d = allocator.allocate(10u);
+    EXPECT_EQ(allocator.getFreeSize(), 0u);
+
+    // 離れた2つは別々の空き
+    allocator.release(a);
+    allocator.release(c);
+    EXPECT_EQ(allocator.getLargestFreeSize(), 10u);
+    EXPECT_FLOAT_EQ(allocator.getFragmentation(), 0.5f);
+
+    // 間を返すと3つが1つになる
+    allocator.release(b);
+    EXPECT_EQ(allocator.getLargestFreeSize(), 30u);
+    EXPECT_FLOAT_EQ(allocator.getFragmentation(), 0.0f);
+    EXPECT_EQ(allocator.allocate(30u), 0u);
+
+    // 後ろの空きとつなぐ
+    allocator.release(0u);
+    allocator.release(d);
+    EXPECT_EQ(allocator.getLargestFreeSize(), 40u);
+    EXPECT_EQ(allocator.allocate(40u), 0u);
+}
+
+//--------------
+// 一番ぴったりの空きを使う (同じ大きさなら前の方)
+//--------------
+TEST(OffsetAllocatorTest, AllocateUsesBestFit)
+{
+    OffsetAllocator allocator(100u);
+    uint32_t large = allocator.allocate(30u); // 0
+    allocator.allocate(10u);                  // 30
+    uint32_t small = allocator.allocate(8u);  // 40
+    allocator.allocate(10u);                  // 48
+    uint32_t exact = allocator.allocate(5u);  // 58
+    allocator.allocate(37u);                  // 63 (最後まで)
+    allocator.release(large);
+    allocator.release(small);
+    allocator.release(exact);
+
+    EXPECT_EQ(allocator.allocate(5u), 58u);  // ぴったり
+    EXPECT_EQ(allocator.allocate(6u), 40u);  // 8の空き
+    EXPECT_EQ(allocator.allocate(20u), 0u);  // 30の空き
+    EXPECT_EQ(allocator.allocate(2u), 46u);  // 2の残り
+    EXPECT_EQ(allocator.allocate(10u), 20u); // 10の残り
+}
+
+//--------------
+// 空きが足りない,または細切れで入らないときは貸さない
+//--------------
+TEST(OffsetAllocatorTest, AllocateFailsWhenOutOfSpace)
+{
+    OffsetAllocator allocator(30u);
+    EXPECT_EQ(allocator.allocate(31u), OffsetAllocator::NO_OFFSET);
+
+    uint32_t a = allocator.allocate(10u);
+    allocator.allocate(10u);
+    uint32_t c = allocator.allocate(10u);
+    EXPECT_EQ(allocator.allocate(1u), OffsetAllocator::NO_OFFSET);
+
+    // 合計20空いていても続いていなければ入らない
+    allocator.release(a);
+    allocator.release(c);
+    EXPECT_EQ(allocator.getFreeSize(), 20u);
+    EXPECT_EQ(allocator.allocate(20u), OffsetAllocator::NO_OFFSET);
+    EXPECT_EQ(allocator.getUsedSize(), 10u);
+
+    // 空のアロケーターは何も貸さない
+    OffsetAllocator empty{};
+    EXPECT_EQ(empty.allocate(1u), OffsetAllocator::NO_OFFSET);
+}
+
+//--------------
+// 詰め直すと貸し出し中が前から並び,移動が全部返る
+//--------------
+TEST(OffsetAllocatorTest, DefragmentPacksLiveRanges)
+{
+    OffsetAllocator allocator(100u);
+    uint32_t a = allocator.allocate(10u); // 0
+    uint32_t b = allocator.allocate(20u); // 10
+    uint32_t c = allocator.allocate(5u);  // 30
+    uint32_t d = allocator.allocate(15u); // 35
+    allocator.release(a);
+    allocator.release(c);
+    EXPECT_GT(allocator.getFragmentation(), 0.0f);
+
+    std::vector<OffsetAllocator::Move> moves{};
+    allocator.defragment(moves);
+    ASSERT_EQ(moves.size(), 2u);
+    EXPECT_EQ(moves[0].from, b);
+    EXPECT_EQ(moves[0].to, 0u);
+    EXPECT_EQ(moves[0].size, 20u);
+    EXPECT_EQ(moves[1].from, d);
+    EXPECT_EQ(moves[1].to, 20u);
+    EXPECT_EQ(moves[1].size, 15u);
+
+    EXPECT_EQ(allocator.getUsedSize(), 35u);
+    EXPECT_EQ(allocator.getLargestFreeSize(), 65u);
+    EXPECT_FLOAT_EQ(allocator.getFragmentation(), 0.0f);
+
+    // 新しい位置で返せて,古い位置は知らない
+    EXPECT_FALSE(allocator.release(d));
+    EXPECT_TRUE(allocator.release(20u));
+    EXPECT_TRUE(allocator.release(0u));
+    EXPECT_EQ(allocator.getLargestFreeSize(), 100u);
+
+    // 動かないものも新しいバッファに写すので移動に入る
+    allocator.allocate(10u);
+    allocator.defragment(moves);
+    ASSERT_EQ(moves.size(), 1u);
+    EXPECT_EQ(moves[0].from, 0u);
+    EXPECT_EQ(moves[0].to, 0u);
+}
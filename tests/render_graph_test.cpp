@@ -0,0 +1,415 @@
+//--------------------------------------------
+//
+// レンダーグラフのテスト (使わないパスの除去,実体の使い回し,クリアと状態の切り替え) [render_graph_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "render_graph.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+
+namespace
+{
+    constexpr uint32_t FORMAT_RGBA8 = 1u;   // 色
+    constexpr uint32_t FORMAT_RGBA16F = 2u; // 法線,発光,シーン
+    constexpr uint32_t FORMAT_RGBA32F = 3u; // 座標
+
+    // 描画先 (レンダラーのFrameTargetと同じ並び)
+    enum class Target : uint32_t
+    {
+        GBuffer0,
+        GBuffer1,
+        GBuffer2,
+        GBuffer3,
+        Scene,
+        Bloom,
+        BloomWork,
+        BloomBlur,
+        Gray,
+        Composite,
+        ShadowMap,
+        Depth,
+        BackBuffer,
+        Max
+    };
+
+    // パス (登録順)
+    enum class Pass : uint32_t
+    {
+        Shadow,
+        Geometry,
+        Decal,
+        Lighting,
+        Forward,
+        BloomExtract,
+        BloomBlurX,
+        BloomBlurY,
+        Gray,
+        Composite,
+        Present,
+        Max
+    };
+
+    //--------------
+    // レンダラーと同じフレームのグラフ (カメラごとのパスとポストプロセス)
+    //--------------
+    struct FrameGraph
+    {
+        RenderGraph graph;                                         // グラフ
+        std::array<uint32_t, size_t(Target::Max)> targets;         // 描画先の番号
+        std::array<uint32_t, size_t(Pass::Max)> passes;            // パスの番号
+        std::array<std::vector<Target>, size_t(Pass::Max)> reads;  // パスが読む描画先
+        std::array<std::vector<Target>, size_t(Pass::Max)> writes; // パスが書く描画先
+        std::vector<Pass> executed;                                // 実行したパス
+
+        FrameGraph() : graph{}, targets{}, passes{}, reads{}, writes{}, executed{} {}
+        ~FrameGraph() = default;
+
+        uint32_t target(Target value) const { return targets[size_t(value)]; }
+        uint32_t pass(Pass value) const { return passes[size_t(value)]; }
+        uint32_t physical(Target value) const { return graph.getPhysicalIndex(target(value)); }
+    };
+
+    //--------------
+    // フレームのグラフを組む (レンダラーのcompileRenderGraphと同じ読み書き)
+    //--------------
+    void BuildFrameGraph(FrameGraph& frame, bool isBloom, bool isGray)
+    {
+        RenderGraph& graph = frame.graph;
+        graph.reset();
+        frame.executed.clear();
+
+        auto create = [&](Target target, uint32_t format, uint32_t sizeShift) { frame.targets[size_t(target)] = graph.createTexture("", RenderGraphTextureDesc(format, sizeShift)); };
+        create(Target::GBuffer0, FORMAT_RGBA8, 0u);
+        create(Target::GBuffer1, FORMAT_RGBA16F, 0u);
+        create(Target::GBuffer2, FORMAT_RGBA32F, 0u);
+        create(Target::GBuffer3, FORMAT_RGBA16F, 0u);
+        create(Target::Scene, FORMAT_RGBA16F, 0u);
+        create(Target::Bloom, FORMAT_RGBA16F, 2u);
+        create(Target::BloomWork, FORMAT_RGBA16F, 2u);
+        create(Target::BloomBlur, FORMAT_RGBA16F, 2u);
+        create(Target::Gray, FORMAT_RGBA16F, 0u);
+        create(Target::Composite, FORMAT_RGBA16F, 0u);
+        frame.targets[size_t(Target::ShadowMap)] = graph.importTexture("ShadowMap");
+        frame.targets[size_t(Target::Depth)] = graph.importTexture("Depth");
+        frame.targets[size_t(Target::BackBuffer)] = graph.importTexture("BackBuffer", true);
+
+        auto add = [&](Pass pass, bool isRepeated, std::initializer_list<Target> reads, std::initializer_list<Target> writes)
+            {
+                uint32_t index = graph.addPass("", [&frame, pass]() { frame.executed.push_back(pass); }, isRepeated);
+                frame.passes[size_t(pass)] = index;
+                frame.reads[size_t(pass)] = reads;
+                frame.writes[size_t(pass)] = writes;
+                for (Target target : reads) graph.read(index, frame.target(target));
+                for (Target target : writes) graph.write(index, frame.target(target));
+            };
+        add(Pass::Shadow, true, {}, { Target::ShadowMap });
+        add(Pass::Geometry, true, {}, { Target::GBuffer0, Target::GBuffer1, Target::GBuffer2, Target::GBuffer3, Target::Depth });
+        add(Pass::Decal, true, { Target::GBuffer2 }, { Target::GBuffer0, Target::Depth });
+        add(Pass::Lighting, true, { Target::GBuffer0, Target::GBuffer1, Target::GBuffer2, Target::GBuffer3, Target::ShadowMap }, { Target::Scene });
+        add(Pass::Forward, true, {}, { Target::Scene, Target::Depth });
+        add(Pass::BloomExtract, false, { Target::Scene }, { Target::Bloom });
+        add(Pass::BloomBlurX, false, { Target::Bloom }, { Target::BloomWork });
+        add(Pass::BloomBlurY, false, { Target::BloomWork }, { Target::BloomBlur });
+        add(Pass::Gray, false, { Target::Scene }, { Target::Gray });
+        if (isBloom)
+        {
+            add(Pass::Composite, false, { isGray ? Target::Gray : Target::Scene, Target::BloomBlur }, { Target::Composite });
+        }
+        else
+        {
+            add(Pass::Composite, false, { isGray ? Target::Gray : Target::Scene }, { Target::Composite });
+        }
+        add(Pass::Present, false, { Target::Composite }, { Target::BackBuffer });
+    }
+
+    //--------------
+    // コンパイルしたパスの切り替え (無ければnullptr)
+    //--------------
+    const RenderGraphCompiledPass* FindCompiled(const RenderGraph& graph, uint32_t pass)
+    {
+        for (const auto& compiled : graph.getCompiledPasses())
+        {
+            if (compiled.pass == pass) return &compiled;
+        }
+        return nullptr;
+    }
+
+    //--------------
+    // 描画先の切り替えがあるか
+    //--------------
+    bool HasBarrier(const RenderGraphCompiledPass& compiled, uint32_t resource, RenderGraphAccess before, RenderGraphAccess after)
+    {
+        return std::any_of(compiled.barriers.begin(), compiled.barriers.end(), [&](const RenderGraphBarrier& barrier)
+            {
+                return barrier.resource == resource && barrier.before == before && barrier.after == after;
+            });
+    }
+}
+
+//--------------
+// ブルームとグレーを切ると,その結果だけを書くパスと描画先は除かれる
+//--------------
+TEST(RenderGraphTest, UnusedPostProcessPassesAreCulled)
+{
+    FrameGraph frame{};
+    BuildFrameGraph(frame, false, false);
+    ASSERT_TRUE(frame.graph.compile());
+
+    for (Pass pass : { Pass::BloomExtract, Pass::BloomBlurX, Pass::BloomBlurY, Pass::Gray })
+    {
+        EXPECT_FALSE(frame.graph.isPassAlive(frame.pass(pass)));
+        EXPECT_EQ(FindCompiled(frame.graph, frame.pass(pass)), nullptr);
+    }
+    for (Pass pass : { Pass::Shadow, Pass::Geometry, Pass::Decal, Pass::Lighting, Pass::Forward, Pass::Composite, Pass::Present })
+    {
+        EXPECT_TRUE(frame.graph.isPassAlive(frame.pass(pass)));
+    }
+    EXPECT_EQ(frame.graph.getCompiledPasses().size(), 7u);
+    for (Target target : { Target::Bloom, Target::BloomWork, Target::BloomBlur, Target::Gray })
+    {
+        EXPECT_EQ(frame.physical(target), render_graph::NO_INDEX);
+    }
+
+    // ブルームだけ使えばグレーだけ除かれる
+    BuildFrameGraph(frame, true, false);
+    ASSERT_TRUE(frame.graph.compile());
+    EXPECT_TRUE(frame.graph.isPassAlive(frame.pass(Pass::BloomBlurY)));
+    EXPECT_FALSE(frame.graph.isPassAlive(frame.pass(Pass::Gray)));
+    EXPECT_EQ(frame.graph.getCompiledPasses().size(), 10u);
+
+    // 全部使えば全部残る
+    BuildFrameGraph(frame, true, true);
+    ASSERT_TRUE(frame.graph.compile());
+    EXPECT_EQ(frame.graph.getCompiledPasses().size(), size_t(Pass::Max));
+
+    // 結果を読まれなくても残すパス
+    BuildFrameGraph(frame, false, false);
+    frame.graph.setSideEffect(frame.pass(Pass::Gray));
+    ASSERT_TRUE(frame.graph.compile());
+    EXPECT_TRUE(frame.graph.isPassAlive(frame.pass(Pass::Gray)));
+    EXPECT_FALSE(frame.graph.isPassAlive(frame.pass(Pass::BloomExtract)));
+}
+
+//--------------
+// 実体を共有するのは作り方が同じで寿命が重ならない描画先だけ
+//--------------
+TEST(RenderGraphTest, PhysicalTexturesAliasOnlyDisjointMatchingTargets)
+{
+    FrameGraph frame{};
+    BuildFrameGraph(frame, true, true);
+    ASSERT_TRUE(frame.graph.compile());
+
+    // 描画先の寿命 (実行順 繰り返すパスで使うものは繰り返しの間ずっと)
+    const auto compiledPasses = frame.graph.getCompiledPasses();
+    const uint32_t repeatLast = uint32_t(Pass::Forward);
+    std::array<uint32_t, size_t(Target::Max)> first{}, last{};
+    first.fill(render_graph::NO_INDEX);
+    for (uint32_t order = 0; order < compiledPasses.size(); ++order)
+    {
+        Pass pass = Pass(compiledPasses[order].pass);
+        bool isRepeated = order <= repeatLast;
+        for (const auto* pTargets : { &frame.reads[size_t(pass)], &frame.writes[size_t(pass)] })
+        {
+            for (Target target : *pTargets)
+            {
+                first[size_t(target)] = std::min(first[size_t(target)], isRepeated ? 0u : order);
+                last[size_t(target)] = std::max(last[size_t(target)], isRepeated ? repeatLast : order);
+            }
+        }
+    }
+
+    const auto physicalTextures = frame.graph.getPhysicalTextures();
+    for (uint32_t a = 0; a < uint32_t(Target::ShadowMap); ++a)
+    {
+        uint32_t physical = frame.physical(Target(a));
+        ASSERT_LT(physical, physicalTextures.size());
+        for (uint32_t b = a + 1u; b < uint32_t(Target::ShadowMap); ++b)
+        {
+            if (frame.physical(Target(b)) != physical) continue;
+            EXPECT_TRUE(physicalTextures[physical] == physicalTextures[frame.physical(Target(b))]);
+            EXPECT_TRUE(last[a] < first[b] || last[b] < first[a]) << "target " << a << " and " << b;
+        }
+    }
+
+    // ブルームの1段目と3段目は重ならないので共有し,間の作業用は別 (1/4の大きさはフル解像度と共有しない)
+    EXPECT_EQ(frame.physical(Target::Bloom), frame.physical(Target::BloomBlur));
+    EXPECT_NE(frame.physical(Target::Bloom), frame.physical(Target::BloomWork));
+    EXPECT_EQ(physicalTextures[frame.physical(Target::Bloom)].sizeShift, 2u);
+
+    // Gバッファはカメラの繰り返しの間ずっと生きているので互いに共有せず,繰り返しの後のグレーと共有する
+    EXPECT_NE(frame.physical(Target::GBuffer1), frame.physical(Target::GBuffer3));
+    EXPECT_NE(frame.physical(Target::GBuffer1), frame.physical(Target::Scene));
+    EXPECT_EQ(frame.physical(Target::Gray), frame.physical(Target::GBuffer1));
+
+    // 座標は作り方が違うので誰とも共有しない
+    for (uint32_t target = 0; target < uint32_t(Target::ShadowMap); ++target)
+    {
+        if (Target(target) != Target::GBuffer2) EXPECT_NE(frame.physical(Target(target)), frame.physical(Target::GBuffer2));
+    }
+    EXPECT_LT(physicalTextures.size(), size_t(Target::ShadowMap));
+
+    // 外の描画先は実体を持たない
+    EXPECT_EQ(frame.physical(Target::BackBuffer), render_graph::NO_INDEX);
+    EXPECT_EQ(frame.physical(Target::Depth), render_graph::NO_INDEX);
+}
+
+//--------------
+// 作り方が違えば寿命が重ならなくても共有しない
+//--------------
+TEST(RenderGraphTest, DifferentDescsAreNotAliased)
+{
+    RenderGraph graph{};
+    uint32_t full = graph.createTexture("Full", RenderGraphTextureDesc(FORMAT_RGBA16F, 0u));
+    uint32_t half = graph.createTexture("Half", RenderGraphTextureDesc(FORMAT_RGBA16F, 1u));
+    uint32_t again = graph.createTexture("Again", RenderGraphTextureDesc(FORMAT_RGBA16F, 0u));
+    uint32_t output = graph.importTexture("BackBuffer", true);
+
+    uint32_t first = graph.addPass("First", {});
+    graph.write(first, full);
+    uint32_t second = graph.addPass("Second", {});
+    graph.read(second, full);
+    graph.write(second, half);
+    uint32_t third = graph.addPass("Third", {});
+    graph.read(third, half);
+    graph.write(third, again);
+    uint32_t fourth = graph.addPass("Fourth", {});
+    graph.read(fourth, again);
+    graph.write(fourth, output);
+    ASSERT_TRUE(graph.compile());
+
+    EXPECT_NE(graph.getPhysicalIndex(full), graph.getPhysicalIndex(half));
+    EXPECT_EQ(graph.getPhysicalIndex(full), graph.getPhysicalIndex(again));
+    EXPECT_EQ(graph.getPhysicalTextures().size(), 2u);
+}
+
+//--------------
+// クリアは最初に書くパスだけ,切り替えは使われ方が変わるパスの前 (繰り返すパスは2周目の切り替え)
+//--------------
+TEST(RenderGraphTest, ClearsAndBarriersArePlacedAtFirstUse)
+{
+    FrameGraph frame{};
+    BuildFrameGraph(frame, true, true);
+    ASSERT_TRUE(frame.graph.compile());
+    const RenderGraph& graph = frame.graph;
+
+    // Gバッファは書き始めのジオメトリでクリアする (外の深度はクリアしない)
+    const RenderGraphCompiledPass* pGeometry = FindCompiled(graph, frame.pass(Pass::Geometry));
+    ASSERT_NE(pGeometry, nullptr);
+    EXPECT_EQ(pGeometry->clears, (std::vector<uint32_t>{ frame.target(Target::GBuffer0), frame.target(Target::GBuffer1), frame.target(Target::GBuffer2), frame.target(Target::GBuffer3) }));
+    EXPECT_TRUE(FindCompiled(graph, frame.pass(Pass::Decal))->clears.empty());
+    EXPECT_TRUE(FindCompiled(graph, frame.pass(Pass::Forward))->clears.empty());
+    EXPECT_EQ(FindCompiled(graph, frame.pass(Pass::Lighting))->clears, (std::vector<uint32_t>{ frame.target(Target::Scene) }));
+    EXPECT_TRUE(FindCompiled(graph, frame.pass(Pass::Present))->clears.empty());
+
+    // 2周目のジオメトリは前のカメラのライティングが読んだGバッファを書きに戻す
+    ASSERT_EQ(pGeometry->barriers.size(), 4u);
+    for (Target target : { Target::GBuffer0, Target::GBuffer1, Target::GBuffer2, Target::GBuffer3 })
+    {
+        EXPECT_TRUE(HasBarrier(*pGeometry, frame.target(target), RenderGraphAccess::Read, RenderGraphAccess::Write));
+    }
+    const RenderGraphCompiledPass* pShadow = FindCompiled(graph, frame.pass(Pass::Shadow));
+    ASSERT_EQ(pShadow->barriers.size(), 1u);
+    EXPECT_TRUE(HasBarrier(*pShadow, frame.target(Target::ShadowMap), RenderGraphAccess::Read, RenderGraphAccess::Write));
+
+    // デカールは座標を読みに,ライティングは残りのGバッファとシャドウマップを読みに切り替える
+    const RenderGraphCompiledPass* pDecal = FindCompiled(graph, frame.pass(Pass::Decal));
+    ASSERT_EQ(pDecal->barriers.size(), 1u);
+    EXPECT_TRUE(HasBarrier(*pDecal, frame.target(Target::GBuffer2), RenderGraphAccess::Write, RenderGraphAccess::Read));
+    const RenderGraphCompiledPass* pLighting = FindCompiled(graph, frame.pass(Pass::Lighting));
+    EXPECT_EQ(pLighting->barriers.size(), 4u);
+    for (Target target : { Target::GBuffer0, Target::GBuffer1, Target::GBuffer3, Target::ShadowMap })
+    {
+        EXPECT_TRUE(HasBarrier(*pLighting, frame.target(target), RenderGraphAccess::Write, RenderGraphAccess::Read));
+    }
+    EXPECT_TRUE(FindCompiled(graph, frame.pass(Pass::Forward))->barriers.empty());
+
+    // シーンを最初に読むパスで切り替え,Gバッファの実体を使い回すグレーは読まれた状態から書きに戻してクリアする
+    EXPECT_TRUE(HasBarrier(*FindCompiled(graph, frame.pass(Pass::BloomExtract)), frame.target(Target::Scene), RenderGraphAccess::Write, RenderGraphAccess::Read));
+    const RenderGraphCompiledPass* pGray = FindCompiled(graph, frame.pass(Pass::Gray));
+    EXPECT_TRUE(pGray->barriers.size() == 1u && HasBarrier(*pGray, frame.target(Target::Gray), RenderGraphAccess::Read, RenderGraphAccess::Write));
+    EXPECT_EQ(pGray->clears, (std::vector<uint32_t>{ frame.target(Target::Gray) }));
+
+    // ブルームの3段目は1段目の実体を読まれた状態から書きに戻す
+    EXPECT_TRUE(HasBarrier(*FindCompiled(graph, frame.pass(Pass::BloomBlurY)), frame.target(Target::BloomBlur), RenderGraphAccess::Read, RenderGraphAccess::Write));
+
+    // 外のバックバッファは前の状態を知らないので切り替えない
+    const RenderGraphCompiledPass* pPresent = FindCompiled(graph, frame.pass(Pass::Present));
+    ASSERT_EQ(pPresent->barriers.size(), 1u);
+    EXPECT_TRUE(HasBarrier(*pPresent, frame.target(Target::Composite), RenderGraphAccess::Write, RenderGraphAccess::Read));
+}
+
+//--------------
+// 実行は繰り返すパスとそれ以外を分けて実行順に,切り替えを先に渡す
+//--------------
+TEST(RenderGraphTest, ExecuteRunsPassesInOrder)
+{
+    FrameGraph frame{};
+    BuildFrameGraph(frame, false, true);
+    ASSERT_TRUE(frame.graph.compile());
+
+    std::vector<uint32_t> prepared{};
+    auto prepare = [&](const RenderGraphCompiledPass& compiled) { prepared.push_back(compiled.pass); };
+    frame.graph.execute(true, prepare);
+    frame.graph.execute(true, prepare);
+    EXPECT_EQ(frame.executed, (std::vector<Pass>{ Pass::Shadow, Pass::Geometry, Pass::Decal, Pass::Lighting, Pass::Forward, Pass::Shadow, Pass::Geometry, Pass::Decal, Pass::Lighting, Pass::Forward }));
+
+    frame.executed.clear();
+    prepared.clear();
+    frame.graph.execute(false, prepare);
+    EXPECT_EQ(frame.executed, (std::vector<Pass>{ Pass::Gray, Pass::Composite, Pass::Present }));
+    EXPECT_EQ(prepared, (std::vector<uint32_t>{ frame.pass(Pass::Gray), frame.pass(Pass::Composite), frame.pass(Pass::Present) }));
+}
+
+//--------------
+// 書く前に読む描画先,同じパスで読み書きする描画先,離れた繰り返すパスはコンパイルできない
+//--------------
+TEST(RenderGraphTest, CompileRejectsInvalidGraphs)
+{
+    RenderGraph graph{};
+    uint32_t texture = graph.createTexture("Texture", RenderGraphTextureDesc(FORMAT_RGBA8, 0u));
+    uint32_t output = graph.importTexture("BackBuffer", true);
+    uint32_t pass = graph.addPass("ReadBeforeWrite", {});
+    graph.read(pass, texture);
+    graph.write(pass, output);
+    EXPECT_FALSE(graph.compile());
+    EXPECT_FALSE(graph.isCompiled());
+    EXPECT_TRUE(graph.getCompiledPasses().empty());
+
+    // 外の描画先は書く前に読んでよい
+    graph.reset();
+    uint32_t history = graph.importTexture("History");
+    output = graph.importTexture("BackBuffer", true);
+    pass = graph.addPass("ReadImported", {});
+    graph.read(pass, history);
+    graph.write(pass, output);
+    EXPECT_TRUE(graph.compile());
+    EXPECT_TRUE(graph.isCompiled());
+
+    // 同じ描画先を同じパスで読み書きする
+    graph.reset();
+    texture = graph.createTexture("Texture", RenderGraphTextureDesc(FORMAT_RGBA8, 0u));
+    output = graph.importTexture("BackBuffer", true);
+    uint32_t writer = graph.addPass("Writer", {});
+    graph.write(writer, texture);
+    pass = graph.addPass("ReadWrite", {});
+    graph.read(pass, texture);
+    graph.write(pass, texture);
+    graph.write(pass, output);
+    EXPECT_FALSE(graph.compile());
+    EXPECT_FALSE(graph.isCompiled());
+
+    // 繰り返すパスの間に繰り返さないパスがある
+    graph.reset();
+    output = graph.importTexture("BackBuffer", true);
+    for (bool isRepeated : { true, false, true })
+    {
+        graph.write(graph.addPass("", {}, isRepeated), output);
+    }
+    EXPECT_FALSE(graph.compile());
+
+    // 範囲の外は登録できない
+    EXPECT_FALSE(graph.read(100u, output));
+    EXPECT_FALSE(graph.write(0u, 100u));
+}
@@ -0,0 +1,250 @@
+//--------------------------------------------
+//
+// シェーダーキャッシュのテスト (キー,当たり外れ,壊れたファイル,掃除) [shader_cache_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "shader_cache.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <fstream>
+
+namespace
+{
+    //--------------
+    // ファイルに書く
+    //--------------
+    void WriteText(const std::filesystem::path& path, std::string_view text)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    //--------------
+    // フォルダのキャッシュファイルの数
+    //--------------
+    size_t CountCacheFiles(const std::filesystem::path& directory)
+    {
+        size_t count = 0u;
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.path().extension() == std::filesystem::path(shader_cache::CACHE_EXTENSION)) ++count;
+        }
+        return count;
+    }
+}
+
+//----------------------------
+// 一時フォルダにシェーダーを置き,呼ばれた数を数えるコンパイラでキャッシュを作る
+//----------------------------
+class ShaderCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const ::testing::TestInfo* pInfo = ::testing::UnitTest::GetInstance()->current_test_info();
+        m_directory = std::filesystem::temp_directory_path() / (std::string("cronus_shader_cache_") + pInfo->name());
+        std::filesystem::remove_all(m_directory);
+        std::filesystem::create_directories(m_directory / "include");
+
+        WriteText(m_directory / "Test.hlsl", "#include \"include/Common.hlsli\"\nfloat4 PS() : SV_Target { return 0; }\n");
+        WriteText(m_directory / "include" / "Common.hlsli", "#include \"Nested.hlsli\"\n");
+        WriteText(m_directory / "include" / "Nested.hlsli", "static const float VALUE = 1.0f;\n");
+        m_request = ShaderCompileRequest(m_directory / "Test.hlsl", "PS", "ps_5_0");
+    }
+
+    void TearDown() override
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(m_directory, ec);
+    }
+
+    // 呼ばれた数を数えるコンパイラ (バイトコードはエントリーポイントとプロファイル 失敗するエントリーポイントもある)
+    ShaderCache makeCache()
+    {
+        return ShaderCache(m_directory / shader_cache::CACHE_DIRECTORY_NAME, [this](const ShaderCompileRequest& request, std::vector<uint8_t>& outBytecode, std::string& outError)
+            {
+                ++m_compileCount;
+                if (request.entryPoint == "Broken")
+                {
+                    outError = "stub error";
+                    return false;
+                }
+                std::string text = request.entryPoint + ":" + request.profile;
+                outBytecode.assign(text.begin(), text.end());
+                return true;
+            });
+    }
+
+    std::filesystem::path cachePath(const ShaderCompileRequest& request) const
+    {
+        return shader_cache::CachePath(m_directory / shader_cache::CACHE_DIRECTORY_NAME, shader_cache::ComputeKey(request));
+    }
+
+    std::filesystem::path m_directory;     // テスト用のSHADERフォルダ
+    ShaderCompileRequest m_request;        // Test.hlslの要求
+    std::atomic<int> m_compileCount{ 0 };  // コンパイラが呼ばれた数
+};
+
+//--------------
+// インクルードは入れ子まで集める
+//--------------
+TEST_F(ShaderCacheTest, CollectsNestedIncludes)
+{
+    std::vector<std::filesystem::path> includes{};
+    ASSERT_TRUE(shader_cache::CollectIncludes(m_request.path, includes));
+    ASSERT_EQ(includes.size(), 2u);
+    EXPECT_EQ(includes[0].filename(), "Common.hlsli");
+    EXPECT_EQ(includes[1].filename(), "Nested.hlsli");
+}
+
+//--------------
+// キーはソース,入れ子のインクルード,エントリーポイント,プロファイル,マクロ,フラグで変わる
+//--------------
+TEST_F(ShaderCacheTest, KeyChangesWithSourcesAndSettings)
+{
+    const uint64_t baseKey = shader_cache::ComputeKey(m_request);
+    EXPECT_EQ(shader_cache::ComputeKey(m_request), baseKey);
+
+    WriteText(m_request.path, "#include \"include/Common.hlsli\"\nfloat4 PS() : SV_Target { return 1; }\n");
+    const uint64_t sourceKey = shader_cache::ComputeKey(m_request);
+    EXPECT_NE(sourceKey, baseKey);
+
+    WriteText(m_directory / "include" / "Nested.hlsli", "static const float VALUE = 2.0f;\n");
+    EXPECT_NE(shader_cache::ComputeKey(m_request), sourceKey);
+
+    ShaderCompileRequest request = m_request;
+    const uint64_t currentKey = shader_cache::ComputeKey(request);
+    request.entryPoint = "Main";
+    EXPECT_NE(shader_cache::ComputeKey(request), currentKey);
+
+    request = m_request;
+    request.profile = "ps_5_1";
+    EXPECT_NE(shader_cache::ComputeKey(request), currentKey);
+
+    request = m_request;
+    request.defines.emplace_back("USE_SHADOW", "1");
+    const uint64_t defineKey = shader_cache::ComputeKey(request);
+    EXPECT_NE(defineKey, currentKey);
+    request.defines.back().second = "0";
+    EXPECT_NE(shader_cache::ComputeKey(request), defineKey);
+
+    request = m_request;
+    request.flags = 1u;
+    EXPECT_NE(shader_cache::ComputeKey(request), currentKey);
+}
+
+//--------------
+// 2回目はコンパイラを呼ばずにファイルから読む
+//--------------
+TEST_F(ShaderCacheTest, SecondLoadHitsCache)
+{
+    ShaderCompileRequest other = m_request;
+    other.entryPoint = "Other";
+    const std::vector<ShaderCompileRequest> requests{ m_request, other };
+
+    ShaderCache cache = makeCache();
+    std::vector<std::vector<uint8_t>> first{};
+    ASSERT_TRUE(cache.load(requests, 2u, first));
+    EXPECT_EQ(m_compileCount.load(), 2);
+    ShaderCacheStats stats{};
+    cache.getStats(stats);
+    EXPECT_EQ(stats.compiled, 2u);
+    EXPECT_EQ(stats.hits, 0u);
+
+    std::vector<std::vector<uint8_t>> second{};
+    ASSERT_TRUE(cache.load(requests, 2u, second));
+    EXPECT_EQ(m_compileCount.load(), 2);
+    cache.getStats(stats);
+    EXPECT_EQ(stats.compiled, 0u);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(std::string(second[1].begin(), second[1].end()), "Other:ps_5_0");
+}
+
+//--------------
+// 失敗したものは空で返し,キャッシュに残さない
+//--------------
+TEST_F(ShaderCacheTest, FailedCompileIsNotCached)
+{
+    ShaderCompileRequest broken = m_request;
+    broken.entryPoint = "Broken";
+    const std::vector<ShaderCompileRequest> requests{ broken };
+
+    ShaderCache cache = makeCache();
+    std::vector<std::vector<uint8_t>> bytecodes{};
+    EXPECT_FALSE(cache.load(requests, 1u, bytecodes));
+    ASSERT_EQ(bytecodes.size(), 1u);
+    EXPECT_TRUE(bytecodes[0].empty());
+    EXPECT_FALSE(std::filesystem::exists(cachePath(broken)));
+
+    ShaderCacheStats stats{};
+    cache.getStats(stats);
+    EXPECT_EQ(stats.failed, 1u);
+}
+
+//--------------
+// 途中で切れたファイルとキーの違うファイルは読まずにコンパイルし直す
+//--------------
+TEST_F(ShaderCacheTest, BrokenCacheFileIsRejected)
+{
+    ShaderCompileRequest other = m_request;
+    other.entryPoint = "Other";
+    const std::vector<ShaderCompileRequest> requests{ m_request };
+    const std::vector<ShaderCompileRequest> otherRequests{ other };
+
+    ShaderCache cache = makeCache();
+    std::vector<std::vector<uint8_t>> bytecodes{};
+    ASSERT_TRUE(cache.load(requests, 1u, bytecodes));
+    ASSERT_TRUE(cache.load(otherRequests, 1u, bytecodes));
+    EXPECT_EQ(m_compileCount.load(), 2);
+
+    // 1バイト切る
+    const std::filesystem::path path = cachePath(m_request);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1u);
+    ASSERT_TRUE(cache.load(requests, 1u, bytecodes));
+    EXPECT_EQ(m_compileCount.load(), 3);
+    EXPECT_EQ(std::string(bytecodes[0].begin(), bytecodes[0].end()), "PS:ps_5_0");
+
+    // 別のキーのファイルを置く
+    std::filesystem::copy_file(cachePath(other), path, std::filesystem::copy_options::overwrite_existing);
+    ASSERT_TRUE(cache.load(requests, 1u, bytecodes));
+    EXPECT_EQ(m_compileCount.load(), 4);
+    EXPECT_EQ(std::string(bytecodes[0].begin(), bytecodes[0].end()), "PS:ps_5_0");
+
+    // 直したファイルは当たる
+    ASSERT_TRUE(cache.load(requests, 1u, bytecodes));
+    EXPECT_EQ(m_compileCount.load(), 4);
+}
+
+//--------------
+// 掃除は今の要求のどれのキーでもないキャッシュだけ消す
+//--------------
+TEST_F(ShaderCacheTest, PruneRemovesOnlyStaleEntries)
+{
+    WriteText(m_directory / "Other.hlsl", "float4 PS() : SV_Target { return 2; }\n");
+    ShaderCompileRequest other(m_directory / "Other.hlsl", "PS", "ps_5_0");
+    const std::vector<ShaderCompileRequest> requests{ m_request, other };
+
+    ShaderCache cache = makeCache();
+    std::vector<std::vector<uint8_t>> bytecodes{};
+    ASSERT_TRUE(cache.load(requests, 1u, bytecodes));
+    const std::filesystem::path stalePath = cachePath(m_request);
+
+    // ソースを変えると古いキーのファイルが残る
+    WriteText(m_directory / "include" / "Nested.hlsli", "static const float VALUE = 3.0f;\n");
+    ASSERT_TRUE(cache.load(requests, 1u, bytecodes));
+    const std::filesystem::path cacheDirectory = m_directory / shader_cache::CACHE_DIRECTORY_NAME;
+    EXPECT_EQ(CountCacheFiles(cacheDirectory), 3u);
+
+    // キャッシュでないファイルは触らない
+    const std::filesystem::path notePath = cacheDirectory / "note.txt";
+    WriteText(notePath, "keep");
+
+    EXPECT_EQ(cache.prune(requests), 1u);
+    EXPECT_FALSE(std::filesystem::exists(stalePath));
+    EXPECT_TRUE(std::filesystem::exists(cachePath(m_request)));
+    EXPECT_TRUE(std::filesystem::exists(cachePath(other)));
+    EXPECT_TRUE(std::filesystem::exists(notePath));
+    EXPECT_EQ(cache.prune(requests), 0u);
+}
@@ -0,0 +1,152 @@
+//--------------------------------------------
+//
+// カスケードシャドウのテスト (動かない影のキャッシュの範囲と使い回し) [shadow_cascade_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "shadow_cascade.h"
+#include <gtest/gtest.h>
+#include <numbers>
+
+namespace
+{
+    const Vector3 LIGHT_DIRECTION(1.0f, -2.0f, 0.5f); // 光の方向
+    const Vector3 LIGHT_UP(0.0f, 1.0f, 0.0f);         // ライトの上方向
+
+    //--------------
+    // カメラの位置からカスケードを作る (いつも同じ向き)
+    //--------------
+    ShadowCascadeSet BuildCascades(const Vector3& eye, const Vector3& lightDirection = LIGHT_DIRECTION)
+    {
+        const Matrix view = Matrix::LookAtLH(eye, eye + Vector3(0.3f, -0.2f, 1.0f), Vector3(0.0f, 1.0f, 0.0f));
+        const Matrix proj = Matrix::PerspectiveFovLH(std::numbers::pi_v<float> / 3.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+        ShadowCascadeSet set{};
+        EXPECT_TRUE(BuildShadowCascades(view, proj, lightDirection, LIGHT_UP, ShadowSettings(), set));
+        return set;
+    }
+
+    //--------------
+    // すべてのカスケードのキャッシュの範囲を作って覚える
+    //--------------
+    void StoreRegions(StaticShadowCache& cache, const ShadowCascadeSet& set)
+    {
+        for (unsigned int cnt = 0; cnt < set.count; ++cnt)
+        {
+            cache.store(cnt, BuildStaticShadowRegion(set.cascades[cnt], ShadowSettings()));
+        }
+    }
+}
+
+//--------------
+// キャッシュの範囲はカスケードより広く,作った時のカスケードを含む
+//--------------
+TEST(ShadowCascadeTest, RegionContainsCascade)
+{
+    const ShadowCascadeSet set = BuildCascades(Vector3(12.3f, 4.0f, -7.7f));
+    ASSERT_EQ(set.count, ShadowSettings().cascadeCount);
+
+    StaticShadowCache cache{};
+    for (unsigned int cnt = 0; cnt < set.count; ++cnt)
+    {
+        EXPECT_FALSE(cache.isReusable(cnt, set.cascades[cnt]));
+    }
+    StoreRegions(cache, set);
+    for (unsigned int cnt = 0; cnt < set.count; ++cnt)
+    {
+        const ShadowCascade& cascade = set.cascades[cnt];
+        const ShadowCascade& region = cache.regions[cnt];
+        EXPECT_GT(region.radius, cascade.radius);
+        EXPECT_EQ(std::memcmp(&region.view, &cascade.view, sizeof(Matrix)), 0);
+        EXPECT_TRUE(cache.isReusable(cnt, cascade)) << "cascade " << cnt;
+    }
+
+    // 範囲の外は使わない
+    EXPECT_FALSE(cache.isReusable(MAX_SHADOW_CASCADES, set.cascades[0]));
+}
+
+//--------------
+// カメラが少し動いてもカスケードの行列は変わるが,キャッシュは使い回せる
+//--------------
+TEST(ShadowCascadeTest, SmallCameraMoveReusesCache)
+{
+    const Vector3 eye(12.3f, 4.0f, -7.7f);
+    const ShadowCascadeSet before = BuildCascades(eye);
+    StaticShadowCache cache{};
+    StoreRegions(cache, before);
+
+    for (const Vector3& offset : { Vector3(0.1f, 0.0f, 0.0f), Vector3(0.0f, 0.1f, 0.0f), Vector3(0.0f, 0.0f, -0.1f), Vector3(0.05f, -0.05f, 0.05f) })
+    {
+        const ShadowCascadeSet after = BuildCascades(eye + offset);
+        bool isMatrixChanged = false;
+        for (unsigned int cnt = 0; cnt < after.count; ++cnt)
+        {
+            isMatrixChanged |= std::memcmp(&before.cascades[cnt].proj, &after.cascades[cnt].proj, sizeof(Matrix)) != 0;
+            EXPECT_TRUE(cache.isReusable(cnt, after.cascades[cnt])) << "cascade " << cnt;
+        }
+        EXPECT_TRUE(isMatrixChanged); // 行列を比べるだけでは描き直してしまう
+    }
+}
+
+//--------------
+// 大きく動くか,ライトの向きが変わるか,捨てたら描き直す
+//--------------
+TEST(ShadowCascadeTest, LargeMoveOrLightChangeRedraws)
+{
+    const Vector3 eye(12.3f, 4.0f, -7.7f);
+    StaticShadowCache cache{};
+    StoreRegions(cache, BuildCascades(eye));
+
+    const ShadowCascadeSet moved = BuildCascades(eye + Vector3(40.0f, 0.0f, 40.0f));
+    for (unsigned int cnt = 0; cnt < moved.count; ++cnt)
+    {
+        EXPECT_FALSE(cache.isReusable(cnt, moved.cascades[cnt])) << "cascade " << cnt;
+    }
+
+    const ShadowCascadeSet turned = BuildCascades(eye, Vector3(1.0f, -2.0f, 0.6f));
+    for (unsigned int cnt = 0; cnt < turned.count; ++cnt)
+    {
+        EXPECT_FALSE(cache.isReusable(cnt, turned.cascades[cnt])) << "cascade " << cnt;
+    }
+
+    // 顔ぶれが変わったら捨てる,同じなら残す
+    const ShadowCascadeSet same = BuildCascades(eye);
+    cache.beginFrame(cache.casterKey);
+    EXPECT_TRUE(cache.isReusable(0u, same.cascades[0]));
+    cache.beginFrame(cache.casterKey + 1u);
+    EXPECT_FALSE(cache.isReusable(0u, same.cascades[0]));
+}
+
+//--------------
+// 歩くカメラではたまにしか描き直さない (毎フレームのカスケードは使う範囲にいつも収まる)
+//--------------
+TEST(ShadowCascadeTest, WalkingCameraRedrawsRarely)
+{
+    constexpr int FRAME_COUNT = 600;
+    const Vector3 step(0.03f, 0.0f, 0.04f); // 1フレームで進む距離 (秒速3m)
+
+    StaticShadowCache cache{};
+    std::array<int, MAX_SHADOW_CASCADES> redraws{};
+    Vector3 eye(12.3f, 4.0f, -7.7f);
+    for (int frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        const ShadowCascadeSet set = BuildCascades(eye);
+        for (unsigned int cnt = 0; cnt < set.count; ++cnt)
+        {
+            if (!cache.isReusable(cnt, set.cascades[cnt]))
+            {
+                cache.store(cnt, BuildStaticShadowRegion(set.cascades[cnt], ShadowSettings()));
+                ++redraws[cnt];
+            }
+            ASSERT_TRUE(cache.isReusable(cnt, set.cascades[cnt])) << "frame " << frame << " cascade " << cnt;
+        }
+        eye = eye + step;
+    }
+
+    // 遠いカスケードほど範囲が広いので描き直しは少ない
+    for (unsigned int cnt = 0; cnt < ShadowSettings().cascadeCount; ++cnt)
+    {
+        EXPECT_GE(redraws[cnt], 1);
+        EXPECT_LT(redraws[cnt], FRAME_COUNT / 10) << "cascade " << cnt;
+    }
+    EXPECT_LE(redraws[2], redraws[0]);
+}
@@ -0,0 +1,198 @@
+//--------------------------------------------
+//
+// スキンメッシュの境界ボックスのテスト (スキニングした頂点との比較) [skinned_bounds_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "skinned_bounds.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace
+{
+    constexpr float EPSILON = 1.0e-4f; // 変換の誤差
+
+    //--------------
+    // 回転と移動 (と拡大) の行列
+    //--------------
+    Matrix MakeTransform(float yaw, float pitch, float roll, const Vector3& position, float scale = 1.0f)
+    {
+        Matrix matrix{};
+        matrix.setScale(scale, scale, scale);
+        matrix.addRotationYawPitchRoll(yaw, pitch, roll);
+        matrix.addPosition(position.x, position.y, position.z);
+        return matrix;
+    }
+
+    //--------------
+    // ボーン (バインドポーズからオフセット行列を作る)
+    //--------------
+    struct TestBone
+    {
+        Matrix offsetMatrix; // モデル空間 -> ボーン空間 (バインドポーズの逆)
+        Matrix global;       // 今のポーズのグローバル行列 (ワールド込み)
+        AABB bounds;         // ボーン空間の境界ボックス
+
+        TestBone(const Matrix& bindPose, const Matrix& pose) : offsetMatrix{}, global{ pose }, bounds{} { Matrix::Inverse(bindPose, offsetMatrix); }
+        ~TestBone() = default;
+    };
+
+    //--------------
+    // 2本のボーンにウェイトを振った頂点
+    //--------------
+    struct TestVertex
+    {
+        Vector3 position; // モデル空間
+        float weight;     // 1本目のウェイト (残りは2本目)
+    };
+
+    //--------------
+    // シェーダーと同じスキニング (パレット行列 = オフセット行列 * グローバル行列 をウェイトで混ぜる)
+    //--------------
+    Vector3 Skin(const Vector3& position, float weight, const TestBone& bone0, const TestBone& bone1)
+    {
+        Vector3 result{};
+        for (const auto& [bone, boneWeight] : { std::pair<const TestBone*, float>{ &bone0, weight }, std::pair<const TestBone*, float>{ &bone1, 1.0f - weight } })
+        {
+            if (boneWeight <= 0.0f) continue;
+            Vector3 skinned = position;
+            skinned.transformCoord(Matrix::Multiply(bone->offsetMatrix, bone->global));
+            result = result + skinned * boneWeight;
+        }
+        return result;
+    }
+
+    //--------------
+    // 点がボックスに入っているか
+    //--------------
+    void ExpectContains(const AABB& box, const Vector3& point)
+    {
+        EXPECT_GE(point.x, box.min.x - EPSILON); EXPECT_LE(point.x, box.max.x + EPSILON);
+        EXPECT_GE(point.y, box.min.y - EPSILON); EXPECT_LE(point.y, box.max.y + EPSILON);
+        EXPECT_GE(point.z, box.min.z - EPSILON); EXPECT_LE(point.z, box.max.z + EPSILON);
+    }
+
+    //--------------
+    // ランダムな頂点 (片方のボーンだけに付く頂点も混ぜる)
+    //--------------
+    std::vector<TestVertex> MakeVertices(uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f), weight(0.0f, 1.0f);
+        std::vector<TestVertex> vertices(200u);
+        for (size_t cnt = 0; cnt < vertices.size(); ++cnt)
+        {
+            vertices[cnt].position = Vector3(position(random), position(random) * 2.0f + 1.0f, position(random) * 0.5f);
+            vertices[cnt].weight = (cnt % 3u == 0u) ? 1.0f : (cnt % 3u == 1u) ? 0.0f : weight(random);
+        }
+        return vertices;
+    }
+
+    //--------------
+    // ボーン空間のボックスを作る (ウェイトのある頂点だけ)
+    //--------------
+    void BuildBoneBounds(std::span<const TestVertex> vertices, TestBone& bone0, TestBone& bone1)
+    {
+        for (const TestVertex& vertex : vertices)
+        {
+            if (vertex.weight > 0.0f) skinning::ExpandBoneBounds(bone0.bounds, vertex.position, bone0.offsetMatrix);
+            if (vertex.weight < 1.0f) skinning::ExpandBoneBounds(bone1.bounds, vertex.position, bone1.offsetMatrix);
+        }
+    }
+}
+
+//--------------
+// オフセット行列が単位でないボーンでも,スキニングした頂点はワールドの境界ボックスに入る
+//--------------
+TEST(SkinnedBoundsTest, BoundsContainSkinnedVertices)
+{
+    const Matrix world = MakeTransform(0.3f, 0.0f, 0.0f, Vector3(10.0f, 0.0f, -4.0f), 2.0f);
+    TestBone bone0(MakeTransform(0.0f, 0.0f, 0.2f, Vector3(0.0f, 0.5f, 0.0f)), Matrix::Multiply(MakeTransform(0.4f, 0.1f, 0.2f, Vector3(0.0f, 0.6f, 0.1f)), world));
+    TestBone bone1(MakeTransform(0.5f, 0.0f, 0.0f, Vector3(0.0f, 2.0f, 0.0f)), Matrix::Multiply(MakeTransform(-0.7f, 0.9f, 0.0f, Vector3(0.5f, 1.5f, 0.3f)), world));
+
+    const std::vector<TestVertex> vertices = MakeVertices(5u);
+    BuildBoneBounds(vertices, bone0, bone1);
+
+    AABB bounds{};
+    bounds.merge(skinning::TransformBoneBounds(bone0.bounds, bone0.offsetMatrix, bone0.global, Vector3()));
+    bounds.merge(skinning::TransformBoneBounds(bone1.bounds, bone1.offsetMatrix, bone1.global, Vector3()));
+    ASSERT_TRUE(bounds.isValid());
+    for (const TestVertex& vertex : vertices)
+    {
+        ExpectContains(bounds, Skin(vertex.position, vertex.weight, bone0, bone1));
+    }
+}
+
+//--------------
+// 動かさないボーンなら,ボックスはスキニングした頂点のボックスとほぼ同じ (オフセット行列を二度掛けない)
+//--------------
+TEST(SkinnedBoundsTest, BindPoseBoundsMatchVertices)
+{
+    const Matrix bindPose = MakeTransform(0.8f, 0.0f, 0.0f, Vector3(3.0f, 1.0f, 0.0f));
+    TestBone bone(bindPose, bindPose);
+    TestBone unused(Matrix{}, Matrix{});
+
+    std::vector<TestVertex> vertices = MakeVertices(7u);
+    for (TestVertex& vertex : vertices) vertex.weight = 1.0f;
+    BuildBoneBounds(vertices, bone, unused);
+    EXPECT_FALSE(unused.bounds.isValid());
+
+    // 回転したボーン空間のボックスを戻すので少し大きくなるが,頂点の広がりの倍は超えない
+    AABB expected{};
+    for (const TestVertex& vertex : vertices)
+    {
+        expected.expand(Skin(vertex.position, 1.0f, bone, unused));
+    }
+    AABB bounds = skinning::TransformBoneBounds(bone.bounds, bone.offsetMatrix, bone.global, Vector3());
+    ExpectContains(bounds, expected.min);
+    ExpectContains(bounds, expected.max);
+    Vector3 center = bounds.getCenter() - expected.getCenter();
+    EXPECT_LT(center.length(), 0.5f);
+    EXPECT_LT(bounds.getExtent().length(), expected.getExtent().length() * 2.0f);
+
+    // 動かすとボックスも同じだけ動く
+    bone.global = Matrix::Multiply(bindPose, MakeTransform(0.0f, 0.0f, 0.0f, Vector3(5.0f, 0.0f, 0.0f)));
+    AABB moved = skinning::TransformBoneBounds(bone.bounds, bone.offsetMatrix, bone.global, Vector3());
+    EXPECT_NEAR(moved.min.x - bounds.min.x, 5.0f, EPSILON);
+    EXPECT_NEAR(moved.max.y - bounds.max.y, 0.0f, EPSILON);
+}
+
+//--------------
+// モーフで動いた頂点もスキニング後にボックスに入る
+//--------------
+TEST(SkinnedBoundsTest, MorphMarginCoversDisplacedVertices)
+{
+    const Vector3 margin(0.2f, 0.05f, 0.1f);
+    TestBone bone0(MakeTransform(0.0f, 0.3f, 0.0f, Vector3(0.0f, 0.5f, 0.0f)), MakeTransform(1.1f, 0.0f, 0.4f, Vector3(2.0f, 0.0f, 0.0f)));
+    TestBone bone1(MakeTransform(0.0f, 0.0f, 0.6f, Vector3(0.0f, 2.0f, 0.0f)), MakeTransform(-0.3f, 0.2f, 0.0f, Vector3(0.0f, 1.0f, 1.0f)));
+
+    const std::vector<TestVertex> vertices = MakeVertices(9u);
+    BuildBoneBounds(vertices, bone0, bone1);
+
+    AABB bounds{};
+    bounds.merge(skinning::TransformBoneBounds(bone0.bounds, bone0.offsetMatrix, bone0.global, margin));
+    bounds.merge(skinning::TransformBoneBounds(bone1.bounds, bone1.offsetMatrix, bone1.global, margin));
+    for (const TestVertex& vertex : vertices)
+    {
+        for (float sx : { -1.0f, 1.0f })
+        {
+            for (float sz : { -1.0f, 1.0f })
+            {
+                Vector3 displaced = vertex.position + Vector3(margin.x * sx, margin.y * sx * sz, margin.z * sz);
+                ExpectContains(bounds, Skin(displaced, vertex.weight, bone0, bone1));
+            }
+        }
+    }
+
+    // モーフの分だけ広がる
+    AABB tight{};
+    tight.merge(skinning::TransformBoneBounds(bone0.bounds, bone0.offsetMatrix, bone0.global, Vector3()));
+    tight.merge(skinning::TransformBoneBounds(bone1.bounds, bone1.offsetMatrix, bone1.global, Vector3()));
+    EXPECT_GT(bounds.getExtent().x, tight.getExtent().x);
+
+    // ボックスがなければそのまま
+    EXPECT_FALSE(skinning::TransformBoneBounds(AABB(), bone0.offsetMatrix, bone0.global, margin).isValid());
+    EXPECT_FALSE(skinning::Inflated(AABB(), margin).isValid());
+}
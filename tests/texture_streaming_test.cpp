@@ -0,0 +1,280 @@
+//--------------------------------------------
+//
+// テクスチャストリーミングのテスト (画面上の大きさと常駐の決め方) [texture_streaming_test.cpp]
+// Author: Fuma Sato
+//
+//--------------------------------------------
+#include "texture_streaming.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <numbers>
+
+namespace
+{
+    constexpr uint32_t TEXTURE_SIZE = 1024u;      // テスト用テクスチャの大きさ (11ミップ)
+    constexpr unsigned int STARTUP_MIP = 3u;      // 既定の設定で起動時に常駐する一番細かいミップ (128px)
+    constexpr float VIEWPORT_SIZE = 1000.0f;      // テスト用の画面の大きさ
+
+    //--------------
+    // RGBA8のミップごとのバイト数
+    //--------------
+    std::vector<size_t> MakeMipBytes(uint32_t size)
+    {
+        std::vector<size_t> mipBytes{};
+        for (unsigned int mip = 0; mip < texture_streaming::CountMips(size, size); ++mip)
+        {
+            size_t mipSize = std::max(size >> mip, 1u);
+            mipBytes.push_back(mipSize * mipSize * 4u);
+        }
+        return mipBytes;
+    }
+
+    //--------------
+    // そのミップから一番粗いミップまでのバイト数
+    //--------------
+    size_t TailBytes(uint32_t size, unsigned int mip)
+    {
+        std::vector<size_t> mipBytes = MakeMipBytes(size);
+        size_t bytes = 0u;
+        for (size_t cnt = mip; cnt < mipBytes.size(); ++cnt)
+        {
+            bytes += mipBytes[cnt];
+        }
+        return bytes;
+    }
+
+    //--------------
+    // 拡大して移動するワールド行列
+    //--------------
+    Matrix MakeWorld(const Vector3& position, float scale = 1.0f)
+    {
+        Matrix world{};
+        world.m[0][0] = world.m[1][1] = world.m[2][2] = scale;
+        world.m[3][0] = position.x;
+        world.m[3][1] = position.y;
+        world.m[3][2] = position.z;
+        return world;
+    }
+
+    //--------------
+    // 原点から+zを見る画角90度の射影 (ビューは単位行列)
+    //--------------
+    Matrix MakeViewProj()
+    {
+        return Matrix::PerspectiveFovLH(std::numbers::pi_v<float> * 0.5f, 1.0f, 0.1f, 1000.0f);
+    }
+
+    //--------------
+    // 1辺1の箱
+    //--------------
+    AABB UnitBox()
+    {
+        return AABB(Vector3(-0.5f, -0.5f, -0.5f), Vector3(0.5f, 0.5f, 0.5f));
+    }
+}
+
+//--------------
+// ミップ数と要求するミップ
+//--------------
+TEST(TextureStreamingTest, RequiredMipFollowsScreenSize)
+{
+    EXPECT_EQ(texture_streaming::CountMips(TEXTURE_SIZE, TEXTURE_SIZE), 11u);
+    EXPECT_EQ(texture_streaming::CountMips(TEXTURE_SIZE, 16u), 11u);
+    EXPECT_EQ(texture_streaming::CountMips(1u, 1u), 1u);
+
+    unsigned int mipCount = texture_streaming::CountMips(TEXTURE_SIZE, TEXTURE_SIZE);
+    EXPECT_EQ(texture_streaming::CalcRequiredMip(TEXTURE_SIZE, TEXTURE_SIZE, mipCount, 1024.0f), 0u);
+    EXPECT_EQ(texture_streaming::CalcRequiredMip(TEXTURE_SIZE, TEXTURE_SIZE, mipCount, 256.0f), 2u);
+    EXPECT_EQ(texture_streaming::CalcRequiredMip(TEXTURE_SIZE, TEXTURE_SIZE, mipCount, 0.5f), mipCount - 1u);
+    EXPECT_EQ(texture_streaming::CalcRequiredMip(TEXTURE_SIZE, TEXTURE_SIZE, mipCount, texture_streaming::FULL_SCREEN_SIZE), 0u);
+}
+
+//--------------
+// 遠いほど小さく,カメラの手前にかかる箱と境界ボックスのないものは一番大きい
+//--------------
+TEST(TextureStreamingTest, ScreenSizeShrinksWithDistance)
+{
+    Matrix viewProj = MakeViewProj();
+    Vector2 viewport(VIEWPORT_SIZE, VIEWPORT_SIZE);
+
+    float nearSize = texture_streaming::CalcScreenSize(UnitBox(), Matrix::Multiply(MakeWorld(Vector3(0.0f, 0.0f, 5.0f)), viewProj), viewport);
+    float farSize = texture_streaming::CalcScreenSize(UnitBox(), Matrix::Multiply(MakeWorld(Vector3(0.0f, 0.0f, 50.0f)), viewProj), viewport);
+    EXPECT_GT(nearSize, farSize);
+    EXPECT_GT(farSize, 0.0f);
+
+    // z=4.5の面の幅1はNDCで2/9,画面の半分をかけて約111px
+    EXPECT_NEAR(nearSize, VIEWPORT_SIZE / 9.0f, 0.5f);
+
+    EXPECT_EQ(texture_streaming::CalcScreenSize(UnitBox(), Matrix::Multiply(MakeWorld(Vector3(0.0f, 0.0f, 0.0f)), viewProj), viewport), texture_streaming::FULL_SCREEN_SIZE);
+    EXPECT_EQ(texture_streaming::CalcScreenSize(AABB(), viewProj, viewport), texture_streaming::FULL_SCREEN_SIZE);
+}
+
+//--------------
+// インスタンシングは一番大きく映りそうなインスタンスで測る
+//--------------
+TEST(TextureStreamingTest, LargestInstanceIsNearestOrScaled)
+{
+    Matrix viewProj = MakeViewProj();
+
+    std::array<InstanceData, 3> instances{};
+    instances[0].world = MakeWorld(Vector3(0.0f, 0.0f, 10.0f));
+    instances[1].world = MakeWorld(Vector3(2.0f, 0.0f, 3.0f));
+    instances[2].world = MakeWorld(Vector3(0.0f, 0.0f, 20.0f));
+    EXPECT_EQ(texture_streaming::FindLargestInstance(instances, viewProj), 1u);
+
+    // 遠くても拡大していれば大きく映る (4/8 > 1/3)
+    instances[2].world = MakeWorld(Vector3(0.0f, 0.0f, 8.0f), 4.0f);
+    EXPECT_EQ(texture_streaming::FindLargestInstance(instances, viewProj), 2u);
+
+    // カメラの後ろに原点があるものは一番大きいとみなす
+    instances[0].world = MakeWorld(Vector3(0.0f, 0.0f, -1.0f));
+    EXPECT_EQ(texture_streaming::FindLargestInstance(instances, viewProj), 0u);
+}
+
+//--------------
+// 登録すると起動時のミップだけ常駐する
+//--------------
+TEST(TextureStreamingTest, RegisterKeepsStartupMip)
+{
+    TextureResidency residency{};
+    std::vector<size_t> mipBytes = MakeMipBytes(TEXTURE_SIZE);
+
+    EXPECT_EQ(residency.registerTexture(0u, TEXTURE_SIZE, TEXTURE_SIZE, mipBytes, ~0u), STARTUP_MIP);
+    EXPECT_EQ(residency.getResidentMip(0u), STARTUP_MIP);
+    EXPECT_EQ(residency.getResidentBytes(), TailBytes(TEXTURE_SIZE, STARTUP_MIP));
+
+    // 一番細かくできるミップの制限が優先
+    EXPECT_EQ(residency.registerTexture(1u, TEXTURE_SIZE, TEXTURE_SIZE, mipBytes, 1u), 1u);
+
+    residency.unregisterTexture(1u);
+    EXPECT_FALSE(residency.isRegistered(1u));
+    EXPECT_EQ(residency.getResidentBytes(), TailBytes(TEXTURE_SIZE, STARTUP_MIP));
+    EXPECT_EQ(residency.getResidentMip(1u), texture_streaming::NO_MIP);
+}
+
+//--------------
+// 要求されたミップを読み込み,終わったら常駐する (失敗したら元に戻す)
+//--------------
+TEST(TextureStreamingTest, RequestStreamsInWantedMip)
+{
+    TextureResidency residency{};
+    residency.registerTexture(0u, TEXTURE_SIZE, TEXTURE_SIZE, MakeMipBytes(TEXTURE_SIZE), ~0u);
+
+    // 同じフレームの要求は大きい方が残る
+    residency.request(0u, 100.0f);
+    residency.request(0u, 256.0f);
+    std::vector<TextureResidencyChange> changes{};
+    residency.update(changes);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].id, 0u);
+    EXPECT_EQ(changes[0].mip, 2u);
+    EXPECT_EQ(residency.getResidentMip(0u), STARTUP_MIP);
+    EXPECT_EQ(residency.getResidentBytes(), TailBytes(TEXTURE_SIZE, 2u));
+
+    residency.onResident(0u, 2u, true);
+    EXPECT_EQ(residency.getResidentMip(0u), 2u);
+
+    // 失敗すると数え直す
+    residency.request(0u, 1024.0f);
+    residency.update(changes);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].mip, 0u);
+    residency.onResident(0u, 0u, false);
+    EXPECT_EQ(residency.getResidentMip(0u), 2u);
+    EXPECT_EQ(residency.getResidentBytes(), TailBytes(TEXTURE_SIZE, 2u));
+}
+
+//--------------
+// 1フレームの読み込み数を超えたら足りないミップの多いものから
+//--------------
+TEST(TextureStreamingTest, StreamsPerFrameAreLimited)
+{
+    TextureStreamingSettings settings{};
+    settings.maxStreamsPerFrame = 1u;
+    TextureResidency residency{};
+    residency.setSettings(settings);
+    residency.registerTexture(0u, TEXTURE_SIZE, TEXTURE_SIZE, MakeMipBytes(TEXTURE_SIZE), ~0u);
+    residency.registerTexture(1u, TEXTURE_SIZE, TEXTURE_SIZE, MakeMipBytes(TEXTURE_SIZE), ~0u);
+
+    std::vector<TextureResidencyChange> changes{};
+    residency.request(0u, 256.0f);
+    residency.request(1u, 1024.0f);
+    residency.update(changes);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].id, 1u);
+
+    // 読み込み中のものは待つ
+    residency.request(0u, 256.0f);
+    residency.request(1u, 1024.0f);
+    residency.update(changes);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].id, 0u);
+
+    TextureStreamingStats stats{};
+    residency.getStats(stats);
+    EXPECT_EQ(stats.textures, 2u);
+    EXPECT_EQ(stats.pending, 2u);
+    EXPECT_EQ(stats.streamedIn, 1u);
+}
+
+//--------------
+// しばらく使われないと起動時のミップまで捨てる
+//--------------
+TEST(TextureStreamingTest, UnusedTextureIsEvicted)
+{
+    TextureStreamingSettings settings{};
+    settings.evictFrames = 2u;
+    TextureResidency residency{};
+    residency.setSettings(settings);
+    residency.registerTexture(0u, TEXTURE_SIZE, TEXTURE_SIZE, MakeMipBytes(TEXTURE_SIZE), ~0u);
+
+    std::vector<TextureResidencyChange> changes{};
+    residency.request(0u, 1024.0f);
+    residency.update(changes);
+    residency.onResident(0u, 0u, true);
+
+    residency.update(changes);
+    EXPECT_TRUE(changes.empty());
+
+    residency.update(changes);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].id, 0u);
+    EXPECT_EQ(changes[0].mip, STARTUP_MIP);
+    EXPECT_EQ(residency.getResidentBytes(), TailBytes(TEXTURE_SIZE, STARTUP_MIP));
+    residency.onResident(0u, STARTUP_MIP, true);
+    EXPECT_EQ(residency.getResidentMip(0u), STARTUP_MIP);
+}
+
+//--------------
+// 上限を超えるときはこのフレームで使っていないものを捨てて空ける
+//--------------
+TEST(TextureStreamingTest, BudgetEvictsTexturesNotUsedThisFrame)
+{
+    TextureStreamingSettings settings{};
+    settings.budgetBytes = TailBytes(TEXTURE_SIZE, 0u) + TailBytes(TEXTURE_SIZE, STARTUP_MIP);
+    TextureResidency residency{};
+    residency.setSettings(settings);
+    residency.registerTexture(0u, TEXTURE_SIZE, TEXTURE_SIZE, MakeMipBytes(TEXTURE_SIZE), ~0u);
+    residency.registerTexture(1u, TEXTURE_SIZE, TEXTURE_SIZE, MakeMipBytes(TEXTURE_SIZE), ~0u);
+
+    std::vector<TextureResidencyChange> changes{};
+    residency.request(0u, 1024.0f);
+    residency.update(changes);
+    residency.onResident(0u, 0u, true);
+    EXPECT_EQ(residency.getResidentBytes(), settings.budgetBytes);
+
+    // 1だけ使うと0の高いミップを捨てて1を読み込む
+    residency.request(1u, 1024.0f);
+    residency.update(changes);
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].id, 0u);
+    EXPECT_EQ(changes[0].mip, STARTUP_MIP);
+    EXPECT_EQ(changes[1].id, 1u);
+    EXPECT_EQ(changes[1].mip, 0u);
+    EXPECT_LE(residency.getResidentBytes(), settings.budgetBytes);
+
+    TextureStreamingStats stats{};
+    residency.getStats(stats);
+    EXPECT_EQ(stats.evicted, 1u);
+    EXPECT_EQ(stats.streamedIn, 1u);
+}
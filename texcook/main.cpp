@@ -0,0 +1,58 @@
+//--------------------------------------------
+//
+// テクスチャクッカー (data以下の画像をBC圧縮のDDSにする) [main.cpp]
+// Author: Fuma Sato
+//
+// texcook [フォルダ=data] [--threads N] [--quick] [--force]
+//
+//--------------------------------------------
+#include "texture_cooker.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+//----------------------------
+// エントリーポイント
+//----------------------------
+int main(int argc, char* argv[])
+{
+    std::filesystem::path root = u8"data";
+    TextureCookSettings settings{};
+    unsigned int maxThread = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int cnt = 1; cnt < argc; ++cnt)
+    {
+        std::string arg = argv[cnt];
+        if (arg == "--quick")
+        {
+            settings.isQuick = true;
+        }
+        else if (arg == "--force")
+        {
+            settings.isForce = true;
+        }
+        else if (arg == "--threads" && cnt + 1 < argc)
+        {
+            maxThread = static_cast<unsigned int>(std::max(1, std::atoi(argv[++cnt])));
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            std::cout << "texcook [dir=data] [--threads N] [--quick] [--force]\n";
+            return 0;
+        }
+        else
+        {
+            root = arg;
+        }
+    }
+
+    TextureCookResult result = texture_cooker::CookDirectory(root, maxThread, settings, [](std::string_view message)
+        {
+            std::cout << message << '\n';
+        });
+
+    std::cout << "cooked " << result.cooked << ", skipped " << result.skipped << ", failed " << result.failed << '\n';
+    return result.failed > 0u ? 1 : 0;
+}